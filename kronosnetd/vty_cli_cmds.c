@@ -303,7 +303,9 @@ static int check_param(struct knet_vty *vty, const int paramtype, char *param, i
 				break;
 			if (!strncmp("round-robin", buf, 11))
 				break;
-			knet_vty_write(vty, "unknown switching policy: %s. Supported passive/active/round-robin%s", param, telnet_newline);
+			if (!strncmp("fec", buf, 3))
+				break;
+			knet_vty_write(vty, "unknown switching policy: %s. Supported passive/active/round-robin/fec%s", param, telnet_newline);
 			err = -1;
 			break;
 		case CMDS_PARAM_LINK_ID:
@@ -405,7 +407,7 @@ static void describe_param(struct knet_vty *vty, const int paramtype)
 			knet_vty_write(vty, "HASH - define packets hashing method: none/md5/sha1/sha256/sha384/sha512%s", telnet_newline);
 			break;
 		case CMDS_PARAM_POLICY:
-			knet_vty_write(vty, "POLICY - define packets switching policy: passive/active/round-robin%s", telnet_newline);
+			knet_vty_write(vty, "POLICY - define packets switching policy: passive/active/round-robin/fec%s", telnet_newline);
 			break;
 		case CMDS_PARAM_LINK_ID:
 			knet_vty_write(vty, "LINKID - specify the link identification number (0-7)%s", telnet_newline);
@@ -652,6 +654,8 @@ static int knet_cmd_stop(struct knet_vty *vty);
 static int knet_cmd_crypto(struct knet_vty *vty);
 static int knet_cmd_pmtufreq(struct knet_vty *vty);
 static int knet_cmd_no_pmtufreq(struct knet_vty *vty);
+static int knet_cmd_stagestats(struct knet_vty *vty);
+static int knet_cmd_no_stagestats(struct knet_vty *vty);
 
 
 /* peer node */
@@ -731,6 +735,7 @@ vty_node_cmds_t no_interface_cmds[] = {
 	{ "mtu", "revert to default MTU", NULL, knet_cmd_no_mtu },
 	{ "pmtudfreq", "revert to default PMTUd frequency (default: 5)", NULL, knet_cmd_no_pmtufreq },
 	{ "peer", "remove peer from this interface", peer_params, knet_cmd_no_peer },
+	{ "stagestats", "disable pipeline stage latency accounting", NULL, knet_cmd_no_stagestats },
 	{ NULL, NULL, NULL, NULL },
 };
 
@@ -762,6 +767,7 @@ vty_node_cmds_t interface_cmds[] = {
 	{ "no", "revert command", NULL, NULL },
 	{ "peer", "add peer endpoint", peer_params, knet_cmd_peer },
 	{ "show", "show running config", NULL, knet_cmd_show_conf },
+	{ "stagestats", "enable pipeline stage latency accounting", NULL, knet_cmd_stagestats },
 	{ "start", "start forwarding engine", NULL, knet_cmd_start },
 	{ "status", "display current network status", NULL, knet_cmd_status },
 	{ "stop", "stop forwarding engine", NULL, knet_cmd_stop },
@@ -1054,6 +1060,8 @@ static int knet_cmd_switch_policy(struct knet_vty *vty)
 		policy = KNET_LINK_POLICY_ACTIVE;
 	if (!strncmp("round-robin", policystr, 11))
 		policy = KNET_LINK_POLICY_RR;
+	if (!strncmp("fec", policystr, 3))
+		policy = KNET_LINK_POLICY_FEC;
 
 	if (policy < 0) {
 		knet_vty_write(vty, "Error: unknown switching policy method%s", telnet_newline);
@@ -1281,6 +1289,32 @@ static int knet_cmd_no_pmtufreq(struct knet_vty *vty)
 	return 0;
 }
 
+static int knet_cmd_no_stagestats(struct knet_vty *vty)
+{
+	struct knet_cfg *knet_iface = (struct knet_cfg *)vty->iface;
+
+	if (knet_handle_enable_stage_stats(knet_iface->cfg_ring.knet_h, 0) < 0) {
+		knet_vty_write(vty, "Error: Unable to disable stage stats on device %s%s",
+				nozzle_get_name_by_handle(knet_iface->cfg_eth.nozzle), telnet_newline);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int knet_cmd_stagestats(struct knet_vty *vty)
+{
+	struct knet_cfg *knet_iface = (struct knet_cfg *)vty->iface;
+
+	if (knet_handle_enable_stage_stats(knet_iface->cfg_ring.knet_h, 1) < 0) {
+		knet_vty_write(vty, "Error: Unable to enable stage stats on device %s%s",
+				nozzle_get_name_by_handle(knet_iface->cfg_eth.nozzle), telnet_newline);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int knet_cmd_pmtufreq(struct knet_vty *vty)
 {
 	struct knet_cfg *knet_iface = (struct knet_cfg *)vty->iface;
@@ -1728,11 +1762,25 @@ static int knet_cmd_exit_node(struct knet_vty *vty)
 	return 0;
 }
 
+static const char *stage_names[KNET_STAGE_MAX] = {
+	"tx filter",
+	"tx compress",
+	"tx fragment",
+	"tx crypt",
+	"tx send",
+	"rx crypt",
+	"rx parse",
+	"rx defrag",
+	"rx decompress",
+	"rx deliver",
+};
+
 static int knet_cmd_status(struct knet_vty *vty)
 {
 	size_t i, j;
 	struct knet_cfg *knet_iface = knet_cfg_head.knet_cfg;
 	struct knet_link_status status;
+	struct knet_stage_stats stage_stats;
 	const char *nl = telnet_newline;
 	struct timespec now;
 	char nodename[KNET_MAX_HOST_LEN];
@@ -1749,6 +1797,20 @@ static int knet_cmd_status(struct knet_vty *vty)
 	while (knet_iface != NULL) {
 		knet_vty_write(vty, "interface %s (active: %d)%s", nozzle_get_name_by_handle(knet_iface->cfg_eth.nozzle), knet_iface->active, nl);
 
+		if ((!knet_handle_get_stage_stats(knet_iface->cfg_ring.knet_h, &stage_stats, sizeof(stage_stats))) &&
+		    (stage_stats.enabled)) {
+			knet_vty_write(vty, "  pipeline stages (packets / average ns / max ns)%s", nl);
+			for (i = 0; i < KNET_STAGE_MAX; i++) {
+				if (!stage_stats.stages[i].count) {
+					continue;
+				}
+				knet_vty_write(vty, "    %-14s %llu / %llu / %llu%s", stage_names[i],
+					       (unsigned long long)stage_stats.stages[i].count,
+					       (unsigned long long)(stage_stats.stages[i].total_ns / stage_stats.stages[i].count),
+					       (unsigned long long)stage_stats.stages[i].max_ns, nl);
+			}
+		}
+
 		knet_host_get_host_list(knet_iface->cfg_ring.knet_h, host_ids, &host_ids_entries);
 
 		for (j = 0; j < host_ids_entries; j++) {
@@ -1766,6 +1828,9 @@ static int knet_cmd_status(struct knet_vty *vty)
 				case KNET_LINK_POLICY_RR:
 					knet_vty_write(vty, "(round-robin)%s", nl);
 					break;
+				case KNET_LINK_POLICY_FEC:
+					knet_vty_write(vty, "(fec)%s", nl);
+					break;
 			}
 
 			knet_link_get_link_list(knet_iface->cfg_ring.knet_h, host_ids[j], link_ids, &link_ids_entries);
@@ -1823,6 +1888,7 @@ static int knet_cmd_print_conf(struct knet_vty *vty)
 	char nodename[KNET_MAX_HOST_LEN];
 	uint8_t policy;
 	unsigned int pmtudfreq = 0;
+	struct knet_stage_stats stage_stats;
 
 	if (vty->filemode)
 		nl = file_newline;
@@ -1845,6 +1911,10 @@ static int knet_cmd_print_conf(struct knet_vty *vty)
 		if ((pmtudfreq > 0) && (pmtudfreq != 5))
 			knet_vty_write(vty, "  pmtudfreq %u%s", pmtudfreq, nl);
 
+		if ((!knet_handle_get_stage_stats(knet_iface->cfg_ring.knet_h, &stage_stats, sizeof(stage_stats))) &&
+		    (stage_stats.enabled))
+			knet_vty_write(vty, "  stagestats%s", nl);
+
 		nozzle_get_ips(knet_iface->cfg_eth.nozzle, &ip_list);
 		while (ip_list) {
 			knet_vty_write(vty, "  ip %s %s%s", ip_list->ipaddr, ip_list->prefix, nl);
@@ -1872,6 +1942,9 @@ static int knet_cmd_print_conf(struct knet_vty *vty)
 				case KNET_LINK_POLICY_RR:
 					knet_vty_write(vty, "   switch-policy round-robin%s", nl);
 					break;
+				case KNET_LINK_POLICY_FEC:
+					knet_vty_write(vty, "   switch-policy fec%s", nl);
+					break;
 			}
 
 			knet_link_get_link_list(knet_iface->cfg_ring.knet_h, host_ids[j], link_ids, &link_ids_entries);
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "internals.h"
+#include "events.h"
+#include "logging.h"
+#include "threads_common.h"
+
+/*
+ * producers are the internal threads, they all hold the global
+ * read lock, so the queue cannot go away under them.
+ * Queueing never blocks, if the queue is full the event is
+ * accounted as dropped.
+ */
+static void _event_queue_push(knet_handle_t knet_h, const struct knet_event *event)
+{
+	struct knet_event_queue *queue = knet_h->event_queue;
+	struct knet_event_slot *slot;
+	uint64_t pos, seq;
+	int64_t diff;
+	uint64_t one = 1;
+
+	pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &queue->slots[pos & queue->mask];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (int64_t)seq - (int64_t)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			__atomic_add_fetch(&queue->dropped, 1, __ATOMIC_RELAXED);
+			goto out_signal;
+		} else {
+			pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	memmove(&slot->event, event, sizeof(struct knet_event));
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+out_signal:
+	if (write(queue->eventfd, &one, sizeof(one)) != sizeof(one)) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Unable to signal event queue: %s", strerror(errno));
+	}
+}
+
+void _event_host_status(knet_handle_t knet_h, knet_node_id_t host_id,
+			uint8_t reachable, uint8_t remote, uint8_t external)
+{
+	struct knet_event event;
+
+	memset(&event, 0, sizeof(struct knet_event));
+	event.type = KNET_EVENT_HOST_STATUS;
+	event.u.host.host_id = host_id;
+	event.u.host.reachable = reachable;
+	event.u.host.remote = remote;
+	event.u.host.external = external;
+
+	_event_queue_push(knet_h, &event);
+}
+
+void _event_link_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			uint8_t connected, uint8_t remote, uint8_t external)
+{
+	struct knet_event event;
+
+	memset(&event, 0, sizeof(struct knet_event));
+	event.type = KNET_EVENT_LINK_STATUS;
+	event.u.link.host_id = host_id;
+	event.u.link.link_id = link_id;
+	event.u.link.connected = connected;
+	event.u.link.remote = remote;
+	event.u.link.external = external;
+
+	_event_queue_push(knet_h, &event);
+}
+
+void _event_pmtud(knet_handle_t knet_h, unsigned int data_mtu)
+{
+	struct knet_event event;
+
+	memset(&event, 0, sizeof(struct knet_event));
+	event.type = KNET_EVENT_PMTUD;
+	event.u.pmtud.data_mtu = data_mtu;
+
+	_event_queue_push(knet_h, &event);
+}
+
+void _event_sock(knet_handle_t knet_h, int datafd, int8_t channel,
+		 uint8_t tx_rx, int error, int errorno)
+{
+	struct knet_event event;
+
+	memset(&event, 0, sizeof(struct knet_event));
+	event.type = KNET_EVENT_SOCK;
+	event.u.sock.datafd = datafd;
+	event.u.sock.channel = channel;
+	event.u.sock.tx_rx = tx_rx;
+	event.u.sock.error = error;
+	event.u.sock.errorno = errorno;
+
+	_event_queue_push(knet_h, &event);
+}
+
+void _event_queue_free(knet_handle_t knet_h)
+{
+	struct knet_event_queue *queue = knet_h->event_queue;
+
+	if (!queue) {
+		return;
+	}
+
+	knet_h->event_queue = NULL;
+	close(queue->eventfd);
+	pthread_mutex_destroy(&queue->consumer_mutex);
+	free(queue->slots);
+	free(queue);
+}
+
+int knet_handle_enable_event_queue(knet_handle_t knet_h, unsigned int entries, int *event_fd)
+{
+	int savederrno = 0, err = 0;
+#ifdef HAVE_SYS_EVENTFD_H
+	struct knet_event_queue *queue = NULL;
+	uint64_t size = 2, i;
+#endif
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (entries > KNET_EVENT_QUEUE_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!entries) {
+		_event_queue_free(knet_h);
+		log_debug(knet_h, KNET_SUB_HANDLE, "Event queue disabled");
+		goto out_unlock;
+	}
+
+	if (knet_h->event_queue) {
+		err = -1;
+		savederrno = EBUSY;
+		log_err(knet_h, KNET_SUB_HANDLE, "Event queue is already enabled: %s",
+			strerror(savederrno));
+		goto out_unlock;
+	}
+
+#ifdef HAVE_SYS_EVENTFD_H
+	while (size < entries) {
+		size <<= 1;
+	}
+
+	queue = malloc(sizeof(struct knet_event_queue));
+	if (!queue) {
+		err = -1;
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for event queue: %s",
+			strerror(savederrno));
+		goto out_unlock;
+	}
+	memset(queue, 0, sizeof(struct knet_event_queue));
+
+	queue->slots = malloc(size * sizeof(struct knet_event_slot));
+	if (!queue->slots) {
+		err = -1;
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for event queue slots: %s",
+			strerror(savederrno));
+		free(queue);
+		goto out_unlock;
+	}
+	memset(queue->slots, 0, size * sizeof(struct knet_event_slot));
+	for (i = 0; i < size; i++) {
+		queue->slots[i].seq = i;
+	}
+	queue->mask = size - 1;
+
+	queue->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (queue->eventfd < 0) {
+		err = -1;
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create event queue eventfd: %s",
+			strerror(savederrno));
+		free(queue->slots);
+		free(queue);
+		goto out_unlock;
+	}
+
+	savederrno = pthread_mutex_init(&queue->consumer_mutex, NULL);
+	if (savederrno) {
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to initialize event queue mutex: %s",
+			strerror(savederrno));
+		close(queue->eventfd);
+		free(queue->slots);
+		free(queue);
+		goto out_unlock;
+	}
+
+	knet_h->event_queue = queue;
+
+	if (event_fd) {
+		*event_fd = queue->eventfd;
+	}
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Event queue enabled (%llu entries)",
+		  (unsigned long long)size);
+#else
+	err = -1;
+	savederrno = ENOTSUP;
+	log_err(knet_h, KNET_SUB_HANDLE, "Event queue requires eventfd support: %s",
+		strerror(savederrno));
+#endif
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_get_events(knet_handle_t knet_h, struct knet_event *events, unsigned int events_max)
+{
+	int savederrno = 0, err = 0;
+	struct knet_event_queue *queue;
+	struct knet_event_slot *slot;
+	uint64_t counter, dropped;
+	unsigned int entries = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!events) || (!events_max)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/*
+	 * only protects the queue from being freed, producers
+	 * hold the same read lock
+	 */
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	queue = knet_h->event_queue;
+	if (!queue) {
+		err = -1;
+		savederrno = EINVAL;
+		goto out_unlock;
+	}
+
+	pthread_mutex_lock(&queue->consumer_mutex);
+
+	/*
+	 * reset the doorbell before reading, events queued from now on
+	 * will ring it again
+	 */
+	if ((read(queue->eventfd, &counter, sizeof(counter)) < 0) && (errno != EAGAIN)) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Unable to read event queue eventfd: %s", strerror(errno));
+	}
+
+	dropped = __atomic_exchange_n(&queue->dropped, 0, __ATOMIC_RELAXED);
+	if (dropped) {
+		memset(&events[entries], 0, sizeof(struct knet_event));
+		events[entries].type = KNET_EVENT_DROPPED;
+		events[entries].u.dropped.count = dropped;
+		entries++;
+	}
+
+	while (entries < events_max) {
+		slot = &queue->slots[queue->tail & queue->mask];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != queue->tail + 1) {
+			break;
+		}
+		memmove(&events[entries], &slot->event, sizeof(struct knet_event));
+		__atomic_store_n(&slot->seq, queue->tail + queue->mask + 1, __ATOMIC_RELEASE);
+		queue->tail++;
+		entries++;
+	}
+
+	/*
+	 * the caller did not collect everything, keep the fd readable
+	 */
+	if (entries == events_max) {
+		counter = 1;
+		if (write(queue->eventfd, &counter, sizeof(counter)) != sizeof(counter)) {
+			log_debug(knet_h, KNET_SUB_HANDLE, "Unable to signal event queue: %s", strerror(errno));
+		}
+	}
+
+	pthread_mutex_unlock(&queue->consumer_mutex);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err ? err : (int)entries;
+}
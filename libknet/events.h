@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_EVENTS_H__
+#define __KNET_EVENTS_H__
+
+#include "internals.h"
+
+/*
+ * bounded multi producer / single consumer ring, every slot
+ * carries a sequence number that tells producers and consumer
+ * whose turn it is to use it.
+ */
+struct knet_event_slot {
+	uint64_t seq;
+	struct knet_event event;
+};
+
+struct knet_event_queue {
+	struct knet_event_slot *slots;
+	uint64_t mask;
+	uint64_t head __attribute__((aligned(64)));	/* next slot to fill, producers */
+	uint64_t tail __attribute__((aligned(64)));	/* next slot to read, consumer */
+	uint64_t dropped;
+	pthread_mutex_t consumer_mutex;
+	int eventfd;
+};
+
+void _event_host_status(knet_handle_t knet_h, knet_node_id_t host_id,
+			uint8_t reachable, uint8_t remote, uint8_t external);
+void _event_link_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			uint8_t connected, uint8_t remote, uint8_t external);
+void _event_pmtud(knet_handle_t knet_h, unsigned int data_mtu);
+void _event_sock(knet_handle_t knet_h, int datafd, int8_t channel,
+		 uint8_t tx_rx, int error, int errorno);
+void _event_queue_free(knet_handle_t knet_h);
+
+#endif
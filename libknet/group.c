@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "internals.h"
+#include "group.h"
+#include "logging.h"
+#include "threads_common.h"
+
+/*
+ * rebuild the list of reachable hosts of a group, TX walks
+ * this list instead of looking up every host for every packet.
+ *
+ * dst_hosts is only resized with global write lock held, here
+ * we only rewrite its content (pointers are valid as long as
+ * the hosts are in the group).
+ */
+static void _group_update_one(knet_handle_t knet_h, struct knet_group *group)
+{
+	struct knet_host *host;
+	size_t i, entries = 0;
+
+	for (i = 0; i < group->host_ids_entries; i++) {
+		host = knet_h->host_index[group->host_ids[i]];
+		if ((!host) || (!host->status.reachable)) {
+			continue;
+		}
+		group->dst_hosts[entries] = host;
+		entries++;
+	}
+
+	group->dst_hosts_entries = entries;
+}
+
+/*
+ * invoked every time a host changes status
+ */
+void _group_update(knet_handle_t knet_h)
+{
+	int group_idx;
+
+	for (group_idx = 0; group_idx < KNET_MAX_GROUPS; group_idx++) {
+		if (knet_h->groups[group_idx]) {
+			_group_update_one(knet_h, knet_h->groups[group_idx]);
+		}
+	}
+}
+
+static int _group_find_host(struct knet_group *group, knet_node_id_t host_id)
+{
+	size_t i;
+
+	for (i = 0; i < group->host_ids_entries; i++) {
+		if (group->host_ids[i] == host_id) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void _group_del_host(knet_handle_t knet_h, struct knet_group *group, int idx)
+{
+	if (group->host_ids[idx] == knet_h->host_id) {
+		group->has_local = 0;
+	}
+
+	group->host_ids_entries--;
+	memmove(&group->host_ids[idx], &group->host_ids[idx + 1],
+		(group->host_ids_entries - idx) * sizeof(knet_node_id_t));
+
+	_group_update_one(knet_h, group);
+}
+
+/*
+ * invoked with global write lock by knet_host_remove
+ */
+void _group_remove_host(knet_handle_t knet_h, knet_node_id_t host_id)
+{
+	int group_idx, idx;
+
+	for (group_idx = 0; group_idx < KNET_MAX_GROUPS; group_idx++) {
+		if (!knet_h->groups[group_idx]) {
+			continue;
+		}
+		idx = _group_find_host(knet_h->groups[group_idx], host_id);
+		if (idx >= 0) {
+			_group_del_host(knet_h, knet_h->groups[group_idx], idx);
+		}
+	}
+}
+
+static void _group_destroy(struct knet_group *group)
+{
+	free(group->host_ids);
+	free(group->dst_hosts);
+	free(group);
+}
+
+void _group_free(knet_handle_t knet_h)
+{
+	int group_idx;
+
+	for (group_idx = 0; group_idx < KNET_MAX_GROUPS; group_idx++) {
+		if (knet_h->groups[group_idx]) {
+			_group_destroy(knet_h->groups[group_idx]);
+			knet_h->groups[group_idx] = NULL;
+		}
+	}
+}
+
+int knet_group_create(knet_handle_t knet_h, uint16_t *group_id)
+{
+	int savederrno = 0, err = 0;
+	int group_idx;
+	struct knet_group *group;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!group_id) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	for (group_idx = 0; group_idx < KNET_MAX_GROUPS; group_idx++) {
+		if (!knet_h->groups[group_idx]) {
+			break;
+		}
+	}
+
+	if (group_idx == KNET_MAX_GROUPS) {
+		savederrno = EBUSY;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create group: %s",
+			strerror(savederrno));
+		goto out_unlock;
+	}
+
+	group = malloc(sizeof(struct knet_group));
+	if (!group) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for group: %s",
+			strerror(savederrno));
+		goto out_unlock;
+	}
+	memset(group, 0, sizeof(struct knet_group));
+
+	knet_h->groups[group_idx] = group;
+	*group_id = group_idx;
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Created group %d", group_idx);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_group_destroy(knet_handle_t knet_h, uint16_t group_id)
+{
+	int savederrno = 0, err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (group_id >= KNET_MAX_GROUPS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!knet_h->groups[group_id]) {
+		savederrno = EINVAL;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to destroy group %u: %s",
+			group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	_group_destroy(knet_h->groups[group_id]);
+	knet_h->groups[group_id] = NULL;
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Destroyed group %u", group_id);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_group_add_host(knet_handle_t knet_h, uint16_t group_id, knet_node_id_t host_id)
+{
+	int savederrno = 0, err = 0;
+	struct knet_group *group;
+	knet_node_id_t *host_ids;
+	struct knet_host **dst_hosts;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (group_id >= KNET_MAX_GROUPS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	group = knet_h->groups[group_id];
+	if (!group) {
+		savederrno = EINVAL;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to find group %u: %s",
+			group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	if (!knet_h->host_index[host_id]) {
+		savederrno = EINVAL;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	if (_group_find_host(group, host_id) >= 0) {
+		savederrno = EEXIST;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Host %u is already in group %u: %s",
+			host_id, group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	host_ids = realloc(group->host_ids, (group->host_ids_entries + 1) * sizeof(knet_node_id_t));
+	if (!host_ids) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for group %u: %s",
+			group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+	group->host_ids = host_ids;
+
+	dst_hosts = realloc(group->dst_hosts, (group->host_ids_entries + 1) * sizeof(struct knet_host *));
+	if (!dst_hosts) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for group %u: %s",
+			group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+	group->dst_hosts = dst_hosts;
+
+	group->host_ids[group->host_ids_entries] = host_id;
+	group->host_ids_entries++;
+
+	if (host_id == knet_h->host_id) {
+		group->has_local = 1;
+	}
+
+	_group_update_one(knet_h, group);
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Added host %u to group %u", host_id, group_id);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_group_remove_host(knet_handle_t knet_h, uint16_t group_id, knet_node_id_t host_id)
+{
+	int savederrno = 0, err = 0;
+	struct knet_group *group;
+	int idx;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (group_id >= KNET_MAX_GROUPS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	group = knet_h->groups[group_id];
+	if (!group) {
+		savederrno = EINVAL;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to find group %u: %s",
+			group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	idx = _group_find_host(group, host_id);
+	if (idx < 0) {
+		savederrno = EINVAL;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Host %u is not in group %u: %s",
+			host_id, group_id, strerror(savederrno));
+		goto out_unlock;
+	}
+
+	_group_del_host(knet_h, group, idx);
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Removed host %u from group %u", host_id, group_id);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
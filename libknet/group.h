@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_GROUP_H__
+#define __KNET_GROUP_H__
+
+#include "internals.h"
+
+void _group_update(knet_handle_t knet_h);
+void _group_remove_host(knet_handle_t knet_h, knet_node_id_t host_id);
+void _group_free(knet_handle_t knet_h);
+
+#endif
@@ -18,6 +18,7 @@
 #include <math.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/timerfd.h>
 
 #include "internals.h"
 #include "crypto.h"
@@ -25,6 +26,7 @@
 #include "compress.h"
 #include "compat.h"
 #include "common.h"
+#include "group.h"
 #include "threads_common.h"
 #include "threads_heartbeat.h"
 #include "threads_pmtud.h"
@@ -33,7 +35,11 @@
 #include "threads_tx.h"
 #include "transports.h"
 #include "transport_common.h"
+#include "uring.h"
 #include "logging.h"
+#include "relay.h"
+#include "stats_shm.h"
+#include "events.h"
 
 static pthread_mutex_t handle_config_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -136,6 +142,20 @@ static int _init_locks(knet_handle_t knet_h)
 		goto exit_fail;
 	}
 
+	savederrno = pthread_mutex_init(&knet_h->zerocopy_mutex, NULL);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to initialize zerocopy mutex: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	savederrno = pthread_mutex_init(&knet_h->send_buf_mutex, NULL);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to initialize send buffers mutex: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
 	return 0;
 
 exit_fail:
@@ -153,6 +173,8 @@ static void _destroy_locks(knet_handle_t knet_h)
 	pthread_mutex_destroy(&knet_h->tx_mutex);
 	pthread_mutex_destroy(&knet_h->backoff_mutex);
 	pthread_mutex_destroy(&knet_h->tx_seq_num_mutex);
+	pthread_mutex_destroy(&knet_h->zerocopy_mutex);
+	pthread_mutex_destroy(&knet_h->send_buf_mutex);
 	pthread_mutex_destroy(&knet_h->threads_status_mutex);
 }
 
@@ -300,6 +322,15 @@ static int _init_buffers(knet_handle_t knet_h)
 	}
 	memset(knet_h->recv_from_links_buf_decompress, 0, KNET_DATABUFSIZE_COMPRESS);
 
+	knet_h->recv_from_links_buf_gro = malloc(KNET_DATABUFSIZE);
+	if (!knet_h->recv_from_links_buf_gro) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for GRO segment buffer: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+	memset(knet_h->recv_from_links_buf_gro, 0, KNET_DATABUFSIZE);
+
 	knet_h->send_to_links_buf_compress = malloc(KNET_DATABUFSIZE_COMPRESS);
 	if (!knet_h->send_to_links_buf_compress) {
 		savederrno = errno;
@@ -309,7 +340,19 @@ static int _init_buffers(knet_handle_t knet_h)
 	}
 	memset(knet_h->send_to_links_buf_compress, 0, KNET_DATABUFSIZE_COMPRESS);
 
+	knet_h->send_to_links_buf_fec = malloc(KNET_DATABUFSIZE_FEC);
+	if (!knet_h->send_to_links_buf_fec) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for FEC buffer: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+	memset(knet_h->send_to_links_buf_fec, 0, KNET_DATABUFSIZE_FEC);
+
 	memset(knet_h->knet_transport_fd_tracker, KNET_MAX_TRANSPORTS, sizeof(knet_h->knet_transport_fd_tracker));
+	for (i = 0; i < KNET_MAX_FDS; i++) {
+		knet_h->knet_transport_fd_tracker[i].uring_armed = 0;
+	}
 
 	return 0;
 
@@ -332,7 +375,19 @@ static void _destroy_buffers(knet_handle_t knet_h)
 	}
 
 	free(knet_h->recv_from_links_buf_decompress);
+	free(knet_h->recv_from_links_buf_gro);
 	free(knet_h->send_to_links_buf_compress);
+	free(knet_h->send_to_links_buf_fec);
+	for (i = 0; i < KNET_DATAFD_MAX; i++) {
+		free(knet_h->coalesce[i].buf);
+	}
+	for (i = 0; i < KNET_ZEROCOPY_BUFS; i++) {
+		free(knet_h->zerocopy_buf[i].data);
+		free(knet_h->zerocopy_buf[i].out);
+	}
+	for (i = 0; i < KNET_SEND_BUFS; i++) {
+		free(knet_h->send_buf[i].data);
+	}
 	free(knet_h->recv_from_sock_buf);
 	free(knet_h->recv_from_links_buf_decrypt);
 	free(knet_h->recv_from_links_buf_crypt);
@@ -351,7 +406,7 @@ static int _init_epolls(knet_handle_t knet_h)
 	 * even if the kernel does dynamic allocation with epoll_ctl
 	 * we need to reserve one extra for host to host communication
 	 */
-	knet_h->send_to_links_epollfd = epoll_create(KNET_EPOLL_MAX_EVENTS + 1);
+	knet_h->send_to_links_epollfd = epoll_create(KNET_TX_EPOLL_MAX_EVENTS);
 	if (knet_h->send_to_links_epollfd < 0) {
 		savederrno = errno;
 		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create epoll datafd to link fd: %s",
@@ -396,6 +451,22 @@ static int _init_epolls(knet_handle_t knet_h)
 		goto exit_fail;
 	}
 
+	knet_h->coalesce_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (knet_h->coalesce_timerfd < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create coalesce timer fd: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	knet_h->pacing_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (knet_h->pacing_timerfd < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create pacing timer fd: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
 	memset(&ev, 0, sizeof(struct epoll_event));
 	ev.events = EPOLLIN;
 	ev.data.fd = knet_h->hostsockfd[0];
@@ -408,6 +479,30 @@ static int _init_epolls(knet_handle_t knet_h)
 		goto exit_fail;
 	}
 
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = knet_h->coalesce_timerfd;
+
+	if (epoll_ctl(knet_h->send_to_links_epollfd,
+		      EPOLL_CTL_ADD, knet_h->coalesce_timerfd, &ev)) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to add coalesce timer fd to epoll pool: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = knet_h->pacing_timerfd;
+
+	if (epoll_ctl(knet_h->send_to_links_epollfd,
+		      EPOLL_CTL_ADD, knet_h->pacing_timerfd, &ev)) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to add pacing timer fd to epoll pool: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
 	memset(&ev, 0, sizeof(struct epoll_event));
 	ev.events = EPOLLIN;
 	ev.data.fd = knet_h->dstsockfd[0];
@@ -445,6 +540,14 @@ static void _close_epolls(knet_handle_t knet_h)
 
 	epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_DEL, knet_h->hostsockfd[0], &ev);
 	epoll_ctl(knet_h->dst_link_handler_epollfd, EPOLL_CTL_DEL, knet_h->dstsockfd[0], &ev);
+	if (knet_h->coalesce_timerfd > 0) {
+		epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_DEL, knet_h->coalesce_timerfd, &ev);
+		close(knet_h->coalesce_timerfd);
+	}
+	if (knet_h->pacing_timerfd > 0) {
+		epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_DEL, knet_h->pacing_timerfd, &ev);
+		close(knet_h->pacing_timerfd);
+	}
 	close(knet_h->send_to_links_epollfd);
 	close(knet_h->recv_from_links_epollfd);
 	close(knet_h->dst_link_handler_epollfd);
@@ -565,7 +668,7 @@ knet_handle_t knet_handle_new(knet_node_id_t host_id,
 		return NULL;
 	}
 
-	if (flags > KNET_HANDLE_FLAG_PRIVILEGED * 2 - 1) {
+	if (flags > KNET_HANDLE_FLAG_IO_URING * 2 - 1) {
 		errno = EINVAL;
 		return NULL;
 	}
@@ -690,6 +793,17 @@ knet_handle_t knet_handle_new(knet_node_id_t host_id,
 		goto exit_fail;
 	}
 
+	/*
+	 * setup io_uring RX engine
+	 */
+
+	if (flags & KNET_HANDLE_FLAG_IO_URING) {
+		if (uring_init(knet_h)) {
+			savederrno = errno;
+			goto exit_fail;
+		}
+	}
+
 	/*
 	 * start transports
 	 */
@@ -751,7 +865,14 @@ int knet_handle_free(knet_handle_t knet_h)
 	pthread_rwlock_unlock(&knet_h->global_rwlock);
 
 	_stop_threads(knet_h);
+	_group_free(knet_h);
+	_stats_shm_free(knet_h);
+	_event_queue_free(knet_h);
+	if (knet_h->mcast_addr.ss_family) {
+		transport_mcast_clear_config(knet_h);
+	}
 	stop_all_transports(knet_h);
+	uring_free(knet_h);
 	_close_epolls(knet_h);
 	_destroy_buffers(knet_h);
 	_close_socks(knet_h);
@@ -929,7 +1050,9 @@ int knet_handle_add_datafd(knet_handle_t knet_h, int *datafd, int8_t *channel)
 	}
 
 	memset(&ev, 0, sizeof(struct epoll_event));
-	ev.events = EPOLLIN;
+	if (!knet_h->txq_blocked) {
+		ev.events = EPOLLIN;
+	}
 	ev.data.fd = knet_h->sockfd[*channel].sockfd[knet_h->sockfd[*channel].is_created];
 
 	if (epoll_ctl(knet_h->send_to_links_epollfd,
@@ -1010,6 +1133,13 @@ int knet_handle_remove_datafd(knet_handle_t knet_h, int datafd)
 
 	memset(&knet_h->sockfd[channel], 0, sizeof(struct knet_sock));
 
+	/*
+	 * drop any message waiting to be coalesced and reset
+	 * the channel configuration
+	 */
+	knet_h->coalesce[channel].max_delay = 0;
+	knet_h->coalesce[channel].buf_len = 0;
+
 out_unlock:
 	pthread_rwlock_unlock(&knet_h->global_rwlock);
 	errno = err ? savederrno : 0;
@@ -1107,58 +1237,21 @@ out_unlock:
 	return err;
 }
 
-int knet_handle_enable_filter(knet_handle_t knet_h,
-			      void *dst_host_filter_fn_private_data,
-			      int (*dst_host_filter_fn) (
-					void *private_data,
-					const unsigned char *outdata,
-					ssize_t outdata_len,
-					uint8_t tx_rx,
-					knet_node_id_t this_host_id,
-					knet_node_id_t src_node_id,
-					int8_t *channel,
-					knet_node_id_t *dst_host_ids,
-					size_t *dst_host_ids_entries))
+int knet_handle_set_channel_coalesce(knet_handle_t knet_h, const int8_t channel, uint32_t max_delay)
 {
-	int savederrno = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	savederrno = get_global_wrlock(knet_h);
-	if (savederrno) {
-		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
-			strerror(savederrno));
-		errno = savederrno;
-		return -1;
-	}
-
-	knet_h->dst_host_filter_fn_private_data = dst_host_filter_fn_private_data;
-	knet_h->dst_host_filter_fn = dst_host_filter_fn;
-	if (knet_h->dst_host_filter_fn) {
-		log_debug(knet_h, KNET_SUB_HANDLE, "dst_host_filter_fn enabled");
-	} else {
-		log_debug(knet_h, KNET_SUB_HANDLE, "dst_host_filter_fn disabled");
-	}
-
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
-
-	errno = 0;
-	return 0;
-}
-
-int knet_handle_setfwd(knet_handle_t knet_h, unsigned int enabled)
-{
-	int savederrno = 0;
-
-	if (!knet_h) {
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (enabled > 1) {
+	if (max_delay > KNET_COALESCE_MAX_DELAY) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1171,30 +1264,59 @@ int knet_handle_setfwd(knet_handle_t knet_h, unsigned int enabled)
 		return -1;
 	}
 
-	knet_h->enabled = enabled;
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
 
-	if (enabled) {
-		log_debug(knet_h, KNET_SUB_HANDLE, "Data forwarding is enabled");
-	} else {
-		log_debug(knet_h, KNET_SUB_HANDLE, "Data forwarding is disabled");
+	/*
+	 * the buffer is kept around till the datafd is removed,
+	 * so that messages already coalesced are still sent
+	 * on time when coalescing is disabled
+	 */
+	if ((max_delay) && (!knet_h->coalesce[channel].buf)) {
+		knet_h->coalesce[channel].buf = malloc(KNET_DATABUFSIZE);
+		if (!knet_h->coalesce[channel].buf) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for coalesce buffer: %s",
+				strerror(savederrno));
+			goto out_unlock;
+		}
+		memset(knet_h->coalesce[channel].buf, 0, KNET_DATABUFSIZE);
+		knet_h->coalesce[channel].buf->kh_version = KNET_HEADER_VERSION;
+		knet_h->coalesce[channel].buf->kh_type = KNET_HEADER_TYPE_DATA_COALESCED;
+		knet_h->coalesce[channel].buf->kh_node = htons(knet_h->host_id);
+		knet_h->coalesce[channel].buf->khp_data_frag_seq = 0;
 	}
 
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	knet_h->coalesce[channel].max_delay = max_delay;
 
-	errno = 0;
-	return 0;
+	log_debug(knet_h, KNET_SUB_HANDLE, "Channel %d coalesce delay set to %u usecs",
+		  channel, max_delay);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
 }
 
-int knet_handle_pmtud_getfreq(knet_handle_t knet_h, unsigned int *interval)
+int knet_handle_get_channel_coalesce(knet_handle_t knet_h, const int8_t channel, uint32_t *max_delay)
 {
-	int savederrno = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (!interval) {
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (max_delay == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1207,24 +1329,30 @@ int knet_handle_pmtud_getfreq(knet_handle_t knet_h, unsigned int *interval)
 		return -1;
 	}
 
-	*interval = knet_h->pmtud_interval;
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
 
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	*max_delay = knet_h->coalesce[channel].max_delay;
 
-	errno = 0;
-	return 0;
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
 }
 
-int knet_handle_pmtud_setfreq(knet_handle_t knet_h, unsigned int interval)
+int knet_handle_set_channel_priority(knet_handle_t knet_h, const int8_t channel, uint8_t priority)
 {
-	int savederrno = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if ((!interval) || (interval > 86400)) {
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1237,106 +1365,426 @@ int knet_handle_pmtud_setfreq(knet_handle_t knet_h, unsigned int interval)
 		return -1;
 	}
 
-	knet_h->pmtud_interval = interval;
-	log_debug(knet_h, KNET_SUB_HANDLE, "PMTUd interval set to: %u seconds", interval);
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
 
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	knet_h->sockfd[channel].priority = priority;
+	knet_h->sockfd[channel].deficit = 0;
 
-	errno = 0;
-	return 0;
+	log_debug(knet_h, KNET_SUB_HANDLE, "Channel %d priority set to %u",
+		  channel, priority);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
 }
 
-int knet_handle_enable_pmtud_notify(knet_handle_t knet_h,
-				    void *pmtud_notify_fn_private_data,
-				    void (*pmtud_notify_fn) (
-						void *private_data,
-						unsigned int data_mtu))
+int knet_handle_get_channel_priority(knet_handle_t knet_h, const int8_t channel, uint8_t *priority)
 {
-	int savederrno = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	savederrno = get_global_wrlock(knet_h);
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (priority == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
 	if (savederrno) {
-		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
 			strerror(savederrno));
 		errno = savederrno;
 		return -1;
 	}
 
-	knet_h->pmtud_notify_fn_private_data = pmtud_notify_fn_private_data;
-	knet_h->pmtud_notify_fn = pmtud_notify_fn;
-	if (knet_h->pmtud_notify_fn) {
-		log_debug(knet_h, KNET_SUB_HANDLE, "pmtud_notify_fn enabled");
-	} else {
-		log_debug(knet_h, KNET_SUB_HANDLE, "pmtud_notify_fn disabled");
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
 	}
 
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	*priority = knet_h->sockfd[channel].priority;
 
-	errno = 0;
-	return 0;
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
 }
 
-int knet_handle_pmtud_get(knet_handle_t knet_h,
-			  unsigned int *data_mtu)
+int knet_handle_set_channel_lifetime(knet_handle_t knet_h, const int8_t channel, uint32_t lifetime)
 {
-	int savederrno = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (!data_mtu) {
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	savederrno = get_global_wrlock(knet_h);
 	if (savederrno) {
-		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
 			strerror(savederrno));
 		errno = savederrno;
 		return -1;
 	}
 
-	*data_mtu = knet_h->data_mtu;
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
 
-	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	knet_h->sockfd[channel].lifetime = lifetime;
 
-	errno = 0;
-	return 0;
+	log_debug(knet_h, KNET_SUB_HANDLE, "Channel %d lifetime set to %u msecs",
+		  channel, lifetime);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
 }
 
-int knet_handle_crypto(knet_handle_t knet_h, struct knet_handle_crypto_cfg *knet_handle_crypto_cfg)
+int knet_handle_get_channel_lifetime(knet_handle_t knet_h, const int8_t channel, uint32_t *lifetime)
 {
-	int savederrno = 0;
-	int err = 0;
+	int err = 0, savederrno = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (!knet_handle_crypto_cfg) {
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	savederrno = get_global_wrlock(knet_h);
+	if (lifetime == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
 	if (savederrno) {
-		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
 			strerror(savederrno));
 		errno = savederrno;
 		return -1;
 	}
 
-	crypto_fini(knet_h);
-
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
+
+	*lifetime = knet_h->sockfd[channel].lifetime;
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_enable_channel_rx_notify(knet_handle_t knet_h,
+					 const int8_t channel,
+					 void *rx_notify_fn_private_data,
+					 void (*rx_notify_fn) (
+						void *private_data,
+						const unsigned char *data,
+						ssize_t data_len,
+						knet_node_id_t src_host_id,
+						int8_t channel))
+{
+	int err = 0, savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
+
+	knet_h->sockfd[channel].rx_notify_fn_private_data = rx_notify_fn_private_data;
+	knet_h->sockfd[channel].rx_notify_fn = rx_notify_fn;
+
+	if (knet_h->sockfd[channel].rx_notify_fn) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Channel %d rx_notify_fn enabled", channel);
+	} else {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Channel %d rx_notify_fn disabled", channel);
+	}
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_enable_filter(knet_handle_t knet_h,
+			      void *dst_host_filter_fn_private_data,
+			      int (*dst_host_filter_fn) (
+					void *private_data,
+					const unsigned char *outdata,
+					ssize_t outdata_len,
+					uint8_t tx_rx,
+					knet_node_id_t this_host_id,
+					knet_node_id_t src_node_id,
+					int8_t *channel,
+					knet_node_id_t *dst_host_ids,
+					size_t *dst_host_ids_entries))
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	knet_h->dst_host_filter_fn_private_data = dst_host_filter_fn_private_data;
+	knet_h->dst_host_filter_fn = dst_host_filter_fn;
+	if (knet_h->dst_host_filter_fn) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "dst_host_filter_fn enabled");
+	} else {
+		log_debug(knet_h, KNET_SUB_HANDLE, "dst_host_filter_fn disabled");
+	}
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_setfwd(knet_handle_t knet_h, unsigned int enabled)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (enabled > 1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	knet_h->enabled = enabled;
+
+	if (enabled) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Data forwarding is enabled");
+	} else {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Data forwarding is disabled");
+	}
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_pmtud_getfreq(knet_handle_t knet_h, unsigned int *interval)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!interval) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	*interval = knet_h->pmtud_interval;
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_pmtud_setfreq(knet_handle_t knet_h, unsigned int interval)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!interval) || (interval > 86400)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	knet_h->pmtud_interval = interval;
+	log_debug(knet_h, KNET_SUB_HANDLE, "PMTUd interval set to: %u seconds", interval);
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_enable_pmtud_notify(knet_handle_t knet_h,
+				    void *pmtud_notify_fn_private_data,
+				    void (*pmtud_notify_fn) (
+						void *private_data,
+						unsigned int data_mtu))
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	knet_h->pmtud_notify_fn_private_data = pmtud_notify_fn_private_data;
+	knet_h->pmtud_notify_fn = pmtud_notify_fn;
+	if (knet_h->pmtud_notify_fn) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "pmtud_notify_fn enabled");
+	} else {
+		log_debug(knet_h, KNET_SUB_HANDLE, "pmtud_notify_fn disabled");
+	}
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_pmtud_get(knet_handle_t knet_h,
+			  unsigned int *data_mtu)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!data_mtu) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	*data_mtu = knet_h->data_mtu;
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_crypto(knet_handle_t knet_h, struct knet_handle_crypto_cfg *knet_handle_crypto_cfg)
+{
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!knet_handle_crypto_cfg) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	crypto_fini(knet_h);
+
 	if ((!strncmp("none", knet_handle_crypto_cfg->crypto_model, 4)) || 
 	    ((!strncmp("none", knet_handle_crypto_cfg->crypto_cipher_type, 4)) &&
 	     (!strncmp("none", knet_handle_crypto_cfg->crypto_hash_type, 4)))) {
@@ -1345,46 +1793,285 @@ int knet_handle_crypto(knet_handle_t knet_h, struct knet_handle_crypto_cfg *knet
 		goto exit_unlock;
 	}
 
-	if (knet_handle_crypto_cfg->private_key_len < KNET_MIN_KEY_LEN) {
-		log_debug(knet_h, KNET_SUB_CRYPTO, "private key len too short (min %d): %u",
-			  KNET_MIN_KEY_LEN, knet_handle_crypto_cfg->private_key_len);
-		savederrno = EINVAL;
-		err = -1;
-		goto exit_unlock;
+	if (knet_handle_crypto_cfg->private_key_len < KNET_MIN_KEY_LEN) {
+		log_debug(knet_h, KNET_SUB_CRYPTO, "private key len too short (min %d): %u",
+			  KNET_MIN_KEY_LEN, knet_handle_crypto_cfg->private_key_len);
+		savederrno = EINVAL;
+		err = -1;
+		goto exit_unlock;
+	}
+
+	if (knet_handle_crypto_cfg->private_key_len > KNET_MAX_KEY_LEN) {
+		log_debug(knet_h, KNET_SUB_CRYPTO, "private key len too long (max %d): %u",
+			  KNET_MAX_KEY_LEN, knet_handle_crypto_cfg->private_key_len);
+		savederrno = EINVAL;
+		err = -1;
+		goto exit_unlock;
+	}
+
+	err = crypto_init(knet_h, knet_handle_crypto_cfg);
+
+	if (err) {
+		err = -2;
+		savederrno = errno;
+	}
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_compress(knet_handle_t knet_h, struct knet_handle_compress_cfg *knet_handle_compress_cfg)
+{
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!knet_handle_compress_cfg) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	compress_fini(knet_h, 0);
+	err = compress_cfg(knet_h, knet_handle_compress_cfg);
+	savederrno = errno;
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_set_zerocopy(knet_handle_t knet_h, uint32_t threshold)
+{
+	int savederrno = 0;
+	int err = 0;
+	int i;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((threshold) && (threshold < KNET_ZEROCOPY_MIN_THRESHOLD)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	/*
+	 * the ring is kept around till the handle is freed,
+	 * the kernel might still be using it after zerocopy
+	 * is disabled
+	 */
+	if ((threshold) && (!knet_h->zerocopy_buf[0].data)) {
+		for (i = 0; i < KNET_ZEROCOPY_BUFS; i++) {
+			knet_h->zerocopy_buf[i].data = malloc(KNET_DATABUFSIZE);
+			knet_h->zerocopy_buf[i].out = malloc(KNET_ZEROCOPY_OUTSIZE);
+			if ((!knet_h->zerocopy_buf[i].data) || (!knet_h->zerocopy_buf[i].out)) {
+				savederrno = ENOMEM;
+				err = -1;
+				log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for zerocopy buffers: %s",
+					strerror(savederrno));
+				break;
+			}
+			memset(knet_h->zerocopy_buf[i].data, 0, KNET_DATABUFSIZE);
+			memset(knet_h->zerocopy_buf[i].out, 0, KNET_ZEROCOPY_OUTSIZE);
+			knet_h->zerocopy_buf[i].pending = 0;
+		}
+		if (err) {
+			for (i = 0; i < KNET_ZEROCOPY_BUFS; i++) {
+				free(knet_h->zerocopy_buf[i].data);
+				knet_h->zerocopy_buf[i].data = NULL;
+				free(knet_h->zerocopy_buf[i].out);
+				knet_h->zerocopy_buf[i].out = NULL;
+			}
+			goto out_unlock;
+		}
+	}
+
+	knet_h->zerocopy_threshold = threshold;
+
+	if (threshold) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "MSG_ZEROCOPY enabled for fragments of %u bytes or more", threshold);
+	} else {
+		log_debug(knet_h, KNET_SUB_HANDLE, "MSG_ZEROCOPY disabled");
+	}
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_get_zerocopy(knet_handle_t knet_h, uint32_t *threshold)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!threshold) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	*threshold = knet_h->zerocopy_threshold;
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_set_mcast(knet_handle_t knet_h, struct sockaddr_storage *mcast_addr,
+			  struct sockaddr_storage *src_addr, uint8_t ttl)
+{
+	int err = 0, savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (mcast_addr) {
+		if ((!src_addr) || (!ttl) ||
+		    (mcast_addr->ss_family != src_addr->ss_family)) {
+			errno = EINVAL;
+			return -1;
+		}
+		if ((mcast_addr->ss_family == AF_INET) &&
+		    (!IN_MULTICAST(ntohl(((struct sockaddr_in *)mcast_addr)->sin_addr.s_addr)))) {
+			errno = EINVAL;
+			return -1;
+		}
+		if ((mcast_addr->ss_family == AF_INET6) &&
+		    (!IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)mcast_addr)->sin6_addr))) {
+			errno = EINVAL;
+			return -1;
+		}
+		if ((mcast_addr->ss_family != AF_INET) &&
+		    (mcast_addr->ss_family != AF_INET6)) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (knet_h->mcast_addr.ss_family) {
+		if (transport_mcast_clear_config(knet_h) < 0) {
+			savederrno = errno;
+			err = -1;
+			goto out_unlock;
+		}
+		memset(&knet_h->mcast_addr, 0, sizeof(struct sockaddr_storage));
+		memset(&knet_h->mcast_src_addr, 0, sizeof(struct sockaddr_storage));
+		knet_h->mcast_ttl = 0;
+		log_debug(knet_h, KNET_SUB_HANDLE, "Multicast broadcast disabled");
+	}
+
+	if (!mcast_addr) {
+		goto out_unlock;
+	}
+
+	memmove(&knet_h->mcast_addr, mcast_addr, sizeof(struct sockaddr_storage));
+	memmove(&knet_h->mcast_src_addr, src_addr, sizeof(struct sockaddr_storage));
+	knet_h->mcast_ttl = ttl;
+
+	if (transport_mcast_set_config(knet_h) < 0) {
+		savederrno = errno;
+		err = -1;
+		memset(&knet_h->mcast_addr, 0, sizeof(struct sockaddr_storage));
+		memset(&knet_h->mcast_src_addr, 0, sizeof(struct sockaddr_storage));
+		knet_h->mcast_ttl = 0;
+		goto out_unlock;
+	}
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Multicast broadcast enabled");
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_get_mcast(knet_handle_t knet_h, struct sockaddr_storage *mcast_addr,
+			  struct sockaddr_storage *src_addr, uint8_t *ttl)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!mcast_addr) || (!src_addr) || (!ttl)) {
+		errno = EINVAL;
+		return -1;
 	}
 
-	if (knet_handle_crypto_cfg->private_key_len > KNET_MAX_KEY_LEN) {
-		log_debug(knet_h, KNET_SUB_CRYPTO, "private key len too long (max %d): %u",
-			  KNET_MAX_KEY_LEN, knet_handle_crypto_cfg->private_key_len);
-		savederrno = EINVAL;
-		err = -1;
-		goto exit_unlock;
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
 	}
 
-	err = crypto_init(knet_h, knet_handle_crypto_cfg);
-
-	if (err) {
-		err = -2;
-		savederrno = errno;
-	}
+	memmove(mcast_addr, &knet_h->mcast_addr, sizeof(struct sockaddr_storage));
+	memmove(src_addr, &knet_h->mcast_src_addr, sizeof(struct sockaddr_storage));
+	*ttl = knet_h->mcast_ttl;
 
-exit_unlock:
 	pthread_rwlock_unlock(&knet_h->global_rwlock);
-	errno = err ? savederrno : 0;
-	return err;
+	errno = 0;
+	return 0;
 }
 
-int knet_handle_compress(knet_handle_t knet_h, struct knet_handle_compress_cfg *knet_handle_compress_cfg)
+int knet_handle_set_relay(knet_handle_t knet_h, unsigned int enabled)
 {
 	int savederrno = 0;
-	int err = 0;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (!knet_handle_compress_cfg) {
+	if (enabled > 1) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1397,13 +2084,57 @@ int knet_handle_compress(knet_handle_t knet_h, struct knet_handle_compress_cfg *
 		return -1;
 	}
 
-	compress_fini(knet_h, 0);
-	err = compress_cfg(knet_h, knet_handle_compress_cfg);
-	savederrno = errno;
+	if (knet_h->relay_enabled == enabled) {
+		goto out_unlock;
+	}
+
+	knet_h->relay_enabled = enabled;
+
+	if (enabled) {
+		/*
+		 * send our link table at the next heartbeat
+		 */
+		memset(&knet_h->relay_table_last, 0, sizeof(struct timespec));
+		log_debug(knet_h, KNET_SUB_HANDLE, "Relay forwarding is enabled");
+	} else {
+		_relay_clear(knet_h, NULL);
+		log_debug(knet_h, KNET_SUB_HANDLE, "Relay forwarding is disabled");
+	}
 
+out_unlock:
 	pthread_rwlock_unlock(&knet_h->global_rwlock);
-	errno = err ? savederrno : 0;
-	return err;
+
+	errno = 0;
+	return 0;
+}
+
+int knet_handle_get_relay(knet_handle_t knet_h, unsigned int *enabled)
+{
+	int savederrno = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!enabled) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	*enabled = knet_h->relay_enabled;
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = 0;
+	return 0;
 }
 
 ssize_t knet_recv(knet_handle_t knet_h, char *buff, const size_t buff_len, const int8_t channel)
@@ -1533,6 +2264,159 @@ out_unlock:
 	return err;
 }
 
+static int _batch_check_msgs(struct knet_msg *msgs, const unsigned int msgs_entries, int is_send)
+{
+	unsigned int i;
+	size_t j, len;
+
+	for (i = 0; i < msgs_entries; i++) {
+		if ((!msgs[i].iov) || (!msgs[i].iovlen) || (msgs[i].iovlen > IOV_MAX)) {
+			return -1;
+		}
+		len = 0;
+		for (j = 0; j < msgs[i].iovlen; j++) {
+			len += msgs[i].iov[j].iov_len;
+		}
+		if ((!len) || ((is_send) && (len > KNET_MAX_PACKET_SIZE))) {
+			return -1;
+		}
+		msgs[i].len = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * sockets preserve message boundaries and can move the whole
+ * batch with one syscall. Anything else (pipes, fifos..) gets
+ * one readv/writev per message.
+ *
+ * returns the number of messages processed, or -1 and errno
+ * set if none could be processed.
+ */
+static int _batch_io(knet_handle_t knet_h, struct knet_msg *msgs, const unsigned int msgs_entries, const int8_t channel, int is_send)
+{
+	int fd = knet_h->sockfd[channel].sockfd[0];
+	int savederrno = 0;
+	ssize_t err = 0;
+	unsigned int i;
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+	struct mmsghdr msgvec[KNET_MAX_BATCH];
+	int msgs_done;
+
+	if (knet_h->sockfd[channel].is_socket) {
+		memset(msgvec, 0, sizeof(struct mmsghdr) * msgs_entries);
+		for (i = 0; i < msgs_entries; i++) {
+			msgvec[i].msg_hdr.msg_iov = msgs[i].iov;
+			msgvec[i].msg_hdr.msg_iovlen = msgs[i].iovlen;
+		}
+
+		if (is_send) {
+			msgs_done = sendmmsg(fd, msgvec, msgs_entries, MSG_NOSIGNAL);
+		} else {
+			msgs_done = recvmmsg(fd, msgvec, msgs_entries, 0, NULL);
+		}
+		savederrno = errno;
+
+		for (i = 0; (int)i < msgs_done; i++) {
+			msgs[i].len = msgvec[i].msg_len;
+		}
+
+		errno = savederrno;
+		return msgs_done;
+	}
+#endif
+
+	for (i = 0; i < msgs_entries; i++) {
+		if (is_send) {
+			err = writev(fd, msgs[i].iov, msgs[i].iovlen);
+		} else {
+			err = readv(fd, msgs[i].iov, msgs[i].iovlen);
+		}
+		savederrno = errno;
+		if (err <= 0) {
+			break;
+		}
+		msgs[i].len = err;
+	}
+
+	if (i > 0) {
+		errno = 0;
+		return i;
+	}
+
+	errno = savederrno;
+	return err;
+}
+
+static int _handle_batch(knet_handle_t knet_h, struct knet_msg *msgs, const unsigned int msgs_entries, const int8_t channel, int is_send)
+{
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (msgs == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!msgs_entries) || (msgs_entries > KNET_MAX_BATCH)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (_batch_check_msgs(msgs, msgs_entries, is_send) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel >= KNET_DATAFD_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
+
+	err = _batch_io(knet_h, msgs, msgs_entries, channel, is_send);
+	savederrno = errno;
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = (err < 0) ? savederrno : 0;
+	return err;
+}
+
+int knet_send_batch(knet_handle_t knet_h, struct knet_msg *msgs, const unsigned int msgs_entries, const int8_t channel)
+{
+	return _handle_batch(knet_h, msgs, msgs_entries, channel, 1);
+}
+
+int knet_recv_batch(knet_handle_t knet_h, struct knet_msg *msgs, const unsigned int msgs_entries, const int8_t channel)
+{
+	return _handle_batch(knet_h, msgs, msgs_entries, channel, 0);
+}
+
 int knet_handle_get_stats(knet_handle_t knet_h, struct knet_handle_stats *stats, size_t struct_size)
 {
 	int savederrno = 0;
@@ -1580,6 +2464,42 @@ int knet_handle_get_stats(knet_handle_t knet_h, struct knet_handle_stats *stats,
 	return err;
 }
 
+int knet_handle_get_histogram(knet_handle_t knet_h, uint8_t histogram_id,
+			      struct knet_histogram *histogram)
+{
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (histogram_id >= KNET_HISTOGRAM_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!histogram) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	memmove(histogram, &knet_h->histograms[histogram_id], sizeof(struct knet_histogram));
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
 int knet_handle_clear_stats(knet_handle_t knet_h, int clear_option)
 {
 	int savederrno = 0;
@@ -1606,6 +2526,8 @@ int knet_handle_clear_stats(knet_handle_t knet_h, int clear_option)
 
 	memset(&knet_h->stats, 0, sizeof(struct knet_handle_stats));
 	memset(&knet_h->stats_extra, 0, sizeof(struct knet_handle_stats_extra));
+	memset(knet_h->histograms, 0, sizeof(knet_h->histograms));
+	memset(knet_h->stage_stats, 0, sizeof(knet_h->stage_stats));
 	if (clear_option == KNET_CLEARSTATS_HANDLE_AND_LINK) {
 		_link_clear_stats(knet_h);
 	}
@@ -1615,6 +2537,97 @@ int knet_handle_clear_stats(knet_handle_t knet_h, int clear_option)
 	return err;
 }
 
+int knet_handle_get_topology_status(knet_handle_t knet_h, uint64_t since_generation,
+				    struct knet_topology_status *topology,
+				    struct knet_topology_host *hosts, size_t hosts_max,
+				    struct knet_topology_link *links, size_t links_max)
+{
+	struct knet_host *host;
+	struct knet_link *link;
+	size_t hosts_entries = 0, links_entries = 0;
+	int link_idx;
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!topology) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((hosts_max) && (!hosts)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((links_max) && (!links)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	/*
+	 * removed hosts/links cannot be reported as a change,
+	 * the caller needs to rebuild its view from scratch
+	 */
+	if (since_generation < knet_h->topology_removed_generation) {
+		since_generation = 0;
+	}
+	topology->full = (since_generation == 0);
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		if (host->status_generation > since_generation) {
+			if (hosts_entries < hosts_max) {
+				hosts[hosts_entries].host_id = host->host_id;
+				hosts[hosts_entries].generation = host->status_generation;
+				memmove(&hosts[hosts_entries].status, &host->status, sizeof(struct knet_host_status));
+			}
+			hosts_entries++;
+		}
+		for (link_idx = 0; link_idx < KNET_MAX_LINK; link_idx++) {
+			link = &host->link[link_idx];
+			if ((!link->configured) ||
+			    (link->status_generation <= since_generation)) {
+				continue;
+			}
+			if (links_entries < links_max) {
+				links[links_entries].host_id = host->host_id;
+				links[links_entries].link_id = link_idx;
+				links[links_entries].generation = link->status_generation;
+				memmove(&links[links_entries].status, &link->status, sizeof(struct knet_link_status));
+				_link_stats_totals(&links[links_entries].status.stats);
+				links[links_entries].status.size = sizeof(struct knet_link_status);
+			}
+			links_entries++;
+		}
+	}
+
+	topology->size = sizeof(struct knet_topology_status);
+	topology->generation = knet_h->topology_generation;
+	topology->hosts_entries = hosts_entries;
+	topology->links_entries = links_entries;
+
+	if ((hosts_entries > hosts_max) || (links_entries > links_max)) {
+		err = -1;
+		savederrno = ENOBUFS;
+	}
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
 int knet_handle_set_threads_timer_res(knet_handle_t knet_h,
 				      useconds_t timeres)
 {
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+
+#include "internals.h"
+#include "histogram.h"
+
+/*
+ * values below KNET_HISTOGRAM_SUB_BUCKETS map 1:1 to buckets,
+ * above that the top KNET_HISTOGRAM_SUB_BITS bits after the most
+ * significant one select the bucket within the power of 2.
+ */
+static unsigned int _histogram_index(uint64_t value)
+{
+	unsigned int msb, shift;
+
+	if (value < KNET_HISTOGRAM_SUB_BUCKETS) {
+		return value;
+	}
+
+	msb = 63 - __builtin_clzll(value);
+	if (msb >= KNET_HISTOGRAM_MAX_BITS) {
+		return KNET_HISTOGRAM_BUCKETS - 1;
+	}
+	shift = msb - KNET_HISTOGRAM_SUB_BITS;
+
+	return ((shift + 1) * KNET_HISTOGRAM_SUB_BUCKETS) +
+	       ((value >> shift) - KNET_HISTOGRAM_SUB_BUCKETS);
+}
+
+/*
+ * highest value counted in a bucket
+ */
+static uint64_t _histogram_bucket_max(unsigned int idx)
+{
+	unsigned int shift, sub;
+
+	if (idx < KNET_HISTOGRAM_SUB_BUCKETS) {
+		return idx;
+	}
+
+	shift = (idx / KNET_HISTOGRAM_SUB_BUCKETS) - 1;
+	sub = idx % KNET_HISTOGRAM_SUB_BUCKETS;
+
+	return ((uint64_t)(KNET_HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/*
+ * histograms have a single writer (the thread that owns the
+ * measured operation), readers copy them with the global lock held.
+ */
+void _histogram_add(struct knet_histogram *histogram, uint64_t value)
+{
+	if ((!histogram->count) || (value < histogram->min)) {
+		histogram->min = value;
+	}
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+	histogram->sum += value;
+	histogram->buckets[_histogram_index(value)]++;
+	histogram->count++;
+}
+
+uint64_t knet_histogram_percentile(const struct knet_histogram *histogram, double percentile)
+{
+	uint64_t rank, seen = 0, value;
+	unsigned int idx;
+
+	if ((!histogram) || (percentile < 0) || (percentile > 100)) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	errno = 0;
+
+	if (!histogram->count) {
+		return 0;
+	}
+
+	rank = (uint64_t)((percentile / 100) * histogram->count + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+	if (rank > histogram->count) {
+		rank = histogram->count;
+	}
+
+	for (idx = 0; idx < KNET_HISTOGRAM_BUCKETS; idx++) {
+		seen += histogram->buckets[idx];
+		if (seen >= rank) {
+			break;
+		}
+	}
+
+	if (idx == KNET_HISTOGRAM_BUCKETS) {
+		return histogram->max;
+	}
+
+	value = _histogram_bucket_max(idx);
+	if (value > histogram->max) {
+		value = histogram->max;
+	}
+	if (value < histogram->min) {
+		value = histogram->min;
+	}
+
+	return value;
+}
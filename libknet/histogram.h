@@ -0,0 +1,16 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_HISTOGRAM_H__
+#define __KNET_HISTOGRAM_H__
+
+#include "internals.h"
+
+void _histogram_add(struct knet_histogram *histogram, uint64_t value);
+
+#endif
@@ -15,9 +15,12 @@
 #include <pthread.h>
 #include <stdio.h>
 
+#include "events.h"
+#include "group.h"
 #include "host.h"
 #include "internals.h"
 #include "logging.h"
+#include "relay.h"
 #include "threads_common.h"
 
 static void _host_list_update(knet_handle_t knet_h)
@@ -91,6 +94,7 @@ int knet_host_add(knet_handle_t knet_h, knet_node_id_t host_id)
 	 * add new host to the index
 	 */
 	knet_h->host_index[host_id] = host;
+	host->status_generation = _host_topology_changed(knet_h);
 
 	/*
 	 * add new host to host list
@@ -154,6 +158,12 @@ int knet_host_remove(knet_handle_t knet_h, knet_node_id_t host_id)
 		}
 	}
 
+	/*
+	 * drop its link table and the routes via this host
+	 */
+	_relay_clear(knet_h, host);
+	_group_remove_host(knet_h, host_id);
+
 	removed = NULL;
 
 	/*
@@ -173,7 +183,11 @@ int knet_host_remove(knet_handle_t knet_h, knet_node_id_t host_id)
 	}
 
 	knet_h->host_index[host_id] = NULL;
+	for (link_idx = 0; link_idx < KNET_MAX_LINK; link_idx++) {
+		free(removed->defrag_buf[link_idx].fec_buf);
+	}
 	free(removed);
+	knet_h->topology_removed_generation = _host_topology_changed(knet_h);
 
 	_host_list_update(knet_h);
 
@@ -370,7 +384,7 @@ int knet_host_set_policy(knet_handle_t knet_h, knet_node_id_t host_id,
 		return -1;
 	}
 
-	if (policy > KNET_LINK_POLICY_RR) {
+	if (policy > KNET_LINK_POLICY_FEC) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -552,6 +566,7 @@ int _send_host_info(knet_handle_t knet_h, const void *data, const size_t datalen
 static void _clear_cbuffers(struct knet_host *host, seq_num_t rx_seq_num)
 {
 	int i;
+	char *fec_buf;
 
 	memset(host->circular_buffer, 0, KNET_CBUFFER_SIZE);
 	host->rx_seq_num = rx_seq_num;
@@ -559,7 +574,9 @@ static void _clear_cbuffers(struct knet_host *host, seq_num_t rx_seq_num)
 	memset(host->circular_buffer_defrag, 0, KNET_CBUFFER_SIZE);
 
 	for (i = 0; i < KNET_MAX_LINK; i++) {
+		fec_buf = host->defrag_buf[i].fec_buf;
 		memset(&host->defrag_buf[i], 0, sizeof(struct knet_host_defrag_buf));
+		host->defrag_buf[i].fec_buf = fec_buf;
 	}
 }
 
@@ -629,6 +646,15 @@ void _seq_num_set(struct knet_host *host, seq_num_t seq_num, int defrag_buf)
 	return;
 }
 
+/*
+ * host and link status can change from different threads holding
+ * only the global read lock, hence the atomic increment.
+ */
+uint64_t _host_topology_changed(knet_handle_t knet_h)
+{
+	return __atomic_add_fetch(&knet_h->topology_generation, 1, __ATOMIC_RELAXED);
+}
+
 int _host_dstcache_update_async(knet_handle_t knet_h, struct knet_host *host)
 {
 	int savederrno = 0;
@@ -650,6 +676,8 @@ int _host_dstcache_update_sync(knet_handle_t knet_h, struct knet_host *host)
 	int link_idx;
 	int best_priority = -1;
 	int reachable = 0;
+	int remote = 0;
+	struct knet_host *relayed_host;
 
 	if (knet_h->host_id == host->host_id && knet_h->has_loop_link) {
 		host->active_link_entries = 1;
@@ -673,7 +701,7 @@ int _host_dstcache_update_sync(knet_handle_t knet_h, struct knet_host *host)
 			}
 			host->active_link_entries = 1;
 		} else {
-			/* for RR and ACTIVE we need to copy all available links */
+			/* for RR, ACTIVE and FEC we need to copy all available links */
 			host->active_links[host->active_link_entries] = link_idx;
 			host->active_link_entries++;
 		}
@@ -690,15 +718,28 @@ int _host_dstcache_update_sync(knet_handle_t knet_h, struct knet_host *host)
 
 	/* no active links, we can clean the circular buffers and indexes */
 	if (!host->active_link_entries) {
-		log_warn(knet_h, KNET_SUB_HOST, "host: %u has no active links", host->host_id);
-		_clear_cbuffers(host, 0);
+		if (_relay_get_via(knet_h, host)) {
+			reachable = 1;
+			remote = 1;
+		} else {
+			log_warn(knet_h, KNET_SUB_HOST, "host: %u has no active links", host->host_id);
+			_clear_cbuffers(host, 0);
+		}
 	} else {
 		reachable = 1;
 	}
 
-	if (host->status.reachable != reachable) {
+	if ((host->status.reachable != reachable) ||
+	    (host->status.remote != remote)) {
 		host->status.reachable = reachable;
-		if (knet_h->host_status_change_notify_fn) {
+		host->status.remote = remote;
+		host->status_generation = _host_topology_changed(knet_h);
+		if (knet_h->event_queue) {
+			_event_host_status(knet_h, host->host_id,
+					   host->status.reachable,
+					   host->status.remote,
+					   host->status.external);
+		} else if (knet_h->host_status_change_notify_fn) {
 			knet_h->host_status_change_notify_fn(
 						     knet_h->host_status_change_notify_fn_private_data,
 						     host->host_id,
@@ -706,6 +747,21 @@ int _host_dstcache_update_sync(knet_handle_t knet_h, struct knet_host *host)
 						     host->status.remote,
 						     host->status.external);
 		}
+
+		_group_update(knet_h);
+
+		/*
+		 * hosts relayed via this one might have changed too
+		 */
+		if (knet_h->relay_enabled) {
+			for (relayed_host = knet_h->host_head; relayed_host != NULL; relayed_host = relayed_host->next) {
+				if ((relayed_host != host) &&
+				    (relayed_host->relay_valid) &&
+				    (relayed_host->relay_via == host->host_id)) {
+					_host_dstcache_update_async(knet_h, relayed_host);
+				}
+			}
+		}
 	}
 
 	return 0;
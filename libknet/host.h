@@ -18,5 +18,6 @@ void _seq_num_set(struct knet_host *host, seq_num_t seq_num, int defrag_buf);
 int _send_host_info(knet_handle_t knet_h, const void *data, const size_t datalen);
 int _host_dstcache_update_async(knet_handle_t knet_h, struct knet_host *host);
 int _host_dstcache_update_sync(knet_handle_t knet_h, struct knet_host *host);
+uint64_t _host_topology_changed(knet_handle_t knet_h);
 
 #endif
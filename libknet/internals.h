@@ -28,13 +28,52 @@
 #define KNET_DATABUFSIZE_COMPRESS_PAD 1024
 #define KNET_DATABUFSIZE_COMPRESS KNET_DATABUFSIZE + KNET_DATABUFSIZE_COMPRESS_PAD
 
+#define KNET_DATABUFSIZE_FEC_PAD 1024
+#define KNET_DATABUFSIZE_FEC KNET_DATABUFSIZE + KNET_DATABUFSIZE_FEC_PAD
+
 #define KNET_RING_RCVBUFF 8388608
 
+/*
+ * MSG_ZEROCOPY output buffers ring. Each buffer holds either the
+ * fragment headers of an unencrypted packet or the encrypted
+ * fragments (data + FEC parity + crypto overhead)
+ */
+#define KNET_ZEROCOPY_BUFS 16
+#define KNET_ZEROCOPY_MAX_FRAGS 32
+#define KNET_ZEROCOPY_OUTSIZE ((KNET_DATABUFSIZE * 2) + (KNET_ZEROCOPY_MAX_FRAGS * (KNET_HEADER_ALL_SIZE + KNET_DATABUFSIZE_CRYPT_PAD)))
+
+/*
+ * buffers lent to the application by knet_send_buf_reserve.
+ * On commit a lent buffer is swapped with recv_from_sock_buf
+ */
+#define KNET_SEND_BUFS 16
+
 #define PCKT_FRAG_MAX UINT8_MAX
 #define PCKT_RX_BUFS  512
 
+/*
+ * RX buffers (KNET_DATABUFSIZE) also receive UDP GRO coalesced
+ * packets, those are capped by the kernel to 64KB.
+ * PCKT_RX_CMSG_SIZE is the room for transport ancillary data
+ * (UDP GRO segment size) of each RX buffer
+ */
+#define PCKT_RX_CMSG_SIZE 64
+
 #define KNET_EPOLL_MAX_EVENTS KNET_DATAFD_MAX
 
+/*
+ * the TX thread also polls hostsockfd, the coalesce and pacing
+ * timers and the link sockets waiting for EPOLLOUT (EPOLLONESHOT,
+ * those that do not fit are returned by the next epoll_wait)
+ */
+#define KNET_TX_EPOLL_MAX_EVENTS (KNET_DATAFD_MAX + 3 + KNET_MAX_LINK)
+
+/*
+ * amount of data the TX thread reads from a channel in one
+ * deficit round robin turn
+ */
+#define KNET_TX_CHANNEL_QUANTUM KNET_MAX_PACKET_SIZE
+
 typedef void *knet_transport_link_t; /* per link transport handle */
 typedef void *knet_transport_t;      /* per knet_h transport handle */
 struct  knet_transport_ops;          /* Forward because of circular dependancy */
@@ -44,6 +83,19 @@ struct knet_mmsghdr {
 	unsigned int  msg_len;	/* Number of bytes transmitted */
 };
 
+/*
+ * packet waiting in a link TX queue for the socket
+ * to become writable again
+ */
+struct knet_txq_msg {
+	struct knet_txq_msg *next;
+	int8_t channel;		/* data channel, see knet_handle tx_channel */
+	seq_num_t seq_num;	/* for the tx probes */
+	struct timespec queued;	/* when the packet has been queued */
+	size_t len;
+	unsigned char buf[];
+};
+
 struct knet_link {
 	/* required */
 	struct sockaddr_storage src_addr;
@@ -60,6 +112,8 @@ struct knet_link {
 	uint64_t flags;
 	/* status */
 	struct knet_link_status status;
+	uint64_t status_generation;		/* see knet_handle_get_topology_status */
+	struct knet_histogram rtt_histogram;	/* see knet_link_get_rtt_histogram */
 	/* internals */
 	uint8_t link_id;
 	uint8_t transport_type;                 /* #defined constant from API */
@@ -67,6 +121,8 @@ struct knet_link {
 	int outsock;
 	unsigned int configured:1;		/* set to 1 if src/dst have been configured transport initialized on this link*/
 	unsigned int transport_connected:1;	/* set to 1 if lower level transport is connected */
+	unsigned int transport_gso:1;		/* set to 1 if lower level transport can segment (UDP GSO) */
+	unsigned int transport_zerocopy:1;	/* set to 1 if lower level transport supports MSG_ZEROCOPY */
 	unsigned int latency_exp;
 	uint8_t received_pong;
 	struct timespec ping_last;
@@ -79,6 +135,20 @@ struct knet_link {
 	uint32_t last_sent_mtu;
 	uint32_t last_recv_mtu;
 	uint8_t has_valid_mtu;
+	/* TX queue, see knet_link_set_tx_queue */
+	struct knet_txq_msg *txq_head;
+	struct knet_txq_msg *txq_tail;
+	uint32_t txq_count;			/* packets in the queue */
+	uint32_t txq_len;			/* max packets in the queue, 0 disables queuing */
+	uint8_t txq_policy;			/* see KNET_LINK_TXQ_POLICY_* */
+	unsigned int txq_blocked:1;		/* queue is full and TX thread has to stop reading data */
+	unsigned int txq_paced:1;		/* queue is waiting for the token bucket to refill */
+	struct timespec txq_next;		/* when the queue can be drained again (pacing) */
+	/* pacing, see knet_link_set_rate */
+	uint64_t rate;				/* bytes per second, 0 disables pacing */
+	uint32_t burst;				/* max bytes sent back to back */
+	double tokens;				/* token bucket, can go negative */
+	struct timespec tokens_last;		/* last token bucket refill */
 };
 
 #define KNET_CBUFFER_SIZE 4096
@@ -93,6 +163,17 @@ struct knet_host_defrag_buf {
 	uint16_t frag_size;		/* normal frag size (not the last one) */
 	uint16_t last_frag_size;	/* the last fragment might not be aligned with MTU size */
 	struct timespec last_update;	/* keep time of the last pckt */
+	uint8_t fec;			/* number of FEC parity fragments for this pckt */
+	uint8_t fec_recv;		/* how many parity fragments did we receive */
+	char *fec_buf;			/* parity fragments (without trailer), allocated on the first FEC pckt */
+};
+
+/*
+ * entry of the link table received from a host, see relay.c
+ */
+struct knet_relay_entry {
+	knet_node_id_t node_id;		/* host directly connected to the table owner */
+	uint32_t latency;		/* latency of its best link in usecs */
 };
 
 struct knet_host {
@@ -103,6 +184,7 @@ struct knet_host {
 	char name[KNET_MAX_HOST_LEN];
 	/* status */
 	struct knet_host_status status;
+	uint64_t status_generation;	/* see knet_handle_get_topology_status */
 	/* internals */
 	char circular_buffer[KNET_CBUFFER_SIZE];
 	seq_num_t rx_seq_num;
@@ -116,9 +198,27 @@ struct knet_host {
 	struct knet_link link[KNET_MAX_LINK];
 	uint8_t active_link_entries;
 	uint8_t active_links[KNET_MAX_LINK];
+	/* relay stuff */
+	struct knet_relay_entry *relay_table;	/* link table received from this host (RX thread only) */
+	size_t relay_table_entries;
+	struct timespec relay_table_time;	/* when relay_table has been received */
+	knet_node_id_t relay_via;		/* host that can forward our data to this host */
+	uint8_t relay_valid;			/* relay_via can be used */
+	uint32_t relay_latency;			/* latency to this host via relay_via in usecs */
 	struct knet_host *next;
 };
 
+/*
+ * see knet_group_create
+ */
+struct knet_group {
+	knet_node_id_t *host_ids;	/* hosts in the group */
+	size_t host_ids_entries;
+	struct knet_host **dst_hosts;	/* reachable hosts in the group, see _group_update */
+	size_t dst_hosts_entries;
+	uint8_t has_local;		/* our own host is in the group */
+};
+
 struct knet_sock {
 	int sockfd[2];   /* sockfd[0] will always be application facing
 			  * and sockfd[1] internal if sockpair has been created by knet */
@@ -127,12 +227,47 @@ struct knet_sock {
 	int in_use;      /* set to 1 if it's use, 0 if free */
 	int has_error;   /* set to 1 if there were errors reading from the sock
 			  * and socket has been removed from epoll */
+	uint8_t priority; /* higher priority channels are served first by the TX thread */
+	ssize_t deficit;  /* deficit round robin counter between channels with the same priority */
+	uint32_t lifetime; /* msecs the transport should try to deliver data, 0 = reliable */
+	void *rx_notify_fn_private_data;
+	void (*rx_notify_fn) ( /* deliver RX data here instead of the datafd */
+		void *private_data,
+		const unsigned char *data,
+		ssize_t data_len,
+		knet_node_id_t src_host_id,
+		int8_t channel);
+};
+
+#define KNET_COALESCE_MAX_DST 16
+
+struct knet_coalesce {
+	uint32_t max_delay;		/* max time in usecs a message can be held, 0 disabled */
+	struct knet_header *buf;	/* packet being filled with user messages */
+	size_t buf_len;			/* size of the user messages in buf (frames included) */
+	struct timespec deadline;	/* buf has to be sent by this time */
+	int bcast;			/* destinations of the messages in buf */
+	knet_node_id_t dst_host_ids[KNET_COALESCE_MAX_DST];
+	size_t dst_host_ids_entries;
+};
+
+struct knet_zerocopy_buf {
+	struct knet_header *data;	/* spare buffer swapped with recv_from_sock_buf */
+	unsigned char *out;		/* fragment headers or encrypted fragments */
+	unsigned int pending;		/* MSG_ZEROCOPY sends not released by the kernel yet */
+};
+
+struct knet_send_buf {
+	struct knet_header *data;	/* allocated on first reserve */
+	uint8_t lent;			/* owned by the application */
 };
 
 struct knet_fd_trackers {
 	uint8_t transport; /* transport type (UDP/SCTP...) */
 	uint8_t data_type; /* internal use for transport to define what data are associated
 			    * to this fd */
+	uint8_t uring_armed; /* fd is received via io_uring */
+	uint32_t uring_gen; /* bumped every time the fd is (re)assigned */
 	void *data;	   /* pointer to the data */
 };
 
@@ -151,12 +286,44 @@ struct knet_handle {
 	knet_node_id_t host_id;
 	unsigned int enabled:1;
 	struct knet_sock sockfd[KNET_DATAFD_MAX];
+	struct knet_coalesce coalesce[KNET_DATAFD_MAX];
+	int coalesce_timerfd;
+	int8_t tx_next_channel;	/* first channel to serve in the next TX round */
+	unsigned int txq_blocked;	/* number of links with a full TX queue and backpressure policy */
+	int pacing_timerfd;
+	uint32_t zerocopy_threshold;	/* min fragment size to use MSG_ZEROCOPY, 0 = disabled */
+	struct knet_zerocopy_buf zerocopy_buf[KNET_ZEROCOPY_BUFS];
+	struct knet_zerocopy_buf *tx_zerocopy_buf; /* ring buffer used by the packet being sent */
+	int8_t tx_channel;		/* data channel of the packet being sent, -1 for internal data */
+	uint8_t tx_direct;		/* packet being sent comes from a knet_send_* call, not a datafd */
+	struct knet_send_buf send_buf[KNET_SEND_BUFS];
+	struct sockaddr_storage mcast_addr;	/* multicast group for broadcast data, ss_family 0 = disabled */
+	struct sockaddr_storage mcast_src_addr;	/* local address used to join the group */
+	uint8_t mcast_ttl;
+	int mcast_sockfd;
+	uint8_t relay_enabled;		/* see knet_handle_set_relay */
+	struct knet_group *groups[KNET_MAX_GROUPS];
+	struct knet_group *tx_group;	/* destination group of the packet being sent */
+	struct timespec relay_table_last;	/* last time we sent our link table */
+	struct knet_stats_shm *stats_shm;	/* see knet_handle_enable_stats_shm */
+	int stats_shm_fd;
+	uint32_t stats_shm_interval;
+	struct timespec stats_shm_last;	/* last time we updated stats_shm */
+	uint64_t topology_generation;	/* bumped on every host/link status change */
+	uint64_t topology_removed_generation;	/* generation of the last host/link removal */
+	struct knet_event_queue *event_queue;	/* see knet_handle_enable_event_queue */
+	struct knet_histogram histograms[KNET_HISTOGRAM_MAX];	/* see knet_handle_get_histogram */
+	uint8_t stage_stats_enabled;	/* see knet_handle_enable_stage_stats */
+	struct knet_stage_counter stage_stats[KNET_STAGE_MAX];
+	pthread_mutex_t zerocopy_mutex;	/* used to protect zerocopy_buf between TX and RX (completions) */
+	pthread_mutex_t send_buf_mutex;	/* used to protect send_buf between reserve and commit */
 	int logfd;
 	uint8_t log_levels[KNET_MAX_SUBSYSTEMS];
 	int hostsockfd[2];
 	int dstsockfd[2];
 	int send_to_links_epollfd;
 	int recv_from_links_epollfd;
+	struct knet_uring *uring;	/* io_uring RX engine, NULL when using epoll */
 	int dst_link_handler_epollfd;
 	unsigned int pmtud_interval;
 	unsigned int data_mtu;	/* contains the max data size that we can send onwire
@@ -171,6 +338,8 @@ struct knet_handle {
 	knet_node_id_t host_ids[KNET_MAX_HOST];
 	size_t host_ids_entries;
 	struct knet_header *recv_from_sock_buf;
+	knet_node_id_t tx_dst_host_ids_temp[KNET_MAX_HOST];	/* TX destinations, too big for the stack, */
+	knet_node_id_t tx_dst_host_ids[KNET_MAX_HOST];		/* protected by tx_mutex */
 	struct knet_header *send_to_links_buf[PCKT_FRAG_MAX];
 	struct knet_header *recv_from_links_buf[PCKT_RX_BUFS];
 	struct knet_header *pingbuf;
@@ -210,7 +379,9 @@ struct knet_handle {
 	size_t compress_threshold;
 	void *compress_int_data[KNET_MAX_COMPRESS_METHODS]; /* for compress method private data */
 	unsigned char *recv_from_links_buf_decompress;
+	unsigned char *recv_from_links_buf_gro;
 	unsigned char *send_to_links_buf_compress;
+	unsigned char *send_to_links_buf_fec;
 	seq_num_t tx_seq_num;
 	pthread_mutex_t tx_seq_num_mutex;
 	uint8_t has_loop_link;
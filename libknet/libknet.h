@@ -15,6 +15,7 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <limits.h>
+#include <sys/uio.h>
 
 /**
  * @file libknet.h
@@ -88,6 +89,12 @@ typedef uint16_t knet_node_id_t;
 
 #define KNET_HANDLE_FLAG_PRIVILEGED (1ULL << 0)
 
+/*
+ * Receive from UDP links with io_uring instead of epoll + recvmmsg.
+ */
+
+#define KNET_HANDLE_FLAG_IO_URING (1ULL << 1)
+
 /*
  * threads timer resolution (see knet_handle_set_threads_timer_res below)
  */
@@ -131,6 +138,10 @@ typedef struct knet_handle *knet_handle_t;
  *            communication sockets.  If disabled, failure to acquire large
  *            enough socket buffers is ignored but logged.  Inadequate buffers
  *            lead to poor performance.
+ *            KNET_HANDLE_FLAG_IO_URING: receive from UDP links using io_uring
+ *            multishot recvmsg into a ring of kernel provided buffers,
+ *            instead of epoll and recvmmsg. Requires Linux >= 6.0.
+ *            Other transports keep using epoll.
  *
  * @return
  * on success, a new knet_handle_t is returned.
@@ -138,6 +149,7 @@ typedef struct knet_handle *knet_handle_t;
  * knet-specific errno values:
  *   ENAMETOOLONG - socket buffers couldn't be set big enough and KNET_HANDLE_FLAG_PRIVILEGED was specified
  *   ERANGE       - buffer size readback returned unexpected type
+ *   EOPNOTSUPP   - KNET_HANDLE_FLAG_IO_URING was specified but io_uring is not available
  */
 
 knet_handle_t knet_handle_new(knet_node_id_t host_id,
@@ -378,6 +390,189 @@ int knet_handle_get_channel(knet_handle_t knet_h, const int datafd, int8_t *chan
 
 int knet_handle_get_datafd(knet_handle_t knet_h, const int8_t channel, int *datafd);
 
+/*
+ * max delay that can be configured for small messages coalescing
+ */
+
+#define KNET_COALESCE_MAX_DELAY 1000000 /* 1 second in usecs */
+
+/**
+ * knet_handle_set_channel_coalesce
+ * @brief Pack small messages sent on a channel into fewer packets
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * channel   - channel as returned by knet_handle_add_datafd
+ *
+ * max_delay - max time in microseconds a message can be held back
+ *             waiting for other messages bound to the same destinations.
+ *             Messages are packed together until the packet would
+ *             exceed the data MTU or max_delay expires, whatever
+ *             comes first. Messages that don't fit in a single
+ *             packet, or that are sent via knet_send_sync, are never
+ *             delayed.
+ *             0 disables coalescing (default).
+ *             Max value is KNET_COALESCE_MAX_DELAY.
+ *             NOTE: the coalescing configuration of a channel is
+ *             reset when its datafd is removed, and all nodes
+ *             need to support coalesced packets.
+ *
+ * @return
+ * knet_handle_set_channel_coalesce returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_channel_coalesce(knet_handle_t knet_h, const int8_t channel, uint32_t max_delay);
+
+/**
+ * knet_handle_get_channel_coalesce
+ * @brief Get the small messages coalescing delay of a channel
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * channel   - channel as returned by knet_handle_add_datafd
+ *
+ * max_delay - will contain the configured delay in microseconds,
+ *             0 if coalescing is disabled.
+ *
+ * @return
+ * knet_handle_get_channel_coalesce returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_channel_coalesce(knet_handle_t knet_h, const int8_t channel, uint32_t *max_delay);
+
+/**
+ * knet_handle_set_channel_priority
+ * @brief Set the priority used by the TX thread to serve a channel
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * channel  - channel as returned by knet_handle_add_datafd
+ *
+ * priority - data from channels with higher priority is always
+ *            sent before data from channels with lower priority.
+ *            Channels with the same priority share the bandwidth
+ *            fairly (deficit round robin).
+ *            Default is 0 (lowest). Host info messages generated
+ *            internally by libknet are always sent first.
+ *            NOTE: the priority of a channel is reset when
+ *            its datafd is removed.
+ *
+ * @return
+ * knet_handle_set_channel_priority returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_channel_priority(knet_handle_t knet_h, const int8_t channel, uint8_t priority);
+
+/**
+ * knet_handle_get_channel_priority
+ * @brief Get the priority of a channel
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * channel  - channel as returned by knet_handle_add_datafd
+ *
+ * priority - will contain the channel priority
+ *
+ * @return
+ * knet_handle_get_channel_priority returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_channel_priority(knet_handle_t knet_h, const int8_t channel, uint8_t *priority);
+
+/**
+ * knet_handle_set_channel_lifetime
+ * @brief Set how long the transport should try to deliver data from a channel
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * channel  - channel as returned by knet_handle_add_datafd
+ *
+ * lifetime - time in milliseconds after which data that has not
+ *            been delivered yet can be abandoned by the transport.
+ *            This is useful for latency sensitive channels, where
+ *            late data is worth less than fresh data.
+ *            Default is 0 (fully reliable when the transport is).
+ *            Only SCTP links (PR-SCTP) honor the lifetime,
+ *            UDP is never reliable.
+ *            NOTE: the lifetime of a channel is reset when
+ *            its datafd is removed.
+ *
+ * @return
+ * knet_handle_set_channel_lifetime returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_channel_lifetime(knet_handle_t knet_h, const int8_t channel, uint32_t lifetime);
+
+/**
+ * knet_handle_get_channel_lifetime
+ * @brief Get the delivery lifetime of a channel
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * channel  - channel as returned by knet_handle_add_datafd
+ *
+ * lifetime - will contain the channel lifetime in milliseconds
+ *
+ * @return
+ * knet_handle_get_channel_lifetime returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_channel_lifetime(knet_handle_t knet_h, const int8_t channel, uint32_t *lifetime);
+
+/**
+ * knet_handle_enable_channel_rx_notify
+ * @brief Receive the data of a channel via callback instead of datafd
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * channel  - channel as returned by knet_handle_add_datafd
+ *
+ * rx_notify_fn_private_data
+ *            void pointer to data that can be used to identify
+ *            the callback.
+ *
+ * rx_notify_fn
+ *            A callback function that is invoked for every packet
+ *            received on the channel, instead of writing the packet
+ *            to the datafd. NULL restores delivery via datafd.
+ *            data points into a libknet internal buffer that is only
+ *            valid till the callback returns.
+ *            The callback is invoked by the RX thread (or by the
+ *            sending thread for data looped back to the local host)
+ *            with internal locks held: it MUST NEVER block, add
+ *            substantial delays or call libknet functions that change
+ *            the configuration.
+ *            The datafd is still used to send data and must stay installed.
+ *            NOTE: the callback is removed together with the datafd.
+ *
+ * @return
+ * knet_handle_enable_channel_rx_notify returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_enable_channel_rx_notify(knet_handle_t knet_h,
+					 const int8_t channel,
+					 void *rx_notify_fn_private_data,
+					 void (*rx_notify_fn) (
+						void *private_data,
+						const unsigned char *data,
+						ssize_t data_len,
+						knet_node_id_t src_host_id,
+						int8_t channel));
+
 /**
  * knet_recv
  * @brief Receive data from knet nodes
@@ -422,6 +617,89 @@ ssize_t knet_send(knet_handle_t knet_h,
 		  const size_t buff_len,
 		  const int8_t channel);
 
+/*
+ * Maximum number of messages moved by one call to
+ * knet_send_batch or knet_recv_batch
+ */
+
+#define KNET_MAX_BATCH 64
+
+/**
+ * struct knet_msg
+ *
+ * @brief one message of a batch
+ *
+ * iov    - data of the message. The payload can be split
+ *          in multiple buffers (scatter/gather)
+ *
+ * iovlen - number of entries in iov
+ *
+ * len    - set by libknet to the amount of data sent/received
+ */
+
+struct knet_msg {
+	struct iovec *iov;
+	size_t iovlen;
+	size_t len;
+};
+
+/**
+ * knet_send_batch
+ *
+ * @brief Send multiple messages to knet nodes
+ *
+ * knet_h       - pointer to knet_handle_t
+ *
+ * msgs         - array of messages to send. Each message total
+ *                length must not exceed KNET_MAX_PACKET_SIZE
+ *
+ * msgs_entries - number of messages in msgs (max KNET_MAX_BATCH)
+ *
+ * channel      - channel number
+ *
+ * knet_send_batch is the batched version of knet_send(3).
+ * When the channel datafd is a socket, messages are written with
+ * a single sendmmsg(2). Otherwise each message is written with
+ * writev(2).
+ *
+ * @return
+ * knet_send_batch returns the number of messages sent,
+ * or -1 on error and errno is set if no message could be sent.
+ */
+
+int knet_send_batch(knet_handle_t knet_h,
+		    struct knet_msg *msgs,
+		    const unsigned int msgs_entries,
+		    const int8_t channel);
+
+/**
+ * knet_recv_batch
+ *
+ * @brief Receive multiple messages from knet nodes
+ *
+ * knet_h       - pointer to knet_handle_t
+ *
+ * msgs         - array of messages to fill
+ *
+ * msgs_entries - number of messages in msgs (max KNET_MAX_BATCH)
+ *
+ * channel      - channel number
+ *
+ * knet_recv_batch is the batched version of knet_recv(3).
+ * When the channel datafd is a socket, messages are read with
+ * a single recvmmsg(2). Otherwise each message is read with
+ * readv(2). Reading stops when there is no more data available.
+ *
+ * @return
+ * knet_recv_batch returns the number of messages received,
+ * or -1 on error and errno is set if no message could be received.
+ */
+
+int knet_recv_batch(knet_handle_t knet_h,
+		    struct knet_msg *msgs,
+		    const unsigned int msgs_entries,
+		    const int8_t channel);
+
 /**
  * knet_send_sync
  *
@@ -457,7 +735,9 @@ ssize_t knet_send(knet_handle_t knet_h,
  * @retval ENOMSG    - received unknown message type
  * @retval EHOSTDOWN - unicast pckt cannot be delivered because dest host is not connected yet
  * @retval ECHILD    - crypto failed
- * @retval EAGAIN    - sendmmsg was unable to send all messages and there was no progress during retry
+ * @retval EAGAIN    - sendmmsg was unable to send all messages and there was no progress during retry,
+ *                    or the TX queue of a link with KNET_LINK_TXQ_POLICY_BACKPRESSURE is full.
+ *                    The packet has not been sent to any destination and can be sent again
  */
 
 int knet_send_sync(knet_handle_t knet_h,
@@ -465,6 +745,210 @@ int knet_send_sync(knet_handle_t knet_h,
 		   const size_t buff_len,
 		   const int8_t channel);
 
+/**
+ * knet_send_to
+ *
+ * @brief Send data to a given list of hosts
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * buff     - pointer to the buffer of data to send
+ *
+ * buff_len - length of data to send
+ *
+ * channel  - data channel to use (see knet_handle_add_datafd(3))
+ *
+ * dst_host_ids - array of destination host ids
+ *
+ * dst_host_ids_entries - number of entries in dst_host_ids (max KNET_MAX_HOST)
+ *
+ * Data is processed in the caller context and dst_host_filter_fn
+ * is not invoked. Small messages can be held back to be coalesced
+ * (see knet_handle_set_channel_coalesce(3)).
+ * Unreachable hosts in dst_host_ids are skipped.
+ *
+ * @return
+ * knet_send_to returns 0 on success and -1 on error.
+ * In addition to normal sendmmsg errors, knet_send_to can fail
+ * due to:
+ *
+ * @retval ECANCELED - data forward is disabled
+ * @retval EINVAL    - invalid dst_host_ids or dst_host_ids_entries
+ * @retval EHOSTDOWN - none of the destination hosts is reachable
+ * @retval ECHILD    - crypto failed
+ * @retval EAGAIN    - sendmmsg was unable to send all messages and there was no progress during retry,
+ *                    or the TX queue of a link with KNET_LINK_TXQ_POLICY_BACKPRESSURE is full.
+ *                    The packet has not been sent to any destination and can be sent again
+ */
+
+int knet_send_to(knet_handle_t knet_h,
+		 const char *buff,
+		 const size_t buff_len,
+		 const int8_t channel,
+		 const knet_node_id_t *dst_host_ids,
+		 size_t dst_host_ids_entries);
+
+/**
+ * knet_send_sync_to
+ *
+ * @brief Synchronously send data to a given list of hosts
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * buff     - pointer to the buffer of data to send
+ *
+ * buff_len - length of data to send
+ *
+ * channel  - data channel to use (see knet_handle_add_datafd(3))
+ *
+ * dst_host_ids - array of destination host ids
+ *
+ * dst_host_ids_entries - number of entries in dst_host_ids (max KNET_MAX_HOST)
+ *
+ * Same as knet_send_to(3), but data is always delivered straight
+ * to the link layer, like knet_send_sync(3). Unlike knet_send_sync(3),
+ * multiple destinations are supported.
+ *
+ * @return
+ * knet_send_sync_to returns 0 on success and -1 on error,
+ * see knet_send_to(3) for errors.
+ */
+
+int knet_send_sync_to(knet_handle_t knet_h,
+		      const char *buff,
+		      const size_t buff_len,
+		      const int8_t channel,
+		      const knet_node_id_t *dst_host_ids,
+		      size_t dst_host_ids_entries);
+
+/**
+ * knet_send_to_group
+ *
+ * @brief Synchronously send data to a group of hosts
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * group_id - destination group (see knet_group_create(3))
+ *
+ * buff     - pointer to the buffer of data to send
+ *
+ * buff_len - length of data to send
+ *
+ * channel  - data channel to use (see knet_handle_add_datafd(3))
+ *
+ * Like knet_send_sync(3), data is delivered directly to the link
+ * layer. dst_host_filter_fn is not invoked: the list of reachable
+ * hosts in the group is maintained by libknet when hosts change
+ * status, and data is sent to all of them.
+ *
+ * @return
+ * knet_send_to_group returns 0 on success and -1 on error.
+ * In addition to normal sendmmsg errors, knet_send_to_group can fail
+ * due to:
+ *
+ * @retval ECANCELED - data forward is disabled
+ * @retval EINVAL    - group_id does not exist
+ * @retval EHOSTDOWN - none of the hosts in the group is reachable
+ * @retval ECHILD    - crypto failed
+ * @retval EAGAIN    - sendmmsg was unable to send all messages and there was no progress during retry,
+ *                    or the TX queue of a link with KNET_LINK_TXQ_POLICY_BACKPRESSURE is full.
+ *                    The packet has not been sent to any destination and can be sent again
+ */
+
+int knet_send_to_group(knet_handle_t knet_h,
+		       uint16_t group_id,
+		       const char *buff,
+		       const size_t buff_len,
+		       const int8_t channel);
+
+/**
+ * knet_send_buf_reserve
+ *
+ * @brief Borrow a TX buffer from libknet
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * buff     - returns a pointer to the buffer where data should be written
+ *
+ * buff_len - returns the size of the buffer (KNET_MAX_PACKET_SIZE)
+ *
+ * knet_send(3) and knet_send_sync(3) copy data into the buffer
+ * the TX path works on. Data written in a reserved buffer is
+ * instead processed in place when passed to knet_send_buf_commit(3).
+ * The buffer already contains room for the knet packet header.
+ *
+ * Up to KNET_SEND_BUFS (16) buffers can be reserved at the same time.
+ * Each buffer must be returned with knet_send_buf_commit(3) or
+ * knet_send_buf_release(3).
+ *
+ * @return
+ * knet_send_buf_reserve returns
+ * 0 on success
+ * -1 on error and errno is set (EBUSY if all buffers are reserved).
+ */
+
+int knet_send_buf_reserve(knet_handle_t knet_h,
+			  char **buff,
+			  size_t *buff_len);
+
+/**
+ * knet_send_buf_commit
+ *
+ * @brief Synchronously send data from a reserved TX buffer
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * buff     - buffer returned by knet_send_buf_reserve(3)
+ *
+ * buff_len - length of data written in the buffer
+ *
+ * channel  - data channel to use (see knet_handle_add_datafd(3))
+ *
+ * Data is processed in the caller context, like knet_send_sync(3),
+ * but destinations follow the same rules as knet_send(3)
+ * (broadcast and multiple destinations are allowed).
+ *
+ * buff is given back to libknet, also on error, and must not be
+ * accessed anymore after this call.
+ *
+ * @return
+ * knet_send_buf_commit returns 0 on success and -1 on error.
+ * In addition to normal sendmmsg errors, knet_send_buf_commit can fail
+ * due to:
+ *
+ * @retval ECANCELED - data forward is disabled
+ * @retval EFAULT    - dst_host_filter fatal error
+ * @retval EINVAL    - buff was not reserved or dst_host_filter did not provide dst_host_ids_entries on unicast pckts
+ * @retval EHOSTDOWN - pckt cannot be delivered because dest host is not connected yet
+ * @retval ECHILD    - crypto failed
+ * @retval EAGAIN    - sendmmsg was unable to send all messages and there was no progress during retry,
+ *                    or the TX queue of a link with KNET_LINK_TXQ_POLICY_BACKPRESSURE is full.
+ *                    The packet has not been sent to any destination and can be sent again
+ */
+
+int knet_send_buf_commit(knet_handle_t knet_h,
+			 char *buff,
+			 const size_t buff_len,
+			 const int8_t channel);
+
+/**
+ * knet_send_buf_release
+ *
+ * @brief Return a reserved TX buffer without sending it
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * buff     - buffer returned by knet_send_buf_reserve(3)
+ *
+ * @return
+ * knet_send_buf_release returns
+ * 0 on success
+ * -1 on error and errno is set (EINVAL if buff was not reserved).
+ */
+
+int knet_send_buf_release(knet_handle_t knet_h,
+			  char *buff);
+
 /**
  * knet_handle_enable_filter
  *
@@ -784,6 +1268,175 @@ struct knet_handle_compress_cfg {
 int knet_handle_compress(knet_handle_t knet_h,
 			 struct knet_handle_compress_cfg *knet_handle_compress_cfg);
 
+/*
+ * smallest fragment size worth sending with MSG_ZEROCOPY
+ */
+
+#define KNET_ZEROCOPY_MIN_THRESHOLD 4096
+
+/**
+ * knet_handle_set_zerocopy
+ *
+ * @brief Send large fragments without copying them in the kernel
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * threshold - min size in bytes of the fragments of a packet to send
+ *             it with MSG_ZEROCOPY.
+ *             0 disables zerocopy (default).
+ *             Min value is KNET_ZEROCOPY_MIN_THRESHOLD, pinning
+ *             pages and tracking completions costs more than
+ *             copying smaller fragments.
+ *
+ * Implementation notes:
+ * - requires SO_ZEROCOPY support for UDP sockets (Linux >= 5.0),
+ *   links on other transports keep copying data.
+ * - unencrypted packets are sent zerocopy only when they are not
+ *   coalesced and have no FEC parity fragments. Encrypted packets
+ *   are always eligible.
+ * - a ring of output buffers is allocated the first time zerocopy
+ *   is enabled. Buffers are not reused till the kernel releases them,
+ *   when they are all in use packets are copied as usual.
+ * - the kernel copies data anyway when the destination is local,
+ *   see tx_zerocopy_copied in knet_handle_stats.
+ *
+ * @return
+ * knet_handle_set_zerocopy returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_zerocopy(knet_handle_t knet_h, uint32_t threshold);
+
+/**
+ * knet_handle_get_zerocopy
+ *
+ * @brief Get the MSG_ZEROCOPY threshold
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * threshold - will contain the current threshold, 0 if zerocopy
+ *             is disabled
+ *
+ * @return
+ * knet_handle_get_zerocopy returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_zerocopy(knet_handle_t knet_h, uint32_t *threshold);
+
+/**
+ * knet_handle_set_mcast
+ *
+ * @brief Send broadcast data once to a multicast group
+ *
+ * knet_h     - pointer to knet_handle_t
+ *
+ * mcast_addr - multicast group (IPv4 or IPv6) and port. Broadcast data
+ *              packets are sent once to the group instead of once per
+ *              host and link. NULL disables multicast (default).
+ *
+ * src_addr   - local address of the interface used to join the group
+ *              and to send to it. Must be of the same family as mcast_addr.
+ *
+ * ttl        - multicast TTL (IPv4) or hop limit (IPv6), 1 keeps the
+ *              traffic on the local network segment.
+ *
+ * Implementation notes:
+ * - all nodes must join the same group, unicast data (knet_send with
+ *   a dst_host_filter returning specific hosts), heartbeats and PMTUd
+ *   still use the links. Data to the local host is still sent via its link.
+ * - multicast is not reliable: a lost packet is lost for all the nodes,
+ *   there is no fallback on the links once the group has been used.
+ * - the data MTU is calculated on the links, the path to the group
+ *   is expected to support the same MTU.
+ * - if sending to the group fails, data is sent on the links as usual.
+ *
+ * @return
+ * knet_handle_set_mcast returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_mcast(knet_handle_t knet_h, struct sockaddr_storage *mcast_addr,
+			  struct sockaddr_storage *src_addr, uint8_t ttl);
+
+/**
+ * knet_handle_get_mcast
+ *
+ * @brief Get the multicast group used for broadcast data
+ *
+ * knet_h     - pointer to knet_handle_t
+ *
+ * mcast_addr - will contain the multicast group,
+ *              ss_family is 0 if multicast is disabled
+ *
+ * src_addr   - will contain the local address used to join the group
+ *
+ * ttl        - will contain the multicast TTL / hop limit
+ *
+ * @return
+ * knet_handle_get_mcast returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_mcast(knet_handle_t knet_h, struct sockaddr_storage *mcast_addr,
+			  struct sockaddr_storage *src_addr, uint8_t *ttl);
+
+/**
+ * knet_handle_set_relay
+ *
+ * @brief Forward data via intermediate hosts
+ *
+ * knet_h     - pointer to knet_handle_t
+ *
+ * enabled    - set to 1 to exchange link tables with the directly
+ *              connected hosts and to relay data, 0 to disable (default).
+ *
+ * Implementation notes:
+ * - every host periodically sends the list of hosts it can reach
+ *   directly, with the latency of its best link to each of them.
+ * - data to a host without active links, or whose direct links are
+ *   slower than going via another host, is sent to that host,
+ *   that forwards it as-is (without decrypting it) over its own links.
+ *   A packet is relayed by one intermediate host at most, and only
+ *   when it has been received from a configured link address of the
+ *   host that generated it. Anything else is dropped and accounted
+ *   in fwd_relay_drops (see knet_handle_get_stats(3)).
+ * - hosts reachable only via a relay are reported as reachable and
+ *   remote (see knet_host_get_status(3)).
+ * - all hosts must enable relay, with the same crypto configuration.
+ *   Relayed packets carry a small extra header that reduces the
+ *   data MTU, and the links of the relay are expected to support
+ *   the same MTU as the links of the sender.
+ *
+ * @return
+ * knet_handle_set_relay returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_set_relay(knet_handle_t knet_h, unsigned int enabled);
+
+/**
+ * knet_handle_get_relay
+ *
+ * @brief Get the relay forwarding status
+ *
+ * knet_h     - pointer to knet_handle_t
+ *
+ * enabled    - will contain 1 if relay forwarding is enabled, 0 otherwise
+ *
+ * @return
+ * knet_handle_get_relay returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_relay(knet_handle_t knet_h, unsigned int *enabled);
+
 
 
 struct knet_handle_stats {
@@ -814,63 +1467,261 @@ struct knet_handle_stats {
 	uint64_t tx_crypt_time_min;
 	uint64_t tx_crypt_time_max;
 
-	uint64_t rx_crypt_packets;
-	uint64_t rx_crypt_time_ave;
-	uint64_t rx_crypt_time_min;
-	uint64_t rx_crypt_time_max;
+	uint64_t rx_crypt_packets;
+	uint64_t rx_crypt_time_ave;
+	uint64_t rx_crypt_time_min;
+	uint64_t rx_crypt_time_max;
+
+	/* Small messages coalescing */
+	uint64_t tx_coalesced_msgs;
+	uint64_t tx_coalesced_packets;
+	uint64_t rx_coalesced_msgs;
+	uint64_t rx_coalesced_packets;
+
+	/* MSG_ZEROCOPY */
+	uint64_t tx_zerocopy_packets;
+	uint64_t tx_zerocopy_copied;
+	uint64_t tx_zerocopy_no_bufs;
+
+	/* Multicast broadcast */
+	uint64_t tx_mcast_packets;
+	uint64_t rx_mcast_packets;
+
+	/* Relay forwarding */
+	uint64_t tx_relay_packets;
+	uint64_t rx_relay_packets;
+	uint64_t fwd_relay_packets;
+	uint64_t fwd_relay_drops;
+};
+
+/**
+ * knet_handle_get_stats
+ *
+ * @brief Get statistics for compression & crypto
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * knet_handle_stats
+ *            pointer to a knet_handle_stats structure
+ *
+ * struct_size
+ *            size of knet_handle_stats structure to allow
+ *            for backwards compatibility. libknet will only
+ *            copy this much data into the stats structure
+ *            so that older callers will not get overflowed if
+ *            new fields are added.
+ *
+ * @return
+ * 0 on success
+ * -1 on error and errno is set.
+ *
+ */
+
+int knet_handle_get_stats(knet_handle_t knet_h, struct knet_handle_stats *stats, size_t struct_size);
+
+/*
+ * Tell knet_handle_clear_stats whether to clear just the handle stats
+ * or all of them.
+ */
+#define KNET_CLEARSTATS_HANDLE_ONLY     1
+#define KNET_CLEARSTATS_HANDLE_AND_LINK 2
+
+/**
+ * knet_handle_clear_stats
+ *
+ * @brief Clear knet stats, link and/or handle
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * clear_option -  Which stats to clear, must be one of
+ *
+ * KNET_CLEARSTATS_HANDLE_ONLY or
+ * KNET_CLEARSTATS_HANDLE_AND_LINK
+ *
+ * @return
+ * 0 on success
+ * -1 on error and errno is set.
+ *
+ */
+
+int knet_handle_clear_stats(knet_handle_t knet_h, int clear_option);
+
+/*
+ * Latency histograms
+ *
+ * log-linear histograms (HDR style): values below
+ * KNET_HISTOGRAM_SUB_BUCKETS are counted exactly, above that every power
+ * of 2 is split in KNET_HISTOGRAM_SUB_BUCKETS buckets, so the relative
+ * error of a percentile is below 1 / KNET_HISTOGRAM_SUB_BUCKETS.
+ * Values are in nanoseconds, anything above 2^KNET_HISTOGRAM_MAX_BITS
+ * is counted in the last bucket.
+ */
+
+#define KNET_HISTOGRAM_SUB_BITS 4
+#define KNET_HISTOGRAM_SUB_BUCKETS (1 << KNET_HISTOGRAM_SUB_BITS)
+#define KNET_HISTOGRAM_MAX_BITS 40
+#define KNET_HISTOGRAM_BUCKETS ((KNET_HISTOGRAM_MAX_BITS - KNET_HISTOGRAM_SUB_BITS + 1) * KNET_HISTOGRAM_SUB_BUCKETS)
+
+struct knet_histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	uint64_t buckets[KNET_HISTOGRAM_BUCKETS];
+};
+
+#define KNET_HISTOGRAM_TX_CRYPT    0	/* time to encrypt a data packet */
+#define KNET_HISTOGRAM_RX_CRYPT    1	/* time to decrypt a packet */
+#define KNET_HISTOGRAM_TX_COMPRESS 2	/* time to compress a data packet */
+#define KNET_HISTOGRAM_RX_COMPRESS 3	/* time to decompress a data packet */
+#define KNET_HISTOGRAM_TX_QUEUE    4	/* time a packet waited in a link TX queue before hitting the wire */
+#define KNET_HISTOGRAM_MAX         5
+
+/**
+ * knet_handle_get_histogram
+ *
+ * @brief Get a copy of one of the handle latency histograms
+ *
+ * knet_h       - pointer to knet_handle_t
+ *
+ * histogram_id - one of the KNET_HISTOGRAM_* defines above
+ *
+ * histogram    - pointer to a struct knet_histogram to fill in
+ *
+ * Histograms are reset by knet_handle_clear_stats.
+ *
+ * @return
+ * knet_handle_get_histogram returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_get_histogram(knet_handle_t knet_h, uint8_t histogram_id,
+			      struct knet_histogram *histogram);
+
+/**
+ * knet_link_get_rtt_histogram
+ *
+ * @brief Get a copy of the ping/pong round trip time histogram of a link
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * host_id   - see knet_host_add(3)
+ *
+ * link_id   - see knet_link_set_config(3)
+ *
+ * histogram - pointer to a struct knet_histogram to fill in
+ *
+ * Link histograms are reset by knet_handle_clear_stats with
+ * KNET_CLEARSTATS_HANDLE_AND_LINK and when the link is cleared.
+ *
+ * @return
+ * knet_link_get_rtt_histogram returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_link_get_rtt_histogram(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+				struct knet_histogram *histogram);
+
+/**
+ * knet_histogram_percentile
+ *
+ * @brief Get a percentile from a histogram
+ *
+ * histogram  - pointer to a struct knet_histogram, usually obtained from
+ *              knet_handle_get_histogram or knet_link_get_rtt_histogram
+ *
+ * percentile - 0.0 to 100.0 (for example 99.9 for p999)
+ *
+ * @return
+ * knet_histogram_percentile returns
+ * the highest value of the bucket containing the requested percentile
+ * (clamped to the recorded min/max), 0 if the histogram is empty or
+ * on error and errno is set.
+ */
+
+uint64_t knet_histogram_percentile(const struct knet_histogram *histogram, double percentile);
+
+/*
+ * pipeline stage latency breakdown
+ *
+ * when enabled, data and host info packets are timestamped as they move through
+ * the TX and RX pipelines and the time spent in each stage is added
+ * to the stage counter. Stages that are skipped for a packet
+ * (for example compression when it is not configured) are not counted.
+ * Times are in nanoseconds.
+ */
+
+#define KNET_STAGE_TX_FILTER     0	/* packet switching and dst_host_filter_fn */
+#define KNET_STAGE_TX_COMPRESS   1
+#define KNET_STAGE_TX_FRAGMENT   2	/* seq num, fragmentation and FEC parity */
+#define KNET_STAGE_TX_CRYPT      3
+#define KNET_STAGE_TX_SEND       4	/* dispatch to the links or their TX queues */
+#define KNET_STAGE_RX_CRYPT      5
+#define KNET_STAGE_RX_PARSE      6	/* header checks, source lookup and duplicate check */
+#define KNET_STAGE_RX_DEFRAG     7
+#define KNET_STAGE_RX_DECOMPRESS 8
+#define KNET_STAGE_RX_DELIVER    9	/* dst_host_filter_fn and write to the datafd */
+#define KNET_STAGE_MAX          10
+
+struct knet_stage_counter {
+	uint64_t count;		/* number of times the stage has been executed */
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+struct knet_stage_stats {
+	size_t size;
+	uint8_t enabled;
+	struct knet_stage_counter stages[KNET_STAGE_MAX];
 };
 
 /**
- * knet_handle_get_stats
+ * knet_handle_enable_stage_stats
  *
- * @brief Get statistics for compression & crypto
+ * @brief Start or stop the per stage latency accounting
  *
- * knet_h   - pointer to knet_handle_t
+ * knet_h  - pointer to knet_handle_t
  *
- * knet_handle_stats
- *            pointer to a knet_handle_stats structure
+ * enabled - set to 1 to timestamp data packets in each pipeline stage,
+ *           0 to stop (default). When disabled the cost in the data
+ *           path is a single check per stage.
  *
- * struct_size
- *            size of knet_handle_stats structure to allow
- *            for backwards compatibility. libknet will only
- *            copy this much data into the stats structure
- *            so that older callers will not get overflowed if
- *            new fields are added.
+ * Counters are kept when accounting is stopped and are reset
+ * by knet_handle_clear_stats.
  *
  * @return
+ * knet_handle_enable_stage_stats returns
  * 0 on success
  * -1 on error and errno is set.
- *
  */
 
-int knet_handle_get_stats(knet_handle_t knet_h, struct knet_handle_stats *stats, size_t struct_size);
-
-/*
- * Tell knet_handle_clear_stats whether to clear just the handle stats
- * or all of them.
- */
-#define KNET_CLEARSTATS_HANDLE_ONLY     1
-#define KNET_CLEARSTATS_HANDLE_AND_LINK 2
+int knet_handle_enable_stage_stats(knet_handle_t knet_h, unsigned int enabled);
 
 /**
- * knet_handle_clear_stats
+ * knet_handle_get_stage_stats
  *
- * @brief Clear knet stats, link and/or handle
+ * @brief Get the per stage latency counters
  *
- * knet_h   - pointer to knet_handle_t
+ * knet_h      - pointer to knet_handle_t
  *
- * clear_option -  Which stats to clear, must be one of
+ * stage_stats - pointer to a struct knet_stage_stats to fill in,
+ *               stages are indexed by the KNET_STAGE_* defines above
  *
- * KNET_CLEARSTATS_HANDLE_ONLY or
- * KNET_CLEARSTATS_HANDLE_AND_LINK
+ * struct_size - size of knet_stage_stats structure to allow
+ *               for backwards compatibility. libknet will only
+ *               copy this much data into the stage_stats structure
+ *               so that older callers will not get overflowed if
+ *               new fields are added.
  *
  * @return
+ * knet_handle_get_stage_stats returns
  * 0 on success
  * -1 on error and errno is set.
- *
  */
 
-int knet_handle_clear_stats(knet_handle_t knet_h, int clear_option);
+int knet_handle_get_stage_stats(knet_handle_t knet_h, struct knet_stage_stats *stage_stats, size_t struct_size);
 
 
 
@@ -1067,6 +1918,7 @@ int knet_host_get_host_list(knet_handle_t knet_h,
 #define KNET_LINK_POLICY_PASSIVE 0
 #define KNET_LINK_POLICY_ACTIVE  1
 #define KNET_LINK_POLICY_RR      2
+#define KNET_LINK_POLICY_FEC     3
 
 /**
  * knet_host_set_policy
@@ -1077,7 +1929,7 @@ int knet_host_get_host_list(knet_handle_t knet_h,
  *
  * host_id  - see knet_host_add(3)
  *
- * policy   - there are currently 3 kind of simple switching policies
+ * policy   - there are currently 4 kind of simple switching policies
  *            based on link configuration.
  *            KNET_LINK_POLICY_PASSIVE - the active link with the lowest
  *                                       priority will be used.
@@ -1093,6 +1945,19 @@ int knet_host_get_host_list(knet_handle_t knet_h,
  *                                       will be send on a different active
  *                                       link.
  *
+ *            KNET_LINK_POLICY_FEC     - forward error correction policy.
+ *                                       fragments of a packet are spread
+ *                                       across all active links together with
+ *                                       XOR parity fragments, so that the
+ *                                       packet can be rebuilt even if one
+ *                                       link drops its share of fragments.
+ *                                       The amount of parity depends on the
+ *                                       number of active links (100% with 2 links,
+ *                                       50% with 3, 33% with 4...).
+ *                                       Packets that fit in a single fragment
+ *                                       are sent on two active links.
+ *                                       Both nodes need to support FEC.
+ *
  * @return
  * knet_host_set_policy returns
  * 0 on success
@@ -1140,10 +2005,8 @@ int knet_host_get_policy(knet_handle_t knet_h, knet_node_id_t host_id,
  *            host status is identified by:
  *            - reachable, this host can send/receive data to/from host_id
  *            - remote, 0 if the host_id is connected locally or 1 if
- *                      the there is one or more knet host(s) in between.
- *                      NOTE: re-switching is NOT currently implemented,
- *                            but this is ready for future and can avoid
- *                            an API/ABI breakage later on.
+ *                      the there is one or more knet host(s) in between
+ *                      (see knet_handle_set_relay(3)).
  *            - external, 0 if the host_id is configured locally or 1 if
  *                        it has been added from remote nodes config.
  *                        NOTE: dynamic topology is NOT currently implemented,
@@ -1207,6 +2070,96 @@ struct knet_host_status {
 int knet_host_get_status(knet_handle_t knet_h, knet_node_id_t host_id,
 			 struct knet_host_status *status);
 
+/*
+ * group API calls
+ *
+ * a group is an application defined set of hosts that can be
+ * used as destination of data packets (see knet_send_to_group(3)),
+ * without going through dst_host_filter_fn.
+ */
+
+/*
+ * Maximum number of groups
+ */
+
+#define KNET_MAX_GROUPS 1024
+
+/**
+ * knet_group_create
+ *
+ * @brief Create a new (empty) group of hosts
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * group_id - will contain the id of the new group,
+ *            between 0 and KNET_MAX_GROUPS - 1
+ *
+ * @return
+ * knet_group_create returns
+ * 0 on success
+ * -1 on error and errno is set.
+ * @retval EBUSY - all KNET_MAX_GROUPS groups are in use
+ */
+
+int knet_group_create(knet_handle_t knet_h, uint16_t *group_id);
+
+/**
+ * knet_group_destroy
+ *
+ * @brief Destroy a group of hosts
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * group_id - see knet_group_create(3)
+ *
+ * @return
+ * knet_group_destroy returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_group_destroy(knet_handle_t knet_h, uint16_t group_id);
+
+/**
+ * knet_group_add_host
+ *
+ * @brief Add a host to a group
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * group_id - see knet_group_create(3)
+ *
+ * host_id  - see knet_host_add(3). Hosts are removed from all
+ *            groups by knet_host_remove(3).
+ *
+ * @return
+ * knet_group_add_host returns
+ * 0 on success
+ * -1 on error and errno is set.
+ * @retval EEXIST - host_id is already part of the group
+ */
+
+int knet_group_add_host(knet_handle_t knet_h, uint16_t group_id, knet_node_id_t host_id);
+
+/**
+ * knet_group_remove_host
+ *
+ * @brief Remove a host from a group
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * group_id - see knet_group_create(3)
+ *
+ * host_id  - see knet_host_add(3)
+ *
+ * @return
+ * knet_group_remove_host returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_group_remove_host(knet_handle_t knet_h, uint16_t group_id, knet_node_id_t host_id);
+
 /*
  * link structs/API calls
  *
@@ -1284,6 +2237,8 @@ int knet_addrtostr(const struct sockaddr_storage *ss, socklen_t sslen,
 #define KNET_TRANSPORT_LOOPBACK 0
 #define KNET_TRANSPORT_UDP      1
 #define KNET_TRANSPORT_SCTP     2
+#define KNET_TRANSPORT_XDP      3 /* UDP, received/sent via AF_XDP when possible */
+#define KNET_TRANSPORT_SHM      4 /* shared memory rings between nodes on the same machine */
 #define KNET_MAX_TRANSPORTS     UINT8_MAX
 
 /*
@@ -1405,6 +2360,15 @@ int knet_handle_get_transport_reconnect_interval(knet_handle_t knet_h, uint32_t
  * link_id   - see knet_link_set_config(3)
  *
  * transport - one of the KNET_TRANSPORT_xxx constants
+ *             KNET_TRANSPORT_XDP links are UDP on the wire. Data are
+ *             received and sent via an AF_XDP socket on the interface
+ *             owning src_addr (requires CAP_NET_ADMIN/CAP_BPF and
+ *             an Ethernet device). If AF_XDP cannot be used, the link
+ *             works as a plain UDP link.
+ *             KNET_TRANSPORT_SHM links connect to a node running on the
+ *             same machine (and network namespace) via shared memory.
+ *             src_addr and dst_addr are only used to identify the two
+ *             ends of the link and dst_addr cannot be null.
  *
  * src_addr  - sockaddr_storage that can be either IPv4 or IPv6
  *
@@ -1691,6 +2655,134 @@ int knet_link_set_priority(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t
 int knet_link_get_priority(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
 			   uint8_t *priority);
 
+#define KNET_LINK_TXQ_POLICY_BACKPRESSURE 0
+#define KNET_LINK_TXQ_POLICY_DROP         1
+
+#define KNET_LINK_TXQ_DEFAULT_LEN 256
+#define KNET_LINK_TXQ_MAX_LEN     65536
+
+/**
+ * knet_link_set_tx_queue
+ *
+ * @brief Set the TX queue size and policy for a link
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * host_id   - see knet_host_add(3)
+ *
+ * link_id   - see knet_link_set_config(3)
+ *
+ * queue_len - how many packets can be queued on this link while
+ *             the link socket cannot accept more data. Queued packets
+ *             are sent as soon as the socket becomes writable, without
+ *             delaying traffic to other hosts/links (unless policy is
+ *             KNET_LINK_TXQ_POLICY_BACKPRESSURE). Queued packets are
+ *             dropped when the link goes down.
+ *             0 disables queuing and the TX thread will retry sending
+ *             to this link till the socket accepts data. The queue
+ *             cannot be disabled on a paced link (see knet_link_set_rate(3)).
+ *             default: KNET_LINK_TXQ_DEFAULT_LEN, max: KNET_LINK_TXQ_MAX_LEN
+ *
+ * policy    - what to do when the queue is full:
+ *             KNET_LINK_TXQ_POLICY_DROP (default) drops new packets for
+ *             this link only.
+ *             KNET_LINK_TXQ_POLICY_BACKPRESSURE is handle-wide: while the
+ *             queue is full, the TX thread stops reading data from all
+ *             the datafds, delaying traffic to every host, till the queue
+ *             has been drained. knet_send_sync(3), knet_send_to(3),
+ *             knet_send_sync_to(3), knet_send_to_group(3) and
+ *             knet_send_buf_commit(3) fail with EAGAIN instead of queuing
+ *             more than queue_len packets. Only use it when one slow link
+ *             is meant to slow the application down.
+ *
+ * @return
+ * knet_link_set_tx_queue returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_link_set_tx_queue(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			   uint32_t queue_len, uint8_t policy);
+
+/**
+ * knet_link_get_tx_queue
+ *
+ * @brief Get the TX queue size and policy for a link
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * host_id   - see knet_host_add(3)
+ *
+ * link_id   - see knet_link_set_config(3)
+ *
+ * queue_len - gather the max number of packets that can be queued
+ *
+ * policy    - gather the queue full policy
+ *
+ * @return
+ * knet_link_get_tx_queue returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_link_get_tx_queue(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			   uint32_t *queue_len, uint8_t *policy);
+
+/**
+ * knet_link_set_rate
+ *
+ * @brief Set the pacing rate for a link
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * host_id   - see knet_host_add(3)
+ *
+ * link_id   - see knet_link_set_config(3)
+ *
+ * rate      - max bytes per second sent on this link, including
+ *             knet and crypto headers. 0 disables pacing (default).
+ *
+ * burst     - max bytes that can be sent back to back on this link
+ *             before pacing kicks in. Must be > 0 if rate is set.
+ *
+ * Packets exceeding the rate are held in the link TX queue (see
+ * knet_link_set_tx_queue(3)) and sent as soon as the rate allows.
+ * Pacing requires the TX queue: setting a rate on a link with the
+ * TX queue disabled fails with EINVAL.
+ *
+ * @return
+ * knet_link_set_rate returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_link_set_rate(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+		       uint64_t rate, uint32_t burst);
+
+/**
+ * knet_link_get_rate
+ *
+ * @brief Get the pacing rate for a link
+ *
+ * knet_h    - pointer to knet_handle_t
+ *
+ * host_id   - see knet_host_add(3)
+ *
+ * link_id   - see knet_link_set_config(3)
+ *
+ * rate      - gather the max bytes per second sent on this link
+ *
+ * burst     - gather the max bytes sent back to back
+ *
+ * @return
+ * knet_link_get_rate returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_link_get_rate(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+		       uint64_t *rate, uint32_t *burst);
+
 /**
  * knet_link_get_link_list
  *
@@ -1799,6 +2891,17 @@ struct knet_link_stats {
 	time_t   last_down_times[MAX_LINK_EVENTS];
 	int8_t   last_up_time_index;
 	int8_t   last_down_time_index;
+
+	/* TX queue */
+	uint64_t tx_data_queued;
+	uint64_t tx_data_queue_drops;
+
+	/* pacing */
+	uint64_t tx_data_paced;
+
+	/* UDP GSO */
+	uint64_t tx_data_gso_packets;
+	uint64_t tx_data_gso_segments;
 	/* Always add new stats at the end */
 };
 
@@ -1853,6 +2956,168 @@ struct knet_link_status {
 int knet_link_get_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
 			 struct knet_link_status *status, size_t struct_size);
 
+/*
+ * Shared memory statistics export
+ *
+ * libknet can publish a periodic snapshot of the handle and link
+ * statistics into a memory region that readers (in process or in other
+ * processes via the memfd returned by knet_handle_enable_stats_shm)
+ * can access without taking any lock inside libknet.
+ *
+ * The region is protected by a sequence counter: the writer
+ * makes seq odd before updating the region and even again when done.
+ * Readers should use knet_stats_shm_read to get a consistent copy.
+ */
+
+#define KNET_STATS_SHM_VERSION 1
+#define KNET_STATS_SHM_MAX_LINKS 4096
+
+struct knet_stats_shm_link {
+	knet_node_id_t host_id;
+	uint8_t link_id;
+	uint8_t enabled;
+	uint8_t connected;
+	struct knet_link_stats stats;
+};
+
+struct knet_stats_shm {
+	uint32_t version;		/* KNET_STATS_SHM_VERSION */
+	uint32_t size;			/* sizeof(struct knet_stats_shm) of the writer */
+	uint64_t seq;			/* odd while an update is in progress */
+	uint64_t update_time;		/* CLOCK_MONOTONIC nsecs of the last update */
+	uint32_t interval;		/* msecs between updates */
+	uint32_t links_entries;		/* valid entries in links */
+	uint32_t links_dropped;		/* links that did not fit in links */
+	struct knet_handle_stats handle __attribute__((aligned(64)));
+	struct knet_stats_shm_link links[KNET_STATS_SHM_MAX_LINKS] __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+/**
+ * knet_handle_enable_stats_shm
+ *
+ * @brief Publish handle and link statistics into shared memory
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * interval - msecs between updates of the region (granularity is
+ *            limited by the threads timer resolution).
+ *            0 disables the export and releases the region. Pointers
+ *            and file descriptors obtained earlier become invalid.
+ *
+ * shmfd    - if not NULL, it will be filled with a file descriptor
+ *            that can be mmap'ed (PROT_READ, MAP_SHARED,
+ *            sizeof(struct knet_stats_shm)) by other processes.
+ *            The fd is owned by libknet, use dup(2) or pass it via
+ *            SCM_RIGHTS. Set to -1 if the platform has no memfd support.
+ *
+ * shm      - if not NULL, it will be filled with a pointer to the
+ *            region mapped in this process.
+ *
+ * Calling this function when the export is already enabled only changes
+ * the interval.
+ *
+ * @return
+ * knet_handle_enable_stats_shm returns
+ * 0 on success
+ * -1 on error and errno is set.
+ */
+
+int knet_handle_enable_stats_shm(knet_handle_t knet_h, uint32_t interval,
+				 int *shmfd, const struct knet_stats_shm **shm);
+
+/**
+ * knet_stats_shm_read
+ *
+ * @brief Get a consistent copy of a statistics region
+ *
+ * shm      - pointer to a region obtained from knet_handle_enable_stats_shm
+ *            or mmap'ed from its file descriptor.
+ *
+ * snapshot - pointer to the struct knet_stats_shm to fill in.
+ *            Only the first links_entries entries of links are copied.
+ *
+ * This function does not take any lock and can be used by processes
+ * that do not own the knet handle.
+ *
+ * @return
+ * knet_stats_shm_read returns
+ * 0 on success
+ * -1 on error and errno is set (EINVAL on version mismatch, EAGAIN if
+ *    the region kept changing while reading it).
+ */
+
+int knet_stats_shm_read(const struct knet_stats_shm *shm, struct knet_stats_shm *snapshot);
+
+/*
+ * Bulk topology status
+ */
+
+struct knet_topology_host {
+	knet_node_id_t host_id;
+	uint64_t generation;		/* generation of the last status change */
+	struct knet_host_status status;
+};
+
+struct knet_topology_link {
+	knet_node_id_t host_id;
+	uint8_t link_id;
+	uint64_t generation;		/* generation of the last status change */
+	struct knet_link_status status;
+};
+
+struct knet_topology_status {
+	size_t size;			/* For ABI checking */
+	uint64_t generation;		/* current generation, pass it as since_generation to the next call */
+	uint8_t full;			/* 1 if hosts/links contain all the hosts and links,
+					 * 0 if they only contain the changes since since_generation */
+	size_t hosts_entries;		/* entries filled in hosts */
+	size_t links_entries;		/* entries filled in links */
+};
+
+/**
+ * knet_handle_get_topology_status
+ *
+ * @brief Get the status of all hosts and links in one call
+ *
+ * knet_h           - pointer to knet_handle_t
+ *
+ * since_generation - 0 to get all hosts and configured links, or the
+ *                    generation returned by a previous call to only get
+ *                    the hosts and links whose status (reachable, remote,
+ *                    enabled, connected, dynconnected, configuration)
+ *                    changed since then. Statistics updates do not change
+ *                    the generation.
+ *                    If a host or a link has been removed in the meantime,
+ *                    a full list is returned and topology->full is set.
+ *
+ * topology         - pointer to a struct knet_topology_status that will
+ *                    be filled in with the current generation and the
+ *                    number of entries filled in hosts and links.
+ *
+ * hosts            - array of hosts_max struct knet_topology_host
+ *
+ * hosts_max        - number of entries in hosts
+ *
+ * links            - array of links_max struct knet_topology_link
+ *
+ * links_max        - number of entries in links
+ *
+ * The whole topology is collected while holding the global lock once,
+ * so hosts and links are consistent with each other.
+ *
+ * @return
+ * knet_handle_get_topology_status returns
+ * 0 on success
+ * -1 on error and errno is set. ENOBUFS if hosts or links are too small,
+ *    in which case topology->hosts_entries and topology->links_entries
+ *    contain the required number of entries.
+ */
+
+int knet_handle_get_topology_status(knet_handle_t knet_h, uint64_t since_generation,
+				    struct knet_topology_status *topology,
+				    struct knet_topology_host *hosts, size_t hosts_max,
+				    struct knet_topology_link *links, size_t links_max);
+
 /**
  * knet_link_enable_status_change_notify
  *
@@ -1871,10 +3136,8 @@ int knet_link_get_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
  *            - connected, 0 if the link has been disconnected, 1 if the link
  *                         is connected.
  *            - remote, 0 if the host_id is connected locally or 1 if
- *                      the there is one or more knet host(s) in between.
- *                      NOTE: re-switching is NOT currently implemented,
- *                            but this is ready for future and can avoid
- *                            an API/ABI breakage later on.
+ *                      the there is one or more knet host(s) in between
+ *                      (see knet_handle_set_relay(3)).
  *            - external, 0 if the host_id is configured locally or 1 if
  *                        it has been added from remote nodes config.
  *                        NOTE: dynamic topology is NOT currently implemented,
@@ -1898,6 +3161,109 @@ int knet_link_enable_status_change_notify(knet_handle_t knet_h,
 						uint8_t remote,
 						uint8_t external));
 
+/*
+ * event queue
+ *
+ * Instead of invoking the host, link, PMTUd and socket notification
+ * callbacks from the libknet internal threads, notifications can be
+ * queued and collected by the application from its own event loop.
+ *
+ * KNET_EVENT_HOST_STATUS carries the same data as the callback installed
+ * by knet_host_enable_status_change_notify, KNET_EVENT_LINK_STATUS as
+ * knet_link_enable_status_change_notify, KNET_EVENT_PMTUD as
+ * knet_handle_enable_pmtud_notify and KNET_EVENT_SOCK as
+ * knet_handle_enable_sock_notify.
+ */
+
+#define KNET_EVENT_QUEUE_MAX 65536	/* max entries in the event queue */
+
+#define KNET_EVENT_DROPPED     0	/* the queue was full, dropped.count events have been lost */
+#define KNET_EVENT_HOST_STATUS 1
+#define KNET_EVENT_LINK_STATUS 2
+#define KNET_EVENT_PMTUD       3
+#define KNET_EVENT_SOCK        4
+
+struct knet_event {
+	uint8_t type;			/* KNET_EVENT_* */
+	union {
+		struct {
+			uint64_t count;
+		} dropped;
+		struct {
+			knet_node_id_t host_id;
+			uint8_t reachable;
+			uint8_t remote;
+			uint8_t external;
+		} host;
+		struct {
+			knet_node_id_t host_id;
+			uint8_t link_id;
+			uint8_t connected;
+			uint8_t remote;
+			uint8_t external;
+		} link;
+		struct {
+			unsigned int data_mtu;
+		} pmtud;
+		struct {
+			int datafd;
+			int8_t channel;
+			uint8_t tx_rx;
+			int error;
+			int errorno;
+		} sock;
+	} u;
+};
+
+/**
+ * knet_handle_enable_event_queue
+ *
+ * @brief Queue notifications instead of invoking the callbacks
+ *
+ * knet_h   - pointer to knet_handle_t
+ *
+ * entries  - number of events the queue can hold (rounded up to a power
+ *            of 2, max KNET_EVENT_QUEUE_MAX). 0 disables the queue,
+ *            pending events are discarded, the eventfd is closed and
+ *            callbacks are invoked again.
+ *
+ * event_fd - if not NULL, it will be filled with a file descriptor that
+ *            becomes readable (POLLIN) when events are pending.
+ *            The fd is owned by libknet and must not be read directly,
+ *            use knet_handle_get_events.
+ *
+ * While the queue is enabled, host, link, PMTUd and socket notifications
+ * are queued and the callbacks registered with the *_notify functions
+ * are not invoked. Queueing does not block: when the queue is full,
+ * events are dropped and a KNET_EVENT_DROPPED event is reported.
+ *
+ * @return
+ * knet_handle_enable_event_queue returns
+ * 0 on success
+ * -1 on error and errno is set (EBUSY if the queue is already enabled).
+ */
+
+int knet_handle_enable_event_queue(knet_handle_t knet_h, unsigned int entries, int *event_fd);
+
+/**
+ * knet_handle_get_events
+ *
+ * @brief Collect queued notifications
+ *
+ * knet_h     - pointer to knet_handle_t
+ *
+ * events     - array of struct knet_event to fill in
+ *
+ * events_max - number of entries in events
+ *
+ * @return
+ * knet_handle_get_events returns
+ * the number of events filled in (0 if none are pending)
+ * -1 on error and errno is set (EINVAL if the queue is not enabled).
+ */
+
+int knet_handle_get_events(knet_handle_t knet_h, struct knet_event *events, unsigned int events_max);
+
 /*
  * logging structs/API calls
  */
@@ -1934,6 +3300,8 @@ int knet_link_enable_status_change_notify(knet_handle_t knet_h,
 #define KNET_SUB_TRANSP_LOOPBACK (KNET_SUB_TRANSP_BASE + KNET_TRANSPORT_LOOPBACK)
 #define KNET_SUB_TRANSP_UDP      (KNET_SUB_TRANSP_BASE + KNET_TRANSPORT_UDP)
 #define KNET_SUB_TRANSP_SCTP     (KNET_SUB_TRANSP_BASE + KNET_TRANSPORT_SCTP)
+#define KNET_SUB_TRANSP_XDP      (KNET_SUB_TRANSP_BASE + KNET_TRANSPORT_XDP)
+#define KNET_SUB_TRANSP_SHM      (KNET_SUB_TRANSP_BASE + KNET_TRANSPORT_SHM)
 
 #define KNET_SUB_NSSCRYPTO     60 /* nsscrypto.c */
 #define KNET_SUB_OPENSSLCRYPTO 61 /* opensslcrypto.c */
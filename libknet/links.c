@@ -11,12 +11,18 @@
 
 #include <errno.h>
 #include <netdb.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/epoll.h>
 
+#include "events.h"
 #include "internals.h"
 #include "logging.h"
 #include "links.h"
+#include "probes.h"
 #include "transports.h"
 #include "host.h"
 #include "threads_common.h"
@@ -33,24 +39,30 @@ int _link_updown(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
 		return 0;
 
 	if ((link->status.enabled) &&
-	    (knet_h->link_status_change_notify_fn)) {
+	    ((knet_h->event_queue) || (knet_h->link_status_change_notify_fn))) {
 		if (link->status.connected != connected) {
 			notify_status = connected; /* connection state */
 		}
 		if (!enabled) {
 			notify_status = 0; /* disable == disconnected */
 		}
-		knet_h->link_status_change_notify_fn(
-					knet_h->link_status_change_notify_fn_private_data,
-					host_id,
-					link_id,
-					notify_status,
-					host->status.remote,
-					host->status.external);
+		if (knet_h->event_queue) {
+			_event_link_status(knet_h, host_id, link_id, notify_status,
+					   host->status.remote, host->status.external);
+		} else {
+			knet_h->link_status_change_notify_fn(
+						knet_h->link_status_change_notify_fn_private_data,
+						host_id,
+						link_id,
+						notify_status,
+						host->status.remote,
+						host->status.external);
+		}
 	}
 
 	link->status.enabled = enabled;
 	link->status.connected = connected;
+	link->status_generation = _host_topology_changed(knet_h);
 
 	_host_dstcache_update_async(knet_h, host);
 
@@ -59,21 +71,110 @@ int _link_updown(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
 		link->status.dynconnected = 0;
 
 	if (connected) {
+		KNET_PROBE(link_up, host_id, link_id, 0, 0);
 		time(&link->status.stats.last_up_times[link->status.stats.last_up_time_index]);
 		link->status.stats.up_count++;
 		if (++link->status.stats.last_up_time_index > MAX_LINK_EVENTS) {
 			link->status.stats.last_up_time_index = 0;
 		}
 	} else {
+		KNET_PROBE(link_down, host_id, link_id, 0, 0);
 		time(&link->status.stats.last_down_times[link->status.stats.last_down_time_index]);
 		link->status.stats.down_count++;
 		if (++link->status.stats.last_down_time_index > MAX_LINK_EVENTS) {
 			link->status.stats.last_down_time_index = 0;
 		}
+		/*
+		 * do not deliver stale data when the link comes back and
+		 * do not let a full queue hold the TX thread from reading
+		 * the datafds while the link is down
+		 */
+		if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+			log_debug(knet_h, KNET_SUB_LINK, "Unable to get TX mutex lock");
+		} else {
+			_link_txq_flush(knet_h, link);
+			pthread_mutex_unlock(&knet_h->tx_mutex);
+		}
 	}
 	return 0;
 }
 
+/*
+ * while blocked, the datafds are kept in the TX epoll without events,
+ * so that the TX thread sleeps till a link socket becomes writable or
+ * the pacing timer fires instead of being woken up by data it cannot read
+ */
+static void _link_txq_poll_datafds(knet_handle_t knet_h, uint32_t events)
+{
+	struct epoll_event ev;
+	int8_t channel;
+
+	for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
+		if ((!knet_h->sockfd[channel].in_use) ||
+		    (knet_h->sockfd[channel].has_error)) {
+			continue;
+		}
+
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = events;
+		ev.data.fd = knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created];
+
+		if (epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_MOD, ev.data.fd, &ev)) {
+			log_debug(knet_h, KNET_SUB_LINK, "Unable to update datafd %d in linkfd epoll pool: %s",
+				  ev.data.fd, strerror(errno));
+		}
+	}
+}
+
+/*
+ * keep track of how many links are holding the TX thread
+ * from reading more data
+ */
+void _link_txq_update_blocked(knet_handle_t knet_h, struct knet_link *link)
+{
+	unsigned int blocked = 0;
+
+	if ((link->txq_policy == KNET_LINK_TXQ_POLICY_BACKPRESSURE) &&
+	    (link->txq_len) &&
+	    (link->txq_count >= link->txq_len)) {
+		blocked = 1;
+	}
+
+	if (link->txq_blocked == blocked) {
+		return;
+	}
+
+	link->txq_blocked = blocked;
+	if (blocked) {
+		knet_h->txq_blocked++;
+		if (knet_h->txq_blocked == 1) {
+			_link_txq_poll_datafds(knet_h, 0);
+		}
+	} else {
+		knet_h->txq_blocked--;
+		if (!knet_h->txq_blocked) {
+			_link_txq_poll_datafds(knet_h, EPOLLIN);
+		}
+	}
+}
+
+void _link_txq_flush(knet_handle_t knet_h, struct knet_link *link)
+{
+	struct knet_txq_msg *txq_msg;
+
+	while (link->txq_head) {
+		txq_msg = link->txq_head;
+		link->txq_head = txq_msg->next;
+		free(txq_msg);
+		link->status.stats.tx_data_queue_drops++;
+	}
+	link->txq_tail = NULL;
+	link->txq_count = 0;
+	link->txq_paced = 0;
+
+	_link_txq_update_blocked(knet_h, link);
+}
+
 void _link_clear_stats(knet_handle_t knet_h)
 {
 	struct knet_host *host;
@@ -89,6 +190,7 @@ void _link_clear_stats(knet_handle_t knet_h)
 		for (link_id = 0; link_id < KNET_MAX_LINK; link_id++) {
 			link = &host->link[link_id];
 			memset(&link->status.stats, 0, sizeof(struct knet_link_stats));
+			memset(&link->rtt_histogram, 0, sizeof(struct knet_histogram));
 		}
 	}
 }
@@ -241,6 +343,8 @@ int knet_link_set_config(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
 	link->latency_exp = KNET_LINK_DEFAULT_PING_PRECISION - \
 			    ((link->ping_interval * KNET_LINK_DEFAULT_PING_PRECISION) / 8000000);
 	link->flags = flags;
+	link->txq_len = KNET_LINK_TXQ_DEFAULT_LEN;
+	link->txq_policy = KNET_LINK_TXQ_POLICY_DROP;
 
 	if (transport_link_set_config(knet_h, link, transport) < 0) {
 		savederrno = errno;
@@ -248,6 +352,7 @@ int knet_link_set_config(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
 		goto exit_unlock;
 	}
 	link->configured = 1;
+	link->status_generation = _host_topology_changed(knet_h);
 	log_debug(knet_h, KNET_SUB_LINK, "host: %u link: %u is configured",
 		  host_id, link_id);
 
@@ -255,6 +360,7 @@ int knet_link_set_config(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
 		knet_h->has_loop_link = 1;
 		knet_h->loop_link = link_id;
 		host->status.reachable = 1;
+		host->status_generation = _host_topology_changed(knet_h);
 		link->status.mtu = KNET_PMTUD_SIZE_V6;
 	} else {
 		link->status.mtu =  KNET_PMTUD_MIN_MTU_V4 - KNET_HEADER_ALL_SIZE - knet_h->sec_header_size;
@@ -417,13 +523,17 @@ int knet_link_clear_config(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t
 		goto exit_unlock;
 	}
 
+	_link_txq_flush(knet_h, link);
+
 	memset(link, 0, sizeof(struct knet_link));
 	link->link_id = link_id;
+	knet_h->topology_removed_generation = _host_topology_changed(knet_h);
 
 	if (knet_h->has_loop_link && host_id == knet_h->host_id && link_id == knet_h->loop_link) {
 		knet_h->has_loop_link = 0;
 		if (host->active_link_entries == 0) {
 			host->status.reachable = 0;
+			host->status_generation = _host_topology_changed(knet_h);
 		}
 	}
 
@@ -497,6 +607,8 @@ int knet_link_set_enable(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
 		goto exit_unlock;
 	}
 
+	_link_txq_flush(knet_h, link);
+
 	log_debug(knet_h, KNET_SUB_LINK, "host: %u link: %u is disabled",
 		  host_id, link_id);
 
@@ -956,6 +1068,290 @@ exit_unlock:
 	return err;
 }
 
+int knet_link_set_tx_queue(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			   uint32_t queue_len, uint8_t policy)
+{
+	int savederrno = 0, err = 0;
+	struct knet_host *host;
+	struct knet_link *link;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link_id >= KNET_MAX_LINK) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (queue_len > KNET_LINK_TXQ_MAX_LEN) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((policy != KNET_LINK_TXQ_POLICY_BACKPRESSURE) &&
+	    (policy != KNET_LINK_TXQ_POLICY_DROP)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_LINK, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	host = knet_h->host_index[host_id];
+	if (!host) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link = &host->link[link_id];
+
+	if (!link->configured) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is not configured: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	/*
+	 * paced data waits in the queue for tokens
+	 */
+	if ((!queue_len) && (link->rate)) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is paced, TX queue cannot be disabled: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link->txq_len = queue_len;
+	link->txq_policy = policy;
+
+	/*
+	 * packets already queued are still sent when the
+	 * socket becomes writable, even if queuing is now disabled
+	 */
+	_link_txq_update_blocked(knet_h, link);
+
+	log_debug(knet_h, KNET_SUB_LINK,
+		  "host: %u link: %u tx queue set to: %u packets policy: %s",
+		  host_id, link_id, link->txq_len,
+		  (link->txq_policy == KNET_LINK_TXQ_POLICY_DROP) ? "drop" : "backpressure");
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_link_get_tx_queue(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+			   uint32_t *queue_len, uint8_t *policy)
+{
+	int savederrno = 0, err = 0;
+	struct knet_host *host;
+	struct knet_link *link;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link_id >= KNET_MAX_LINK) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!queue_len) || (!policy)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_LINK, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	host = knet_h->host_index[host_id];
+	if (!host) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link = &host->link[link_id];
+
+	if (!link->configured) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is not configured: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	*queue_len = link->txq_len;
+	*policy = link->txq_policy;
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_link_set_rate(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+		       uint64_t rate, uint32_t burst)
+{
+	int savederrno = 0, err = 0;
+	struct knet_host *host;
+	struct knet_link *link;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link_id >= KNET_MAX_LINK) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((rate) && (!burst)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_LINK, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	host = knet_h->host_index[host_id];
+	if (!host) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link = &host->link[link_id];
+
+	if (!link->configured) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is not configured: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	if ((rate) && (!link->txq_len)) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u has no TX queue to hold paced data: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link->rate = rate;
+	link->burst = burst;
+	/*
+	 * start with a full bucket, packets already waiting for
+	 * tokens are sent when the pacing timer expires
+	 */
+	link->tokens = burst;
+	clock_gettime(CLOCK_MONOTONIC, &link->tokens_last);
+
+	if (link->rate) {
+		log_debug(knet_h, KNET_SUB_LINK,
+			  "host: %u link: %u rate set to: %" PRIu64 " bytes/sec burst: %u bytes",
+			  host_id, link_id, link->rate, link->burst);
+	} else {
+		log_debug(knet_h, KNET_SUB_LINK,
+			  "host: %u link: %u pacing disabled",
+			  host_id, link_id);
+	}
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_link_get_rate(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+		       uint64_t *rate, uint32_t *burst)
+{
+	int savederrno = 0, err = 0;
+	struct knet_host *host;
+	struct knet_link *link;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link_id >= KNET_MAX_LINK) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((!rate) || (!burst)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_LINK, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	host = knet_h->host_index[host_id];
+	if (!host) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link = &host->link[link_id];
+
+	if (!link->configured) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is not configured: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	*rate = link->rate;
+	*burst = link->burst;
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
 int knet_link_get_link_list(knet_handle_t knet_h, knet_node_id_t host_id,
 			    uint8_t *link_ids, size_t *link_ids_entries)
 {
@@ -1012,6 +1408,40 @@ exit_unlock:
 	return err;
 }
 
+void _link_stats_totals(struct knet_link_stats *stats)
+{
+	stats->rx_total_packets =
+		stats->rx_data_packets +
+		stats->rx_ping_packets +
+		stats->rx_pong_packets +
+		stats->rx_pmtu_packets;
+	stats->tx_total_packets =
+		stats->tx_data_packets +
+		stats->tx_ping_packets +
+		stats->tx_pong_packets +
+		stats->tx_pmtu_packets;
+	stats->rx_total_bytes =
+		stats->rx_data_bytes +
+		stats->rx_ping_bytes +
+		stats->rx_pong_bytes +
+		stats->rx_pmtu_bytes;
+	stats->tx_total_bytes =
+		stats->tx_data_bytes +
+		stats->tx_ping_bytes +
+		stats->tx_pong_bytes +
+		stats->tx_pmtu_bytes;
+	stats->tx_total_errors =
+		stats->tx_data_errors +
+		stats->tx_ping_errors +
+		stats->tx_pong_errors +
+		stats->tx_pmtu_errors;
+	stats->tx_total_retries =
+		stats->tx_data_retries +
+		stats->tx_ping_retries +
+		stats->tx_pong_retries +
+		stats->tx_pmtu_retries;
+}
+
 int knet_link_get_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
 			 struct knet_link_status *status, size_t struct_size)
 {
@@ -1064,36 +1494,7 @@ int knet_link_get_status(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t l
 	memmove(status, &link->status, struct_size);
 
 	/* Calculate totals - no point in doing this on-the-fly */
-	status->stats.rx_total_packets =
-		status->stats.rx_data_packets +
-		status->stats.rx_ping_packets +
-		status->stats.rx_pong_packets +
-		status->stats.rx_pmtu_packets;
-	status->stats.tx_total_packets =
-		status->stats.tx_data_packets +
-		status->stats.tx_ping_packets +
-		status->stats.tx_pong_packets +
-		status->stats.tx_pmtu_packets;
-	status->stats.rx_total_bytes =
-		status->stats.rx_data_bytes +
-		status->stats.rx_ping_bytes +
-		status->stats.rx_pong_bytes +
-		status->stats.rx_pmtu_bytes;
-	status->stats.tx_total_bytes =
-		status->stats.tx_data_bytes +
-		status->stats.tx_ping_bytes +
-		status->stats.tx_pong_bytes +
-		status->stats.tx_pmtu_bytes;
-	status->stats.tx_total_errors =
-		status->stats.tx_data_errors +
-		status->stats.tx_ping_errors +
-		status->stats.tx_pong_errors +
-		status->stats.tx_pmtu_errors;
-	status->stats.tx_total_retries =
-		status->stats.tx_data_retries +
-		status->stats.tx_ping_retries +
-		status->stats.tx_pong_retries +
-		status->stats.tx_pmtu_retries;
+	_link_stats_totals(&status->stats);
 
 	/* Tell the caller our full size in case they have an old version */
 	status->size = sizeof(struct knet_link_status);
@@ -1104,6 +1505,63 @@ exit_unlock:
 	return err;
 }
 
+int knet_link_get_rtt_histogram(knet_handle_t knet_h, knet_node_id_t host_id, uint8_t link_id,
+				struct knet_histogram *histogram)
+{
+	int savederrno = 0, err = 0;
+	struct knet_host *host;
+	struct knet_link *link;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (link_id >= KNET_MAX_LINK) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!histogram) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_LINK, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	host = knet_h->host_index[host_id];
+	if (!host) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "Unable to find host %u: %s",
+			host_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	link = &host->link[link_id];
+
+	if (!link->configured) {
+		err = -1;
+		savederrno = EINVAL;
+		log_err(knet_h, KNET_SUB_LINK, "host %u link %u is not configured: %s",
+			host_id, link_id, strerror(savederrno));
+		goto exit_unlock;
+	}
+
+	memmove(histogram, &link->rtt_histogram, sizeof(struct knet_histogram));
+
+exit_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
 int knet_link_enable_status_change_notify(knet_handle_t knet_h,
 					  void *link_status_change_notify_fn_private_data,
 					  void (*link_status_change_notify_fn) (
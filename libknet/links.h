@@ -34,5 +34,10 @@ int _link_updown(knet_handle_t knet_h, knet_node_id_t node_id, uint8_t link_id,
 		 unsigned int enabled, unsigned int connected);
 
 void _link_clear_stats(knet_handle_t knet_h);
+void _link_stats_totals(struct knet_link_stats *stats);
+
+void _link_txq_update_blocked(knet_handle_t knet_h, struct knet_link *link);
+
+void _link_txq_flush(knet_handle_t knet_h, struct knet_link *link);
 
 #endif
@@ -19,32 +19,21 @@
 
 #include "libknet.h"
 
-#if 0
-
 /*
- * for future protocol extension (re-switching table calculation)
+ * link table: the hosts the sender can reach directly, with the
+ * latency of its best link to each of them. Used to calculate
+ * relay routes (see relay.c)
  */
 
-struct knet_hinfo_link {
-	uint8_t			khl_link_id;
-	uint8_t			khl_link_dynamic;
-	uint8_t			khl_link_priority;
-	uint64_t		khl_link_latency;
-	char			khl_link_dst_ipaddr[KNET_MAX_HOST_LEN];
-	char			khl_link_dst_port[KNET_MAX_PORT_LEN];
-} __attribute__((packed));
-
-struct knet_hinfo_link_table {
-	knet_node_id_t		khlt_node_id;
-	uint8_t			khlt_local; /* we have this node connected locally */
-	struct knet_hinfo_link	khlt_link[KNET_MAX_LINK]; /* info we send about each link in the node */
+struct knet_hostinfo_link_table_entry {
+	knet_node_id_t		khlt_node_id;		/* host directly connected to the sender */
+	uint32_t		khlt_latency;		/* latency of the best link in usecs */
 } __attribute__((packed));
 
-struct link_table {
-	knet_node_id_t		khdt_host_entries;
-	uint8_t			khdt_host_maps[0]; /* array of knet_hinfo_link_table[khdt_host_entries] */
+struct knet_hostinfo_payload_link_table {
+	knet_node_id_t		khip_link_table_entries; /* number of entries in khip_link_table */
+	struct knet_hostinfo_link_table_entry khip_link_table[0];
 } __attribute__((packed));
-#endif
 
 #define KNET_HOSTINFO_LINK_STATUS_DOWN 0
 #define KNET_HOSTINFO_LINK_STATUS_UP   1
@@ -60,6 +49,7 @@ struct knet_hostinfo_payload_link_status {
 
 union knet_hostinfo_payload {
 	struct knet_hostinfo_payload_link_status knet_hostinfo_payload_link_status;
+	struct knet_hostinfo_payload_link_table knet_hostinfo_payload_link_table;
 } __attribute__((packed));
 
 /*
@@ -72,7 +62,7 @@ union knet_hostinfo_payload {
  */
 
 #define KNET_HOSTINFO_TYPE_LINK_UP_DOWN 0 // UNUSED
-#define KNET_HOSTINFO_TYPE_LINK_TABLE   1 // NOT IMPLEMENTED
+#define KNET_HOSTINFO_TYPE_LINK_TABLE   1
 
 #define KNET_HOSTINFO_UCAST 0	/* send info to a specific host */
 #define KNET_HOSTINFO_BCAST 1	/* send info to all known / connected hosts */
@@ -87,10 +77,15 @@ struct knet_hostinfo {
 #define KNET_HOSTINFO_ALL_SIZE sizeof(struct knet_hostinfo)
 #define KNET_HOSTINFO_SIZE (KNET_HOSTINFO_ALL_SIZE - sizeof(union knet_hostinfo_payload))
 #define KNET_HOSTINFO_LINK_STATUS_SIZE (KNET_HOSTINFO_SIZE + sizeof(struct knet_hostinfo_payload_link_status))
+#define KNET_HOSTINFO_LINK_TABLE_SIZE(entries) (KNET_HOSTINFO_SIZE + sizeof(struct knet_hostinfo_payload_link_table) + \
+						(entries) * sizeof(struct knet_hostinfo_link_table_entry))
 
 #define khip_link_status_status khi_payload.knet_hostinfo_payload_link_status.khip_link_status_status
 #define khip_link_status_link_id khi_payload.knet_hostinfo_payload_link_status.khip_link_status_link_id
 
+#define khip_link_table_entries khi_payload.knet_hostinfo_payload_link_table.khip_link_table_entries
+#define khip_link_table khi_payload.knet_hostinfo_payload_link_table.khip_link_table
+
 /*
  * typedef uint64_t seq_num_t;
  * #define SEQ_MAX UINT64_MAX
@@ -101,7 +96,7 @@ typedef uint16_t seq_num_t;
 struct knet_header_payload_data {
 	seq_num_t	khp_data_seq_num;	/* pckt seq number used to deduplicate pkcts */
 	uint8_t		khp_data_compress;	/* identify if user data are compressed */
-	uint8_t		khp_data_pad1;		/* make sure to have space in the header to grow features */
+	uint8_t		khp_data_fec;		/* number of FEC parity fragments appended to the data fragments */
 	uint8_t		khp_data_bcast;		/* data destination bcast/ucast */
 	uint8_t		khp_data_frag_num;	/* number of fragments of this pckt. 1 is not fragmented */
 	uint8_t		khp_data_frag_seq;	/* as above, indicates the frag sequence number */
@@ -151,6 +146,7 @@ union knet_header_payload {
 
 #define KNET_HEADER_TYPE_DATA        0x00 /* pure data packet */
 #define KNET_HEADER_TYPE_HOST_INFO   0x01 /* host status information pckt */
+#define KNET_HEADER_TYPE_DATA_COALESCED 0x02 /* multiple user messages packed in one data packet */
 
 #define KNET_HEADER_TYPE_PMSK        0x80 /* packet mask */
 #define KNET_HEADER_TYPE_PING        0x81 /* heartbeat */
@@ -179,6 +175,7 @@ struct knet_header {
 #define khp_data_bcast    kh_payload.khp_data.khp_data_bcast
 #define khp_data_channel  kh_payload.khp_data.khp_data_channel
 #define khp_data_compress kh_payload.khp_data.khp_data_compress
+#define khp_data_fec      kh_payload.khp_data.khp_data_fec
 
 #define khp_ping_link     kh_payload.khp_ping.khp_ping_link
 #define khp_ping_time     kh_payload.khp_ping.khp_ping_time
@@ -199,4 +196,46 @@ struct knet_header {
 #define KNET_HEADER_PMTUD_SIZE (KNET_HEADER_SIZE + sizeof(struct knet_header_payload_pmtud))
 #define KNET_HEADER_DATA_SIZE (KNET_HEADER_SIZE + sizeof(struct knet_header_payload_data))
 
+/*
+ * FEC parity fragments are sent as data fragments with
+ * khp_data_frag_seq > khp_data_frag_num.
+ * Parity fragment N (0 based) is the XOR of all data fragments
+ * where (frag_seq - 1) % khp_data_fec == N, each padded with 0s
+ * to the normal fragment size, and it's followed by a trailer
+ * with the size of the last data fragment (network byte order)
+ * to allow the receiver to rebuild it.
+ */
+
+#define KNET_FEC_TRAILER_SIZE sizeof(uint16_t)
+
+/*
+ * KNET_HEADER_TYPE_DATA_COALESCED packets use the same header as
+ * KNET_HEADER_TYPE_DATA, but khp_data_userdata contains a sequence
+ * of user messages, each one prefixed by its length
+ * (network byte order).
+ */
+
+#define KNET_COALESCE_FRAME_SIZE sizeof(uint16_t)
+
+/*
+ * relayed packets: the sender prepends this header, in clear text,
+ * to the packet (already encrypted if crypto is enabled) and sends
+ * it to an intermediate host. The relay only looks at krh_dst_node
+ * and forwards the packet as-is over its own links, the destination
+ * strips the header and processes the rest as a normal packet.
+ *
+ * krh_magic can never match the first bytes of a clear text
+ * knet_header (kh_version is 0x01).
+ */
+
+#define KNET_RELAY_MAGIC 0x4b4e5259 /* "KNRY" */
+
+struct knet_relay_header {
+	uint32_t		krh_magic;	/* KNET_RELAY_MAGIC */
+	knet_node_id_t		krh_src_node;	/* host that generated the packet */
+	knet_node_id_t		krh_dst_node;	/* final destination of the packet */
+} __attribute__((packed));
+
+#define KNET_RELAY_HEADER_SIZE sizeof(struct knet_relay_header)
+
 #endif
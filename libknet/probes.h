@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_PROBES_H__
+#define __KNET_PROBES_H__
+
+/*
+ * USDT static tracepoints (provider "knet") for eBPF/bpftrace/systemtap.
+ *
+ * All probes have the same arguments:
+ *
+ * arg0 - host_id
+ * arg1 - link_id (KNET_MAX_LINK when not known or not relevant)
+ * arg2 - seq_num (0 when not relevant)
+ * arg3 - size, in bytes unless noted below
+ *
+ * tx_packet        - packet accepted by a link transport, size is the sum of
+ *                    the fragments accepted (packets sent from the TX queue
+ *                    can show up more than once)
+ * tx_frag          - fragment accepted by a link transport
+ * tx_retry         - sendmmsg retry, size is the number of messages left to send
+ * tx_crypt_fail    - unable to encrypt a packet, size is the packet size (host_id 0)
+ * rx_packet        - data packet received
+ * rx_frag          - fragment received, before defrag
+ * rx_defrag_done   - all fragments received, size is the packet size
+ * rx_defrag_expire - incomplete packet evicted, size is the number of fragments received
+ * rx_dedup_drop    - packet already delivered
+ * rx_crypt_fail    - unable to decrypt/authenticate a packet (host_id and seq_num 0)
+ * link_up          - link is connected (size 0)
+ * link_down        - link is disconnected or disabled (size 0)
+ * pmtud_step       - PMTUd probe sent, size is the onwire size tested
+ *
+ * Without sys/sdt.h at build time the probes compile to nothing.
+ * With it, each probe is a single nop in the code until a tracer
+ * attaches to it.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define KNET_PROBE(name, host_id, link_id, seq_num, size) \
+	DTRACE_PROBE4(knet, name, host_id, link_id, seq_num, size)
+#else
+#define KNET_PROBE(name, host_id, link_id, seq_num, size) \
+do { \
+	(void)(host_id); \
+	(void)(link_id); \
+	(void)(seq_num); \
+	(void)(size); \
+} while (0)
+#endif
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "internals.h"
+#include "host.h"
+#include "logging.h"
+#include "netutils.h"
+#include "relay.h"
+#include "threads_common.h"
+#include "transports.h"
+
+/*
+ * relay forwarding:
+ *
+ * every KNET_RELAY_TABLE_INTERVAL each host broadcasts a link table
+ * with the hosts it can reach directly and the latency of its best
+ * link to each of them.
+ *
+ * when a table is received from a directly connected host (via),
+ * every host in the table becomes reachable via that host, with
+ * latency(us -> via) + latency(via -> host). The best via is kept
+ * per destination (relay_via/relay_latency). Routes are dropped when
+ * the via host stops announcing the destination or stops sending
+ * tables altogether.
+ *
+ * the TX thread uses the relay when the destination has no active
+ * links, or the relay is faster than the direct links
+ * (see _relay_get_via).
+ */
+
+uint32_t _relay_link_latency(struct knet_host *host)
+{
+	uint32_t latency = UINT32_MAX;
+	struct knet_link *link;
+	uint8_t i;
+
+	for (i = 0; i < host->active_link_entries; i++) {
+		link = &host->link[host->active_links[i]];
+		if (link->status.latency < latency) {
+			latency = link->status.latency;
+		}
+	}
+
+	return latency;
+}
+
+struct knet_host *_relay_get_via(knet_handle_t knet_h, struct knet_host *dst_host)
+{
+	struct knet_host *via_host;
+
+	if ((!knet_h->relay_enabled) || (!dst_host->relay_valid)) {
+		return NULL;
+	}
+
+	via_host = knet_h->host_index[dst_host->relay_via];
+	if ((!via_host) || (!via_host->active_link_entries)) {
+		return NULL;
+	}
+
+	if ((dst_host->active_link_entries) &&
+	    ((uint64_t)_relay_link_latency(dst_host) <= (uint64_t)dst_host->relay_latency + KNET_RELAY_LATENCY_PENALTY)) {
+		return NULL;
+	}
+
+	return via_host;
+}
+
+/*
+ * space to reserve in data fragments for the relay header,
+ * encrypted packets are padded to the crypto block size
+ */
+size_t _relay_overhead(knet_handle_t knet_h)
+{
+	size_t overhead = KNET_RELAY_HEADER_SIZE;
+
+	if (!knet_h->relay_enabled) {
+		return 0;
+	}
+
+	if ((knet_h->crypto_instance) && (knet_h->sec_block_size)) {
+		overhead = ((overhead + knet_h->sec_block_size - 1) / knet_h->sec_block_size) * knet_h->sec_block_size;
+	}
+
+	return overhead;
+}
+
+static void _relay_send_link_table(knet_handle_t knet_h)
+{
+	unsigned char buf[KNET_HOSTINFO_LINK_TABLE_SIZE(KNET_RELAY_TABLE_MAX_ENTRIES)];
+	struct knet_hostinfo *knet_hostinfo = (struct knet_hostinfo *)buf;
+	struct knet_host *host;
+	knet_node_id_t entries = 0;
+
+	memset(buf, 0, KNET_HOSTINFO_SIZE);
+	knet_hostinfo->khi_type = KNET_HOSTINFO_TYPE_LINK_TABLE;
+	knet_hostinfo->khi_bcast = KNET_HOSTINFO_BCAST;
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		if ((host->host_id == knet_h->host_id) || (!host->active_link_entries)) {
+			continue;
+		}
+		if (entries == KNET_RELAY_TABLE_MAX_ENTRIES) {
+			log_debug(knet_h, KNET_SUB_HOST, "Link table is full, not all hosts can be relayed");
+			break;
+		}
+		knet_hostinfo->khip_link_table[entries].khlt_node_id = htons(host->host_id);
+		knet_hostinfo->khip_link_table[entries].khlt_latency = htonl(_relay_link_latency(host));
+		entries++;
+	}
+
+	knet_hostinfo->khip_link_table_entries = htons(entries);
+
+	_send_host_info(knet_h, buf, KNET_HOSTINFO_LINK_TABLE_SIZE(entries));
+}
+
+static void _relay_route_del(knet_handle_t knet_h, struct knet_host *dst_host, const char *reason)
+{
+	log_debug(knet_h, KNET_SUB_HOST, "host: %u is no longer reachable via host: %u (%s)",
+		  dst_host->host_id, dst_host->relay_via, reason);
+	dst_host->relay_valid = 0;
+	_host_dstcache_update_async(knet_h, dst_host);
+}
+
+/*
+ * invoked by the heartbeat thread with global read lock
+ */
+void _relay_timer(knet_handle_t knet_h)
+{
+	struct knet_host *dst_host, *via_host;
+	struct timespec now;
+	unsigned long long diff;
+
+	if (!knet_h->relay_enabled) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_diff(knet_h->relay_table_last, now, &diff);
+	if (diff < (unsigned long long)KNET_RELAY_TABLE_INTERVAL * 1000000llu) {
+		return;
+	}
+	knet_h->relay_table_last = now;
+
+	for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+		if (!dst_host->relay_valid) {
+			continue;
+		}
+		via_host = knet_h->host_index[dst_host->relay_via];
+		if (!via_host) {
+			_relay_route_del(knet_h, dst_host, "host removed");
+			continue;
+		}
+		timespec_diff(via_host->relay_table_time, now, &diff);
+		if (diff > (unsigned long long)KNET_RELAY_TABLE_TIMEOUT * 1000000llu) {
+			_relay_route_del(knet_h, dst_host, "link table timeout");
+		}
+	}
+
+	_relay_send_link_table(knet_h);
+}
+
+static int _relay_entry_cmp(const void *a, const void *b)
+{
+	const struct knet_relay_entry *ea = a, *eb = b;
+
+	return (int)ea->node_id - (int)eb->node_id;
+}
+
+static void _relay_update_routes(knet_handle_t knet_h, struct knet_host *via_host)
+{
+	struct knet_host *dst_host;
+	struct knet_relay_entry key, *entry;
+	uint32_t via_latency;
+	uint64_t latency;
+	size_t i;
+
+	via_latency = _relay_link_latency(via_host);
+
+	/*
+	 * routes via this host to hosts that are not in its table anymore
+	 */
+	for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+		if ((!dst_host->relay_valid) || (dst_host->relay_via != via_host->host_id)) {
+			continue;
+		}
+		key.node_id = dst_host->host_id;
+		if (!bsearch(&key, via_host->relay_table, via_host->relay_table_entries,
+			     sizeof(struct knet_relay_entry), _relay_entry_cmp)) {
+			_relay_route_del(knet_h, dst_host, "not announced");
+		}
+	}
+
+	for (i = 0; i < via_host->relay_table_entries; i++) {
+		entry = &via_host->relay_table[i];
+		dst_host = knet_h->host_index[entry->node_id];
+		if (!dst_host) {
+			continue;
+		}
+
+		latency = (uint64_t)via_latency + entry->latency;
+		if (latency > UINT32_MAX) {
+			latency = UINT32_MAX;
+		}
+
+		if ((dst_host->relay_valid) &&
+		    (dst_host->relay_via != via_host->host_id) &&
+		    (dst_host->relay_latency <= latency)) {
+			continue;
+		}
+
+		if ((!dst_host->relay_valid) || (dst_host->relay_via != via_host->host_id)) {
+			log_debug(knet_h, KNET_SUB_HOST, "host: %u is reachable via host: %u",
+				  dst_host->host_id, via_host->host_id);
+			dst_host->relay_via = via_host->host_id;
+			dst_host->relay_latency = latency;
+			dst_host->relay_valid = 1;
+			_host_dstcache_update_async(knet_h, dst_host);
+		} else {
+			dst_host->relay_latency = latency;
+		}
+	}
+}
+
+/*
+ * invoked by the RX thread with global read lock
+ */
+void _relay_recv_link_table(knet_handle_t knet_h, struct knet_host *src_host,
+			    struct knet_hostinfo *knet_hostinfo, ssize_t len)
+{
+	struct knet_relay_entry *relay_table;
+	knet_node_id_t entries, node_id;
+	size_t i;
+
+	if (!knet_h->relay_enabled) {
+		return;
+	}
+
+	if (len < (ssize_t)KNET_HOSTINFO_LINK_TABLE_SIZE(0)) {
+		log_debug(knet_h, KNET_SUB_RX, "Link table from host %u is too short", src_host->host_id);
+		return;
+	}
+
+	entries = ntohs(knet_hostinfo->khip_link_table_entries);
+	if (len < (ssize_t)KNET_HOSTINFO_LINK_TABLE_SIZE(entries)) {
+		log_debug(knet_h, KNET_SUB_RX, "Link table from host %u is truncated", src_host->host_id);
+		return;
+	}
+
+	/*
+	 * we can only relay via hosts we are directly connected to
+	 */
+	if ((src_host->host_id == knet_h->host_id) || (!src_host->active_link_entries)) {
+		return;
+	}
+
+	if (entries != src_host->relay_table_entries) {
+		relay_table = realloc(src_host->relay_table, entries * sizeof(struct knet_relay_entry));
+		if ((!relay_table) && (entries)) {
+			log_debug(knet_h, KNET_SUB_RX, "Unable to allocate memory for link table from host %u",
+				  src_host->host_id);
+			return;
+		}
+		src_host->relay_table = relay_table;
+	}
+
+	src_host->relay_table_entries = 0;
+	for (i = 0; i < entries; i++) {
+		node_id = ntohs(knet_hostinfo->khip_link_table[i].khlt_node_id);
+		/*
+		 * skip ourselves and hosts we know nothing about
+		 */
+		if ((node_id == knet_h->host_id) || (node_id == src_host->host_id) ||
+		    (!knet_h->host_index[node_id])) {
+			continue;
+		}
+		src_host->relay_table[src_host->relay_table_entries].node_id = node_id;
+		src_host->relay_table[src_host->relay_table_entries].latency = ntohl(knet_hostinfo->khip_link_table[i].khlt_latency);
+		src_host->relay_table_entries++;
+	}
+	qsort(src_host->relay_table, src_host->relay_table_entries,
+	      sizeof(struct knet_relay_entry), _relay_entry_cmp);
+
+	clock_gettime(CLOCK_MONOTONIC, &src_host->relay_table_time);
+
+	_relay_update_routes(knet_h, src_host);
+}
+
+/*
+ * the packet is forwarded before it is decrypted, make sure it
+ * comes from a link of the host it claims to be from
+ */
+static int _relay_src_is_link(struct knet_host *src_host, const struct sockaddr_storage *src_addr)
+{
+	struct sockaddr_storage pckt_src;
+	struct knet_link *src_link;
+	int link_idx;
+
+	/*
+	 * only address and port, as the links are configured
+	 */
+	cpyaddrport(&pckt_src, src_addr);
+
+	for (link_idx = 0; link_idx < KNET_MAX_LINK; link_idx++) {
+		src_link = &src_host->link[link_idx];
+		if ((!src_link->configured) ||
+		    (src_link->transport_type == KNET_TRANSPORT_LOOPBACK)) {
+			continue;
+		}
+		if (!cmpaddr(&src_link->dst_addr, sockaddr_len(&src_link->dst_addr),
+			     &pckt_src, sockaddr_len(&pckt_src))) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * invoked by the RX thread with global read lock,
+ * buf is the packet including the relay header and
+ * src_addr the address it has been received from
+ */
+int _relay_forward(knet_handle_t knet_h, const unsigned char *buf, ssize_t len,
+		   const struct sockaddr_storage *src_addr)
+{
+	const struct knet_relay_header *relay_header = (const struct knet_relay_header *)buf;
+	struct knet_host *src_host, *dst_host;
+	struct knet_link *dst_link;
+	ssize_t sent;
+
+	src_host = knet_h->host_index[ntohs(relay_header->krh_src_node)];
+	dst_host = knet_h->host_index[ntohs(relay_header->krh_dst_node)];
+
+	if ((!src_host) || (!dst_host)) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to find source or destination host for relayed packet");
+		knet_h->stats.fwd_relay_drops++;
+		return -1;
+	}
+
+	if ((!src_addr) || (!_relay_src_is_link(src_host, src_addr))) {
+		log_debug(knet_h, KNET_SUB_RX, "Dropping relayed packet: not received from a link of host %u",
+			  src_host->host_id);
+		knet_h->stats.fwd_relay_drops++;
+		return -1;
+	}
+
+	if (!dst_host->active_link_entries) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to relay packet from host %u to host %u: no active links",
+			  src_host->host_id, dst_host->host_id);
+		knet_h->stats.fwd_relay_drops++;
+		return -1;
+	}
+
+	dst_link = &dst_host->link[dst_host->active_links[0]];
+	if (dst_link->transport_type == KNET_TRANSPORT_LOOPBACK) {
+		knet_h->stats.fwd_relay_drops++;
+		return -1;
+	}
+
+	sent = transport_tx_sendto(knet_h, dst_link, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (sent != len) {
+		dst_link->status.stats.tx_data_errors++;
+		knet_h->stats.fwd_relay_drops++;
+		log_debug(knet_h, KNET_SUB_RX, "Unable to relay packet from host %u to host %u: %s",
+			  src_host->host_id, dst_host->host_id, strerror(errno));
+		return -1;
+	}
+
+	dst_link->status.stats.tx_data_packets++;
+	dst_link->status.stats.tx_data_bytes += len;
+	knet_h->stats.fwd_relay_packets++;
+
+	return 0;
+}
+
+/*
+ * invoked with global write lock, host is going away or
+ * relay is being disabled (host == NULL, clear everything)
+ */
+void _relay_clear(knet_handle_t knet_h, struct knet_host *host)
+{
+	struct knet_host *dst_host;
+	int was_valid;
+
+	for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+		if ((!host) || (dst_host == host)) {
+			free(dst_host->relay_table);
+			dst_host->relay_table = NULL;
+			dst_host->relay_table_entries = 0;
+		}
+
+		if ((host) && (dst_host->relay_via != host->host_id)) {
+			continue;
+		}
+
+		was_valid = dst_host->relay_valid;
+		dst_host->relay_valid = 0;
+
+		if ((was_valid) && (dst_host != host)) {
+			_host_dstcache_update_sync(knet_h, dst_host);
+		}
+	}
+}
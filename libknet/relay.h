@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_RELAY_H__
+#define __KNET_RELAY_H__
+
+#include "internals.h"
+#include "onwire.h"
+
+#define KNET_RELAY_TABLE_INTERVAL 1000		/* msecs between link tables */
+#define KNET_RELAY_TABLE_TIMEOUT (KNET_RELAY_TABLE_INTERVAL * 3) /* msecs before a link table is stale */
+#define KNET_RELAY_TABLE_MAX_ENTRIES 1024	/* max hosts sent in a link table */
+#define KNET_RELAY_LATENCY_PENALTY 1000		/* usecs, a relay has to beat the direct links by this much */
+
+uint32_t _relay_link_latency(struct knet_host *host);
+struct knet_host *_relay_get_via(knet_handle_t knet_h, struct knet_host *dst_host);
+size_t _relay_overhead(knet_handle_t knet_h);
+
+void _relay_timer(knet_handle_t knet_h);
+void _relay_recv_link_table(knet_handle_t knet_h, struct knet_host *src_host,
+			    struct knet_hostinfo *knet_hostinfo, ssize_t len);
+int _relay_forward(knet_handle_t knet_h, const unsigned char *buf, ssize_t len,
+		   const struct sockaddr_storage *src_addr);
+void _relay_clear(knet_handle_t knet_h, struct knet_host *host);
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "internals.h"
+#include "logging.h"
+#include "stage_stats.h"
+#include "threads_common.h"
+
+/*
+ * TX stages are only updated with tx_mutex held and RX stages
+ * by the RX thread, readers copy them with the global lock held.
+ * Accounting can only change with the global write lock held,
+ * so a packet is never half way through the pipeline when it does.
+ */
+void _stage_stats_account(knet_handle_t knet_h, uint8_t stage, struct timespec *stage_time)
+{
+	struct knet_stage_counter *counter = &knet_h->stage_stats[stage];
+	struct timespec now;
+	uint64_t stage_ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/*
+	 * the packet entered the pipeline before accounting started
+	 */
+	if ((!stage_time->tv_sec) && (!stage_time->tv_nsec)) {
+		*stage_time = now;
+		return;
+	}
+
+	timespec_diff((*stage_time), now, &stage_ns);
+	*stage_time = now;
+
+	counter->count++;
+	counter->total_ns += stage_ns;
+	if (stage_ns > counter->max_ns) {
+		counter->max_ns = stage_ns;
+	}
+}
+
+int knet_handle_enable_stage_stats(knet_handle_t knet_h, unsigned int enabled)
+{
+	int savederrno = 0;
+	int err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (enabled > 1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	knet_h->stage_stats_enabled = enabled;
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Pipeline stage stats %s",
+		  enabled ? "enabled" : "disabled");
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_handle_get_stage_stats(knet_handle_t knet_h, struct knet_stage_stats *stage_stats, size_t struct_size)
+{
+	int savederrno = 0;
+	int err = 0;
+	struct knet_stage_stats current;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!stage_stats) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (struct_size < sizeof(size_t)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	memset(&current, 0, sizeof(struct knet_stage_stats));
+	current.enabled = knet_h->stage_stats_enabled;
+	memmove(current.stages, knet_h->stage_stats, sizeof(current.stages));
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	if (struct_size > sizeof(struct knet_stage_stats)) {
+		struct_size = sizeof(struct knet_stage_stats);
+	}
+
+	/* Tell the caller our full size in case they have an old version */
+	current.size = sizeof(struct knet_stage_stats);
+
+	memmove(stage_stats, &current, struct_size);
+
+	errno = err ? savederrno : 0;
+	return err;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_STAGE_STATS_H__
+#define __KNET_STAGE_STATS_H__
+
+#include <time.h>
+
+#include "internals.h"
+
+void _stage_stats_account(knet_handle_t knet_h, uint8_t stage, struct timespec *stage_time);
+
+/*
+ * the data path only pays for a branch when accounting is off
+ */
+static inline void _stage_stats_start(knet_handle_t knet_h, struct timespec *stage_time)
+{
+	if (knet_h->stage_stats_enabled) {
+		clock_gettime(CLOCK_MONOTONIC, stage_time);
+	}
+}
+
+/*
+ * account the time since the previous mark to stage and
+ * start the next stage
+ */
+static inline void _stage_stats_mark(knet_handle_t knet_h, uint8_t stage, struct timespec *stage_time)
+{
+	if (knet_h->stage_stats_enabled) {
+		_stage_stats_account(knet_h, stage, stage_time);
+	}
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "internals.h"
+#include "links.h"
+#include "logging.h"
+#include "stats_shm.h"
+#include "threads_common.h"
+
+/*
+ * the region is written only by the heartbeat thread (and by
+ * knet_handle_enable_stats_shm with global write lock held),
+ * so there is a single writer and seq does not need to be
+ * incremented atomically, only ordered against the data.
+ */
+static void _stats_shm_update(knet_handle_t knet_h, struct timespec *now)
+{
+	struct knet_stats_shm *shm = knet_h->stats_shm;
+	struct knet_stats_shm_link *shm_link;
+	struct knet_host *host;
+	struct knet_link *link;
+	uint32_t entries = 0, dropped = 0;
+	int link_idx;
+
+	__atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	shm->update_time = ((uint64_t)now->tv_sec * 1000000000llu) + now->tv_nsec;
+	shm->interval = knet_h->stats_shm_interval;
+
+	memmove(&shm->handle, &knet_h->stats, sizeof(struct knet_handle_stats));
+	shm->handle.tx_crypt_packets += knet_h->stats_extra.tx_crypt_ping_packets +
+		knet_h->stats_extra.tx_crypt_pong_packets +
+		knet_h->stats_extra.tx_crypt_pmtu_packets +
+		knet_h->stats_extra.tx_crypt_pmtu_reply_packets;
+	shm->handle.size = sizeof(struct knet_handle_stats);
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		for (link_idx = 0; link_idx < KNET_MAX_LINK; link_idx++) {
+			link = &host->link[link_idx];
+			if (!link->configured) {
+				continue;
+			}
+			if (entries == KNET_STATS_SHM_MAX_LINKS) {
+				dropped++;
+				continue;
+			}
+			shm_link = &shm->links[entries];
+			shm_link->host_id = host->host_id;
+			shm_link->link_id = link_idx;
+			shm_link->enabled = link->status.enabled;
+			shm_link->connected = link->status.connected;
+			memmove(&shm_link->stats, &link->status.stats, sizeof(struct knet_link_stats));
+			_link_stats_totals(&shm_link->stats);
+			entries++;
+		}
+	}
+	shm->links_entries = entries;
+	shm->links_dropped = dropped;
+
+	__atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * called by the heartbeat thread with global read lock held
+ */
+void _stats_shm_timer(knet_handle_t knet_h)
+{
+	struct timespec now;
+	unsigned long long diff;
+
+	if (!knet_h->stats_shm) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_diff(knet_h->stats_shm_last, now, &diff);
+	if (diff < (unsigned long long)knet_h->stats_shm_interval * 1000000llu) {
+		return;
+	}
+	knet_h->stats_shm_last = now;
+
+	_stats_shm_update(knet_h, &now);
+}
+
+void _stats_shm_free(knet_handle_t knet_h)
+{
+	if (!knet_h->stats_shm) {
+		return;
+	}
+
+	munmap(knet_h->stats_shm, sizeof(struct knet_stats_shm));
+	knet_h->stats_shm = NULL;
+	if (knet_h->stats_shm_fd >= 0) {
+		close(knet_h->stats_shm_fd);
+	}
+	knet_h->stats_shm_fd = -1;
+	knet_h->stats_shm_interval = 0;
+}
+
+static int _stats_shm_alloc(knet_handle_t knet_h)
+{
+	void *map;
+	int fd = -1;
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("knet-stats", MFD_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (ftruncate(fd, sizeof(struct knet_stats_shm)) < 0) {
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, sizeof(struct knet_stats_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+#else
+	map = mmap(NULL, sizeof(struct knet_stats_shm), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#endif
+	if (map == MAP_FAILED) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+
+	knet_h->stats_shm = map;
+	knet_h->stats_shm_fd = fd;
+	knet_h->stats_shm->version = KNET_STATS_SHM_VERSION;
+	knet_h->stats_shm->size = sizeof(struct knet_stats_shm);
+
+	return 0;
+}
+
+int knet_handle_enable_stats_shm(knet_handle_t knet_h, uint32_t interval,
+				 int *shmfd, const struct knet_stats_shm **shm)
+{
+	int savederrno = 0, err = 0;
+	struct timespec now;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = get_global_wrlock(knet_h);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to get write lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!interval) {
+		_stats_shm_free(knet_h);
+		log_debug(knet_h, KNET_SUB_HANDLE, "Shared memory stats disabled");
+		goto out_unlock;
+	}
+
+	if ((!knet_h->stats_shm) && (_stats_shm_alloc(knet_h) < 0)) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate shared memory stats: %s",
+			strerror(savederrno));
+		goto out_unlock;
+	}
+
+	knet_h->stats_shm_interval = interval;
+
+	/*
+	 * make sure the region is valid before returning it
+	 */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	knet_h->stats_shm_last = now;
+	_stats_shm_update(knet_h, &now);
+
+	if (shmfd) {
+		*shmfd = knet_h->stats_shm_fd;
+	}
+	if (shm) {
+		*shm = knet_h->stats_shm;
+	}
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "Shared memory stats enabled (interval: %u msecs)", interval);
+
+out_unlock:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_stats_shm_read(const struct knet_stats_shm *shm, struct knet_stats_shm *snapshot)
+{
+	uint64_t seq_start, seq_end;
+	uint32_t entries;
+	int retries;
+
+	if ((!shm) || (!snapshot)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (__atomic_load_n(&shm->version, __ATOMIC_RELAXED) != KNET_STATS_SHM_VERSION) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (retries = 0; retries < KNET_STATS_SHM_READ_RETRIES; retries++) {
+		seq_start = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq_start & 1) {
+			sched_yield();
+			continue;
+		}
+
+		entries = shm->links_entries;
+		if (entries > KNET_STATS_SHM_MAX_LINKS) {
+			entries = KNET_STATS_SHM_MAX_LINKS;
+		}
+		memcpy(snapshot, shm, offsetof(struct knet_stats_shm, links));
+		memcpy(snapshot->links, shm->links, entries * sizeof(struct knet_stats_shm_link));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq_end = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+		if (seq_start == seq_end) {
+			snapshot->links_entries = entries;
+			errno = 0;
+			return 0;
+		}
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_STATS_SHM_H__
+#define __KNET_STATS_SHM_H__
+
+#include "internals.h"
+
+#define KNET_STATS_SHM_READ_RETRIES 1000	/* attempts to get a consistent copy before giving up */
+
+void _stats_shm_timer(knet_handle_t knet_h);
+void _stats_shm_free(knet_handle_t knet_h);
+
+#endif
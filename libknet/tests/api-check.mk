@@ -10,6 +10,8 @@ api_checks		= \
 			  api_knet_handle_new_test \
 			  api_knet_handle_free_test \
 			  api_knet_handle_compress_test \
+			  api_knet_handle_set_zerocopy_test \
+			  api_knet_handle_get_zerocopy_test \
 			  api_knet_handle_crypto_test \
 			  api_knet_handle_setfwd_test \
 			  api_knet_handle_enable_filter_test \
@@ -18,21 +20,55 @@ api_checks		= \
 			  api_knet_handle_remove_datafd_test \
 			  api_knet_handle_get_channel_test \
 			  api_knet_handle_get_datafd_test \
+			  api_knet_handle_set_channel_coalesce_test \
+			  api_knet_handle_get_channel_coalesce_test \
+			  api_knet_handle_set_channel_priority_test \
+			  api_knet_handle_get_channel_priority_test \
+			  api_knet_handle_set_channel_lifetime_test \
+			  api_knet_handle_get_channel_lifetime_test \
+			  api_knet_handle_enable_channel_rx_notify_test \
+			  api_knet_handle_set_mcast_test \
+			  api_knet_handle_get_mcast_test \
+			  api_knet_handle_set_relay_test \
+			  api_knet_handle_get_relay_test \
 			  api_knet_handle_get_stats_test \
 			  api_knet_get_crypto_list_test \
 			  api_knet_get_compress_list_test \
 			  api_knet_handle_clear_stats_test \
+			  api_knet_handle_enable_stats_shm_test \
+			  api_knet_stats_shm_read_test \
+			  api_knet_handle_get_topology_status_test \
+			  api_knet_handle_enable_event_queue_test \
+			  api_knet_handle_get_events_test \
+			  api_knet_handle_get_histogram_test \
+			  api_knet_histogram_percentile_test \
+			  api_knet_handle_enable_stage_stats_test \
+			  api_knet_handle_get_stage_stats_test \
 			  api_knet_get_transport_list_test \
 			  api_knet_get_transport_name_by_id_test \
 			  api_knet_get_transport_id_by_name_test \
 			  api_knet_handle_set_transport_reconnect_interval_test \
 			  api_knet_handle_get_transport_reconnect_interval_test \
 			  api_knet_recv_test \
+			  api_knet_recv_batch_test \
 			  api_knet_send_test \
+			  api_knet_send_batch_test \
 			  api_knet_send_crypto_test \
 			  api_knet_send_compress_test \
+			  api_knet_send_fec_test \
 			  api_knet_send_sync_test \
+			  api_knet_send_to_test \
+			  api_knet_send_sync_to_test \
+			  api_knet_send_to_group_test \
+			  api_knet_send_buf_reserve_test \
+			  api_knet_send_buf_commit_test \
+			  api_knet_send_buf_release_test \
 			  api_knet_send_loopback_test \
+			  api_knet_send_xdp_test \
+			  api_knet_send_xdp_veth_test \
+			  api_knet_send_shm_test \
+			  api_knet_send_zerocopy_test \
+			  api_knet_send_uring_test \
 			  api_knet_handle_pmtud_setfreq_test \
 			  api_knet_handle_pmtud_getfreq_test \
 			  api_knet_handle_enable_pmtud_notify_test \
@@ -47,6 +83,10 @@ api_checks		= \
 			  api_knet_host_get_policy_test \
 			  api_knet_host_get_status_test \
 			  api_knet_host_enable_status_change_notify_test \
+			  api_knet_group_create_test \
+			  api_knet_group_destroy_test \
+			  api_knet_group_add_host_test \
+			  api_knet_group_remove_host_test \
 			  api_knet_log_get_subsystem_name_test \
 			  api_knet_log_get_subsystem_id_test \
 			  api_knet_log_get_loglevel_name_test \
@@ -64,10 +104,15 @@ api_checks		= \
 			  api_knet_link_get_pong_count_test \
 			  api_knet_link_set_priority_test \
 			  api_knet_link_get_priority_test \
+			  api_knet_link_set_tx_queue_test \
+			  api_knet_link_get_tx_queue_test \
+			  api_knet_link_set_rate_test \
+			  api_knet_link_get_rate_test \
 			  api_knet_link_set_enable_test \
 			  api_knet_link_get_enable_test \
 			  api_knet_link_get_link_list_test \
 			  api_knet_link_get_status_test \
+			  api_knet_link_get_rtt_histogram_test \
 			  api_knet_link_enable_status_change_notify_test \
 			  api_knet_handle_set_threads_timer_res_test \
 			  api_knet_handle_get_threads_timer_res_test
@@ -84,6 +129,12 @@ api_knet_handle_new_limit_test_SOURCES = api_knet_handle_new_limit.c \
 api_knet_handle_compress_test_SOURCES = api_knet_handle_compress.c \
 					test-common.c
 
+api_knet_handle_set_zerocopy_test_SOURCES = api_knet_handle_set_zerocopy.c \
+					    test-common.c
+
+api_knet_handle_get_zerocopy_test_SOURCES = api_knet_handle_get_zerocopy.c \
+					    test-common.c
+
 api_knet_handle_crypto_test_SOURCES = api_knet_handle_crypto.c \
 				      test-common.c
 
@@ -108,6 +159,39 @@ api_knet_handle_get_channel_test_SOURCES = api_knet_handle_get_channel.c \
 api_knet_handle_get_datafd_test_SOURCES = api_knet_handle_get_datafd.c \
 					  test-common.c
 
+api_knet_handle_set_channel_coalesce_test_SOURCES = api_knet_handle_set_channel_coalesce.c \
+						    test-common.c
+
+api_knet_handle_get_channel_coalesce_test_SOURCES = api_knet_handle_get_channel_coalesce.c \
+						    test-common.c
+
+api_knet_handle_set_channel_priority_test_SOURCES = api_knet_handle_set_channel_priority.c \
+						    test-common.c
+
+api_knet_handle_get_channel_priority_test_SOURCES = api_knet_handle_get_channel_priority.c \
+						    test-common.c
+
+api_knet_handle_set_channel_lifetime_test_SOURCES = api_knet_handle_set_channel_lifetime.c \
+						    test-common.c
+
+api_knet_handle_get_channel_lifetime_test_SOURCES = api_knet_handle_get_channel_lifetime.c \
+						    test-common.c
+
+api_knet_handle_enable_channel_rx_notify_test_SOURCES = api_knet_handle_enable_channel_rx_notify.c \
+							test-common.c
+
+api_knet_handle_set_mcast_test_SOURCES = api_knet_handle_set_mcast.c \
+					 test-common.c
+
+api_knet_handle_get_mcast_test_SOURCES = api_knet_handle_get_mcast.c \
+					 test-common.c
+
+api_knet_handle_set_relay_test_SOURCES = api_knet_handle_set_relay.c \
+					 test-common.c
+
+api_knet_handle_get_relay_test_SOURCES = api_knet_handle_get_relay.c \
+					 test-common.c
+
 api_knet_handle_get_stats_test_SOURCES = api_knet_handle_get_stats.c \
 					 test-common.c
 
@@ -120,6 +204,33 @@ api_knet_get_compress_list_test_SOURCES = api_knet_get_compress_list.c \
 api_knet_handle_clear_stats_test_SOURCES = api_knet_handle_clear_stats.c \
 					  test-common.c
 
+api_knet_handle_enable_stats_shm_test_SOURCES = api_knet_handle_enable_stats_shm.c \
+						test-common.c
+
+api_knet_stats_shm_read_test_SOURCES = api_knet_stats_shm_read.c \
+				       test-common.c
+
+api_knet_handle_get_topology_status_test_SOURCES = api_knet_handle_get_topology_status.c \
+						   test-common.c
+
+api_knet_handle_enable_event_queue_test_SOURCES = api_knet_handle_enable_event_queue.c \
+						  test-common.c
+
+api_knet_handle_get_events_test_SOURCES = api_knet_handle_get_events.c \
+					  test-common.c
+
+api_knet_handle_get_histogram_test_SOURCES = api_knet_handle_get_histogram.c \
+					     test-common.c
+
+api_knet_histogram_percentile_test_SOURCES = api_knet_histogram_percentile.c \
+					     test-common.c
+
+api_knet_handle_enable_stage_stats_test_SOURCES = api_knet_handle_enable_stage_stats.c \
+						  test-common.c
+
+api_knet_handle_get_stage_stats_test_SOURCES = api_knet_handle_get_stage_stats.c \
+					       test-common.c
+
 api_knet_get_transport_list_test_SOURCES = api_knet_get_transport_list.c \
 					   test-common.c
 
@@ -138,21 +249,63 @@ api_knet_handle_get_transport_reconnect_interval_test_SOURCES = api_knet_handle_
 api_knet_recv_test_SOURCES = api_knet_recv.c \
 			     test-common.c
 
+api_knet_recv_batch_test_SOURCES = api_knet_recv_batch.c \
+				   test-common.c
+
 api_knet_send_test_SOURCES = api_knet_send.c \
 			     test-common.c
 
+api_knet_send_batch_test_SOURCES = api_knet_send_batch.c \
+				   test-common.c
+
 api_knet_send_compress_test_SOURCES = api_knet_send_compress.c \
 				      test-common.c
 
 api_knet_send_crypto_test_SOURCES = api_knet_send_crypto.c \
 				    test-common.c
 
+api_knet_send_fec_test_SOURCES = api_knet_send_fec.c \
+				 test-common.c
+
 api_knet_send_loopback_test_SOURCES = api_knet_send_loopback.c \
 			     test-common.c
 
 api_knet_send_sync_test_SOURCES = api_knet_send_sync.c \
 				  test-common.c
 
+api_knet_send_to_test_SOURCES = api_knet_send_to.c \
+				test-common.c
+
+api_knet_send_sync_to_test_SOURCES = api_knet_send_sync_to.c \
+				     test-common.c
+
+api_knet_send_to_group_test_SOURCES = api_knet_send_to_group.c \
+				      test-common.c
+
+api_knet_send_buf_reserve_test_SOURCES = api_knet_send_buf_reserve.c \
+					 test-common.c
+
+api_knet_send_buf_commit_test_SOURCES = api_knet_send_buf_commit.c \
+					test-common.c
+
+api_knet_send_buf_release_test_SOURCES = api_knet_send_buf_release.c \
+					 test-common.c
+
+api_knet_send_xdp_test_SOURCES = api_knet_send_xdp.c \
+				 test-common.c
+
+api_knet_send_xdp_veth_test_SOURCES = api_knet_send_xdp_veth.c \
+				      test-common.c
+
+api_knet_send_shm_test_SOURCES = api_knet_send_shm.c \
+				 test-common.c
+
+api_knet_send_zerocopy_test_SOURCES = api_knet_send_zerocopy.c \
+				      test-common.c
+
+api_knet_send_uring_test_SOURCES = api_knet_send_uring.c \
+				   test-common.c
+
 api_knet_handle_pmtud_setfreq_test_SOURCES = api_knet_handle_pmtud_setfreq.c \
 					     test-common.c
 
@@ -195,6 +348,18 @@ api_knet_host_get_status_test_SOURCES = api_knet_host_get_status.c \
 api_knet_host_enable_status_change_notify_test_SOURCES = api_knet_host_enable_status_change_notify.c \
 							 test-common.c
 
+api_knet_group_create_test_SOURCES = api_knet_group_create.c \
+				     test-common.c
+
+api_knet_group_destroy_test_SOURCES = api_knet_group_destroy.c \
+				      test-common.c
+
+api_knet_group_add_host_test_SOURCES = api_knet_group_add_host.c \
+				       test-common.c
+
+api_knet_group_remove_host_test_SOURCES = api_knet_group_remove_host.c \
+					  test-common.c
+
 api_knet_log_get_subsystem_name_test_SOURCES = api_knet_log_get_subsystem_name.c \
 					       test-common.c
 
@@ -244,6 +409,18 @@ api_knet_link_set_priority_test_SOURCES = api_knet_link_set_priority.c \
 api_knet_link_get_priority_test_SOURCES = api_knet_link_get_priority.c \
 					  test-common.c
 
+api_knet_link_set_tx_queue_test_SOURCES = api_knet_link_set_tx_queue.c \
+					  test-common.c
+
+api_knet_link_get_tx_queue_test_SOURCES = api_knet_link_get_tx_queue.c \
+					  test-common.c
+
+api_knet_link_set_rate_test_SOURCES = api_knet_link_set_rate.c \
+				      test-common.c
+
+api_knet_link_get_rate_test_SOURCES = api_knet_link_get_rate.c \
+				      test-common.c
+
 api_knet_link_set_enable_test_SOURCES = api_knet_link_set_enable.c \
 					test-common.c
 
@@ -256,6 +433,9 @@ api_knet_link_get_link_list_test_SOURCES = api_knet_link_get_link_list.c \
 api_knet_link_get_status_test_SOURCES = api_knet_link_get_status.c \
 					test-common.c
 
+api_knet_link_get_rtt_histogram_test_SOURCES = api_knet_link_get_rtt_histogram.c \
+					       test-common.c
+
 api_knet_link_enable_status_change_notify_test_SOURCES = api_knet_link_enable_status_change_notify.c \
 							 test-common.c
 
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	uint16_t group_id;
+
+	printf("Test knet_group_add_host incorrect knet_h\n");
+
+	if ((!knet_group_add_host(NULL, 0, 1)) || (errno != EINVAL)) {
+		printf("knet_group_add_host accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_group_add_host with invalid group_id (KNET_MAX_GROUPS)\n");
+
+	if ((!knet_group_add_host(knet_h, KNET_MAX_GROUPS, 1)) || (errno != EINVAL)) {
+		printf("knet_group_add_host accepted invalid group_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_group_add_host with unused group_id\n");
+
+	if ((!knet_group_add_host(knet_h, 0, 1)) || (errno != EINVAL)) {
+		printf("knet_group_add_host accepted unused group_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_group_create(knet_h, &group_id) < 0) {
+		printf("knet_group_create failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_group_add_host with unknown host\n");
+
+	if ((!knet_group_add_host(knet_h, group_id, 1)) || (errno != EINVAL)) {
+		printf("knet_group_add_host accepted unknown host or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_group_add_host with valid data\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_group_add_host(knet_h, group_id, 1) < 0) {
+		printf("knet_group_add_host failed: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_h->groups[group_id]->host_ids_entries != 1) ||
+	    (knet_h->groups[group_id]->host_ids[0] != 1)) {
+		printf("knet_group_add_host did not record the host in the group\n");
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->groups[group_id]->dst_hosts_entries != 0) {
+		printf("knet_group_add_host added an unreachable host to the destinations\n");
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_group_add_host with host already in group\n");
+
+	if ((!knet_group_add_host(knet_h, group_id, 1)) || (errno != EEXIST)) {
+		printf("knet_group_add_host accepted duplicate host or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
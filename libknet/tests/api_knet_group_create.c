@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	uint16_t group_id, i;
+
+	printf("Test knet_group_create incorrect knet_h\n");
+
+	if ((!knet_group_create(NULL, &group_id)) || (errno != EINVAL)) {
+		printf("knet_group_create accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_group_create with NULL group_id\n");
+
+	if ((!knet_group_create(knet_h, NULL)) || (errno != EINVAL)) {
+		printf("knet_group_create accepted invalid group_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_group_create with valid data\n");
+
+	if (knet_group_create(knet_h, &group_id) < 0) {
+		printf("knet_group_create failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((group_id != 0) || (!knet_h->groups[group_id])) {
+		printf("knet_group_create returned incorrect group_id %u\n", group_id);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_group_create with all groups in use\n");
+
+	for (i = 1; i < KNET_MAX_GROUPS; i++) {
+		if (knet_group_create(knet_h, &group_id) < 0) {
+			printf("knet_group_create failed: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+	}
+
+	if ((!knet_group_create(knet_h, &group_id)) || (errno != EBUSY)) {
+		printf("knet_group_create accepted too many groups or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "events.h"
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int event_fd = -1;
+
+	printf("Test knet_handle_enable_event_queue incorrect knet_h\n");
+
+	if ((!knet_handle_enable_event_queue(NULL, 16, &event_fd)) || (errno != EINVAL)) {
+		printf("knet_handle_enable_event_queue accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_enable_event_queue with too many entries\n");
+
+	if ((!knet_handle_enable_event_queue(knet_h, KNET_EVENT_QUEUE_MAX + 1, &event_fd)) || (errno != EINVAL)) {
+		printf("knet_handle_enable_event_queue accepted invalid entries or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_event_queue with valid input\n");
+
+	if (knet_handle_enable_event_queue(knet_h, 10, &event_fd) < 0) {
+		printf("knet_handle_enable_event_queue failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((event_fd < 0) || (!knet_h->event_queue) || (knet_h->event_queue->mask != 15)) {
+		printf("knet_handle_enable_event_queue did not set up the queue correctly\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_event_queue when already enabled\n");
+
+	if ((!knet_handle_enable_event_queue(knet_h, 16, NULL)) || (errno != EBUSY)) {
+		printf("knet_handle_enable_event_queue accepted double enable or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_event_queue disable\n");
+
+	if (knet_handle_enable_event_queue(knet_h, 0, NULL) < 0) {
+		printf("knet_handle_enable_event_queue failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->event_queue) {
+		printf("knet_handle_enable_event_queue did not release the queue\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+
+	printf("Test knet_handle_enable_stage_stats incorrect knet_h\n");
+
+	if ((!knet_handle_enable_stage_stats(NULL, 1)) || (errno != EINVAL)) {
+		printf("knet_handle_enable_stage_stats accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_enable_stage_stats with invalid enabled\n");
+
+	if ((!knet_handle_enable_stage_stats(knet_h, 2)) || (errno != EINVAL)) {
+		printf("knet_handle_enable_stage_stats accepted invalid enabled or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_stage_stats default is disabled\n");
+
+	if (knet_h->stage_stats_enabled) {
+		printf("stage stats are enabled by default\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_enable_stage_stats enable\n");
+
+	if ((knet_handle_enable_stage_stats(knet_h, 1) < 0) || (knet_h->stage_stats_enabled != 1)) {
+		printf("knet_handle_enable_stage_stats failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_stage_stats disable\n");
+
+	if ((knet_handle_enable_stage_stats(knet_h, 0) < 0) || (knet_h->stage_stats_enabled != 0)) {
+		printf("knet_handle_enable_stage_stats failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static struct knet_stats_shm snapshot;
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int shmfd = -1;
+	const struct knet_stats_shm *shm = NULL;
+	struct knet_stats_shm *map;
+	uint64_t update_time;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_enable_stats_shm incorrect knet_h\n");
+
+	if ((!knet_handle_enable_stats_shm(NULL, 100, &shmfd, &shm)) || (errno != EINVAL)) {
+		printf("knet_handle_enable_stats_shm accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_enable_stats_shm with valid input\n");
+
+	if (knet_handle_enable_stats_shm(knet_h, 100, &shmfd, &shm) < 0) {
+		printf("knet_handle_enable_stats_shm failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!shm) || (shm->version != KNET_STATS_SHM_VERSION) || (shm->seq & 1) || (!shm->seq)) {
+		printf("knet_handle_enable_stats_shm returned an invalid region\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test mapping the stats region from the fd\n");
+
+#ifdef HAVE_MEMFD_CREATE
+	map = mmap(NULL, sizeof(struct knet_stats_shm), PROT_READ, MAP_SHARED, shmfd, 0);
+	if (map == MAP_FAILED) {
+		printf("Unable to mmap stats fd: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+#else
+	map = (struct knet_stats_shm *)shm;
+#endif
+
+	if (map->version != KNET_STATS_SHM_VERSION) {
+		printf("stats region from fd does not match\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test stats region is updated with link stats\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	update_time = shm->update_time;
+
+	sleep(1);
+
+	if (knet_stats_shm_read(map, &snapshot) < 0) {
+		printf("knet_stats_shm_read failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((snapshot.update_time == update_time) ||
+	    (snapshot.interval != 100) ||
+	    (snapshot.links_entries != 1) ||
+	    (snapshot.links[0].host_id != 1) ||
+	    (snapshot.links[0].link_id != 0)) {
+		printf("stats region has not been updated (entries: %u)\n", snapshot.links_entries);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+#ifdef HAVE_MEMFD_CREATE
+	munmap(map, sizeof(struct knet_stats_shm));
+#endif
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_enable_stats_shm disable\n");
+
+	if (knet_handle_enable_stats_shm(knet_h, 0, NULL, NULL) < 0) {
+		printf("knet_handle_enable_stats_shm failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->stats_shm) {
+		printf("knet_handle_enable_stats_shm did not release the region\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
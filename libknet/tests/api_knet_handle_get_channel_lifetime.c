@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	uint32_t lifetime = 0;
+
+	printf("Test knet_handle_get_channel_lifetime incorrect knet_h\n");
+
+	if ((!knet_handle_get_channel_lifetime(NULL, channel, &lifetime)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_lifetime accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_channel_lifetime with invalid channel (< 0)\n");
+
+	channel = -1;
+
+	if ((!knet_handle_get_channel_lifetime(knet_h, channel, &lifetime)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_lifetime accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_lifetime with invalid channel (KNET_DATAFD_MAX)\n");
+
+	channel = KNET_DATAFD_MAX;
+
+	if ((!knet_handle_get_channel_lifetime(knet_h, channel, &lifetime)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_lifetime accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_lifetime with unconfigured datafd/channel\n");
+
+	channel = 10;
+
+	if ((!knet_handle_get_channel_lifetime(knet_h, channel, &lifetime)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_lifetime accepted unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_channel_lifetime with invalid lifetime\n");
+
+	if ((!knet_handle_get_channel_lifetime(knet_h, channel, NULL)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_lifetime accepted invalid lifetime or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_lifetime default value\n");
+
+	lifetime = 1;
+
+	if (knet_handle_get_channel_lifetime(knet_h, channel, &lifetime) < 0) {
+		printf("knet_handle_get_channel_lifetime failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (lifetime != 0) {
+		printf("knet_handle_get_channel_lifetime returned incorrect default value: %u\n", lifetime);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_lifetime after set\n");
+
+	if (knet_handle_set_channel_lifetime(knet_h, channel, 100) < 0) {
+		printf("knet_handle_set_channel_lifetime failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_get_channel_lifetime(knet_h, channel, &lifetime) < 0) {
+		printf("knet_handle_get_channel_lifetime failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (lifetime != 100) {
+		printf("knet_handle_get_channel_lifetime returned incorrect value: %u\n", lifetime);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	uint8_t priority = 0;
+
+	printf("Test knet_handle_get_channel_priority incorrect knet_h\n");
+
+	if ((!knet_handle_get_channel_priority(NULL, channel, &priority)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_priority accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_channel_priority with invalid channel (< 0)\n");
+
+	channel = -1;
+
+	if ((!knet_handle_get_channel_priority(knet_h, channel, &priority)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_priority accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_priority with invalid channel (KNET_DATAFD_MAX)\n");
+
+	channel = KNET_DATAFD_MAX;
+
+	if ((!knet_handle_get_channel_priority(knet_h, channel, &priority)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_priority accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_priority with unconfigured datafd/channel\n");
+
+	channel = 10;
+
+	if ((!knet_handle_get_channel_priority(knet_h, channel, &priority)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_priority accepted unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_channel_priority with invalid priority\n");
+
+	if ((!knet_handle_get_channel_priority(knet_h, channel, NULL)) || (errno != EINVAL)) {
+		printf("knet_handle_get_channel_priority accepted invalid priority or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_priority default value\n");
+
+	priority = 1;
+
+	if (knet_handle_get_channel_priority(knet_h, channel, &priority) < 0) {
+		printf("knet_handle_get_channel_priority failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (priority != 0) {
+		printf("knet_handle_get_channel_priority returned incorrect default value: %u\n", priority);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_channel_priority after set\n");
+
+	if (knet_handle_set_channel_priority(knet_h, channel, 10) < 0) {
+		printf("knet_handle_set_channel_priority failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_get_channel_priority(knet_h, channel, &priority) < 0) {
+		printf("knet_handle_get_channel_priority failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (priority != 10) {
+		printf("knet_handle_get_channel_priority returned incorrect value: %u\n", priority);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
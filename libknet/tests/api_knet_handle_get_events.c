@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int link_notified = 0;
+
+static void link_notify(void *priv,
+			knet_node_id_t host_id,
+			uint8_t link_id,
+			uint8_t connected,
+			uint8_t remote,
+			uint8_t external)
+{
+	link_notified = 1;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int event_fd = -1;
+	struct knet_event events[16];
+	struct pollfd pfd;
+	int res, i, found;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_events incorrect knet_h\n");
+
+	if ((knet_handle_get_events(NULL, events, 16) != -1) || (errno != EINVAL)) {
+		printf("knet_handle_get_events accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_events with NULL events\n");
+
+	if ((knet_handle_get_events(knet_h, NULL, 16) != -1) || (errno != EINVAL)) {
+		printf("knet_handle_get_events accepted invalid events or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_events with queue disabled\n");
+
+	if ((knet_handle_get_events(knet_h, events, 16) != -1) || (errno != EINVAL)) {
+		printf("knet_handle_get_events accepted disabled queue or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if ((knet_link_enable_status_change_notify(knet_h, NULL, link_notify) < 0) ||
+	    (knet_handle_enable_event_queue(knet_h, 16, &event_fd) < 0)) {
+		printf("Unable to enable event queue: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_events with empty queue\n");
+
+	if (knet_handle_get_events(knet_h, events, 16) != 0) {
+		printf("knet_handle_get_events returned events from an empty queue: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable\n");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_events after link up\n");
+
+	memset(&pfd, 0, sizeof(struct pollfd));
+	pfd.fd = event_fd;
+	pfd.events = POLLIN;
+
+	if (poll(&pfd, 1, 1000) != 1) {
+		printf("event fd did not become readable\n");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	res = knet_handle_get_events(knet_h, events, 16);
+	found = 0;
+	for (i = 0; i < res; i++) {
+		if ((events[i].type == KNET_EVENT_LINK_STATUS) &&
+		    (events[i].u.link.host_id == 1) &&
+		    (events[i].u.link.link_id == 0) &&
+		    (events[i].u.link.connected == 1)) {
+			found = 1;
+		}
+	}
+
+	if ((!found) || (link_notified)) {
+		printf("knet_handle_get_events did not return the link event (res: %d found: %d notified: %d)\n",
+		       res, found, link_notified);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_events with a full queue\n");
+
+	knet_handle_enable_event_queue(knet_h, 0, NULL);
+	if (knet_handle_enable_event_queue(knet_h, 2, &event_fd) < 0) {
+		printf("Unable to enable event queue: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * link down + host down + link up + host up
+	 */
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	sleep(1);
+	knet_link_set_enable(knet_h, 1, 0, 1);
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable\n");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	res = knet_handle_get_events(knet_h, events, 16);
+	if ((res < 1) || (events[0].type != KNET_EVENT_DROPPED) || (!events[0].u.dropped.count)) {
+		printf("knet_handle_get_events did not report dropped events (res: %d)\n", res);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static struct knet_histogram histogram;
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+
+	printf("Test knet_handle_get_histogram incorrect knet_h\n");
+
+	if ((!knet_handle_get_histogram(NULL, KNET_HISTOGRAM_TX_CRYPT, &histogram)) || (errno != EINVAL)) {
+		printf("knet_handle_get_histogram accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_histogram with invalid histogram_id\n");
+
+	if ((!knet_handle_get_histogram(knet_h, KNET_HISTOGRAM_MAX, &histogram)) || (errno != EINVAL)) {
+		printf("knet_handle_get_histogram accepted invalid histogram_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_histogram with NULL histogram\n");
+
+	if ((!knet_handle_get_histogram(knet_h, KNET_HISTOGRAM_TX_CRYPT, NULL)) || (errno != EINVAL)) {
+		printf("knet_handle_get_histogram accepted invalid histogram or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_histogram with valid input\n");
+
+	knet_h->histograms[KNET_HISTOGRAM_RX_CRYPT].count = 1;
+	knet_h->histograms[KNET_HISTOGRAM_RX_CRYPT].buckets[1] = 1;
+
+	memset(&histogram, 0x55, sizeof(struct knet_histogram));
+
+	if ((knet_handle_get_histogram(knet_h, KNET_HISTOGRAM_RX_CRYPT, &histogram) < 0) ||
+	    (histogram.count != 1) || (histogram.buckets[1] != 1) || (histogram.buckets[0] != 0)) {
+		printf("knet_handle_get_histogram failed or returned invalid data: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_clear_stats resets histograms\n");
+
+	if ((knet_handle_clear_stats(knet_h, KNET_CLEARSTATS_HANDLE_ONLY) < 0) ||
+	    (knet_handle_get_histogram(knet_h, KNET_HISTOGRAM_RX_CRYPT, &histogram) < 0) ||
+	    (histogram.count != 0) || (histogram.buckets[1] != 0)) {
+		printf("knet_handle_clear_stats did not reset histograms: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct sockaddr_storage lo, mcast;
+	struct sockaddr_storage get_mcast, get_src;
+	uint8_t ttl = 0;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if ((make_local_sockaddr(&mcast, 1) < 0) ||
+	    (inet_pton(AF_INET, "239.255.42.2", &((struct sockaddr_in *)&mcast)->sin_addr) != 1)) {
+		printf("Unable to convert multicast group to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_mcast incorrect knet_h\n");
+
+	if ((!knet_handle_get_mcast(NULL, &get_mcast, &get_src, &ttl)) || (errno != EINVAL)) {
+		printf("knet_handle_get_mcast accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_mcast with invalid mcast_addr\n");
+
+	if ((!knet_handle_get_mcast(knet_h, NULL, &get_src, &ttl)) || (errno != EINVAL)) {
+		printf("knet_handle_get_mcast accepted invalid mcast_addr or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_mcast with invalid src_addr\n");
+
+	if ((!knet_handle_get_mcast(knet_h, &get_mcast, NULL, &ttl)) || (errno != EINVAL)) {
+		printf("knet_handle_get_mcast accepted invalid src_addr or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_mcast with invalid ttl\n");
+
+	if ((!knet_handle_get_mcast(knet_h, &get_mcast, &get_src, NULL)) || (errno != EINVAL)) {
+		printf("knet_handle_get_mcast accepted invalid ttl or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_mcast default value\n");
+
+	memset(&get_mcast, 1, sizeof(struct sockaddr_storage));
+	ttl = 1;
+
+	if (knet_handle_get_mcast(knet_h, &get_mcast, &get_src, &ttl) < 0) {
+		printf("knet_handle_get_mcast failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((get_mcast.ss_family) || (ttl)) {
+		printf("knet_handle_get_mcast returned multicast enabled by default\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_mcast after set\n");
+
+	if (knet_handle_set_mcast(knet_h, &mcast, &lo, 4) < 0) {
+		printf("Unable to join multicast group on loopback: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(SKIP);
+	}
+
+	if (knet_handle_get_mcast(knet_h, &get_mcast, &get_src, &ttl) < 0) {
+		printf("knet_handle_get_mcast failed: %s\n", strerror(errno));
+		knet_handle_set_mcast(knet_h, NULL, NULL, 0);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((memcmp(&get_mcast, &mcast, sizeof(struct sockaddr_storage))) ||
+	    (memcmp(&get_src, &lo, sizeof(struct sockaddr_storage))) ||
+	    (ttl != 4)) {
+		printf("knet_handle_get_mcast returned incorrect values\n");
+		knet_handle_set_mcast(knet_h, NULL, NULL, 0);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	/*
+	 * knet_handle_free releases the group
+	 */
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
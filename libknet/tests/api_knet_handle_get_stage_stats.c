@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct knet_stage_stats stage_stats;
+	char send_buff[KNET_MAX_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len = 0;
+	int recv_len = 0;
+	int i;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	memset(send_buff, 0, sizeof(send_buff));
+
+	printf("Test knet_handle_get_stage_stats incorrect knet_h\n");
+
+	if ((!knet_handle_get_stage_stats(NULL, &stage_stats, sizeof(struct knet_stage_stats))) || (errno != EINVAL)) {
+		printf("knet_handle_get_stage_stats accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_stage_stats with NULL stage_stats\n");
+
+	if ((!knet_handle_get_stage_stats(knet_h, NULL, sizeof(struct knet_stage_stats))) || (errno != EINVAL)) {
+		printf("knet_handle_get_stage_stats accepted invalid stage_stats or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_stage_stats with invalid struct_size\n");
+
+	if ((!knet_handle_get_stage_stats(knet_h, &stage_stats, 0)) || (errno != EINVAL)) {
+		printf("knet_handle_get_stage_stats accepted invalid struct_size or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_stage_stats with accounting disabled\n");
+
+	memset(&stage_stats, 0, sizeof(struct knet_stage_stats));
+
+	if ((knet_handle_get_stage_stats(knet_h, &stage_stats, sizeof(struct knet_stage_stats)) < 0) ||
+	    (stage_stats.size != sizeof(struct knet_stage_stats)) ||
+	    (stage_stats.enabled) ||
+	    (stage_stats.stages[KNET_STAGE_TX_FILTER].count)) {
+		printf("knet_handle_get_stage_stats returned invalid data: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_stage_stats after sending data\n");
+
+	if (knet_handle_enable_stage_stats(knet_h, 1) < 0) {
+		printf("knet_handle_enable_stage_stats failed: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	send_len = knet_send(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (send_len != sizeof(send_buff)) {
+		printf("knet_send failed: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_packet(knet_h, 10, datafd)) {
+		printf("Error waiting for packet: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (recv_len != send_len) {
+		printf("knet_recv received only %d bytes: %s\n", recv_len, strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	memset(&stage_stats, 0, sizeof(struct knet_stage_stats));
+
+	if ((knet_handle_get_stage_stats(knet_h, &stage_stats, sizeof(struct knet_stage_stats)) < 0) ||
+	    (!stage_stats.enabled) ||
+	    (!stage_stats.stages[KNET_STAGE_TX_FILTER].count) ||
+	    (!stage_stats.stages[KNET_STAGE_TX_FRAGMENT].count) ||
+	    (!stage_stats.stages[KNET_STAGE_TX_SEND].count) ||
+	    (!stage_stats.stages[KNET_STAGE_RX_PARSE].count) ||
+	    (!stage_stats.stages[KNET_STAGE_RX_DEFRAG].count) ||
+	    (!stage_stats.stages[KNET_STAGE_RX_DELIVER].count) ||
+	    (stage_stats.stages[KNET_STAGE_TX_CRYPT].count) ||
+	    (stage_stats.stages[KNET_STAGE_RX_DECOMPRESS].count)) {
+		printf("knet_handle_get_stage_stats returned unexpected counters: %s\n", strerror(errno));
+		for (i = 0; i < KNET_STAGE_MAX; i++) {
+			printf("stage %d: count %" PRIu64 " total %" PRIu64 " max %" PRIu64 "\n", i,
+			       stage_stats.stages[i].count, stage_stats.stages[i].total_ns, stage_stats.stages[i].max_ns);
+		}
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_stage_stats after knet_handle_clear_stats\n");
+
+	knet_handle_enable_stage_stats(knet_h, 0);
+
+	if ((knet_handle_clear_stats(knet_h, KNET_CLEARSTATS_HANDLE_ONLY) < 0) ||
+	    (knet_handle_get_stage_stats(knet_h, &stage_stats, sizeof(struct knet_stage_stats)) < 0) ||
+	    (stage_stats.stages[KNET_STAGE_TX_FILTER].count) ||
+	    (stage_stats.stages[KNET_STAGE_RX_DELIVER].count)) {
+		printf("knet_handle_clear_stats did not reset stage stats: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static struct knet_topology_host hosts[4];
+static struct knet_topology_link links[4];
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct knet_topology_status topology;
+	uint64_t generation;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_topology_status incorrect knet_h\n");
+
+	if ((!knet_handle_get_topology_status(NULL, 0, &topology, hosts, 4, links, 4)) || (errno != EINVAL)) {
+		printf("knet_handle_get_topology_status accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_topology_status with NULL topology\n");
+
+	if ((!knet_handle_get_topology_status(knet_h, 0, NULL, hosts, 4, links, 4)) || (errno != EINVAL)) {
+		printf("knet_handle_get_topology_status accepted invalid topology or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status with NULL hosts\n");
+
+	if ((!knet_handle_get_topology_status(knet_h, 0, &topology, NULL, 4, links, 4)) || (errno != EINVAL)) {
+		printf("knet_handle_get_topology_status accepted invalid hosts or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status with NULL links\n");
+
+	if ((!knet_handle_get_topology_status(knet_h, 0, &topology, hosts, 4, NULL, 4)) || (errno != EINVAL)) {
+		printf("knet_handle_get_topology_status accepted invalid links or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_get_topology_status full topology\n");
+
+	memset(&topology, 0, sizeof(struct knet_topology_status));
+
+	if (knet_handle_get_topology_status(knet_h, 0, &topology, hosts, 4, links, 4) < 0) {
+		printf("knet_handle_get_topology_status failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!topology.full) || (!topology.generation) ||
+	    (topology.size != sizeof(struct knet_topology_status)) ||
+	    (topology.hosts_entries != 1) || (hosts[0].host_id != 1) ||
+	    (topology.links_entries != 1) || (links[0].host_id != 1) || (links[0].link_id != 0) ||
+	    (links[0].status.size != sizeof(struct knet_link_status))) {
+		printf("knet_handle_get_topology_status returned invalid data\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	generation = topology.generation;
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status with small arrays\n");
+
+	if ((!knet_handle_get_topology_status(knet_h, 0, &topology, NULL, 0, NULL, 0)) || (errno != ENOBUFS) ||
+	    (topology.hosts_entries != 1) || (topology.links_entries != 1)) {
+		printf("knet_handle_get_topology_status accepted small arrays or returned incorrect error: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status without changes\n");
+
+	if ((knet_handle_get_topology_status(knet_h, generation, &topology, hosts, 4, links, 4) < 0) ||
+	    (topology.full) || (topology.generation != generation) ||
+	    (topology.hosts_entries != 0) || (topology.links_entries != 0)) {
+		printf("knet_handle_get_topology_status returned unexpected changes: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status after enabling the link\n");
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_handle_get_topology_status(knet_h, generation, &topology, hosts, 4, links, 4) < 0) ||
+	    (topology.full) || (topology.generation <= generation) ||
+	    (topology.links_entries != 1) || (!links[0].status.enabled) ||
+	    (links[0].generation <= generation)) {
+		printf("knet_handle_get_topology_status did not report the link change: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	generation = topology.generation;
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_topology_status after removing the link\n");
+
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+
+	if ((knet_handle_get_topology_status(knet_h, generation, &topology, hosts, 4, links, 4) < 0) ||
+	    (!topology.full) || (topology.hosts_entries != 1) || (topology.links_entries != 0)) {
+		printf("knet_handle_get_topology_status did not report a full topology: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	uint32_t threshold;
+
+	printf("Test knet_handle_get_zerocopy incorrect knet_h\n");
+
+	if ((!knet_handle_get_zerocopy(NULL, &threshold)) || (errno != EINVAL)) {
+		printf("knet_handle_get_zerocopy accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_get_zerocopy with NULL threshold\n");
+
+	if ((!knet_handle_get_zerocopy(knet_h, NULL)) || (errno != EINVAL)) {
+		printf("knet_handle_get_zerocopy accepted invalid threshold or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_zerocopy default\n");
+
+	threshold = 1;
+
+	if ((knet_handle_get_zerocopy(knet_h, &threshold) < 0) || (threshold != 0)) {
+		printf("knet_handle_get_zerocopy failed or returned incorrect default: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_get_zerocopy after set\n");
+
+	if (knet_handle_set_zerocopy(knet_h, KNET_ZEROCOPY_MIN_THRESHOLD * 2) < 0) {
+		printf("knet_handle_set_zerocopy failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_handle_get_zerocopy(knet_h, &threshold) < 0) || (threshold != KNET_ZEROCOPY_MIN_THRESHOLD * 2)) {
+		printf("knet_handle_get_zerocopy failed or returned incorrect threshold: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -113,6 +113,36 @@ static void test(void)
 		exit(FAIL);
 	}
 
+	printf("Test knet_handle_new hostid 1, proper log_fd, invalid flags\n");
+
+	knet_h = knet_handle_new(1, logfds[1], KNET_LOG_DEBUG, 1ULL << 63);
+
+	if ((knet_h) || (errno != EINVAL)) {
+		printf("knet_handle_new accepted invalid flags or returned incorrect errno on invalid flags: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_new hostid 1, proper log_fd, io_uring RX engine\n");
+
+	knet_h = knet_handle_new(1, logfds[1], KNET_LOG_DEBUG, KNET_HANDLE_FLAG_IO_URING);
+
+	if ((!knet_h) && (errno != EOPNOTSUPP)) {
+		printf("knet_handle_new failed to enable io_uring: %s\n", strerror(errno));
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (!knet_h) {
+		printf("io_uring is not supported on this system\n");
+	}
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+
 	printf("Test knet_handle_new hostid 1, proper log_fd, proper log level (DEBUG)\n");
 
 	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+#define COALESCE_MSGS 16
+#define COALESCE_MSG_SIZE 64
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct knet_handle_stats stats;
+	char send_buff[COALESCE_MSG_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len = 0;
+	int recv_len = 0;
+	int savederrno;
+	int i;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_set_channel_coalesce incorrect knet_h\n");
+
+	if ((!knet_handle_set_channel_coalesce(NULL, channel, 1000)) || (errno != EINVAL)) {
+		printf("knet_handle_set_channel_coalesce accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_set_channel_coalesce with invalid channel (< 0)\n");
+
+	channel = -1;
+
+	if ((!knet_handle_set_channel_coalesce(knet_h, channel, 1000)) || (errno != EINVAL)) {
+		printf("knet_handle_set_channel_coalesce accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_channel_coalesce with invalid channel (KNET_DATAFD_MAX)\n");
+
+	channel = KNET_DATAFD_MAX;
+
+	if ((!knet_handle_set_channel_coalesce(knet_h, channel, 1000)) || (errno != EINVAL)) {
+		printf("knet_handle_set_channel_coalesce accepted invalid channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_channel_coalesce with unconfigured datafd/channel\n");
+
+	channel = 10;
+
+	if ((!knet_handle_set_channel_coalesce(knet_h, channel, 1000)) || (errno != EINVAL)) {
+		printf("knet_handle_set_channel_coalesce accepted unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_set_channel_coalesce with invalid max_delay\n");
+
+	if ((!knet_handle_set_channel_coalesce(knet_h, channel, KNET_COALESCE_MAX_DELAY + 1)) || (errno != EINVAL)) {
+		printf("knet_handle_set_channel_coalesce accepted invalid max_delay or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_channel_coalesce with valid data\n");
+
+	if (knet_handle_set_channel_coalesce(knet_h, channel, 100000) < 0) {
+		printf("knet_handle_set_channel_coalesce failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	for (i = 0; i < COALESCE_MSGS; i++) {
+		memset(send_buff, i, sizeof(send_buff));
+
+		send_len = knet_send(knet_h, send_buff, sizeof(send_buff), channel);
+		if (send_len != sizeof(send_buff)) {
+			printf("knet_send failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	for (i = 0; i < COALESCE_MSGS; i++) {
+		if (wait_for_packet(knet_h, 10, datafd)) {
+			printf("Error waiting for packet: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+		savederrno = errno;
+		if (recv_len != sizeof(send_buff)) {
+			printf("knet_recv received only %d bytes: %s (errno: %d)\n", recv_len, strerror(errno), errno);
+			test_cleanup(knet_h, logfds);
+			if ((is_helgrind()) && (recv_len == -1) && (savederrno == EAGAIN)) {
+				printf("helgrind exception. this is normal due to possible timeouts\n");
+				exit(PASS);
+			}
+			exit(FAIL);
+		}
+
+		memset(send_buff, i, sizeof(send_buff));
+
+		if (memcmp(recv_buff, send_buff, sizeof(send_buff))) {
+			printf("recv and send buffers are different for message %d!\n", i);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_get_stats(knet_h, &stats, sizeof(stats)) < 0) {
+		printf("knet_handle_get_stats failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * all messages have been sent within the coalesce delay,
+	 * so there must be fewer packets than messages on the wire
+	 */
+	if ((stats.tx_coalesced_msgs != COALESCE_MSGS) ||
+	    (stats.rx_coalesced_msgs != COALESCE_MSGS) ||
+	    (stats.tx_coalesced_packets >= COALESCE_MSGS) ||
+	    (stats.rx_coalesced_packets != stats.tx_coalesced_packets)) {
+		printf("stats look wrong: tx msgs: %" PRIu64 " tx packets: %" PRIu64 " rx msgs: %" PRIu64 " rx packets: %" PRIu64 "\n",
+		       stats.tx_coalesced_msgs, stats.tx_coalesced_packets,
+		       stats.rx_coalesced_msgs, stats.rx_coalesced_packets);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	knet_handle_set_mcast(knet_h, NULL, NULL, 0);
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct knet_handle_stats stats;
+	char send_buff[KNET_MAX_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len = 0;
+	int recv_len = 0;
+	int savederrno;
+	struct sockaddr_storage lo, mcast;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if ((make_local_sockaddr(&mcast, 1) < 0) ||
+	    (inet_pton(AF_INET, "239.255.42.1", &((struct sockaddr_in *)&mcast)->sin_addr) != 1)) {
+		printf("Unable to convert multicast group to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	memset(send_buff, 0, sizeof(send_buff));
+
+	printf("Test knet_handle_set_mcast incorrect knet_h\n");
+
+	if ((!knet_handle_set_mcast(NULL, &mcast, &lo, 1)) || (errno != EINVAL)) {
+		printf("knet_handle_set_mcast accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_set_mcast with non multicast address\n");
+
+	if ((!knet_handle_set_mcast(knet_h, &lo, &lo, 1)) || (errno != EINVAL)) {
+		printf("knet_handle_set_mcast accepted invalid mcast_addr or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_mcast with no src_addr\n");
+
+	if ((!knet_handle_set_mcast(knet_h, &mcast, NULL, 1)) || (errno != EINVAL)) {
+		printf("knet_handle_set_mcast accepted invalid src_addr or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_mcast with invalid ttl\n");
+
+	if ((!knet_handle_set_mcast(knet_h, &mcast, &lo, 0)) || (errno != EINVAL)) {
+		printf("knet_handle_set_mcast accepted invalid ttl or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_handle_set_mcast with valid data\n");
+
+	if (knet_handle_set_mcast(knet_h, &mcast, &lo, 1) < 0) {
+		printf("Unable to join multicast group on loopback: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(SKIP);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test broadcast data delivery with multicast enabled\n");
+
+	send_len = knet_send(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (send_len != sizeof(send_buff)) {
+		printf("knet_send failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_packet(knet_h, 10, datafd)) {
+		printf("Error waiting for packet: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+	savederrno = errno;
+	if (recv_len != send_len) {
+		printf("knet_recv received only %d bytes: %s (errno: %d)\n", recv_len, strerror(errno), errno);
+		test_cleanup(knet_h, logfds);
+		if ((is_helgrind()) && (recv_len == -1) && (savederrno == EAGAIN)) {
+			printf("helgrind exception. this is normal due to possible timeouts\n");
+			exit(PASS);
+		}
+		exit(FAIL);
+	}
+
+	if (memcmp(recv_buff, send_buff, KNET_MAX_PACKET_SIZE)) {
+		printf("recv and send buffers are different!\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_get_stats(knet_h, &stats, sizeof(stats)) < 0) {
+		printf("knet_handle_get_stats failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * the local host is served by its link, our own
+	 * packets sent to the group must be dropped
+	 */
+	if ((!stats.tx_mcast_packets) || (stats.rx_mcast_packets)) {
+		printf("multicast stats look wrong: tx_mcast_packets: %" PRIu64 " rx_mcast_packets: %" PRIu64 "\n",
+		       stats.tx_mcast_packets, stats.rx_mcast_packets);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_mcast disable\n");
+
+	if (knet_handle_set_mcast(knet_h, NULL, NULL, 0) < 0) {
+		printf("knet_handle_set_mcast failed to disable multicast: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->mcast_addr.ss_family) {
+		printf("knet_handle_set_mcast did not disable multicast\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "onwire.h"
+#include "test-common.h"
+
+static int peerfd[2] = { -1, -1 };
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct knet_host *host;
+
+	printf("Test knet_handle_set_relay with invalid knet_h\n");
+
+	if ((!knet_handle_set_relay(NULL, 0)) || (errno != EINVAL)) {
+		printf("knet_handle_set_relay accepted invalid knet_h parameter\n");
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_handle_set_relay with invalid param (2)\n");
+
+	if ((!knet_handle_set_relay(knet_h, 2)) || (errno != EINVAL)) {
+		printf("knet_handle_set_relay accepted invalid param for enabled: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_relay with valid param (1)\n");
+
+	if (knet_handle_set_relay(knet_h, 1) < 0) {
+		printf("knet_handle_set_relay failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->relay_enabled != 1) {
+		printf("knet_handle_set_relay failed to set correct value\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_handle_set_relay (0) drops relay routes\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * fake a link table and a route received from the network
+	 */
+	host = knet_h->host_index[1];
+	host->relay_table = malloc(sizeof(struct knet_relay_entry));
+	if (!host->relay_table) {
+		printf("Unable to allocate memory for link table\n");
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+	host->relay_table[0].node_id = knet_h->host_id;
+	host->relay_table[0].latency = 1000;
+	host->relay_table_entries = 1;
+	host->relay_via = knet_h->host_id;
+	host->relay_valid = 1;
+
+	if (knet_handle_set_relay(knet_h, 0) < 0) {
+		printf("knet_handle_set_relay failed: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_h->relay_enabled != 0) ||
+	    (host->relay_valid) || (host->relay_table) || (host->relay_table_entries)) {
+		printf("knet_handle_set_relay failed to clear relay routes\n");
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static void forward_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (peerfd[i] >= 0) {
+			close(peerfd[i]);
+		}
+	}
+
+	for (i = 2; i <= 3; i++) {
+		knet_link_set_enable(knet_h, i, 0, 0);
+		knet_link_clear_config(knet_h, i, 0);
+		knet_host_remove(knet_h, i);
+	}
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+/*
+ * a relayed packet for host 3 claiming to come from host 2,
+ * sent from peerfd[idx]
+ */
+static int send_relayed(int idx, struct sockaddr_storage *lo)
+{
+	unsigned char buf[KNET_RELAY_HEADER_SIZE + 64];
+	struct knet_relay_header *relay_header = (struct knet_relay_header *)buf;
+
+	memset(buf, 0xaa, sizeof(buf));
+	relay_header->krh_magic = htonl(KNET_RELAY_MAGIC);
+	relay_header->krh_src_node = htons(2);
+	relay_header->krh_dst_node = htons(3);
+
+	if (sendto(peerfd[idx], buf, sizeof(buf), 0, (struct sockaddr *)lo, sizeof(struct sockaddr_in)) != sizeof(buf)) {
+		printf("Unable to send relayed packet: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * nobody answers the pings of host 3, pretend its link is up
+ */
+static void fake_link_up(knet_handle_t knet_h)
+{
+	pthread_rwlock_wrlock(&knet_h->global_rwlock);
+	knet_h->host_index[3]->active_links[0] = 0;
+	knet_h->host_index[3]->active_link_entries = 1;
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+}
+
+/*
+ * wait for the relay counters to move, returns 0 if they did
+ */
+static int wait_relay_stats(knet_handle_t knet_h, struct knet_handle_stats *before, struct knet_handle_stats *after)
+{
+	int i;
+
+	for (i = 0; i < 500; i++) {
+		if (knet_handle_get_stats(knet_h, after, sizeof(struct knet_handle_stats)) < 0) {
+			printf("knet_handle_get_stats failed: %s\n", strerror(errno));
+			return -1;
+		}
+		if ((after->fwd_relay_drops != before->fwd_relay_drops) ||
+		    (after->fwd_relay_packets != before->fwd_relay_packets)) {
+			return 0;
+		}
+		usleep(10000);
+	}
+
+	return -1;
+}
+
+static void test_forward(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct sockaddr_storage lo[4];
+	struct knet_handle_stats before, after;
+	struct knet_relay_header *relay_header;
+	unsigned char recv_buff[KNET_MAX_PACKET_SIZE];
+	struct pollfd pfd;
+	ssize_t recv_len;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if (make_local_sockaddr(&lo[i], i) < 0) {
+			printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+			exit(FAIL);
+		}
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test relayed packets are forwarded only from links of the source host\n");
+
+	/*
+	 * peerfd[0] is an unknown address, peerfd[1] is where host 3
+	 * lives and receives what we forward. Host 2 is at lo[3].
+	 */
+	for (i = 0; i < 2; i++) {
+		peerfd[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if ((peerfd[i] < 0) ||
+		    (bind(peerfd[i], (struct sockaddr *)&lo[i + 1], sizeof(struct sockaddr_in)) < 0)) {
+			printf("Unable to create peer socket: %s\n", strerror(errno));
+			forward_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if ((knet_handle_set_relay(knet_h, 1) < 0) ||
+	    (knet_host_add(knet_h, 2) < 0) ||
+	    (knet_host_add(knet_h, 3) < 0) ||
+	    (knet_link_set_config(knet_h, 2, 0, KNET_TRANSPORT_UDP, &lo[0], &lo[3], 0) < 0) ||
+	    (knet_link_set_config(knet_h, 3, 0, KNET_TRANSPORT_UDP, &lo[0], &lo[2], 0) < 0) ||
+	    (knet_link_set_enable(knet_h, 2, 0, 1) < 0) ||
+	    (knet_link_set_enable(knet_h, 3, 0, 1) < 0)) {
+		printf("Unable to configure hosts: %s\n", strerror(errno));
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * let the dst cache process the new links before faking one up
+	 */
+	sleep(1);
+
+	if (knet_handle_get_stats(knet_h, &before, sizeof(struct knet_handle_stats)) < 0) {
+		printf("knet_handle_get_stats failed: %s\n", strerror(errno));
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	fake_link_up(knet_h);
+
+	if ((send_relayed(0, &lo[0]) < 0) ||
+	    (wait_relay_stats(knet_h, &before, &after) < 0)) {
+		printf("relayed packet from an unknown address has not been processed\n");
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((after.fwd_relay_drops != before.fwd_relay_drops + 1) ||
+	    (after.fwd_relay_packets != before.fwd_relay_packets)) {
+		printf("relayed packet from an unknown address has been forwarded\n");
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test relayed packets from a link of the source host are forwarded\n");
+
+	/*
+	 * host 2 is lo[3], send from there
+	 */
+	close(peerfd[0]);
+	peerfd[0] = socket(AF_INET, SOCK_DGRAM, 0);
+	if ((peerfd[0] < 0) ||
+	    (bind(peerfd[0], (struct sockaddr *)&lo[3], sizeof(struct sockaddr_in)) < 0)) {
+		printf("Unable to create peer socket: %s\n", strerror(errno));
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	memmove(&before, &after, sizeof(struct knet_handle_stats));
+
+	fake_link_up(knet_h);
+
+	if ((send_relayed(0, &lo[0]) < 0) ||
+	    (wait_relay_stats(knet_h, &before, &after) < 0)) {
+		printf("relayed packet from host 2 has not been processed\n");
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((after.fwd_relay_packets != before.fwd_relay_packets + 1) ||
+	    (after.fwd_relay_drops != before.fwd_relay_drops)) {
+		printf("relayed packet from host 2 has not been forwarded\n");
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * skip the pings sent to host 3
+	 */
+	pfd.fd = peerfd[1];
+	pfd.events = POLLIN;
+	recv_len = 0;
+	while (poll(&pfd, 1, 1000) > 0) {
+		recv_len = recv(peerfd[1], recv_buff, sizeof(recv_buff), 0);
+		relay_header = (struct knet_relay_header *)recv_buff;
+		if ((recv_len == KNET_RELAY_HEADER_SIZE + 64) &&
+		    (ntohl(relay_header->krh_magic) == KNET_RELAY_MAGIC)) {
+			break;
+		}
+		recv_len = 0;
+	}
+
+	if (!recv_len) {
+		printf("host 3 did not receive the relayed packet\n");
+		forward_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	forward_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+	test_forward();
+
+	return PASS;
+}
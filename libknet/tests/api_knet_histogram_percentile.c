@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "test-common.h"
+
+static struct knet_histogram histogram;
+
+static void test(void)
+{
+	uint64_t value;
+	int i;
+
+	printf("Test knet_histogram_percentile with NULL histogram\n");
+
+	if ((knet_histogram_percentile(NULL, 50) != 0) || (errno != EINVAL)) {
+		printf("knet_histogram_percentile accepted invalid histogram or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_histogram_percentile with invalid percentile\n");
+
+	if ((knet_histogram_percentile(&histogram, 100.1) != 0) || (errno != EINVAL)) {
+		printf("knet_histogram_percentile accepted invalid percentile or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_histogram_percentile with empty histogram\n");
+
+	if ((knet_histogram_percentile(&histogram, 50) != 0) || (errno != 0)) {
+		printf("knet_histogram_percentile returned data from an empty histogram: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_histogram_percentile with exact values\n");
+
+	/*
+	 * values 0 - 15 once each
+	 */
+	for (i = 0; i < KNET_HISTOGRAM_SUB_BUCKETS; i++) {
+		histogram.buckets[i] = 1;
+	}
+	histogram.count = KNET_HISTOGRAM_SUB_BUCKETS;
+	histogram.min = 0;
+	histogram.max = KNET_HISTOGRAM_SUB_BUCKETS - 1;
+
+	value = knet_histogram_percentile(&histogram, 50);
+	if (value != 7) {
+		printf("knet_histogram_percentile returned p50 %llu (expected 7)\n", (unsigned long long)value);
+		exit(FAIL);
+	}
+
+	value = knet_histogram_percentile(&histogram, 100);
+	if (value != 15) {
+		printf("knet_histogram_percentile returned p100 %llu (expected 15)\n", (unsigned long long)value);
+		exit(FAIL);
+	}
+
+	printf("Test knet_histogram_percentile with a tail value\n");
+
+	/*
+	 * 1000 lands in the bucket covering 992 - 1023 (shift 5, sub bucket 15)
+	 */
+	histogram.buckets[(6 * KNET_HISTOGRAM_SUB_BUCKETS) + 15] = 1;
+	histogram.count++;
+	histogram.max = 1000;
+
+	value = knet_histogram_percentile(&histogram, 99.9);
+	if (value != 1000) {
+		printf("knet_histogram_percentile returned p999 %llu (expected 1000)\n", (unsigned long long)value);
+		exit(FAIL);
+	}
+
+	value = knet_histogram_percentile(&histogram, 50);
+	if (value != 8) {
+		printf("knet_histogram_percentile returned p50 %llu (expected 8)\n", (unsigned long long)value);
+		exit(FAIL);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
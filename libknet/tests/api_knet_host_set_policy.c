@@ -51,7 +51,7 @@ static void test(void)
 
 	printf("Test knet_host_set_policy incorrect policy\n");
 
-	if ((!knet_host_set_policy(knet_h, 1, KNET_LINK_POLICY_RR + 1)) || (errno != EINVAL)) {
+	if ((!knet_host_set_policy(knet_h, 1, KNET_LINK_POLICY_FEC + 1)) || (errno != EINVAL)) {
 		printf("knet_host_set_policy accepted invalid policy or returned incorrect error: %s\n", strerror(errno));
 		knet_handle_free(knet_h);
 		flush_logs(logfds[0], stdout);
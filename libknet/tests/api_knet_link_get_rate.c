@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "link.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct sockaddr_storage src, dst;
+	uint64_t rate = 0;
+	uint32_t burst = 0;
+
+	if (make_local_sockaddr(&src, 0) < 0) {
+		printf("Unable to convert src to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if (make_local_sockaddr(&dst, 1) < 0) {
+		printf("Unable to convert dst to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_link_get_rate incorrect knet_h\n");
+
+	if ((!knet_link_get_rate(NULL, 1, 0, &rate, &burst)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_link_get_rate with unconfigured host_id\n");
+
+	if ((!knet_link_get_rate(knet_h, 1, 0, &rate, &burst)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted invalid host_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_get_rate with incorrect linkid\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("Unable to add host_id 1: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_link_get_rate(knet_h, 1, KNET_MAX_LINK, &rate, &burst)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted invalid linkid or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_get_rate with unconfigured link\n");
+
+	if ((!knet_link_get_rate(knet_h, 1, 0, &rate, &burst)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted unconfigured link or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_get_rate with incorrect rate\n");
+
+	if ((!knet_link_get_rate(knet_h, 1, 0, NULL, &burst)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted incorrect rate or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_get_rate with incorrect burst\n");
+
+	if ((!knet_link_get_rate(knet_h, 1, 0, &rate, NULL)) || (errno != EINVAL)) {
+		printf("knet_link_get_rate accepted incorrect burst or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_get_rate with correct values\n");
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &src, &dst, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_get_rate(knet_h, 1, 0, &rate, &burst) < 0) {
+		printf("knet_link_get_rate failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((rate != 0) || (burst != 0)) {
+		printf("knet_link_get_rate failed to get default values\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_rate(knet_h, 1, 0, 1000000, 65536) < 0) {
+		printf("knet_link_set_rate failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_get_rate(knet_h, 1, 0, &rate, &burst) < 0) {
+		printf("knet_link_get_rate failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((rate != 1000000) || (burst != 65536)) {
+		printf("knet_link_get_rate failed to get correct values\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
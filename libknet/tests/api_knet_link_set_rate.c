@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "threads_common.h"
+#include "netutils.h"
+#include "test-common.h"
+
+#define PACING_RATE 1000000
+#define PACING_BURST 65536
+#define PACING_MSGS 40
+#define PACING_MSG_SIZE 50000
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct sockaddr_storage lo;
+	int datafd = 0;
+	int8_t channel = 0;
+	char send_buff[PACING_MSG_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len = 0;
+	int recv_len = 0;
+	int savederrno;
+	int i;
+	struct timespec clock_start, clock_end;
+	unsigned long long time_diff = 0;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_link_set_rate incorrect knet_h\n");
+
+	if ((!knet_link_set_rate(NULL, 1, 0, 1000000, 65536)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_link_set_rate with unconfigured host_id\n");
+
+	if ((!knet_link_set_rate(knet_h, 1, 0, 1000000, 65536)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted invalid host_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_rate with incorrect linkid\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("Unable to add host_id 1: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_link_set_rate(knet_h, 1, KNET_MAX_LINK, 1000000, 65536)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted invalid linkid or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_rate with unconfigured link\n");
+
+	if ((!knet_link_set_rate(knet_h, 1, 0, 1000000, 65536)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted unconfigured link or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_link_set_rate with incorrect burst\n");
+
+	if ((!knet_link_set_rate(knet_h, 1, 0, 1000000, 0)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted invalid burst or returned incorrect error: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_rate with TX queue disabled\n");
+
+	if (knet_link_set_tx_queue(knet_h, 1, 0, 0, KNET_LINK_TXQ_POLICY_BACKPRESSURE) < 0) {
+		printf("knet_link_set_tx_queue failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_link_set_rate(knet_h, 1, 0, PACING_RATE, PACING_BURST)) || (errno != EINVAL)) {
+		printf("knet_link_set_rate accepted a link without TX queue or returned incorrect error: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_tx_queue(knet_h, 1, 0, KNET_LINK_TXQ_DEFAULT_LEN, KNET_LINK_TXQ_POLICY_BACKPRESSURE) < 0) {
+		printf("knet_link_set_tx_queue failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_rate with correct values\n");
+
+	if (knet_link_set_rate(knet_h, 1, 0, PACING_RATE, PACING_BURST) < 0) {
+		printf("knet_link_set_rate failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_h->host_index[1]->link[0].rate != PACING_RATE) ||
+	    (knet_h->host_index[1]->link[0].burst != PACING_BURST)) {
+		printf("knet_link_set_rate failed to set correct values\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue disabling the queue of a paced link\n");
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, 0, 0, KNET_LINK_TXQ_POLICY_BACKPRESSURE)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue disabled the queue of a paced link or returned incorrect error: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test data delivery on a paced link\n");
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	memset(send_buff, 1, sizeof(send_buff));
+
+	clock_gettime(CLOCK_MONOTONIC, &clock_start);
+
+	for (i = 0; i < PACING_MSGS; i++) {
+		send_len = knet_send(knet_h, send_buff, sizeof(send_buff), channel);
+		if (send_len != sizeof(send_buff)) {
+			printf("knet_send failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	for (i = 0; i < PACING_MSGS; i++) {
+		if (wait_for_packet(knet_h, 10, datafd)) {
+			printf("Error waiting for packet: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+		savederrno = errno;
+		if (recv_len != sizeof(send_buff)) {
+			printf("knet_recv received only %d bytes: %s (errno: %d)\n", recv_len, strerror(errno), errno);
+			test_cleanup(knet_h, logfds);
+			if ((is_helgrind()) && (recv_len == -1) && (savederrno == EAGAIN)) {
+				printf("helgrind exception. this is normal due to possible timeouts\n");
+				exit(PASS);
+			}
+			exit(FAIL);
+		}
+
+		if (memcmp(recv_buff, send_buff, sizeof(send_buff))) {
+			printf("recv and send buffers are different for message %d!\n", i);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &clock_end);
+	timespec_diff(clock_start, clock_end, &time_diff);
+
+	flush_logs(logfds[0], stdout);
+
+	/*
+	 * PACING_MSGS * PACING_MSG_SIZE is twice the rate, minus the burst
+	 * it cannot take less than a second (allow some room for rounding)
+	 */
+	printf("Received %d messages in %llu msecs (paced: %" PRIu64 ")\n",
+	       PACING_MSGS, time_diff / 1000000llu,
+	       knet_h->host_index[1]->link[0].status.stats.tx_data_paced);
+
+	if ((time_diff < 900000000llu) ||
+	    (!knet_h->host_index[1]->link[0].status.stats.tx_data_paced)) {
+		printf("Data has not been paced\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
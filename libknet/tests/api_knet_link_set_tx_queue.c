@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "link.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	struct sockaddr_storage src, dst;
+
+	if (make_local_sockaddr(&src, 0) < 0) {
+		printf("Unable to convert src to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if (make_local_sockaddr(&dst, 1) < 0) {
+		printf("Unable to convert dst to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_link_set_tx_queue incorrect knet_h\n");
+
+	if ((!knet_link_set_tx_queue(NULL, 1, 0, 16, KNET_LINK_TXQ_POLICY_DROP)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_link_set_tx_queue with unconfigured host_id\n");
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, 0, 16, KNET_LINK_TXQ_POLICY_DROP)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted invalid host_id or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue with incorrect linkid\n");
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("Unable to add host_id 1: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, KNET_MAX_LINK, 16, KNET_LINK_TXQ_POLICY_DROP)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted invalid linkid or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue with unconfigured link\n");
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, 0, 16, KNET_LINK_TXQ_POLICY_DROP)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted unconfigured link or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &src, &dst, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test knet_link_set_tx_queue with incorrect queue_len\n");
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, 0, KNET_LINK_TXQ_MAX_LEN + 1, KNET_LINK_TXQ_POLICY_DROP)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted invalid queue_len or returned incorrect error: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue with incorrect policy\n");
+
+	if ((!knet_link_set_tx_queue(knet_h, 1, 0, 16, KNET_LINK_TXQ_POLICY_DROP + 1)) || (errno != EINVAL)) {
+		printf("knet_link_set_tx_queue accepted invalid policy or returned incorrect error: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue with correct values\n");
+
+	if (knet_link_set_tx_queue(knet_h, 1, 0, 16, KNET_LINK_TXQ_POLICY_DROP) < 0) {
+		printf("knet_link_set_tx_queue failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_h->host_index[1]->link[0].txq_len != 16) ||
+	    (knet_h->host_index[1]->link[0].txq_policy != KNET_LINK_TXQ_POLICY_DROP)) {
+		printf("knet_link_set_tx_queue failed to set correct values\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_link_set_tx_queue disabling the queue\n");
+
+	if (knet_link_set_tx_queue(knet_h, 1, 0, 0, KNET_LINK_TXQ_POLICY_BACKPRESSURE) < 0) {
+		printf("knet_link_set_tx_queue failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_h->host_index[1]->link[0].txq_len != 0) ||
+	    (knet_h->host_index[1]->link[0].txq_policy != KNET_LINK_TXQ_POLICY_BACKPRESSURE) ||
+	    (knet_h->txq_blocked != 0)) {
+		printf("knet_link_set_tx_queue failed to set correct values\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
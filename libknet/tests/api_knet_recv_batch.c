@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+#define MSGS 8
+#define HALF 512
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	char buff[MSGS][HALF * 2];
+	struct iovec iov[MSGS][2];
+	struct knet_msg msgs[MSGS];
+	int i, err;
+	char send_buff[HALF * 2];
+	struct iovec iov_out[1];
+
+	for (i = 0; i < MSGS; i++) {
+		iov[i][0].iov_base = (void *)buff[i];
+		iov[i][0].iov_len = HALF;
+		iov[i][1].iov_base = (void *)(buff[i] + HALF);
+		iov[i][1].iov_len = HALF;
+		msgs[i].iov = iov[i];
+		msgs[i].iovlen = 2;
+	}
+
+	printf("Test knet_recv_batch incorrect knet_h\n");
+
+	if ((knet_recv_batch(NULL, msgs, MSGS, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_recv_batch with no msgs\n");
+
+	if ((knet_recv_batch(knet_h, NULL, MSGS, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid msgs or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with invalid msgs_entries (0)\n");
+
+	if ((knet_recv_batch(knet_h, msgs, 0, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid msgs_entries (0) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with invalid msgs_entries (> KNET_MAX_BATCH)\n");
+
+	if ((knet_recv_batch(knet_h, msgs, KNET_MAX_BATCH + 1, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid msgs_entries (> KNET_MAX_BATCH) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with invalid msg length (0)\n");
+
+	msgs[1].iov[0].iov_len = 0;
+	msgs[1].iov[1].iov_len = 0;
+
+	if ((knet_recv_batch(knet_h, msgs, MSGS, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid msg length (0) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	msgs[1].iov[0].iov_len = HALF;
+	msgs[1].iov[1].iov_len = HALF;
+
+	printf("Test knet_recv_batch with invalid channel (-1)\n");
+
+	if ((knet_recv_batch(knet_h, msgs, MSGS, -1) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid channel (-1) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with invalid channel (KNET_DATAFD_MAX)\n");
+
+	if ((knet_recv_batch(knet_h, msgs, MSGS, KNET_DATAFD_MAX) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid channel (KNET_DATAFD_MAX) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with unconfigured channel\n");
+
+	if ((knet_recv_batch(knet_h, msgs, MSGS, channel) != -1) || (errno != EINVAL)) {
+		printf("knet_recv_batch accepted invalid unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with no data\n");
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_recv_batch(knet_h, msgs, MSGS, channel) != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+		printf("knet_recv_batch did not return EAGAIN on empty datafd: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_recv_batch with valid data\n");
+
+	for (i = 0; i < MSGS; i++) {
+		memset(send_buff, i, sizeof(send_buff));
+
+		iov_out[0].iov_base = (void *)send_buff;
+		iov_out[0].iov_len = sizeof(send_buff) - i;
+
+		if (writev(knet_h->sockfd[channel].sockfd[1], iov_out, 1) != (ssize_t)(sizeof(send_buff) - i)) {
+			printf("Unable to write data: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+	}
+
+	err = knet_recv_batch(knet_h, msgs, MSGS, channel);
+	if (err != MSGS) {
+		printf("knet_recv_batch received only %d messages: %s\n", err, strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	for (i = 0; i < MSGS; i++) {
+		memset(send_buff, i, sizeof(send_buff));
+
+		if (msgs[i].len != sizeof(send_buff) - i) {
+			printf("knet_recv_batch received %zu bytes for message %d\n", msgs[i].len, i);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		if (memcmp(buff[i], send_buff, msgs[i].len)) {
+			printf("knet_recv_batch received bad data for message %d\n", i);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
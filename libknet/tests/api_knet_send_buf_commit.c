@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	char *buff = NULL;
+	size_t buff_len = 0;
+	char other_buff[KNET_MAX_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t recv_len = 0;
+	int i;
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	memset(other_buff, 0, sizeof(other_buff));
+
+	printf("Test knet_send_buf_commit incorrect knet_h\n");
+
+	if ((!knet_send_buf_commit(NULL, other_buff, KNET_MAX_PACKET_SIZE, channel)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_send_buf_commit with no buff\n");
+
+	if ((!knet_send_buf_commit(knet_h, NULL, KNET_MAX_PACKET_SIZE, channel)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid buff or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with buff not reserved\n");
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, other_buff, KNET_MAX_PACKET_SIZE, channel)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted buff not reserved or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with invalid buff_len (0)\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, 0, channel)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid buff_len (0) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_release(knet_h, buff)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit did not give back the buffer on error\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with invalid buff_len (> KNET_MAX_PACKET_SIZE)\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE + 1, channel)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid buff_len (> KNET_MAX_PACKET_SIZE) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with invalid channel (KNET_DATAFD_MAX)\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE, KNET_DATAFD_MAX)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid channel (KNET_DATAFD_MAX) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with unconfigured channel\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE, channel + 1)) || (errno != EINVAL)) {
+		printf("knet_send_buf_commit accepted invalid unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with data forwarding disabled\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE, channel)) || (errno != ECANCELED)) {
+		printf("knet_send_buf_commit didn't detect datafwd disabled or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_commit with host down\n");
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE, channel)) || (errno != EHOSTDOWN)) {
+		printf("knet_send_buf_commit didn't detect hostdown or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	/*
+	 * send a few packets to cycle buffers between the pool
+	 * and the TX path
+	 */
+	for (i = 0; i < KNET_SEND_BUFS + 2; i++) {
+		printf("Test knet_send_buf_commit with valid data (%d)\n", i);
+
+		if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+			printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+			knet_link_set_enable(knet_h, 1, 0, 0);
+			knet_link_clear_config(knet_h, 1, 0);
+			knet_host_remove(knet_h, 1);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		memset(buff, i, KNET_MAX_PACKET_SIZE);
+
+		if (knet_send_buf_commit(knet_h, buff, KNET_MAX_PACKET_SIZE, channel) < 0) {
+			printf("knet_send_buf_commit failed: %s\n", strerror(errno));
+			knet_link_set_enable(knet_h, 1, 0, 0);
+			knet_link_clear_config(knet_h, 1, 0);
+			knet_host_remove(knet_h, 1);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		if (wait_for_packet(knet_h, 10, datafd)) {
+			printf("Error waiting for packet: %s\n", strerror(errno));
+			knet_link_set_enable(knet_h, 1, 0, 0);
+			knet_link_clear_config(knet_h, 1, 0);
+			knet_host_remove(knet_h, 1);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+		if (recv_len != KNET_MAX_PACKET_SIZE) {
+			printf("knet_recv received only %zd bytes: %s\n", recv_len, strerror(errno));
+			knet_link_set_enable(knet_h, 1, 0, 0);
+			knet_link_clear_config(knet_h, 1, 0);
+			knet_host_remove(knet_h, 1);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		memset(other_buff, i, KNET_MAX_PACKET_SIZE);
+
+		if (memcmp(recv_buff, other_buff, KNET_MAX_PACKET_SIZE)) {
+			printf("recv and send buffers are different!\n");
+			knet_link_set_enable(knet_h, 1, 0, 0);
+			knet_link_clear_config(knet_h, 1, 0);
+			knet_host_remove(knet_h, 1);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		flush_logs(logfds[0], stdout);
+	}
+
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
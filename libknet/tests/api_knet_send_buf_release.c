@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	char *buff = NULL;
+	char other_buff[KNET_MAX_PACKET_SIZE];
+	size_t buff_len = 0;
+
+	printf("Test knet_send_buf_release incorrect knet_h\n");
+
+	if ((!knet_send_buf_release(NULL, other_buff)) || (errno != EINVAL)) {
+		printf("knet_send_buf_release accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_send_buf_release with no buff\n");
+
+	if ((!knet_send_buf_release(knet_h, NULL)) || (errno != EINVAL)) {
+		printf("knet_send_buf_release accepted invalid buff or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_release with buff not reserved\n");
+
+	if ((!knet_send_buf_release(knet_h, other_buff)) || (errno != EINVAL)) {
+		printf("knet_send_buf_release accepted buff not reserved or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_release with valid data\n");
+
+	if (knet_send_buf_reserve(knet_h, &buff, &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_send_buf_release(knet_h, buff) < 0) {
+		printf("knet_send_buf_release failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_release with buff already released\n");
+
+	if ((!knet_send_buf_release(knet_h, buff)) || (errno != EINVAL)) {
+		printf("knet_send_buf_release accepted double release or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	char *buff[KNET_SEND_BUFS];
+	char *extra_buff;
+	size_t buff_len = 0;
+	int i;
+
+	printf("Test knet_send_buf_reserve incorrect knet_h\n");
+
+	if ((!knet_send_buf_reserve(NULL, &buff[0], &buff_len)) || (errno != EINVAL)) {
+		printf("knet_send_buf_reserve accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_send_buf_reserve with no buff\n");
+
+	if ((!knet_send_buf_reserve(knet_h, NULL, &buff_len)) || (errno != EINVAL)) {
+		printf("knet_send_buf_reserve accepted invalid buff or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_reserve with no buff_len\n");
+
+	if ((!knet_send_buf_reserve(knet_h, &buff[0], NULL)) || (errno != EINVAL)) {
+		printf("knet_send_buf_reserve accepted invalid buff_len or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_reserve with valid data\n");
+
+	for (i = 0; i < KNET_SEND_BUFS; i++) {
+		if (knet_send_buf_reserve(knet_h, &buff[i], &buff_len) < 0) {
+			printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		if (buff_len != KNET_MAX_PACKET_SIZE) {
+			printf("knet_send_buf_reserve returned incorrect buff_len: %zu\n", buff_len);
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+
+		/*
+		 * make sure the whole buffer is writable
+		 */
+		memset(buff[i], i, buff_len);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_reserve with all buffers reserved\n");
+
+	if ((!knet_send_buf_reserve(knet_h, &extra_buff, &buff_len)) || (errno != EBUSY)) {
+		printf("knet_send_buf_reserve accepted too many reservations or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_buf_reserve after release\n");
+
+	if (knet_send_buf_release(knet_h, buff[0]) < 0) {
+		printf("knet_send_buf_release failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_send_buf_reserve(knet_h, &buff[0], &buff_len) < 0) {
+		printf("knet_send_buf_reserve failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	for (i = 0; i < KNET_SEND_BUFS; i++) {
+		knet_send_buf_release(knet_h, buff[i]);
+	}
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2016-2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+static int sinkfd = -1;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	if (sinkfd >= 0) {
+		close(sinkfd);
+	}
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_link_set_enable(knet_h, 1, 1, 0);
+	knet_link_clear_config(knet_h, 1, 1);
+	knet_link_set_enable(knet_h, 1, 2, 0);
+	knet_link_clear_config(knet_h, 1, 2);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct knet_link_status link_status;
+	char send_buff[KNET_MAX_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len = 0;
+	int recv_len = 0;
+	int savederrno;
+	int i;
+	uint8_t link_id, lost_link_id;
+	struct sockaddr_storage lo0, lo1, lo2, lo3;
+	struct pollfd pfd;
+	struct knet_header *sink_hdr;
+	int sink_frags = 0;
+
+	if (make_local_sockaddr(&lo0, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if (make_local_sockaddr(&lo1, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if (make_local_sockaddr(&lo2, 2) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	if (make_local_sockaddr(&lo3, 3) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	for (i = 0; i < KNET_MAX_PACKET_SIZE; i++) {
+		send_buff[i] = i % 251;
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send with FEC policy and valid data\n");
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+        }
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_set_policy(knet_h, 1, KNET_LINK_POLICY_FEC) < 0) {
+		printf("knet_host_set_policy failed: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo0, &lo0, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 1, KNET_TRANSPORT_UDP, &lo1, &lo1, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 2, KNET_TRANSPORT_UDP, &lo2, &lo2, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_link_set_enable(knet_h, 1, 0, 1) < 0) ||
+	    (knet_link_set_enable(knet_h, 1, 1, 1) < 0) ||
+	    (knet_link_set_enable(knet_h, 1, 2, 1) < 0)) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * wait for all links to be used
+	 */
+	for (i = 0; i < 100; i++) {
+		if (knet_h->host_index[1]->active_link_entries == 3) {
+			break;
+		}
+		usleep(100000);
+	}
+
+	send_len = knet_send(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (send_len <= 0) {
+		printf("knet_send failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (send_len != sizeof(send_buff)) {
+		printf("knet_send sent only %zd bytes: %s\n", send_len, strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (wait_for_packet(knet_h, 10, datafd)) {
+		printf("Error waiting for packet: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+	savederrno = errno;
+	if (recv_len != send_len) {
+		printf("knet_recv received only %d bytes: %s (errno: %d)\n", recv_len, strerror(errno), errno);
+		test_cleanup(knet_h, logfds);
+		if ((is_helgrind()) && (recv_len == -1) && (savederrno == EAGAIN)) {
+			printf("helgrind exception. this is normal due to possible timeouts\n");
+			exit(PASS);
+		}
+		exit(FAIL);
+	}
+
+	if (memcmp(recv_buff, send_buff, KNET_MAX_PACKET_SIZE)) {
+		printf("recv and send buffers are different!\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/* A sanity check on the stats, fragments should be spread across links */
+	for (link_id = 0; link_id < 3; link_id++) {
+		if (knet_link_get_status(knet_h, 1, link_id, &link_status, sizeof(link_status)) < 0) {
+			printf("knet_link_get_status failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if ((knet_h->host_index[1]->active_link_entries == 3) &&
+		    ((link_status.stats.tx_data_packets == 0) ||
+		     (link_status.stats.tx_data_bytes >= KNET_MAX_PACKET_SIZE * 2))) {
+			printf("stats look wrong for link %u: tx_packets: %" PRIu64 " (%" PRIu64 " bytes)\n",
+			       link_id,
+			       link_status.stats.tx_data_packets,
+			       link_status.stats.tx_data_bytes);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send with FEC policy and one link dropping all fragments\n");
+
+	if (knet_h->host_index[1]->active_link_entries < 2) {
+		printf("FEC recovery needs at least 2 active links, got %u\n", knet_h->host_index[1]->active_link_entries);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * the link still looks healthy to the TX thread, but everything
+	 * it sends ends up in sinkfd instead of the receiving socket
+	 * (until the missing pongs take the link down)
+	 */
+	sinkfd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sinkfd < 0) {
+		printf("Unable to create sink socket: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (bind(sinkfd, (struct sockaddr *)&lo3, sizeof(struct sockaddr_in)) < 0) {
+		printf("Unable to bind sink socket: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	lost_link_id = knet_h->host_index[1]->active_links[0];
+
+	pthread_rwlock_wrlock(&knet_h->global_rwlock);
+	memmove(&knet_h->host_index[1]->link[lost_link_id].dst_addr, &lo3, sizeof(struct sockaddr_storage));
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	for (i = 0; i < KNET_MAX_PACKET_SIZE; i++) {
+		send_buff[i] = (i * 7) % 253;
+	}
+
+	send_len = knet_send(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (send_len != sizeof(send_buff)) {
+		printf("knet_send failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_packet(knet_h, 10, datafd)) {
+		printf("Error waiting for packet: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+	savederrno = errno;
+	if (recv_len != send_len) {
+		printf("knet_recv received only %d bytes: %s (errno: %d)\n", recv_len, strerror(errno), errno);
+		test_cleanup(knet_h, logfds);
+		if ((is_helgrind()) && (recv_len == -1) && (savederrno == EAGAIN)) {
+			printf("helgrind exception. this is normal due to possible timeouts\n");
+			exit(PASS);
+		}
+		exit(FAIL);
+	}
+
+	if (memcmp(recv_buff, send_buff, KNET_MAX_PACKET_SIZE)) {
+		printf("recv and send buffers are different after FEC recovery!\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * make sure the link really lost data fragments of that packet
+	 * (not only parity), pings can land in the sink too, skip them
+	 */
+	pfd.fd = sinkfd;
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, 100) > 0) {
+		recv_len = recv(sinkfd, recv_buff, KNET_MAX_PACKET_SIZE, 0);
+		if (recv_len < (int)KNET_HEADER_DATA_SIZE) {
+			continue;
+		}
+		sink_hdr = (struct knet_header *)recv_buff;
+		if ((sink_hdr->kh_type == KNET_HEADER_TYPE_DATA) &&
+		    (sink_hdr->khp_data_frag_num > 1) &&
+		    (sink_hdr->khp_data_frag_seq <= sink_hdr->khp_data_frag_num)) {
+			sink_frags++;
+		}
+	}
+
+	if (!sink_frags) {
+		printf("No data fragments have been dropped on link %u, FEC recovery not exercised\n", lost_link_id);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	printf("Recovered packet with %d data fragments dropped on link %u\n", sink_frags, lost_link_id);
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
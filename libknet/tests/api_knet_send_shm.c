@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "transport_shm.h"
+#include "test-common.h"
+
+#ifdef KNET_HAVE_SHM
+
+/*
+ * two handles in the same process, node 1 has the lower address
+ * and connects to node 2
+ */
+
+#define SHM_PACKET_SIZE 8000
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t *knet_h, int *logfds)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!knet_h[i]) {
+			continue;
+		}
+		knet_link_set_enable(knet_h[i], 2 - i, 0, 0);
+		knet_link_clear_config(knet_h[i], 2 - i, 0);
+		knet_host_remove(knet_h[i], 2 - i);
+		knet_handle_free(knet_h[i]);
+	}
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static int start_link(knet_handle_t knet_h, int idx)
+{
+	knet_node_id_t peer = 2 - idx;
+	struct sockaddr_storage src, dst;
+
+	if ((make_local_sockaddr(&src, idx) < 0) ||
+	    (make_local_sockaddr(&dst, 1 - idx) < 0)) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (knet_link_set_config(knet_h, peer, 0, KNET_TRANSPORT_SHM, &src, &dst, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (knet_link_set_ping_timers(knet_h, peer, 0, 200, 1000, 2048) < 0) {
+		printf("knet_link_set_ping_timers failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, peer, 0);
+		return -1;
+	}
+
+	if (knet_link_set_enable(knet_h, peer, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, peer, 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+static knet_handle_t start_node(int idx, int *logfds, int *datafd, int8_t *channel)
+{
+	knet_handle_t knet_h;
+	knet_node_id_t peer = 2 - idx;
+
+	knet_h = knet_handle_new(idx + 1, logfds[1], KNET_LOG_DEBUG, 0);
+	if (!knet_h) {
+		printf("knet_handle_new failed: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	*datafd = 0;
+	*channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, datafd, channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if (knet_host_add(knet_h, peer) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if (start_link(knet_h, idx) < 0) {
+		knet_host_remove(knet_h, peer);
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, peer, 0, 0);
+		knet_link_clear_config(knet_h, peer, 0);
+		knet_host_remove(knet_h, peer);
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	return knet_h;
+}
+
+static int get_status(knet_handle_t knet_h, knet_node_id_t peer, struct knet_link_status *status)
+{
+	if (knet_link_get_status(knet_h, peer, 0, status, sizeof(struct knet_link_status)) < 0) {
+		printf("knet_link_get_status failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * data pckts do not carry the link id, the RX side accounts them
+ * to the link picked by the same header byte used by the pings.
+ * Add up all the links of the host.
+ */
+static void get_rx_data(knet_handle_t knet_h, knet_node_id_t peer, uint64_t *packets, uint64_t *bytes)
+{
+	struct knet_host *host = knet_h->host_index[peer];
+	int i;
+
+	*packets = 0;
+	*bytes = 0;
+
+	for (i = 0; i < KNET_MAX_LINK; i++) {
+		*packets += host->link[i].status.stats.rx_data_packets;
+		*bytes += host->link[i].status.stats.rx_data_bytes;
+	}
+}
+
+/*
+ * the sequence number first, so that reordering or a packet
+ * that has been overwritten in the ring are both caught
+ */
+static void fill_packet(char *buf, uint32_t seq)
+{
+	memset(buf, seq & 0xff, SHM_PACKET_SIZE);
+	memmove(buf, &seq, sizeof(seq));
+}
+
+static int recv_packets(knet_handle_t knet_h, int datafd, int8_t channel, uint32_t count, int logfd)
+{
+	char send_buff[SHM_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t recv_len;
+	uint32_t seq;
+
+	for (seq = 0; seq < count; seq++) {
+		if (wait_for_packet(knet_h, 10, datafd)) {
+			printf("Error waiting for packet %u: %s\n", seq, strerror(errno));
+			flush_logs(logfd, stdout);
+			return -1;
+		}
+
+		recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+		fill_packet(send_buff, seq);
+		if ((recv_len != SHM_PACKET_SIZE) ||
+		    (memcmp(recv_buff, send_buff, SHM_PACKET_SIZE))) {
+			printf("knet_recv received wrong data for packet %u (%zd bytes): %s\n", seq, recv_len, strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h[2] = { NULL, NULL };
+	int logfds[2];
+	int datafd[2];
+	int8_t channel[2];
+	char send_buff[SHM_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	struct knet_link_status tx_before, tx_after, rx_after;
+	uint64_t rx_packets_before, rx_bytes_before, rx_packets_after, rx_bytes_after;
+	uint64_t back_packets_before, back_packets_after, back_bytes;
+	struct timespec deadline, now;
+	knet_node_id_t dst_host = 2;
+	uint32_t seq, count;
+	ssize_t send_len;
+	int recv_len;
+	int i, stalled;
+
+	if (knet_get_transport_id_by_name("SHM") != KNET_TRANSPORT_SHM) {
+		printf("SHM transport not built in, skipping test\n");
+		exit(SKIP);
+	}
+
+	setup_logpipes(logfds);
+
+	for (i = 0; i < 2; i++) {
+		knet_h[i] = start_node(i, logfds, &datafd[i], &channel[i]);
+		if (!knet_h[i]) {
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if ((wait_for_host(knet_h[0], 2, 10, logfds[0], stdout) < 0) ||
+	    (wait_for_host(knet_h[1], 1, 10, logfds[0], stdout) < 0)) {
+		printf("timeout waiting for hosts to be reachable\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test SHM ring wraparound\n");
+
+	if (get_status(knet_h[0], 2, &tx_before) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+	get_rx_data(knet_h[1], 1, &rx_packets_before, &rx_bytes_before);
+
+	/*
+	 * one packet at a time, the ring never fills up but
+	 * head and tail go around it three times
+	 */
+	count = (3 * KNET_SHM_RING_SIZE) / SHM_PACKET_SIZE;
+
+	for (seq = 0; seq < count; seq++) {
+		fill_packet(send_buff, seq);
+
+		if (knet_send_sync_to(knet_h[0], send_buff, SHM_PACKET_SIZE, channel[0], &dst_host, 1) < 0) {
+			printf("knet_send_sync_to failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if (wait_for_packet(knet_h[1], 10, datafd[1])) {
+			printf("Error waiting for packet %u: %s\n", seq, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h[1], recv_buff, KNET_MAX_PACKET_SIZE, channel[1]);
+		if ((recv_len != SHM_PACKET_SIZE) ||
+		    (memcmp(recv_buff, send_buff, SHM_PACKET_SIZE))) {
+			printf("knet_recv received wrong data for packet %u (%d bytes): %s\n", seq, recv_len, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if (get_status(knet_h[0], 2, &tx_after) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+	get_rx_data(knet_h[1], 1, &rx_packets_after, &rx_bytes_after);
+
+	if (tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes < 2 * KNET_SHM_RING_SIZE) {
+		printf("only %" PRIu64 " bytes went through the ring\n",
+		       tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((rx_packets_after - rx_packets_before !=
+	     tx_after.stats.tx_data_packets - tx_before.stats.tx_data_packets) ||
+	    (rx_bytes_after - rx_bytes_before !=
+	     tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes)) {
+		printf("stats look wrong: tx_packets: %" PRIu64 " (%" PRIu64 " bytes), rx_packets: %" PRIu64 " (%" PRIu64 " bytes)\n",
+		       tx_after.stats.tx_data_packets - tx_before.stats.tx_data_packets,
+		       tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes,
+		       rx_packets_after - rx_packets_before,
+		       rx_bytes_after - rx_bytes_before);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (tx_after.stats.tx_data_retries != tx_before.stats.tx_data_retries) {
+		printf("ring reported full while the peer was draining it\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test SHM full ring\n");
+
+	if (get_status(knet_h[0], 2, &tx_before) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+	get_rx_data(knet_h[1], 1, &rx_packets_before, &rx_bytes_before);
+
+	/*
+	 * stall the RX thread of node 2 and send until the TX
+	 * thread of node 1 finds the ring full and waits
+	 */
+	if (pthread_rwlock_wrlock(&knet_h[1]->global_rwlock) != 0) {
+		printf("Unable to stall the RX thread\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += 10;
+	stalled = 0;
+	seq = 0;
+
+	while (!stalled) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec > deadline.tv_sec) {
+			break;
+		}
+
+		/*
+		 * a few packets more than the ring can hold are enough,
+		 * everything sent here ends up in the datafd of node 2
+		 * at once and what does not fit in there is lost
+		 */
+		if (seq > (KNET_SHM_RING_SIZE / SHM_PACKET_SIZE) + 32) {
+			usleep(1000);
+			stalled = (knet_h[0]->host_index[2]->link[0].status.stats.tx_data_retries != tx_before.stats.tx_data_retries);
+			continue;
+		}
+
+		fill_packet(send_buff, seq);
+		send_len = knet_send(knet_h[0], send_buff, SHM_PACKET_SIZE, channel[0]);
+		if (send_len == SHM_PACKET_SIZE) {
+			seq++;
+		} else if ((send_len < 0) && (errno == EAGAIN)) {
+			usleep(1000);
+		} else {
+			printf("knet_send failed: %s\n", strerror(errno));
+			pthread_rwlock_unlock(&knet_h[1]->global_rwlock);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		/*
+		 * knet_link_get_status would wait for the global write lock
+		 * and the TX thread holds the read lock while it waits for
+		 * the ring, peek at the counter
+		 */
+		stalled = (knet_h[0]->host_index[2]->link[0].status.stats.tx_data_retries != tx_before.stats.tx_data_retries);
+	}
+
+	pthread_rwlock_unlock(&knet_h[1]->global_rwlock);
+
+	if (!stalled) {
+		printf("ring never filled up after %u packets\n", seq);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	count = seq;
+
+	if (recv_packets(knet_h[1], datafd[1], channel[1], count, logfds[0]) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (get_status(knet_h[0], 2, &tx_after) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+	get_rx_data(knet_h[1], 1, &rx_packets_after, &rx_bytes_after);
+
+	if ((tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes < KNET_SHM_RING_SIZE / 2) ||
+	    (tx_after.stats.tx_data_errors != tx_before.stats.tx_data_errors) ||
+	    (rx_packets_after - rx_packets_before !=
+	     tx_after.stats.tx_data_packets - tx_before.stats.tx_data_packets)) {
+		printf("stats look wrong: tx_packets: %" PRIu64 " (%" PRIu64 " bytes, %u errors), rx_packets: %" PRIu64 "\n",
+		       tx_after.stats.tx_data_packets - tx_before.stats.tx_data_packets,
+		       tx_after.stats.tx_data_bytes - tx_before.stats.tx_data_bytes,
+		       tx_after.stats.tx_data_errors - tx_before.stats.tx_data_errors,
+		       rx_packets_after - rx_packets_before);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	printf("Ring filled up after %u packets, %u TX retries\n",
+	       count, tx_after.stats.tx_data_retries - tx_before.stats.tx_data_retries);
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test SHM peer detach and reattach\n");
+
+	if (get_status(knet_h[0], 2, &tx_before) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * node 2 goes away, node 1 drops the rings and must
+	 * reconnect on its own once node 2 is back
+	 */
+	knet_link_set_enable(knet_h[1], 1, 0, 0);
+	knet_link_clear_config(knet_h[1], 1, 0);
+
+	for (i = 0; i < 100; i++) {
+		if (get_status(knet_h[0], 2, &tx_after) < 0) {
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+		if (!tx_after.connected) {
+			break;
+		}
+		usleep(100000);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (tx_after.connected) {
+		printf("link did not go down after the peer detached\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (start_link(knet_h[1], 1) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((wait_for_host(knet_h[0], 2, 10, logfds[0], stdout) < 0) ||
+	    (wait_for_host(knet_h[1], 1, 10, logfds[0], stdout) < 0)) {
+		printf("timeout waiting for hosts to be reachable after reattach\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (get_status(knet_h[0], 2, &tx_after) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if ((tx_after.stats.down_count == tx_before.stats.down_count) ||
+	    (tx_after.stats.up_count == tx_before.stats.up_count)) {
+		printf("link did not go through down/up: down_count %u -> %u, up_count %u -> %u\n",
+		       tx_before.stats.down_count, tx_after.stats.down_count,
+		       tx_before.stats.up_count, tx_after.stats.up_count);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	get_rx_data(knet_h[1], 1, &rx_packets_before, &rx_bytes_before);
+	get_rx_data(knet_h[0], 2, &back_packets_before, &back_bytes);
+
+	/*
+	 * both directions, the rings are new on both sides
+	 */
+	for (i = 0; i < 2; i++) {
+		dst_host = 2 - i;
+		fill_packet(send_buff, 0);
+
+		if (knet_send_sync_to(knet_h[i], send_buff, SHM_PACKET_SIZE, channel[i], &dst_host, 1) < 0) {
+			printf("knet_send_sync_to failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if (recv_packets(knet_h[1 - i], datafd[1 - i], channel[1 - i], 1, logfds[0]) < 0) {
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if (get_status(knet_h[1], 1, &rx_after) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+	get_rx_data(knet_h[1], 1, &rx_packets_after, &rx_bytes_after);
+	get_rx_data(knet_h[0], 2, &back_packets_after, &back_bytes);
+
+	/*
+	 * the new link of node 2 starts from scratch
+	 */
+	if ((rx_packets_after == rx_packets_before) ||
+	    (back_packets_after == back_packets_before) ||
+	    (rx_after.stats.tx_data_packets != back_packets_after - back_packets_before)) {
+		printf("stats look wrong after reattach: node 1 rx_packets: %" PRIu64 ", node 2 tx_packets: %" PRIu64 " rx_packets: %" PRIu64 "\n",
+		       back_packets_after - back_packets_before,
+		       rx_after.stats.tx_data_packets,
+		       rx_packets_after - rx_packets_before);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
+#else
+int main(int argc, char *argv[])
+{
+	printf("SHM transport not built in, skipping test\n");
+
+	return SKIP;
+}
+#endif
@@ -9,6 +9,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -99,9 +100,14 @@ static void test(void)
 	int datafd = 0;
 	int8_t channel = 0;
 	char send_buff[KNET_MAX_PACKET_SIZE];
-	struct sockaddr_storage lo;
-
-	if (make_local_sockaddr(&lo, 1) < 0) {
+	struct sockaddr_storage lo, lo1;
+	int i;
+	int link_connected = 1;
+	unsigned int txq_count, txq_blocked;
+	uint64_t tx_packets;
+
+	if ((make_local_sockaddr(&lo, 1) < 0) ||
+	    (make_local_sockaddr(&lo1, 2) < 0)) {
 		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
 		exit(FAIL);
 	}
@@ -375,6 +381,196 @@ static void test(void)
 
 	flush_logs(logfds[0], stdout);
 
+	printf("Test knet_send_sync with a full backpressure TX queue on one link only\n");
+
+	if ((knet_host_set_policy(knet_h, 1, KNET_LINK_POLICY_ACTIVE) < 0) ||
+	    (knet_link_set_config(knet_h, 1, 1, KNET_TRANSPORT_UDP, &lo1, &lo1, 0) < 0) ||
+	    (knet_link_set_enable(knet_h, 1, 1, 1) < 0)) {
+		printf("Unable to configure second link: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_link_clear_config(knet_h, 1, 1);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	for (i = 0; i < 100; i++) {
+		if (knet_h->host_index[1]->active_link_entries == 2) {
+			break;
+		}
+		usleep(100000);
+	}
+
+	/*
+	 * pacing holds everything past the first packet in the queue
+	 * of link 1, link 0 is free to send
+	 */
+	if ((i == 100) ||
+	    (knet_link_set_tx_queue(knet_h, 1, 1, 4, KNET_LINK_TXQ_POLICY_BACKPRESSURE) < 0) ||
+	    (knet_link_set_rate(knet_h, 1, 1, 1, 1) < 0)) {
+		printf("Unable to bring up second link: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 1, 0);
+		knet_link_clear_config(knet_h, 1, 1);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	for (i = 0; i < 16; i++) {
+		tx_packets = knet_h->host_index[1]->link[0].status.stats.tx_data_packets;
+		if (knet_send_sync(knet_h, send_buff, 500, channel) < 0) {
+			break;
+		}
+	}
+
+	if ((i == 16) || (errno != EAGAIN) ||
+	    (knet_h->host_index[1]->link[0].status.stats.tx_data_packets != tx_packets)) {
+		printf("knet_send_sync sent data to link 0 and returned %s (%d sent)\n", strerror(errno), i);
+		knet_link_set_enable(knet_h, 1, 1, 0);
+		knet_link_clear_config(knet_h, 1, 1);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	knet_link_set_enable(knet_h, 1, 1, 0);
+	knet_link_clear_config(knet_h, 1, 1);
+	knet_host_set_policy(knet_h, 1, KNET_LINK_POLICY_PASSIVE);
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync with a full backpressure TX queue\n");
+
+	/*
+	 * pacing holds everything past the first packet in the queue
+	 */
+	if ((knet_link_set_tx_queue(knet_h, 1, 0, 4, KNET_LINK_TXQ_POLICY_BACKPRESSURE) < 0) ||
+	    (knet_link_set_rate(knet_h, 1, 0, 1000, 1000) < 0)) {
+		printf("Unable to configure link TX queue: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	tx_packets = knet_h->host_index[1]->link[0].status.stats.tx_data_packets;
+
+	for (i = 0; i < 16; i++) {
+		if (knet_send_sync(knet_h, send_buff, 500, channel) < 0) {
+			break;
+		}
+	}
+
+	if ((i == 16) || (errno != EAGAIN)) {
+		printf("knet_send_sync didn't stop at the full queue or returned incorrect error (%d sent): %s\n", i, strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_h->host_index[1]->link[0].txq_count > 4) {
+		printf("knet_send_sync queued %u packets with a queue of 4\n", knet_h->host_index[1]->link[0].txq_count);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	printf("Test queued packets are not counted as sent\n");
+
+	pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	pthread_mutex_lock(&knet_h->tx_mutex);
+	txq_count = knet_h->host_index[1]->link[0].txq_count;
+	tx_packets = knet_h->host_index[1]->link[0].status.stats.tx_data_packets - tx_packets;
+	pthread_mutex_unlock(&knet_h->tx_mutex);
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	if (tx_packets + txq_count != (uint64_t)i) {
+		printf("knet_send_sync sent %d packets, %" PRIu64 " counted as sent and %u queued\n", i, tx_packets, txq_count);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test TX queue is flushed when the link goes down\n");
+
+	/*
+	 * keep the queued packets waiting for tokens and
+	 * make the heartbeat thread take the link down
+	 */
+	if (knet_link_set_rate(knet_h, 1, 0, 1, 1) < 0) {
+		printf("Unable to slow down link: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	pthread_rwlock_wrlock(&knet_h->global_rwlock);
+	knet_h->host_index[1]->link[0].transport_connected = 0;
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	for (i = 0; i < 100; i++) {
+		pthread_rwlock_rdlock(&knet_h->global_rwlock);
+		link_connected = knet_h->host_index[1]->link[0].status.connected;
+		pthread_rwlock_unlock(&knet_h->global_rwlock);
+		if (!link_connected) {
+			break;
+		}
+		usleep(100000);
+	}
+
+	pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	txq_count = knet_h->host_index[1]->link[0].txq_count;
+	txq_blocked = knet_h->txq_blocked;
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	if ((link_connected) || (txq_count) || (txq_blocked)) {
+		printf("TX queue not flushed on link down (connected: %d queued: %u blocked: %u)\n",
+		       link_connected, txq_count, txq_blocked);
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
 	knet_link_set_enable(knet_h, 1, 0, 0);
 	knet_link_clear_config(knet_h, 1, 0);
 	knet_host_remove(knet_h, 1);
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+/*
+ * TX must never get here, RX needs to accept the packet
+ */
+static int dhost_filter(void *pvt_data,
+			const unsigned char *outdata,
+			ssize_t outdata_len,
+			uint8_t tx_rx,
+			knet_node_id_t this_host_id,
+			knet_node_id_t src_host_id,
+			int8_t *dst_channel,
+			knet_node_id_t *dst_host_ids,
+			size_t *dst_host_ids_entries)
+{
+	if (tx_rx == KNET_NOTIFY_TX) {
+		return -1;
+	}
+
+	return 1;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	char send_buff[KNET_MAX_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t recv_len = 0;
+	knet_node_id_t dst_host_ids[2] = { 1, 2 };
+	struct sockaddr_storage lo;
+
+	if (make_local_sockaddr(&lo, 1) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	memset(send_buff, 1, sizeof(send_buff));
+
+	printf("Test knet_send_sync_to incorrect knet_h\n");
+
+	if ((!knet_send_sync_to(NULL, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid knet_h or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test knet_send_sync_to with no send_buff\n");
+
+	if ((!knet_send_sync_to(knet_h, NULL, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid send_buff or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid send_buff len (0)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, 0, channel, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid send_buff len (0) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid send_buff len (> KNET_MAX_PACKET_SIZE)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE + 1, channel, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid send_buff len (> KNET_MAX_PACKET_SIZE) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid channel (-1)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, -1, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid channel (-1) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid channel (KNET_DATAFD_MAX)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, KNET_DATAFD_MAX, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid channel (KNET_DATAFD_MAX) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with unconfigured channel\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid unconfigured channel or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with no dst_host_ids\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, NULL, 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid dst_host_ids or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid dst_host_ids_entries (0)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 0)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid dst_host_ids_entries (0) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with invalid dst_host_ids_entries (> KNET_MAX_HOST)\n");
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, KNET_MAX_HOST + 1)) || (errno != EINVAL)) {
+		printf("knet_send_sync_to accepted invalid dst_host_ids_entries (> KNET_MAX_HOST) or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with data forwarding disabled\n");
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 1)) || (errno != ECANCELED)) {
+		printf("knet_send_sync_to didn't detect datafwd disabled or returned incorrect error: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with host down\n");
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_enable_filter(knet_h, NULL, dhost_filter) < 0) {
+		printf("knet_handle_enable_filter failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((!knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 1)) || (errno != EHOSTDOWN)) {
+		printf("knet_send_sync_to didn't detect hostdown or returned incorrect error: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_send_sync_to with valid data (dst_host_filter bypassed, unknown hosts skipped)\n");
+
+	if (knet_send_sync_to(knet_h, send_buff, KNET_MAX_PACKET_SIZE, channel, dst_host_ids, 2) < 0) {
+		printf("knet_send_sync_to failed: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_packet(knet_h, 10, datafd)) {
+		printf("Error waiting for packet: %s\n", strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+	if (recv_len != sizeof(send_buff)) {
+		printf("knet_recv received only %zd bytes: %s\n", recv_len, strerror(errno));
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (memcmp(recv_buff, send_buff, KNET_MAX_PACKET_SIZE)) {
+		printf("recv and send buffers are different!\n");
+		knet_link_set_enable(knet_h, 1, 0, 0);
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
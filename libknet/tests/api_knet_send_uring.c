@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "uring.h"
+#include "test-common.h"
+
+/*
+ * more packets than io_uring buffers, the kernel only gets
+ * buffers back once the RX thread is done with them
+ */
+#define URING_PACKETS (4 * KNET_URING_BUFS)
+#define URING_PACKET_SIZE 1024
+
+/*
+ * packets in flight, what does not fit in the datafd is lost
+ */
+#define URING_BATCH 32
+
+/*
+ * times the link is cleared and configured again
+ */
+#define URING_RECONFIG 5
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+static int configure_link(knet_handle_t knet_h, struct sockaddr_storage *lo)
+{
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, lo, lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (knet_link_set_ping_timers(knet_h, 1, 0, 200, 1000, 2048) < 0) {
+		printf("knet_link_set_ping_timers failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		return -1;
+	}
+
+	if (knet_link_set_enable(knet_h, 1, 0, 1) < 0) {
+		printf("knet_link_set_enable failed: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, 1, 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void fill_packet(char *buf, uint32_t seq)
+{
+	memset(buf, seq & 0xff, URING_PACKET_SIZE);
+	memmove(buf, &seq, sizeof(seq));
+}
+
+static int send_recv_packets(knet_handle_t knet_h, int datafd, int8_t channel, uint32_t packets)
+{
+	char send_buff[URING_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len;
+	int recv_len;
+	uint32_t seq, sent, recv;
+
+	for (seq = 0; seq < packets; ) {
+		for (sent = 0; (sent < URING_BATCH) && (seq + sent < packets); ) {
+			fill_packet(send_buff, seq + sent);
+			send_len = knet_send(knet_h, send_buff, URING_PACKET_SIZE, channel);
+			if (send_len == URING_PACKET_SIZE) {
+				sent++;
+			} else if ((send_len < 0) && (errno == EAGAIN)) {
+				usleep(1000);
+			} else {
+				printf("knet_send failed: %s\n", strerror(errno));
+				return -1;
+			}
+		}
+
+		for (recv = 0; recv < sent; recv++, seq++) {
+			if (wait_for_packet(knet_h, 10, datafd)) {
+				printf("Error waiting for packet %u: %s\n", seq, strerror(errno));
+				return -1;
+			}
+
+			recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+			fill_packet(send_buff, seq);
+			if ((recv_len != URING_PACKET_SIZE) ||
+			    (memcmp(recv_buff, send_buff, URING_PACKET_SIZE))) {
+				printf("knet_recv received wrong data for packet %u (%d bytes): %s\n", seq, recv_len, strerror(errno));
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * junk is dropped by the RX thread, but it takes
+ * io_uring buffers like any other packet
+ */
+static int send_junk(int sockfd, struct sockaddr_storage *lo, int packets)
+{
+	char junk[URING_PACKET_SIZE];
+	int i;
+
+	memset(junk, 0, sizeof(junk));
+
+	for (i = 0; i < packets; i++) {
+		if (sendto(sockfd, junk, sizeof(junk), 0, (struct sockaddr *)lo, sizeof(struct sockaddr_in)) < 0) {
+			printf("Unable to send junk: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * drop whatever was in flight when the link has been cleared,
+ * till nothing has been received for a second
+ */
+static void drain_datafd(knet_handle_t knet_h, int datafd, int8_t channel)
+{
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	fd_set rfds;
+	struct timeval tv;
+
+	while (1) {
+		FD_ZERO(&rfds);
+		FD_SET(datafd, &rfds);
+
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+
+		if (select(datafd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+			break;
+		}
+
+		if (knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel) < 0) {
+			break;
+		}
+	}
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct sockaddr_storage lo;
+	char send_buff[URING_PACKET_SIZE];
+	int junkfd;
+	uint32_t seq;
+	int i, j;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	printf("Test knet_send/knet_recv with the io_uring RX engine\n");
+
+	knet_h = knet_handle_new(1, logfds[1], KNET_LOG_DEBUG, KNET_HANDLE_FLAG_IO_URING);
+
+	if ((!knet_h) && (errno == EOPNOTSUPP)) {
+		printf("io_uring is not supported on this system. Skipping\n");
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(SKIP);
+	}
+
+	if (!knet_h) {
+		printf("knet_handle_new failed to enable io_uring: %s\n", strerror(errno));
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (configure_link(knet_h, &lo) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (knet_handle_setfwd(knet_h, 1) < 0) {
+		printf("knet_handle_setfwd failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test sending %d packets, more than the %d io_uring buffers\n", URING_PACKETS, KNET_URING_BUFS);
+
+	if (send_recv_packets(knet_h, datafd, channel, URING_PACKETS) < 0) {
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	junkfd = socket(lo.ss_family, SOCK_DGRAM, 0);
+	if (junkfd < 0) {
+		printf("Unable to create socket: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * with the RX thread held, the kernel runs out of buffers and
+	 * ends the multishot recvmsg (no IORING_CQE_F_MORE). The socket
+	 * goes back to epoll, that has to arm it again for the packets
+	 * left in the socket.
+	 */
+	printf("Test io_uring running out of buffers\n");
+
+	if (pthread_rwlock_wrlock(&knet_h->global_rwlock) != 0) {
+		printf("Unable to get global write lock\n");
+		close(junkfd);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (send_junk(junkfd, &lo, 2 * KNET_URING_BUFS) < 0) {
+		pthread_rwlock_unlock(&knet_h->global_rwlock);
+		close(junkfd);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	usleep(500000);
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	if (send_recv_packets(knet_h, datafd, channel, URING_PACKETS) < 0) {
+		close(junkfd);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	/*
+	 * the RX thread finds the completions of the old socket (at
+	 * least the cancelled recvmsg) once the link has been cleared.
+	 * They have to be dropped (uring_gen) and their buffers given
+	 * back to the kernel, the new socket often gets the same fd.
+	 */
+	printf("Test clearing and configuring the link again while traffic is flowing\n");
+
+	for (i = 0; i < URING_RECONFIG; i++) {
+		for (seq = 0; seq < URING_BATCH; seq++) {
+			fill_packet(send_buff, seq);
+			if ((knet_send(knet_h, send_buff, URING_PACKET_SIZE, channel) < 0) &&
+			    (errno != EAGAIN)) {
+				printf("knet_send failed: %s\n", strerror(errno));
+				close(junkfd);
+				test_cleanup(knet_h, logfds);
+				exit(FAIL);
+			}
+		}
+
+		if (send_junk(junkfd, &lo, KNET_URING_BUFS) < 0) {
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if ((knet_link_set_enable(knet_h, 1, 0, 0) < 0) ||
+		    (knet_link_clear_config(knet_h, 1, 0) < 0)) {
+			printf("Unable to clear link: %s\n", strerror(errno));
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		/*
+		 * the host status is updated asynchronously, do not take
+		 * the old status for the new link being up
+		 */
+		for (j = 0; j < 100; j++) {
+			if (!knet_h->host_index[1]->status.reachable) {
+				break;
+			}
+			usleep(100000);
+		}
+
+		if (j == 100) {
+			printf("host is still reachable without links\n");
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if (configure_link(knet_h, &lo) < 0) {
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+			printf("timeout waiting for host to be reachable again\n");
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		drain_datafd(knet_h, datafd, channel);
+
+		if (send_recv_packets(knet_h, datafd, channel, KNET_URING_BUFS) < 0) {
+			close(junkfd);
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		flush_logs(logfds[0], stdout);
+	}
+
+	close(junkfd);
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
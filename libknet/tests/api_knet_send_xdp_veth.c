@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+/*
+ * loopback is not Ethernet and never hits the AF_XDP path,
+ * run two handles in two network namespaces over a veth pair
+ */
+
+#define CAP_NET_ADMIN_BIT 12
+#define CAP_SYS_ADMIN_BIT 21
+#define CAP_BPF_BIT       39
+
+#define XDP_VETH_PACKETS  100
+
+static int private_data;
+static char ns_name[2][32];
+static int orig_ns = -1;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+/*
+ * CAP_BPF (or CAP_SYS_ADMIN on older kernels) to load the XDP program,
+ * CAP_NET_ADMIN to create the namespaces and attach the program
+ */
+static int has_caps(void)
+{
+	FILE *status;
+	char line[256];
+	unsigned long long caps = 0;
+
+	status = fopen("/proc/self/status", "r");
+	if (!status) {
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), status)) {
+		if (!strncmp(line, "CapEff:", 7)) {
+			caps = strtoull(line + 7, NULL, 16);
+			break;
+		}
+	}
+	fclose(status);
+
+	if (!(caps & (1ULL << CAP_NET_ADMIN_BIT))) {
+		return 0;
+	}
+
+	if ((!(caps & (1ULL << CAP_BPF_BIT))) &&
+	    (!(caps & (1ULL << CAP_SYS_ADMIN_BIT)))) {
+		return 0;
+	}
+
+	return 1;
+}
+
+static void netns_cleanup(void)
+{
+	char command[256];
+	char *error_string = NULL;
+
+	if (orig_ns >= 0) {
+		setns(orig_ns, CLONE_NEWNET);
+		close(orig_ns);
+		orig_ns = -1;
+	}
+
+	snprintf(command, sizeof(command), "ip netns del %s; ip netns del %s", ns_name[0], ns_name[1]);
+	execute_shell(command, &error_string);
+	free(error_string);
+}
+
+static int netns_setup(void)
+{
+	char command[1024];
+	char *error_string = NULL;
+	int err;
+
+	snprintf(ns_name[0], sizeof(ns_name[0]), "knetxdp%ua", (unsigned int)getpid());
+	snprintf(ns_name[1], sizeof(ns_name[1]), "knetxdp%ub", (unsigned int)getpid());
+
+	snprintf(command, sizeof(command),
+		 "ip netns add %s && ip netns add %s && "
+		 "ip link add kxdpa netns %s type veth peer name kxdpb netns %s && "
+		 "ip -n %s addr add 10.202.0.1/24 dev kxdpa && "
+		 "ip -n %s addr add 10.202.0.2/24 dev kxdpb && "
+		 "ip -n %s link set kxdpa up && "
+		 "ip -n %s link set kxdpb up",
+		 ns_name[0], ns_name[1],
+		 ns_name[0], ns_name[1],
+		 ns_name[0], ns_name[1],
+		 ns_name[0], ns_name[1]);
+
+	err = execute_shell(command, &error_string);
+	if (err) {
+		printf("Unable to create veth pair: %s\n", error_string ? error_string : "");
+	}
+	free(error_string);
+
+	return err;
+}
+
+static int netns_enter(int idx)
+{
+	char path[PATH_MAX];
+	int fd, err;
+
+	snprintf(path, sizeof(path), "/run/netns/%s", ns_name[idx]);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+
+	err = setns(fd, CLONE_NEWNET);
+	close(fd);
+
+	return err;
+}
+
+/*
+ * datagrams sent through the kernel UDP stack in the
+ * network namespace of the calling thread
+ */
+static int udp_out_datagrams(uint64_t *out)
+{
+	FILE *snmp;
+	char header[1024], values[1024];
+	char *hsave = NULL, *vsave = NULL, *h, *v;
+	int found = -1;
+
+	snmp = fopen("/proc/thread-self/net/snmp", "r");
+	if (!snmp) {
+		return -1;
+	}
+
+	while (fgets(header, sizeof(header), snmp)) {
+		if (strncmp(header, "Udp:", 4)) {
+			continue;
+		}
+		if (!fgets(values, sizeof(values), snmp)) {
+			break;
+		}
+		h = strtok_r(header, " \n", &hsave);
+		v = strtok_r(values, " \n", &vsave);
+		while ((h) && (v)) {
+			if (!strcmp(h, "OutDatagrams")) {
+				*out = strtoull(v, NULL, 10);
+				found = 0;
+				break;
+			}
+			h = strtok_r(NULL, " \n", &hsave);
+			v = strtok_r(NULL, " \n", &vsave);
+		}
+		break;
+	}
+	fclose(snmp);
+
+	return found;
+}
+
+static void test_cleanup(knet_handle_t *knet_h, int *logfds)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!knet_h[i]) {
+			continue;
+		}
+		knet_link_set_enable(knet_h[i], 2 - i, 0, 0);
+		knet_link_clear_config(knet_h[i], 2 - i, 0);
+		knet_host_remove(knet_h[i], 2 - i);
+		knet_handle_free(knet_h[i]);
+	}
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+	netns_cleanup();
+}
+
+static knet_handle_t start_node(int idx, int *logfds, int *datafd, int8_t *channel, char *portstr)
+{
+	knet_handle_t knet_h;
+	knet_node_id_t peer = 2 - idx;
+	struct sockaddr_storage src, dst;
+	const char *addr[2] = { "10.202.0.1", "10.202.0.2" };
+
+	if (netns_enter(idx) < 0) {
+		printf("Unable to enter network namespace %s: %s\n", ns_name[idx], strerror(errno));
+		return NULL;
+	}
+
+	if ((knet_strtoaddr(addr[idx], portstr, &src, sizeof(struct sockaddr_storage)) < 0) ||
+	    (knet_strtoaddr(addr[1 - idx], portstr, &dst, sizeof(struct sockaddr_storage)) < 0)) {
+		printf("Unable to convert address to sockaddr: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	knet_h = knet_handle_new(idx + 1, logfds[1], KNET_LOG_DEBUG, 0);
+	if (!knet_h) {
+		printf("knet_handle_new failed: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	if (knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) {
+		printf("knet_handle_enable_sock_notify failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	*datafd = 0;
+	*channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, datafd, channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if (knet_host_add(knet_h, peer) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if (knet_link_set_config(knet_h, peer, 0, KNET_TRANSPORT_XDP, &src, &dst, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, peer);
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	if ((knet_link_set_enable(knet_h, peer, 0, 1) < 0) ||
+	    (knet_handle_setfwd(knet_h, 1) < 0)) {
+		printf("Unable to enable link: %s\n", strerror(errno));
+		knet_link_clear_config(knet_h, peer, 0);
+		knet_host_remove(knet_h, peer);
+		knet_handle_free(knet_h);
+		return NULL;
+	}
+
+	return knet_h;
+}
+
+static void test(void)
+{
+	knet_handle_t knet_h[2] = { NULL, NULL };
+	int logfds[2];
+	int datafd[2];
+	int8_t channel[2];
+	char send_buff[1024];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	char portstr[32];
+	knet_node_id_t dst_host = 2;
+	uint64_t out_before, out_after;
+	int recv_len;
+	int i;
+
+	if (knet_get_transport_id_by_name("XDP") != KNET_TRANSPORT_XDP) {
+		printf("XDP transport not built in, skipping test\n");
+		exit(SKIP);
+	}
+
+	if (is_memcheck() || is_helgrind()) {
+		printf("XDP veth test does not run under valgrind, skipping test\n");
+		exit(SKIP);
+	}
+
+	if (!has_caps()) {
+		printf("XDP veth test requires CAP_NET_ADMIN and CAP_BPF, skipping test\n");
+		exit(SKIP);
+	}
+
+	if (netns_setup()) {
+		netns_cleanup();
+		printf("Unable to create network namespaces, skipping test\n");
+		exit(SKIP);
+	}
+
+	orig_ns = open("/proc/thread-self/ns/net", O_RDONLY);
+	if (orig_ns < 0) {
+		printf("Unable to open network namespace: %s\n", strerror(errno));
+		netns_cleanup();
+		exit(FAIL);
+	}
+
+	snprintf(portstr, sizeof(portstr), "%u", 1024 + ((unsigned int)getpid() % 60000));
+
+	setup_logpipes(logfds);
+
+	printf("Test knet_send_sync_to over XDP transport on a veth pair\n");
+
+	for (i = 0; i < 2; i++) {
+		knet_h[i] = start_node(i, logfds, &datafd[i], &channel[i], portstr);
+		if (!knet_h[i]) {
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if ((wait_for_host(knet_h[0], 2, 10, logfds[0], stdout) < 0) ||
+	    (wait_for_host(knet_h[1], 1, 10, logfds[0], stdout) < 0)) {
+		printf("timeout waiting for hosts to be reachable\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * the peer MAC address is learned from the heartbeats
+	 * received on the AF_XDP socket, before that data
+	 * goes via the UDP socket
+	 */
+	sleep(2);
+
+	flush_logs(logfds[0], stdout);
+
+	if (netns_enter(0) < 0) {
+		printf("Unable to enter network namespace %s: %s\n", ns_name[0], strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (udp_out_datagrams(&out_before) < 0) {
+		printf("Unable to read UDP stats\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	for (i = 0; i < XDP_VETH_PACKETS; i++) {
+		memset(send_buff, i, sizeof(send_buff));
+
+		if (knet_send_sync_to(knet_h[0], send_buff, sizeof(send_buff), channel[0], &dst_host, 1) < 0) {
+			printf("knet_send_sync_to failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		if (wait_for_packet(knet_h[1], 10, datafd[1])) {
+			printf("Error waiting for packet %d: %s\n", i, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h[1], recv_buff, KNET_MAX_PACKET_SIZE, channel[1]);
+		if ((recv_len != sizeof(send_buff)) ||
+		    (memcmp(recv_buff, send_buff, sizeof(send_buff)))) {
+			printf("knet_recv received wrong data for packet %d (%d bytes): %s\n", i, recv_len, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	if (udp_out_datagrams(&out_after) < 0) {
+		printf("Unable to read UDP stats\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * heartbeats still go via the UDP socket, data must not
+	 */
+	printf("UDP datagrams sent by the kernel for %d data packets: %" PRIu64 "\n",
+	       XDP_VETH_PACKETS, out_after - out_before);
+
+	if (out_after - out_before >= XDP_VETH_PACKETS / 2) {
+		printf("data has been sent via the UDP socket instead of AF_XDP\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
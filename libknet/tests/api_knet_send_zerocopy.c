@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "netutils.h"
+#include "test-common.h"
+
+/*
+ * more packets than zerocopy ring buffers, so that buffers
+ * have to be released by the kernel and reused, or the ring
+ * runs dry and packets are copied.
+ * Packets are 2 fragments, the first one is as big as the data
+ * MTU and spans more pages than the kernel takes for a zerocopy
+ * datagram (EMSGSIZE, sent again as a copy).
+ */
+#define ZC_PACKETS (2 * KNET_ZEROCOPY_BUFS)
+#define ZC_PACKET_SIZE KNET_MAX_PACKET_SIZE
+
+static int private_data;
+
+static void sock_notify(void *pvt_data,
+			int datafd,
+			int8_t channel,
+			uint8_t tx_rx,
+			int error,
+			int errorno)
+{
+	return;
+}
+
+static void test_cleanup(knet_handle_t knet_h, int *logfds)
+{
+	knet_link_set_enable(knet_h, 1, 0, 0);
+	knet_link_clear_config(knet_h, 1, 0);
+	knet_host_remove(knet_h, 1);
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+/*
+ * the sequence number first, so that a buffer reused
+ * while the kernel still holds it is caught
+ */
+static void fill_packet(char *buf, uint32_t seq)
+{
+	memset(buf, seq & 0xff, ZC_PACKET_SIZE);
+	memmove(buf, &seq, sizeof(seq));
+}
+
+static unsigned int zerocopy_pending(knet_handle_t knet_h)
+{
+	unsigned int pending = 0;
+	int i;
+
+	pthread_mutex_lock(&knet_h->zerocopy_mutex);
+	for (i = 0; i < KNET_ZEROCOPY_BUFS; i++) {
+		pending += knet_h->zerocopy_buf[i].pending;
+	}
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+
+	return pending;
+}
+
+static void test(const char *model)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	int datafd = 0;
+	int8_t channel = 0;
+	struct knet_handle_stats stats;
+	struct knet_handle_crypto_cfg knet_handle_crypto_cfg;
+	char send_buff[ZC_PACKET_SIZE];
+	char recv_buff[KNET_MAX_PACKET_SIZE];
+	ssize_t send_len;
+	int recv_len;
+	struct sockaddr_storage lo;
+	unsigned int data_mtu, pending;
+	uint32_t seq;
+	int i;
+
+	if (make_local_sockaddr(&lo, 0) < 0) {
+		printf("Unable to convert loopback to sockaddr: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	printf("Test zerocopy send %s\n", model ? model : "without crypto");
+
+	if (model) {
+		memset(&knet_handle_crypto_cfg, 0, sizeof(struct knet_handle_crypto_cfg));
+		strncpy(knet_handle_crypto_cfg.crypto_model, model, sizeof(knet_handle_crypto_cfg.crypto_model) - 1);
+		strncpy(knet_handle_crypto_cfg.crypto_cipher_type, "aes128", sizeof(knet_handle_crypto_cfg.crypto_cipher_type) - 1);
+		strncpy(knet_handle_crypto_cfg.crypto_hash_type, "sha1", sizeof(knet_handle_crypto_cfg.crypto_hash_type) - 1);
+		knet_handle_crypto_cfg.private_key_len = 2000;
+
+		if (knet_handle_crypto(knet_h, &knet_handle_crypto_cfg)) {
+			printf("knet_handle_crypto failed with correct config: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			flush_logs(logfds[0], stdout);
+			close_logpipes(logfds);
+			exit(FAIL);
+		}
+	}
+
+	if (knet_handle_set_zerocopy(knet_h, KNET_ZEROCOPY_MIN_THRESHOLD) < 0) {
+		printf("knet_handle_set_zerocopy failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((knet_handle_enable_sock_notify(knet_h, &private_data, sock_notify) < 0) ||
+	    (knet_handle_pmtud_setfreq(knet_h, 1) < 0)) {
+		printf("Unable to configure handle: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	datafd = 0;
+	channel = -1;
+
+	if (knet_handle_add_datafd(knet_h, &datafd, &channel) < 0) {
+		printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_host_add(knet_h, 1) < 0) {
+		printf("knet_host_add failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (knet_link_set_config(knet_h, 1, 0, KNET_TRANSPORT_UDP, &lo, &lo, 0) < 0) {
+		printf("Unable to configure link: %s\n", strerror(errno));
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if (!knet_h->host_index[1]->link[0].transport_zerocopy) {
+		printf("SO_ZEROCOPY not supported. Skipping\n");
+		knet_link_clear_config(knet_h, 1, 0);
+		knet_host_remove(knet_h, 1);
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(SKIP);
+	}
+
+	if ((knet_link_set_enable(knet_h, 1, 0, 1) < 0) ||
+	    (knet_handle_setfwd(knet_h, 1) < 0)) {
+		printf("Unable to enable link: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	if (wait_for_host(knet_h, 1, 10, logfds[0], stdout) < 0) {
+		printf("timeout waiting for host to be reachable\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	/*
+	 * fragments smaller than the threshold are copied,
+	 * wait for PMTUd to find out the loopback MTU
+	 */
+	for (i = 0; i < 30; i++) {
+		if ((!knet_handle_pmtud_get(knet_h, &data_mtu)) &&
+		    (data_mtu >= KNET_ZEROCOPY_MIN_THRESHOLD)) {
+			break;
+		}
+		sleep(1);
+	}
+
+	if (i == 30) {
+		printf("PMTUd did not find a data MTU large enough for zerocopy\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	/*
+	 * unencrypted packets from the datafd are sent straight from the
+	 * socket buffer, that is swapped with a spare one of the ring
+	 * while the kernel holds it (see _zerocopy_put_buf)
+	 */
+	printf("Test sending %d packets of %d bytes back-to-back (data MTU: %u)\n", ZC_PACKETS, ZC_PACKET_SIZE, data_mtu);
+
+	for (seq = 0; seq < ZC_PACKETS; ) {
+		fill_packet(send_buff, seq);
+		send_len = knet_send(knet_h, send_buff, ZC_PACKET_SIZE, channel);
+		if (send_len == ZC_PACKET_SIZE) {
+			seq++;
+		} else if ((send_len < 0) && (errno == EAGAIN)) {
+			usleep(1000);
+		} else {
+			printf("knet_send failed: %s\n", strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	printf("Test received data matches what has been sent\n");
+
+	for (seq = 0; seq < ZC_PACKETS; seq++) {
+		if (wait_for_packet(knet_h, 10, datafd)) {
+			printf("Error waiting for packet %u: %s\n", seq, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+
+		recv_len = knet_recv(knet_h, recv_buff, KNET_MAX_PACKET_SIZE, channel);
+		fill_packet(send_buff, seq);
+		if ((recv_len != ZC_PACKET_SIZE) ||
+		    (memcmp(recv_buff, send_buff, ZC_PACKET_SIZE))) {
+			printf("knet_recv received wrong data for packet %u (%d bytes): %s\n", seq, recv_len, strerror(errno));
+			test_cleanup(knet_h, logfds);
+			exit(FAIL);
+		}
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test packets have been sent with MSG_ZEROCOPY\n");
+
+	if (knet_handle_get_stats(knet_h, &stats, sizeof(stats)) < 0) {
+		printf("knet_handle_get_stats failed: %s\n", strerror(errno));
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	printf("tx_zerocopy_packets: %" PRIu64 " tx_zerocopy_copied: %" PRIu64 " tx_zerocopy_no_bufs: %" PRIu64 "\n",
+	       stats.tx_zerocopy_packets, stats.tx_zerocopy_copied, stats.tx_zerocopy_no_bufs);
+
+	if (!stats.tx_zerocopy_packets) {
+		printf("no packet has been sent with MSG_ZEROCOPY\n");
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	printf("Test the kernel released all the zerocopy buffers\n");
+
+	for (i = 0; i < 100; i++) {
+		pending = zerocopy_pending(knet_h);
+		if (!pending) {
+			break;
+		}
+		usleep(100000);
+	}
+
+	if (pending) {
+		printf("%u zerocopy sends have not been completed\n", pending);
+		test_cleanup(knet_h, logfds);
+		exit(FAIL);
+	}
+
+	test_cleanup(knet_h, logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	struct knet_crypto_info crypto_list[16];
+	size_t crypto_list_entries;
+
+	test(NULL);
+
+	memset(crypto_list, 0, sizeof(crypto_list));
+
+	if (knet_get_crypto_list(crypto_list, &crypto_list_entries) < 0) {
+		printf("knet_get_crypto_list failed: %s\n", strerror(errno));
+		return FAIL;
+	}
+
+	if (crypto_list_entries == 0) {
+		printf("no crypto modules detected. Skipping encrypted test\n");
+		return PASS;
+	}
+
+	test(crypto_list[0].name);
+
+	return PASS;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libknet.h"
+
+#include "internals.h"
+#include "test-common.h"
+
+static struct knet_stats_shm fake_shm;
+static struct knet_stats_shm snapshot;
+
+static void test(void)
+{
+	knet_handle_t knet_h;
+	int logfds[2];
+	const struct knet_stats_shm *shm = NULL;
+
+	printf("Test knet_stats_shm_read with NULL shm\n");
+
+	if ((!knet_stats_shm_read(NULL, &snapshot)) || (errno != EINVAL)) {
+		printf("knet_stats_shm_read accepted invalid shm or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_stats_shm_read with NULL snapshot\n");
+
+	if ((!knet_stats_shm_read(&fake_shm, NULL)) || (errno != EINVAL)) {
+		printf("knet_stats_shm_read accepted invalid snapshot or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_stats_shm_read with wrong version\n");
+
+	memset(&fake_shm, 0, sizeof(struct knet_stats_shm));
+	fake_shm.version = KNET_STATS_SHM_VERSION + 1;
+
+	if ((!knet_stats_shm_read(&fake_shm, &snapshot)) || (errno != EINVAL)) {
+		printf("knet_stats_shm_read accepted invalid version or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_stats_shm_read with an update in progress\n");
+
+	fake_shm.version = KNET_STATS_SHM_VERSION;
+	fake_shm.seq = 1;
+
+	if ((!knet_stats_shm_read(&fake_shm, &snapshot)) || (errno != EAGAIN)) {
+		printf("knet_stats_shm_read accepted an inconsistent region or returned incorrect error: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	printf("Test knet_stats_shm_read with too many links entries\n");
+
+	fake_shm.seq = 2;
+	fake_shm.links_entries = KNET_STATS_SHM_MAX_LINKS + 1;
+
+	if ((knet_stats_shm_read(&fake_shm, &snapshot) < 0) || (snapshot.links_entries != KNET_STATS_SHM_MAX_LINKS)) {
+		printf("knet_stats_shm_read did not clamp links entries: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	setup_logpipes(logfds);
+
+	knet_h = knet_handle_start(logfds, KNET_LOG_DEBUG);
+
+	if (knet_handle_enable_stats_shm(knet_h, 100, NULL, &shm) < 0) {
+		printf("knet_handle_enable_stats_shm failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	printf("Test knet_stats_shm_read with valid input\n");
+
+	memset(&snapshot, 0, sizeof(struct knet_stats_shm));
+
+	if (knet_stats_shm_read(shm, &snapshot) < 0) {
+		printf("knet_stats_shm_read failed: %s\n", strerror(errno));
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	if ((snapshot.version != KNET_STATS_SHM_VERSION) ||
+	    (snapshot.size != sizeof(struct knet_stats_shm)) ||
+	    (snapshot.handle.size != sizeof(struct knet_handle_stats)) ||
+	    (snapshot.links_entries != 0)) {
+		printf("knet_stats_shm_read returned invalid data\n");
+		knet_handle_free(knet_h);
+		flush_logs(logfds[0], stdout);
+		close_logpipes(logfds);
+		exit(FAIL);
+	}
+
+	flush_logs(logfds[0], stdout);
+
+	knet_handle_free(knet_h);
+	flush_logs(logfds[0], stdout);
+	close_logpipes(logfds);
+}
+
+int main(int argc, char *argv[])
+{
+	test();
+
+	return PASS;
+}
@@ -45,6 +45,9 @@ static int wait_for_perf_rx = 0;
 static char *compresscfg = NULL;
 static char *cryptocfg = NULL;
 static int machine_output = 0;
+static int ctrl_datafd = 0;
+static int8_t ctrl_channel = -1;
+static uint8_t ctrl_priority = 255;
 
 static int bench_shutdown_in_progress = 0;
 static pthread_mutex_t shutdown_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -53,6 +56,7 @@ static pthread_mutex_t shutdown_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define TEST_PING_AND_DATA 1
 #define TEST_PERF_BY_SIZE 2
 #define TEST_PERF_BY_TIME 3
+#define TEST_PERF_LATENCY 4
 
 static int test_type = TEST_PING;
 
@@ -65,6 +69,26 @@ static int test_type = TEST_PING;
 static uint64_t perf_by_size_size = 1 * ONE_GIGABYTE;
 static uint64_t perf_by_time_secs = 10;
 
+/*
+ * perf-latency: probes sent on the control channel while
+ * the data channel is flooded with bulk traffic
+ */
+#define LATENCY_PROBE_INTERVAL 10000 /* usecs */
+
+struct latency_probe {
+	uint32_t seq;
+	uint8_t reply;
+	struct timespec sent;
+};
+
+static pthread_t probe_thread = (pthread_t)NULL;
+static pthread_mutex_t latency_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long *latency_samples = NULL;
+static uint64_t latency_samples_max = 0;
+static uint64_t latency_samples_count = 0;
+static uint32_t latency_probes_sent = 0;
+static int latency_test_done = 0;
+
 struct node {
 	int nodeid;
 	int links;
@@ -81,8 +105,8 @@ static void print_help(void)
 	printf("                                           Example: -c nss:aes128:sha1\n");
 	printf(" -z [implementation]:[level]:[threshold]   compress configuration. (default disabled)\n");
 	printf("                                           Example: -z zlib:5:100\n");
-	printf(" -p [active|passive|rr]                    (default: passive)\n");
-	printf(" -P [UDP|SCTP]                             (default: UDP) protocol (transport) to use for all links\n");
+	printf(" -p [active|passive|rr|fec]                (default: passive)\n");
+	printf(" -P [UDP|SCTP|XDP|SHM]                     (default: UDP) protocol (transport) to use for all links\n");
 	printf(" -t [nodeid]                               This nodeid (required)\n");
 	printf(" -n [nodeid],[proto]/[link1_ip],[link2_..] Other nodes information (at least one required)\n");
 	printf("                                           Example: -t 1,192.168.8.1,SCTP/3ffe::8:1,UDP/172...\n");
@@ -92,7 +116,7 @@ static void print_help(void)
 	printf(" -o                                        enable baseport offset per nodeid\n");
 	printf(" -m                                        change PMTUd interval in seconds (default: 60)\n");
 	printf(" -w                                        dont wait for all nodes to be up before starting the test (default: wait)\n");
-	printf(" -T [ping|ping_data|perf-by-size|perf-by-time]\n");
+	printf(" -T [ping|ping_data|perf-by-size|perf-by-time|perf-latency]\n");
 	printf("                                           test type (default: ping)\n");
 	printf("                                           ping: will wait for all hosts to join the knet network, sleep 5 seconds and quit\n");
 	printf("                                           ping_data: will wait for all hosts to join the knet network, sends some data to all nodes and quit\n");
@@ -103,14 +127,22 @@ static void print_help(void)
 	printf("                                                         perform a series of benchmarks by transmitting a known\n");
 	printf("                                                         size of packets for a given amount of time (10 seconds)\n");
 	printf("                                                         and measuring the quantity of data transmitted, then quit\n");
+	printf("                                           perf-latency: will wait for all hosts to join the knet network,\n");
+	printf("                                                         flood the data channel with bulk traffic for a given amount\n");
+	printf("                                                         of time (10 seconds) while measuring round trip time of small\n");
+	printf("                                                         probes sent on a separate control channel, then quit\n");
 	printf(" -s                                        nodeid that will generate traffic for benchmarks\n");
 	printf(" -S [size|seconds]                         when used in combination with -T perf-by-size it indicates how many GB of traffic to generate for the test. (default: 1GB)\n");
 	printf("                                           when used in combination with -T perf-by-time it indicates how many Seconds of traffic to generate for the test. (default: 10 seconds)\n");
+	printf(" -R [priority]                             when used in combination with -T perf-latency it sets the control channel TX priority (default: 255)\n");
+	printf("                                           0 puts the control channel at the same priority as the bulk channel\n");
 	printf(" -C                                        repeat the test continously (default: off)\n");
 	printf(" -X[XX]                                    show stats at the end of the run (default: 1)\n");
 	printf("                                           1: show handle stats, 2: show summary link stats\n");
 	printf("                                           3: show detailed link stats\n");
+	printf("                                           4: show latency histograms (p50/p90/p99/p999)\n");
 	printf(" -a                                        enable machine parsable output (default: off).\n");
+	printf(" -U                                        receive link traffic via io_uring (default: off)\n");
 }
 
 static void parse_nodes(char *nodesinfo[MAX_NODES], int onidx, int port, struct node nodes[MAX_NODES], int *thisidx)
@@ -230,6 +262,7 @@ static void setup_knet(int argc, char *argv[])
 	int thisidx = -1;
 	int onidx = 0;
 	int debug = KNET_LOG_INFO;
+	uint64_t handle_flags = 0;
 	int port = 50000, portoffset = 0;
 	int thisport = 0, otherport = 0;
 	int thisnewport = 0, othernewport = 0;
@@ -247,7 +280,7 @@ static void setup_knet(int argc, char *argv[])
 
 	memset(nodes, 0, sizeof(nodes));
 
-	while ((rv = getopt(argc, argv, "aCT:S:s:ldom:wb:t:n:c:p:X::P:z:h")) != EOF) {
+	while ((rv = getopt(argc, argv, "aCT:S:s:R:ldom:wb:t:n:c:p:X::P:z:Uh")) != EOF) {
 		switch(rv) {
 			case 'h':
 				print_help();
@@ -259,6 +292,9 @@ static void setup_knet(int argc, char *argv[])
 			case 'd':
 				debug = KNET_LOG_DEBUG;
 				break;
+			case 'U':
+				handle_flags |= KNET_HANDLE_FLAG_IO_URING;
+				break;
 			case 'c':
 				if (cryptocfg) {
 					printf("Error: -c can only be specified once\n");
@@ -288,8 +324,12 @@ static void setup_knet(int argc, char *argv[])
 					policy = KNET_LINK_POLICY_PASSIVE;
 					policyfound = 1;
 				}
+				if (!strcmp(policystr, "fec")) {
+					policy = KNET_LINK_POLICY_FEC;
+					policyfound = 1;
+				}
 				if (!policyfound) {
-					printf("Error: invalid policy %s specified. -p accepts active|passive|rr\n", policystr);
+					printf("Error: invalid policy %s specified. -p accepts active|passive|rr|fec\n", policystr);
 					exit(FAIL);
 				}
 				break;
@@ -307,8 +347,16 @@ static void setup_knet(int argc, char *argv[])
 					protocol = KNET_TRANSPORT_SCTP;
 					protofound = 1;
 				}
+				if (!strcmp(protostr, "XDP")) {
+					protocol = KNET_TRANSPORT_XDP;
+					protofound = 1;
+				}
+				if (!strcmp(protostr, "SHM")) {
+					protocol = KNET_TRANSPORT_SHM;
+					protofound = 1;
+				}
 				if (!protofound) {
-					printf("Error: invalid protocol %s specified. -P accepts udp|sctp\n", policystr);
+					printf("Error: invalid protocol %s specified. -P accepts udp|sctp|xdp|shm\n", policystr);
 					exit(FAIL);
 				}
 				break;
@@ -386,6 +434,17 @@ static void setup_knet(int argc, char *argv[])
 				if (!strcmp("perf-by-time", optarg)) {
 					test_type = TEST_PERF_BY_TIME;
 				}
+				if (!strcmp("perf-latency", optarg)) {
+					test_type = TEST_PERF_LATENCY;
+				}
+				break;
+			case 'R':
+				rv = atoi(optarg);
+				if ((rv < 0) || (rv > 255)) {
+					printf("Error: -R priority out of range %d (0 - 255)\n", rv);
+					exit(FAIL);
+				}
+				ctrl_priority = (uint8_t)rv;
 				break;
 			case 'S':
 				perf_by_size_size = (uint64_t)atoi(optarg) * ONE_GIGABYTE;
@@ -442,14 +501,14 @@ static void setup_knet(int argc, char *argv[])
 		}
 	}
 
-	if (((test_type == TEST_PERF_BY_SIZE) || (test_type == TEST_PERF_BY_TIME)) && (senderid < 0)) {
+	if (((test_type == TEST_PERF_BY_SIZE) || (test_type == TEST_PERF_BY_TIME) || (test_type == TEST_PERF_LATENCY)) && (senderid < 0)) {
 		printf("Error: performance test requires -s to be set (for now)\n");
 		exit(FAIL);
 	}
 
 	logfd = start_logging(stdout);
 
-	knet_h = knet_handle_new(thisnodeid, logfd, debug, 0);
+	knet_h = knet_handle_new(thisnodeid, logfd, debug, handle_flags);
 	if (!knet_h) {
 		printf("Unable to knet_handle_new: %s\n", strerror(errno));
 		exit(FAIL);
@@ -502,6 +561,23 @@ static void setup_knet(int argc, char *argv[])
 		exit(FAIL);
 	}
 
+	if (test_type == TEST_PERF_LATENCY) {
+		ctrl_datafd = 0;
+		ctrl_channel = -1;
+
+		if (knet_handle_add_datafd(knet_h, &ctrl_datafd, &ctrl_channel) < 0) {
+			printf("knet_handle_add_datafd failed: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			exit(FAIL);
+		}
+
+		if (knet_handle_set_channel_priority(knet_h, ctrl_channel, ctrl_priority) < 0) {
+			printf("knet_handle_set_channel_priority failed: %s\n", strerror(errno));
+			knet_handle_free(knet_h);
+			exit(FAIL);
+		}
+	}
+
 	if (knet_handle_pmtud_setfreq(knet_h, pmtud_interval) < 0) {
 		printf("knet_handle_pmtud_setfreq failed: %s\n", strerror(errno));
 		knet_handle_free(knet_h);
@@ -624,6 +700,49 @@ static void setup_knet(int argc, char *argv[])
 	}
 }
 
+static void handle_latency_probes(void)
+{
+	struct latency_probe probe;
+	struct timespec now;
+	unsigned long long rtt;
+	ssize_t len;
+
+	while ((len = recv(ctrl_datafd, &probe, sizeof(probe), MSG_DONTWAIT)) > 0) {
+		if (len != sizeof(probe)) {
+			printf("[info]: RXT: received %zd bytes probe?\n", len);
+			continue;
+		}
+		if (senderid != thisnodeid) {
+			/*
+			 * echo requests back to the sender, ignore replies
+			 * from other nodes
+			 */
+			if (probe.reply) {
+				continue;
+			}
+			probe.reply = 1;
+			if (knet_send(knet_h, (char *)&probe, sizeof(probe), ctrl_channel) != sizeof(probe)) {
+				printf("[info]: RXT: unable to reply to probe: %s\n", strerror(errno));
+			}
+			continue;
+		}
+		if (!probe.reply) {
+			continue;
+		}
+		if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+			printf("[info]: unable to get probe time!\n");
+			continue;
+		}
+		timespec_diff(probe.sent, now, &rtt);
+		pthread_mutex_lock(&latency_mutex);
+		if (latency_samples_count < latency_samples_max) {
+			latency_samples[latency_samples_count] = rtt;
+			latency_samples_count++;
+		}
+		pthread_mutex_unlock(&latency_mutex);
+	}
+}
+
 static void *_rx_thread(void *args)
 {
 	int rx_epoll;
@@ -671,13 +790,30 @@ static void *_rx_thread(void *args)
 		return NULL;
 	}
 
+	if (ctrl_datafd) {
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = EPOLLIN;
+		ev.data.fd = ctrl_datafd;
+
+		if (epoll_ctl(rx_epoll, EPOLL_CTL_ADD, ctrl_datafd, &ev)) {
+			printf("RXT: Unable to add ctrl_datafd to epoll\nHALTING RX THREAD!\n");
+			return NULL;
+		}
+	}
+
 	memset(&clock_start, 0, sizeof(clock_start));
 	memset(&clock_end, 0, sizeof(clock_start));
 
 	while (!bench_shutdown_in_progress) {
 		if (epoll_wait(rx_epoll, events, KNET_EPOLL_MAX_EVENTS, 1) >= 1) {
+			if (ctrl_datafd) {
+				handle_latency_probes();
+			}
 			msg_recv = _recvmmsg(datafd, &msg[0], PCKT_FRAG_MAX, MSG_DONTWAIT | MSG_NOSIGNAL);
 			if (msg_recv < 0) {
+				if ((ctrl_datafd) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+					continue;
+				}
 				printf("[info]: RXT: error from recvmmsg: %s\n", strerror(errno));
 			}
 			switch(test_type) {
@@ -691,6 +827,7 @@ static void *_rx_thread(void *args)
 					break;
 				case TEST_PERF_BY_TIME:
 				case TEST_PERF_BY_SIZE:
+				case TEST_PERF_LATENCY:
 					for (i = 0; i < msg_recv; i++) {
 						if (msg[i].msg_len < 64) {
 							if (msg[i].msg_len == 0) {
@@ -746,6 +883,9 @@ static void *_rx_thread(void *args)
 	}
 
 	epoll_ctl(rx_epoll, EPOLL_CTL_DEL, datafd, &ev);
+	if (ctrl_datafd) {
+		epoll_ctl(rx_epoll, EPOLL_CTL_DEL, ctrl_datafd, &ev);
+	}
 	close(rx_epoll);
 
 	return NULL;
@@ -939,6 +1079,43 @@ static int node_compare(const void *aptr, const void *bptr)
 	return a > b;
 }
 
+static void display_histogram(const char *prefix, const char *name, struct knet_histogram *histogram)
+{
+	if (!histogram->count) {
+		return;
+	}
+
+	printf("[stat]: %s%s (nsecs): count %" PRIu64 " min %" PRIu64 " p50 %" PRIu64 " p90 %" PRIu64
+	       " p99 %" PRIu64 " p999 %" PRIu64 " max %" PRIu64 "\n",
+	       prefix, name, histogram->count, histogram->min,
+	       knet_histogram_percentile(histogram, 50),
+	       knet_histogram_percentile(histogram, 90),
+	       knet_histogram_percentile(histogram, 99),
+	       knet_histogram_percentile(histogram, 99.9),
+	       histogram->max);
+}
+
+static void display_handle_histograms(void)
+{
+	struct knet_histogram histogram;
+	const char *names[KNET_HISTOGRAM_MAX] = {
+		"tx_crypt_time", "rx_crypt_time",
+		"tx_compress_time", "rx_compress_time",
+		"tx_queue_time" };
+	uint8_t i;
+
+	printf("\n");
+	printf("[stat]: handle latency histograms\n");
+	printf("[stat]: -------------------------\n");
+	for (i = 0; i < KNET_HISTOGRAM_MAX; i++) {
+		if (knet_handle_get_histogram(knet_h, i, &histogram) < 0) {
+			perror("[info]: failed to get knet handle histogram");
+			return;
+		}
+		display_histogram(" ", names[i], &histogram);
+	}
+}
+
 static void display_stats(int level)
 {
 	struct knet_handle_stats handle_stats;
@@ -991,6 +1168,9 @@ static void display_stats(int level)
 			printf("\n");
 		}
 	}
+	if (level > 3) {
+		display_handle_histograms();
+	}
 	if (level < 2) {
 		return;
 	}
@@ -1052,6 +1232,11 @@ static void display_stats(int level)
 			total_link_stats.tx_pong_retries += link_status.stats.tx_pong_retries;
 			total_link_stats.tx_data_errors += link_status.stats.tx_data_errors;
 			total_link_stats.tx_data_retries += link_status.stats.tx_data_retries;
+			total_link_stats.tx_data_queued += link_status.stats.tx_data_queued;
+			total_link_stats.tx_data_queue_drops += link_status.stats.tx_data_queue_drops;
+			total_link_stats.tx_data_paced += link_status.stats.tx_data_paced;
+			total_link_stats.tx_data_gso_packets += link_status.stats.tx_data_gso_packets;
+			total_link_stats.tx_data_gso_segments += link_status.stats.tx_data_gso_segments;
 
 			total_link_stats.down_count += link_status.stats.down_count;
 			total_link_stats.up_count += link_status.stats.up_count;
@@ -1092,6 +1277,11 @@ static void display_stats(int level)
 				printf("[stat]:   tx_pong_retries:  %" PRIu32 "\n", link_status.stats.tx_pong_retries);
 				printf("[stat]:   tx_data_errors:   %" PRIu32 "\n", link_status.stats.tx_data_errors);
 				printf("[stat]:   tx_data_retries:  %" PRIu32 "\n", link_status.stats.tx_data_retries);
+				printf("[stat]:   tx_data_queued:   %" PRIu64 "\n", link_status.stats.tx_data_queued);
+				printf("[stat]:   tx_data_queue_drops: %" PRIu64 "\n", link_status.stats.tx_data_queue_drops);
+				printf("[stat]:   tx_data_paced:    %" PRIu64 "\n", link_status.stats.tx_data_paced);
+				printf("[stat]:   tx_data_gso_packets: %" PRIu64 "\n", link_status.stats.tx_data_gso_packets);
+				printf("[stat]:   tx_data_gso_segments: %" PRIu64 "\n", link_status.stats.tx_data_gso_segments);
 
 				printf("[stat]:   latency_min:      %" PRIu32 "\n", link_status.stats.latency_min);
 				printf("[stat]:   latency_max:      %" PRIu32 "\n", link_status.stats.latency_max);
@@ -1101,6 +1291,13 @@ static void display_stats(int level)
 				printf("[stat]:   down_count:       %" PRIu32 "\n", link_status.stats.down_count);
 				printf("[stat]:   up_count:         %" PRIu32 "\n", link_status.stats.up_count);
 			}
+			if (level > 3) {
+				struct knet_histogram rtt_histogram;
+
+				if (knet_link_get_rtt_histogram(knet_h, host_list[j], link_list[i], &rtt_histogram) == 0) {
+					display_histogram("  ", "rtt", &rtt_histogram);
+				}
+			}
 		}
 	}
 	printf("\n");
@@ -1138,6 +1335,11 @@ static void display_stats(int level)
 	printf("[stat]: tx_pong_retries:  %" PRIu32 "\n", total_link_stats.tx_pong_retries);
 	printf("[stat]: tx_data_errors:   %" PRIu32 "\n", total_link_stats.tx_data_errors);
 	printf("[stat]: tx_data_retries:  %" PRIu32 "\n", total_link_stats.tx_data_retries);
+	printf("[stat]: tx_data_queued:   %" PRIu64 "\n", total_link_stats.tx_data_queued);
+	printf("[stat]: tx_data_queue_drops: %" PRIu64 "\n", total_link_stats.tx_data_queue_drops);
+	printf("[stat]: tx_data_paced:    %" PRIu64 "\n", total_link_stats.tx_data_paced);
+	printf("[stat]: tx_data_gso_packets: %" PRIu64 "\n", total_link_stats.tx_data_gso_packets);
+	printf("[stat]: tx_data_gso_segments: %" PRIu64 "\n", total_link_stats.tx_data_gso_segments);
 
 	printf("[stat]: down_count:       %" PRIu32 "\n", total_link_stats.down_count);
 	printf("[stat]: up_count:         %" PRIu32 "\n", total_link_stats.up_count);
@@ -1214,6 +1416,180 @@ static void send_perf_data_by_time(void)
 	}
 }
 
+static void *_probe_thread(void *args)
+{
+	struct latency_probe probe;
+
+	memset(&probe, 0, sizeof(probe));
+
+	while (!latency_test_done) {
+		probe.seq = latency_probes_sent;
+		if (clock_gettime(CLOCK_MONOTONIC, &probe.sent) != 0) {
+			printf("[info]: unable to get probe time!\n");
+		}
+		if (knet_send(knet_h, (char *)&probe, sizeof(probe), ctrl_channel) != sizeof(probe)) {
+			printf("[info]: unable to send probe: %s\n", strerror(errno));
+		} else {
+			latency_probes_sent++;
+		}
+		usleep(LATENCY_PROBE_INTERVAL);
+	}
+
+	return NULL;
+}
+
+static int latency_compare(const void *aptr, const void *bptr)
+{
+	const unsigned long long *a = aptr;
+	const unsigned long long *b = bptr;
+
+	if (*a < *b) {
+		return -1;
+	}
+	if (*a > *b) {
+		return 1;
+	}
+	return 0;
+}
+
+static double latency_percentile(double percentile)
+{
+	uint64_t idx;
+
+	idx = (uint64_t)((percentile / 100) * (latency_samples_count - 1));
+
+	return (double)latency_samples[idx] / 1000;
+}
+
+static void display_latency(void)
+{
+	unsigned long long total = 0;
+	uint64_t i;
+
+	pthread_mutex_lock(&latency_mutex);
+
+	if (!latency_samples_count) {
+		printf("[info]: no probe replies received\n");
+		pthread_mutex_unlock(&latency_mutex);
+		return;
+	}
+
+	qsort(latency_samples, latency_samples_count, sizeof(unsigned long long), latency_compare);
+
+	for (i = 0; i < latency_samples_count; i++) {
+		total = total + latency_samples[i];
+	}
+
+	if (!machine_output) {
+		printf("[latency] control channel priority: %u probes sent: %" PRIu32 " replies: %" PRIu64 "\n",
+		       ctrl_priority, latency_probes_sent, latency_samples_count);
+		printf("[latency] rtt usecs min: %.3f avg: %.3f p50: %.3f p99: %.3f p99.9: %.3f max: %.3f\n",
+		       (double)latency_samples[0] / 1000,
+		       ((double)total / latency_samples_count) / 1000,
+		       latency_percentile(50),
+		       latency_percentile(99),
+		       latency_percentile(99.9),
+		       (double)latency_samples[latency_samples_count - 1] / 1000);
+	} else {
+		printf("[latency],%u,%" PRIu32 ",%" PRIu64 ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+		       ctrl_priority, latency_probes_sent, latency_samples_count,
+		       (double)latency_samples[0] / 1000,
+		       ((double)total / latency_samples_count) / 1000,
+		       latency_percentile(50),
+		       latency_percentile(99),
+		       latency_percentile(99.9),
+		       (double)latency_samples[latency_samples_count - 1] / 1000);
+	}
+
+	pthread_mutex_unlock(&latency_mutex);
+}
+
+static void send_perf_latency(void)
+{
+	char *tx_buf[PCKT_FRAG_MAX];
+	struct knet_mmsghdr msg[PCKT_FRAG_MAX];
+	struct iovec iov_out[PCKT_FRAG_MAX];
+	char ctrl_message[16];
+	int sent_msgs;
+	int i;
+	struct timespec clock_start, clock_end;
+	unsigned long long time_diff = 0;
+	size_t hosts = 0;
+	knet_node_id_t host_ids[KNET_MAX_HOST];
+
+	if (knet_host_get_host_list(knet_h, host_ids, &hosts) < 0) {
+		printf("knet_host_get_host_list failed: %s\n", strerror(errno));
+		exit(FAIL);
+	}
+
+	/*
+	 * one sample per probe per remote host, with some slack
+	 * for probes sent during the final sleep
+	 */
+	pthread_mutex_lock(&latency_mutex);
+	latency_samples_count = 0;
+	latency_samples_max = (((perf_by_time_secs + 2) * 1000000) / LATENCY_PROBE_INTERVAL + 1) * (hosts ? hosts : 1);
+	free(latency_samples);
+	latency_samples = malloc(latency_samples_max * sizeof(unsigned long long));
+	pthread_mutex_unlock(&latency_mutex);
+	if (!latency_samples) {
+		printf("Unable to allocate latency samples\n");
+		exit(FAIL);
+	}
+
+	setup_send_buffers_common(msg, iov_out, tx_buf);
+
+	memset(&clock_start, 0, sizeof(clock_start));
+	memset(&clock_end, 0, sizeof(clock_start));
+
+	for (i = 0; i < PCKT_FRAG_MAX; i++) {
+		iov_out[i].iov_len = KNET_MAX_PACKET_SIZE;
+	}
+	printf("[info]: testing control channel latency with %u bytes bulk packet size for %" PRIu64 " seconds.\n", KNET_MAX_PACKET_SIZE, perf_by_time_secs);
+
+	latency_probes_sent = 0;
+	latency_test_done = 0;
+
+	memset(ctrl_message, 0, sizeof(ctrl_message));
+	knet_send(knet_h, ctrl_message, TEST_START, channel);
+
+	if (pthread_create(&probe_thread, 0, _probe_thread, NULL)) {
+		printf("Unable to start probe thread\n");
+		exit(FAIL);
+	}
+
+	if (clock_gettime(CLOCK_MONOTONIC, &clock_start) != 0) {
+		printf("[info]: unable to get start time!\n");
+	}
+
+	while (time_diff < (perf_by_time_secs * 1000000000llu)) {
+		sent_msgs = send_messages(&msg[0], PCKT_FRAG_MAX);
+		if (sent_msgs < 0) {
+			printf("Something went wrong, aborting\n");
+			exit(FAIL);
+		}
+		if (clock_gettime(CLOCK_MONOTONIC, &clock_end) != 0) {
+			printf("[info]: unable to get end time!\n");
+		}
+		timespec_diff(clock_start, clock_end, &time_diff);
+	}
+
+	latency_test_done = 1;
+	pthread_join(probe_thread, NULL);
+	probe_thread = (pthread_t)NULL;
+
+	sleep(2);
+
+	knet_send(knet_h, ctrl_message, TEST_STOP, channel);
+	knet_send(knet_h, ctrl_message, TEST_COMPLETE, channel);
+
+	display_latency();
+
+	for (i = 0; i < PCKT_FRAG_MAX; i++) {
+		free(tx_buf[i]);
+	}
+}
+
 static void cleanup_all(void)
 {
 	if (pthread_mutex_lock(&shutdown_mutex)) {
@@ -1233,6 +1609,7 @@ static void cleanup_all(void)
 		stop_rx_thread();
 	}
 	knet_handle_stop(knet_h);
+	free(latency_samples);
 }
 
 static void sigint_handler(int signum)
@@ -1274,6 +1651,16 @@ restart:
 				}
 			}
 			break;
+		case TEST_PERF_LATENCY:
+			if (senderid == thisnodeid) {
+				send_perf_latency();
+			} else {
+				printf("[info]: waiting for perf rx thread to finish\n");
+				while(!wait_for_perf_rx) {
+					sleep(1);
+				}
+			}
+			break;
 		case TEST_PERF_BY_TIME:
 			if (senderid == thisnodeid) {
 				send_perf_data_by_time();
@@ -18,6 +18,8 @@
 #include "crypto.h"
 #include "links.h"
 #include "logging.h"
+#include "relay.h"
+#include "stats_shm.h"
 #include "transports.h"
 #include "threads_common.h"
 #include "threads_heartbeat.h"
@@ -85,9 +87,7 @@ static void _handle_check_each(knet_handle_t knet_h, struct knet_host *dst_host,
 		}
 
 retry:
-		len = sendto(dst_link->outsock, outbuf, outlen,
-			MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *) &dst_link->dst_addr,
-			sizeof(struct sockaddr_storage));
+		len = transport_tx_sendto(knet_h, dst_link, outbuf, outlen, MSG_DONTWAIT | MSG_NOSIGNAL);
 		savederrno = errno;
 
 		dst_link->ping_last = clock_now;
@@ -213,6 +213,10 @@ void *_handle_heartbt_thread(void *data)
 
 		_send_pings(knet_h, 1);
 
+		_relay_timer(knet_h);
+
+		_stats_shm_timer(knet_h);
+
 		pthread_rwlock_unlock(&knet_h->global_rwlock);
 	}
 
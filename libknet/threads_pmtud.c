@@ -15,9 +15,11 @@
 #include <pthread.h>
 
 #include "crypto.h"
+#include "events.h"
 #include "links.h"
 #include "host.h"
 #include "logging.h"
+#include "probes.h"
 #include "transports.h"
 #include "threads_common.h"
 #include "threads_pmtud.h"
@@ -172,9 +174,7 @@ restart:
 		return -1;
 	}
 retry:
-	len = sendto(dst_link->outsock, outbuf, data_len,
-			MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *) &dst_link->dst_addr,
-			sizeof(struct sockaddr_storage));
+	len = transport_tx_sendto(knet_h, dst_link, outbuf, data_len, MSG_DONTWAIT | MSG_NOSIGNAL);
 	savederrno = errno;
 
 	/*
@@ -240,6 +240,7 @@ retry:
 		dst_link->last_recv_mtu = 0;
 		dst_link->status.stats.tx_pmtu_packets++;
 		dst_link->status.stats.tx_pmtu_bytes += data_len;
+		KNET_PROBE(pmtud_step, dst_host->host_id, dst_link->link_id, 0, onwire_len);
 
 		if (clock_gettime(CLOCK_REALTIME, &ts) < 0) {
 			log_debug(knet_h, KNET_SUB_PMTUD, "Unable to get current time: %s", strerror(errno));
@@ -544,7 +545,9 @@ void *_handle_pmtud_link_thread(void *data)
 				knet_h->data_mtu = lower_mtu;
 				log_info(knet_h, KNET_SUB_PMTUD, "Global data MTU changed to: %u", knet_h->data_mtu);
 
-				if (knet_h->pmtud_notify_fn) {
+				if (knet_h->event_queue) {
+					_event_pmtud(knet_h, knet_h->data_mtu);
+				} else if (knet_h->pmtud_notify_fn) {
 					knet_h->pmtud_notify_fn(knet_h->pmtud_notify_fn_private_data,
 								knet_h->data_mtu);
 				}
@@ -10,6 +10,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/uio.h>
@@ -18,14 +19,20 @@
 #include "compat.h"
 #include "compress.h"
 #include "crypto.h"
+#include "events.h"
+#include "histogram.h"
 #include "host.h"
 #include "links.h"
 #include "logging.h"
+#include "probes.h"
+#include "relay.h"
+#include "stage_stats.h"
 #include "transports.h"
 #include "transport_common.h"
 #include "threads_common.h"
 #include "threads_heartbeat.h"
 #include "threads_rx.h"
+#include "uring.h"
 #include "netutils.h"
 
 /*
@@ -116,14 +123,92 @@ static int find_pckt_defrag_buf(knet_handle_t knet_h, struct knet_header *inbuf)
 			oldest = i;
 		}
 	}
+	KNET_PROBE(rx_defrag_expire, src_host->host_id, KNET_MAX_LINK,
+		   src_host->defrag_buf[oldest].pckt_seq, src_host->defrag_buf[oldest].frag_recv);
 	src_host->defrag_buf[oldest].in_use = 0;
 	return oldest;
 }
 
+/*
+ * rebuild missing data fragments from FEC parity.
+ * each parity group can recover one missing fragment.
+ */
+static void pckt_fec_recover(struct knet_host_defrag_buf *defrag_buf, uint8_t frag_num)
+{
+	int fec_idx, frag_idx, missing, missing_idx;
+	size_t i, frag_len, src_len;
+	unsigned char *dst, *src;
+
+	if ((!defrag_buf->fec_recv) || (defrag_buf->frag_recv == frag_num)) {
+		return;
+	}
+
+	/*
+	 * parity tells us the fragment size, so we can move
+	 * the last fragment to its final location now
+	 */
+	if (defrag_buf->last_first) {
+		memmove(defrag_buf->buf + ((frag_num - 1) * defrag_buf->frag_size),
+			defrag_buf->buf + (KNET_MAX_PACKET_SIZE - defrag_buf->last_frag_size),
+			defrag_buf->last_frag_size);
+		defrag_buf->last_first = 0;
+	}
+
+	for (fec_idx = 0; fec_idx < defrag_buf->fec; fec_idx++) {
+		if (!defrag_buf->frag_map[frag_num + fec_idx + 1]) {
+			continue;
+		}
+
+		missing = 0;
+		missing_idx = 0;
+		for (frag_idx = fec_idx; frag_idx < frag_num; frag_idx = frag_idx + defrag_buf->fec) {
+			if (!defrag_buf->frag_map[frag_idx + 1]) {
+				missing++;
+				missing_idx = frag_idx;
+			}
+		}
+
+		if (missing != 1) {
+			continue;
+		}
+
+		if (missing_idx == frag_num - 1) {
+			frag_len = defrag_buf->last_frag_size;
+		} else {
+			frag_len = defrag_buf->frag_size;
+		}
+
+		dst = (unsigned char *)defrag_buf->buf + (missing_idx * defrag_buf->frag_size);
+		memmove(dst, defrag_buf->fec_buf + (fec_idx * defrag_buf->frag_size), frag_len);
+
+		for (frag_idx = fec_idx; frag_idx < frag_num; frag_idx = frag_idx + defrag_buf->fec) {
+			if (frag_idx == missing_idx) {
+				continue;
+			}
+			src = (unsigned char *)defrag_buf->buf + (frag_idx * defrag_buf->frag_size);
+			if (frag_idx == frag_num - 1) {
+				src_len = defrag_buf->last_frag_size;
+			} else {
+				src_len = defrag_buf->frag_size;
+			}
+			if (src_len > frag_len) {
+				src_len = frag_len;
+			}
+			for (i = 0; i < src_len; i++) {
+				dst[i] ^= src[i];
+			}
+		}
+
+		defrag_buf->frag_recv++;
+		defrag_buf->frag_map[missing_idx + 1] = 1;
+	}
+}
+
 static int pckt_defrag(knet_handle_t knet_h, struct knet_header *inbuf, ssize_t *len)
 {
 	struct knet_host_defrag_buf *defrag_buf;
 	int defrag_buf_idx;
+	char *fec_buf;
 
 	defrag_buf_idx = find_pckt_defrag_buf(knet_h, inbuf);
 	if (defrag_buf_idx < 0) {
@@ -137,9 +222,12 @@ static int pckt_defrag(knet_handle_t knet_h, struct knet_header *inbuf, ssize_t
 
 	/*
 	 * if the buf is not is use, then make sure it's clean
+	 * (the parity storage is kept around for the next FEC pckt)
 	 */
 	if (!defrag_buf->in_use) {
+		fec_buf = defrag_buf->fec_buf;
 		memset(defrag_buf, 0, sizeof(struct knet_host_defrag_buf));
+		defrag_buf->fec_buf = fec_buf;
 		defrag_buf->in_use = 1;
 		defrag_buf->pckt_seq = inbuf->khp_data_seq_num;
 	}
@@ -160,6 +248,57 @@ static int pckt_defrag(knet_handle_t knet_h, struct knet_header *inbuf, ssize_t
 		return 1;
 	}
 
+	/*
+	 * FEC parity fragments are stored apart and used only
+	 * to rebuild missing data fragments
+	 */
+
+	if (inbuf->khp_data_frag_seq > inbuf->khp_data_frag_num) {
+		uint16_t frag_size, last_frag_size;
+
+		if ((inbuf->khp_data_frag_seq > inbuf->khp_data_frag_num + inbuf->khp_data_fec) ||
+		    (inbuf->khp_data_frag_num + inbuf->khp_data_fec >= PCKT_FRAG_MAX) ||
+		    (*len <= (ssize_t)KNET_FEC_TRAILER_SIZE)) {
+			log_debug(knet_h, KNET_SUB_RX, "Received invalid FEC fragment");
+			return 1;
+		}
+
+		frag_size = *len - KNET_FEC_TRAILER_SIZE;
+		memmove(&last_frag_size, inbuf->khp_data_userdata + frag_size, KNET_FEC_TRAILER_SIZE);
+		last_frag_size = ntohs(last_frag_size);
+
+		if ((last_frag_size > frag_size) ||
+		    ((defrag_buf->frag_size) && (defrag_buf->frag_size != frag_size)) ||
+		    ((inbuf->khp_data_fec * frag_size) > KNET_MAX_PACKET_SIZE) ||
+		    (((inbuf->khp_data_frag_num - 1) * frag_size) + last_frag_size > KNET_MAX_PACKET_SIZE)) {
+			log_debug(knet_h, KNET_SUB_RX, "Received invalid FEC fragment");
+			return 1;
+		}
+
+		/*
+		 * only hosts sending FEC pckts need parity storage
+		 */
+		if (!defrag_buf->fec_buf) {
+			defrag_buf->fec_buf = malloc(KNET_MAX_PACKET_SIZE);
+			if (!defrag_buf->fec_buf) {
+				log_debug(knet_h, KNET_SUB_RX, "Unable to allocate FEC buffer: %s", strerror(errno));
+				return 1;
+			}
+		}
+
+		defrag_buf->frag_size = frag_size;
+		defrag_buf->last_frag_size = last_frag_size;
+		defrag_buf->fec = inbuf->khp_data_fec;
+
+		memmove(defrag_buf->fec_buf + ((inbuf->khp_data_frag_seq - inbuf->khp_data_frag_num - 1) * frag_size),
+			inbuf->khp_data_userdata, frag_size);
+
+		defrag_buf->fec_recv++;
+		defrag_buf->frag_map[inbuf->khp_data_frag_seq] = 1;
+
+		goto check_complete;
+	}
+
 	/*
 	 *  we need to handle the last packet with gloves due to its different size
 	 */
@@ -191,6 +330,9 @@ static int pckt_defrag(knet_handle_t knet_h, struct knet_header *inbuf, ssize_t
 	defrag_buf->frag_recv++;
 	defrag_buf->frag_map[inbuf->khp_data_frag_seq] = 1;
 
+check_complete:
+	pckt_fec_recover(defrag_buf, inbuf->khp_data_frag_num);
+
 	/*
 	 * check if we received all the fragments
 	 */
@@ -226,6 +368,139 @@ static int pckt_defrag(knet_handle_t knet_h, struct knet_header *inbuf, ssize_t
 	return 1;
 }
 
+/*
+ * returns 0 if the message has been delivered to the channel datafd
+ * (or rx_notify_fn),
+ * 1 if the message is not for us and -1 on error
+ */
+static int _deliver_data(knet_handle_t knet_h, knet_node_id_t src_node_id, int8_t channel,
+			 unsigned char *data, ssize_t data_len)
+{
+	ssize_t outlen;
+	struct iovec iov_out[1];
+	knet_node_id_t dst_host_ids[KNET_MAX_HOST];
+	size_t dst_host_ids_entries = 0;
+	int bcast = 1;
+
+	if (knet_h->dst_host_filter_fn) {
+		size_t host_idx;
+		int found = 0;
+
+		bcast = knet_h->dst_host_filter_fn(
+				knet_h->dst_host_filter_fn_private_data,
+				(const unsigned char *)data,
+				data_len,
+				KNET_NOTIFY_RX,
+				knet_h->host_id,
+				src_node_id,
+				&channel,
+				dst_host_ids,
+				&dst_host_ids_entries);
+		if (bcast < 0) {
+			log_debug(knet_h, KNET_SUB_RX, "Error from dst_host_filter_fn: %d", bcast);
+			return -1;
+		}
+
+		if ((!bcast) && (!dst_host_ids_entries)) {
+			log_debug(knet_h, KNET_SUB_RX, "Message is unicast but no dst_host_ids_entries");
+			return -1;
+		}
+
+		/* check if we are dst for this packet */
+		if (!bcast) {
+			if (dst_host_ids_entries > KNET_MAX_HOST) {
+				log_debug(knet_h, KNET_SUB_RX, "dst_host_filter_fn returned too many destinations");
+				return -1;
+			}
+			for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
+				if (dst_host_ids[host_idx] == knet_h->host_id) {
+					found = 1;
+					break;
+				}
+			}
+			if (!found) {
+				log_debug(knet_h, KNET_SUB_RX, "Packet is not for us");
+				return 1;
+			}
+		}
+	}
+
+	if (!knet_h->sockfd[channel].in_use) {
+		log_debug(knet_h, KNET_SUB_RX,
+			  "received packet for channel %d but there is no local sock connected",
+			  channel);
+		return -1;
+	}
+
+	if (knet_h->sockfd[channel].rx_notify_fn) {
+		knet_h->sockfd[channel].rx_notify_fn(knet_h->sockfd[channel].rx_notify_fn_private_data,
+						     data, data_len, src_node_id, channel);
+		return 0;
+	}
+
+	memset(iov_out, 0, sizeof(iov_out));
+	iov_out[0].iov_base = (void *) data;
+	iov_out[0].iov_len = data_len;
+
+	outlen = writev(knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created], iov_out, 1);
+	if (outlen <= 0) {
+		if (knet_h->event_queue) {
+			_event_sock(knet_h, knet_h->sockfd[channel].sockfd[0],
+				    channel, KNET_NOTIFY_RX, outlen, errno);
+			return -1;
+		}
+		knet_h->sock_notify_fn(knet_h->sock_notify_fn_private_data,
+				       knet_h->sockfd[channel].sockfd[0],
+				       channel,
+				       KNET_NOTIFY_RX,
+				       outlen,
+				       errno);
+		return -1;
+	}
+	if ((size_t)outlen != iov_out[0].iov_len) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * split a coalesced packet and deliver each message on its own.
+ * returns 0 if all messages have been handled, -1 on error
+ */
+static int _deliver_coalesced_data(knet_handle_t knet_h, knet_node_id_t src_node_id, int8_t channel,
+				   unsigned char *data, ssize_t data_len)
+{
+	uint16_t frame_len;
+	ssize_t offset = 0;
+	int err = 0;
+
+	while (offset < data_len) {
+		if (offset + (ssize_t)KNET_COALESCE_FRAME_SIZE > data_len) {
+			log_debug(knet_h, KNET_SUB_RX, "Coalesced packet has a truncated frame header");
+			return -1;
+		}
+		memmove(&frame_len, data + offset, KNET_COALESCE_FRAME_SIZE);
+		frame_len = ntohs(frame_len);
+		offset += KNET_COALESCE_FRAME_SIZE;
+
+		if ((!frame_len) || (offset + frame_len > data_len)) {
+			log_debug(knet_h, KNET_SUB_RX, "Coalesced packet has an invalid frame length: %u", frame_len);
+			return -1;
+		}
+
+		if (_deliver_data(knet_h, src_node_id, channel, data + offset, frame_len) < 0) {
+			err = -1;
+		}
+		knet_h->stats.rx_coalesced_msgs++;
+		offset += frame_len;
+	}
+
+	knet_h->stats.rx_coalesced_packets++;
+
+	return err;
+}
+
 static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struct knet_mmsghdr *msg)
 {
 	int err = 0, savederrno = 0;
@@ -233,9 +508,6 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 	struct knet_host *src_host;
 	struct knet_link *src_link;
 	unsigned long long latency_last;
-	knet_node_id_t dst_host_ids[KNET_MAX_HOST];
-	size_t dst_host_ids_entries = 0;
-	int bcast = 1;
 	int was_decrypted = 0;
 	uint64_t crypt_time = 0;
 	struct timespec recvtime;
@@ -243,11 +515,30 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 	unsigned char *outbuf = (unsigned char *)msg->msg_hdr.msg_iov->iov_base;
 	ssize_t len = msg->msg_len;
 	struct knet_hostinfo *knet_hostinfo;
-	struct iovec iov_out[1];
 	int8_t channel;
 	struct sockaddr_storage pckt_src;
 	seq_num_t recv_seq_num;
 	int wipe_bufs = 0;
+	const struct knet_relay_header *relay_header = NULL;
+	struct timespec stage_time = { 0 };
+
+	_stage_stats_start(knet_h, &stage_time);
+
+	/*
+	 * relayed packets: forward them if they are not for us,
+	 * otherwise strip the relay header and process them as usual
+	 */
+	if ((knet_h->relay_enabled) &&
+	    (len > (ssize_t)KNET_RELAY_HEADER_SIZE) &&
+	    (ntohl(((const struct knet_relay_header *)inbuf)->krh_magic) == KNET_RELAY_MAGIC)) {
+		relay_header = (const struct knet_relay_header *)inbuf;
+		if (ntohs(relay_header->krh_dst_node) != knet_h->host_id) {
+			_relay_forward(knet_h, (const unsigned char *)inbuf, len, msg->msg_hdr.msg_name);
+			return;
+		}
+		inbuf = (struct knet_header *)((unsigned char *)inbuf + KNET_RELAY_HEADER_SIZE);
+		len = len - KNET_RELAY_HEADER_SIZE;
+	}
 
 	if (knet_h->crypto_instance) {
 		struct timespec start_time;
@@ -261,10 +552,12 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 						    knet_h->recv_from_links_buf_decrypt,
 						    &outlen) < 0) {
 			log_debug(knet_h, KNET_SUB_RX, "Unable to decrypt/auth packet");
+			KNET_PROBE(rx_crypt_fail, 0, KNET_MAX_LINK, 0, len);
 			return;
 		}
 		clock_gettime(CLOCK_MONOTONIC, &end_time);
 		timespec_diff(start_time, end_time, &crypt_time);
+		_histogram_add(&knet_h->histograms[KNET_HISTOGRAM_RX_CRYPT], crypt_time);
 
 		if (crypt_time < knet_h->stats.rx_crypt_time_min) {
 			knet_h->stats.rx_crypt_time_min = crypt_time;
@@ -276,6 +569,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 		len = outlen;
 		inbuf = (struct knet_header *)knet_h->recv_from_links_buf_decrypt;
 		was_decrypted++;
+		_stage_stats_mark(knet_h, KNET_STAGE_RX_CRYPT, &stage_time);
 	}
 
 	if (len < (ssize_t)(KNET_HEADER_SIZE + 1)) {
@@ -295,10 +589,37 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 		return;
 	}
 
+	/*
+	 * only broadcast data is sent to the multicast group, our own
+	 * packets looped back have already been delivered via the link
+	 */
+	if ((knet_h->mcast_addr.ss_family) && (sockfd == knet_h->mcast_sockfd)) {
+		if (((inbuf->kh_type != KNET_HEADER_TYPE_DATA) &&
+		     (inbuf->kh_type != KNET_HEADER_TYPE_DATA_COALESCED)) ||
+		    (inbuf->kh_node == knet_h->host_id)) {
+			return;
+		}
+		knet_h->stats.rx_mcast_packets++;
+	}
+
+	/*
+	 * only data is relayed and it did not arrive on a link of src_host
+	 */
+	if (relay_header) {
+		if ((inbuf->kh_node != ntohs(relay_header->krh_src_node)) ||
+		    ((inbuf->kh_type & KNET_HEADER_TYPE_PMSK) != 0)) {
+			log_debug(knet_h, KNET_SUB_RX, "Invalid relayed packet from host %u", inbuf->kh_node);
+			return;
+		}
+		knet_h->stats.rx_relay_packets++;
+	}
+
 	src_link = NULL;
 
-	src_link = src_host->link +
-		(inbuf->khp_ping_link % KNET_MAX_LINK);
+	if (!relay_header) {
+		src_link = src_host->link +
+			(inbuf->khp_ping_link % KNET_MAX_LINK);
+	}
 	if ((inbuf->kh_type & KNET_HEADER_TYPE_PMSK) != 0) {
 		if (src_link->dynamic == KNET_LINK_DYNIP) {
 			/*
@@ -336,6 +657,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 	switch (inbuf->kh_type) {
 	case KNET_HEADER_TYPE_HOST_INFO:
 	case KNET_HEADER_TYPE_DATA:
+	case KNET_HEADER_TYPE_DATA_COALESCED:
 		/*
 		 * TODO: should we accept data even if we can't reply to the other node?
 		 *       how would that work with SCTP and guaranteed delivery?
@@ -354,13 +676,21 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 			src_link->status.stats.rx_data_bytes += len;
 		}
 
+		KNET_PROBE(rx_packet, src_host->host_id, src_link ? src_link->link_id : KNET_MAX_LINK,
+			   inbuf->khp_data_seq_num, len);
+
 		if (!_seq_num_lookup(src_host, inbuf->khp_data_seq_num, 0, 0)) {
-			if (src_host->link_handler_policy != KNET_LINK_POLICY_ACTIVE) {
+			KNET_PROBE(rx_dedup_drop, src_host->host_id, src_link ? src_link->link_id : KNET_MAX_LINK,
+				   inbuf->khp_data_seq_num, len);
+			if ((src_host->link_handler_policy != KNET_LINK_POLICY_ACTIVE) &&
+			    (src_host->link_handler_policy != KNET_LINK_POLICY_FEC)) {
 				log_debug(knet_h, KNET_SUB_RX, "Packet has already been delivered");
 			}
 			return;
 		}
 
+		_stage_stats_mark(knet_h, KNET_STAGE_RX_PARSE, &stage_time);
+
 		if (inbuf->khp_data_frag_num > 1) {
 			/*
 			 * len as received from the socket also includes extra stuff
@@ -369,9 +699,15 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 			 * defragging
 			 */
 			len = len - KNET_HEADER_DATA_SIZE;
-			if (pckt_defrag(knet_h, inbuf, &len)) {
+			KNET_PROBE(rx_frag, src_host->host_id, src_link ? src_link->link_id : KNET_MAX_LINK,
+				   inbuf->khp_data_seq_num, len);
+			err = pckt_defrag(knet_h, inbuf, &len);
+			_stage_stats_mark(knet_h, KNET_STAGE_RX_DEFRAG, &stage_time);
+			if (err) {
 				return;
 			}
+			KNET_PROBE(rx_defrag_done, src_host->host_id, src_link ? src_link->link_id : KNET_MAX_LINK,
+				   inbuf->khp_data_seq_num, len);
 			len = len + KNET_HEADER_DATA_SIZE;
 		}
 
@@ -391,6 +727,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 				/* Collect stats */
 				clock_gettime(CLOCK_MONOTONIC, &end_time);
 				timespec_diff(start_time, end_time, &compress_time);
+				_histogram_add(&knet_h->histograms[KNET_HISTOGRAM_RX_COMPRESS], compress_time);
 
 				if (compress_time < knet_h->stats.rx_compress_time_min) {
 					knet_h->stats.rx_compress_time_min = compress_time;
@@ -408,6 +745,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 
 				memmove(inbuf->khp_data_userdata, knet_h->recv_from_links_buf_decompress, decmp_outlen);
 				len = decmp_outlen + KNET_HEADER_DATA_SIZE;
+				_stage_stats_mark(knet_h, KNET_STAGE_RX_DECOMPRESS, &stage_time);
 			} else {
 				knet_h->stats.rx_failed_to_decompress++;
 				log_warn(knet_h, KNET_SUB_COMPRESS, "Unable to decompress packet (%d): %s",
@@ -416,7 +754,8 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 			}
 		}
 
-		if (inbuf->kh_type == KNET_HEADER_TYPE_DATA) {
+		if ((inbuf->kh_type == KNET_HEADER_TYPE_DATA) ||
+		    (inbuf->kh_type == KNET_HEADER_TYPE_DATA_COALESCED)) {
 			if (knet_h->enabled != 1) /* data forward is disabled */
 				break;
 
@@ -427,79 +766,22 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 				 crypt_time) / (knet_h->stats.rx_crypt_packets+1);
 			knet_h->stats.rx_crypt_packets++;
 
-			if (knet_h->dst_host_filter_fn) {
-				size_t host_idx;
-				int found = 0;
-
-				bcast = knet_h->dst_host_filter_fn(
-						knet_h->dst_host_filter_fn_private_data,
-						(const unsigned char *)inbuf->khp_data_userdata,
-						len - KNET_HEADER_DATA_SIZE,
-						KNET_NOTIFY_RX,
-						knet_h->host_id,
-						inbuf->kh_node,
-						&channel,
-						dst_host_ids,
-						&dst_host_ids_entries);
-				if (bcast < 0) {
-					log_debug(knet_h, KNET_SUB_RX, "Error from dst_host_filter_fn: %d", bcast);
+			if (inbuf->kh_type == KNET_HEADER_TYPE_DATA) {
+				if (_deliver_data(knet_h, inbuf->kh_node, channel,
+						  inbuf->khp_data_userdata, len - KNET_HEADER_DATA_SIZE)) {
 					return;
 				}
-
-				if ((!bcast) && (!dst_host_ids_entries)) {
-					log_debug(knet_h, KNET_SUB_RX, "Message is unicast but no dst_host_ids_entries");
+			} else {
+				if (_deliver_coalesced_data(knet_h, inbuf->kh_node, channel,
+							    inbuf->khp_data_userdata, len - KNET_HEADER_DATA_SIZE) < 0) {
 					return;
 				}
-
-				/* check if we are dst for this packet */
-				if (!bcast) {
-					if (dst_host_ids_entries > KNET_MAX_HOST) {
-						log_debug(knet_h, KNET_SUB_RX, "dst_host_filter_fn returned too many destinations");
-						return;
-					}
-					for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
-						if (dst_host_ids[host_idx] == knet_h->host_id) {
-							found = 1;
-							break;
-						}
-					}
-					if (!found) {
-						log_debug(knet_h, KNET_SUB_RX, "Packet is not for us");
-						return;
-					}
-				}
-			}
-		}
-
-		if (inbuf->kh_type == KNET_HEADER_TYPE_DATA) {
-			if (!knet_h->sockfd[channel].in_use) {
-				log_debug(knet_h, KNET_SUB_RX,
-					  "received packet for channel %d but there is no local sock connected",
-					  channel);
-				return;
-			}
-
-			memset(iov_out, 0, sizeof(iov_out));
-			iov_out[0].iov_base = (void *) inbuf->khp_data_userdata;
-			iov_out[0].iov_len = len - KNET_HEADER_DATA_SIZE;
-
-			outlen = writev(knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created], iov_out, 1);
-			if (outlen <= 0) {
-				knet_h->sock_notify_fn(knet_h->sock_notify_fn_private_data,
-						       knet_h->sockfd[channel].sockfd[0],
-						       channel,
-						       KNET_NOTIFY_RX,
-						       outlen,
-						       errno);
-				return;
-			}
-			if ((size_t)outlen == iov_out[0].iov_len) {
-				_seq_num_set(src_host, inbuf->khp_data_seq_num, 0);
 			}
+			_stage_stats_mark(knet_h, KNET_STAGE_RX_DELIVER, &stage_time);
+			_seq_num_set(src_host, inbuf->khp_data_seq_num, 0);
 		} else { /* HOSTINFO */
 			knet_hostinfo = (struct knet_hostinfo *)inbuf->khp_data_userdata;
 			if (knet_hostinfo->khi_bcast == KNET_HOSTINFO_UCAST) {
-				bcast = 0;
 				knet_hostinfo->khi_dst_node_id = ntohs(knet_hostinfo->khi_dst_node_id);
 			}
 			if (!_seq_num_lookup(src_host, inbuf->khp_data_seq_num, 0, 0)) {
@@ -510,6 +792,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 				case KNET_HOSTINFO_TYPE_LINK_UP_DOWN:
 					break;
 				case KNET_HOSTINFO_TYPE_LINK_TABLE:
+					_relay_recv_link_table(knet_h, src_host, knet_hostinfo, len - KNET_HEADER_DATA_SIZE);
 					break;
 				default:
 					log_warn(knet_h, KNET_SUB_RX, "Receiving unknown host info message from host %u", src_host->host_id);
@@ -578,9 +861,7 @@ static void _parse_recv_from_links(knet_handle_t knet_h, int sockfd, const struc
 		}
 
 retry_pong:
-		len = sendto(src_link->outsock, outbuf, outlen, MSG_DONTWAIT | MSG_NOSIGNAL,
-				(struct sockaddr *) &src_link->dst_addr,
-				sizeof(struct sockaddr_storage));
+		len = transport_tx_sendto(knet_h, src_link, outbuf, outlen, MSG_DONTWAIT | MSG_NOSIGNAL);
 		savederrno = errno;
 		if (len != outlen) {
 			err = transport_tx_sock_error(knet_h, src_link->transport_type, src_link->outsock, len, savederrno);
@@ -612,6 +893,7 @@ retry_pong:
 		memmove(&recvtime, &inbuf->khp_ping_time[0], sizeof(struct timespec));
 		timespec_diff(recvtime,
 				src_link->status.pong_last, &latency_last);
+		_histogram_add(&src_link->rtt_histogram, latency_last);
 
 		src_link->status.latency =
 			((src_link->status.latency * src_link->latency_exp) +
@@ -671,9 +953,7 @@ retry_pong:
 			goto out_pmtud;
 		}
 retry_pmtud:
-		len = sendto(src_link->outsock, outbuf, outlen, MSG_DONTWAIT | MSG_NOSIGNAL,
-				(struct sockaddr *) &src_link->dst_addr,
-				sizeof(struct sockaddr_storage));
+		len = transport_tx_sendto(knet_h, src_link, outbuf, outlen, MSG_DONTWAIT | MSG_NOSIGNAL);
 		savederrno = errno;
 		if (len != outlen) {
 			err = transport_tx_sock_error(knet_h, src_link->transport_type, src_link->outsock, len, savederrno);
@@ -715,8 +995,52 @@ out_pmtud:
 	}
 }
 
+/*
+ * split a buffer coalesced by the kernel (UDP GRO), each segment
+ * is parsed as a packet of its own.
+ *
+ * segments are copied out of the coalesced buffer first: parsing
+ * works in place and defrag writes the whole reassembled packet
+ * back in the RX buffer, that would overwrite the next segments
+ * (and the end of the buffer).
+ */
+static void _parse_gro_recv_from_links(knet_handle_t knet_h, int sockfd, const struct knet_mmsghdr *msg, size_t seg_size)
+{
+	struct knet_mmsghdr seg_msg;
+	struct iovec seg_iov;
+	unsigned char *buf = msg->msg_hdr.msg_iov->iov_base;
+	size_t offset = 0, len = msg->msg_len;
+
+	/*
+	 * the last segment of a truncated read is incomplete
+	 */
+	if (msg->msg_hdr.msg_flags & MSG_TRUNC) {
+		log_debug(knet_h, KNET_SUB_RX, "Coalesced packet has been truncated, dropping last segment");
+		len = len - (len % seg_size);
+	}
+
+	memmove(&seg_msg, msg, sizeof(struct knet_mmsghdr));
+	seg_msg.msg_hdr.msg_iov = &seg_iov;
+	seg_msg.msg_hdr.msg_iovlen = 1;
+
+	seg_iov.iov_base = knet_h->recv_from_links_buf_gro;
+
+	while (offset < len) {
+		if (len - offset > seg_size) {
+			seg_iov.iov_len = seg_size;
+		} else {
+			seg_iov.iov_len = len - offset;
+		}
+		memmove(knet_h->recv_from_links_buf_gro, buf + offset, seg_iov.iov_len);
+		seg_msg.msg_len = seg_iov.iov_len;
+		_parse_recv_from_links(knet_h, sockfd, &seg_msg);
+		offset = offset + seg_iov.iov_len;
+	}
+}
+
 static void _handle_recv_from_links(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg)
 {
+	size_t seg_size;
 	int err, savederrno;
 	int i, msg_recv, transport;
 
@@ -737,14 +1061,20 @@ static void _handle_recv_from_links(knet_handle_t knet_h, int sockfd, struct kne
 
 	/*
 	 * reset msg_namelen to buffer size because after recvmmsg
-	 * each msg_namelen will contain sizeof sockaddr_in or sockaddr_in6
+	 * each msg_namelen will contain sizeof sockaddr_in or sockaddr_in6.
+	 * same goes for msg_controllen, only UDP needs ancillary data (GRO)
 	 */
 
 	for (i = 0; i < PCKT_RX_BUFS; i++) {
 		msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+		if (transport == KNET_TRANSPORT_UDP) {
+			msg[i].msg_hdr.msg_controllen = PCKT_RX_CMSG_SIZE;
+		} else {
+			msg[i].msg_hdr.msg_controllen = 0;
+		}
 	}
 
-	msg_recv = _recvmmsg(sockfd, &msg[0], PCKT_RX_BUFS, MSG_DONTWAIT | MSG_NOSIGNAL);
+	msg_recv = transport_rx_recvmmsg(knet_h, transport, sockfd, &msg[0], PCKT_RX_BUFS, MSG_DONTWAIT | MSG_NOSIGNAL);
 	savederrno = errno;
 
 	/*
@@ -797,7 +1127,12 @@ static void _handle_recv_from_links(knet_handle_t knet_h, int sockfd, struct kne
 				goto exit_unlock;
 				break;
 			case 2: /* packet is data and should be parsed as such */
-				_parse_recv_from_links(knet_h, sockfd, &msg[i]);
+				seg_size = transport_rx_gro_size(knet_h, transport, &msg[i]);
+				if ((seg_size) && (msg[i].msg_len > seg_size)) {
+					_parse_gro_recv_from_links(knet_h, sockfd, &msg[i], seg_size);
+				} else {
+					_parse_recv_from_links(knet_h, sockfd, &msg[i]);
+				}
 				break;
 		}
 	}
@@ -806,6 +1141,235 @@ exit_unlock:
 	pthread_rwlock_unlock(&knet_h->global_rwlock);
 }
 
+/*
+ * io_uring RX engine
+ */
+
+/*
+ * move a UDP socket from epoll to io_uring. epoll keeps
+ * reporting socket errors (EPOLLERR is always reported)
+ */
+static int _uring_arm_sock(knet_handle_t knet_h, int sockfd)
+{
+	struct knet_fd_trackers *tracker = &knet_h->knet_transport_fd_tracker[sockfd];
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = 0;
+	ev.data.fd = sockfd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_MOD, sockfd, &ev) < 0) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to update socket %d on epoll pool: %s",
+			  sockfd, strerror(errno));
+		return -1;
+	}
+
+	if (uring_recvmsg(knet_h, sockfd, KNET_URING_SOCK_DATA(tracker->uring_gen, sockfd)) < 0) {
+		ev.events = EPOLLIN;
+		epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_MOD, sockfd, &ev);
+		return -1;
+	}
+
+	tracker->uring_armed = 1;
+
+	return 0;
+}
+
+/*
+ * give the socket back to epoll, it will be armed
+ * again on the next event
+ */
+static void _uring_disarm_sock(knet_handle_t knet_h, int sockfd)
+{
+	struct knet_fd_trackers *tracker = &knet_h->knet_transport_fd_tracker[sockfd];
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = sockfd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_MOD, sockfd, &ev) < 0) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to update socket %d on epoll pool: %s",
+			  sockfd, strerror(errno));
+	}
+
+	tracker->uring_armed = 0;
+}
+
+/*
+ * collect the sockets with events on the RX epoll fd. UDP sockets
+ * are moved to io_uring, the others are returned in fds to be
+ * served the usual way.
+ */
+static int _uring_handle_epoll(knet_handle_t knet_h, int *fds, int *nfds)
+{
+	struct epoll_event events[KNET_EPOLL_MAX_EVENTS];
+	struct knet_fd_trackers *tracker;
+	int i, nev, sockfd;
+
+	nev = epoll_wait(knet_h->recv_from_links_epollfd, events, KNET_EPOLL_MAX_EVENTS - *nfds, 0);
+	if (nev <= 0) {
+		return 0;
+	}
+
+	for (i = 0; i < nev; i++) {
+		sockfd = events[i].data.fd;
+
+		if (_is_valid_fd(knet_h, sockfd) < 1) {
+			continue;
+		}
+
+		tracker = &knet_h->knet_transport_fd_tracker[sockfd];
+
+		if (tracker->uring_armed) {
+			transport_rx_sock_error(knet_h, tracker->transport, sockfd, -1, EAGAIN);
+			continue;
+		}
+
+		if ((tracker->transport == KNET_TRANSPORT_UDP) &&
+		    (!_uring_arm_sock(knet_h, sockfd))) {
+			continue;
+		}
+
+		fds[*nfds] = sockfd;
+		(*nfds)++;
+	}
+
+	return nev;
+}
+
+static void _uring_recv_from_links(knet_handle_t knet_h, int sockfd, int32_t res, uint32_t flags)
+{
+	struct knet_mmsghdr msg;
+	struct iovec iov;
+	size_t seg_size;
+	int transport = knet_h->knet_transport_fd_tracker[sockfd].transport;
+
+	memset(&msg, 0, sizeof(struct knet_mmsghdr));
+	msg.msg_hdr.msg_iov = &iov;
+
+	if (uring_get_msg(knet_h, res, flags, &msg) < 0) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to parse io_uring recvmsg buffer");
+		return;
+	}
+
+	if (transport_rx_is_data(knet_h, transport, sockfd, &msg) != 2) {
+		return;
+	}
+
+	seg_size = transport_rx_gro_size(knet_h, transport, &msg);
+	if ((seg_size) && (msg.msg_len > seg_size)) {
+		_parse_gro_recv_from_links(knet_h, sockfd, &msg, seg_size);
+	} else {
+		_parse_recv_from_links(knet_h, sockfd, &msg);
+	}
+}
+
+/*
+ * reap all the completions. Returns 1 if the epoll fd
+ * had events and needs to be checked again.
+ */
+static int _handle_uring_cqes(knet_handle_t knet_h, struct knet_mmsghdr *msg, int epoll_pending)
+{
+	struct knet_fd_trackers *tracker;
+	uint64_t user_data;
+	int32_t res;
+	uint32_t flags;
+	int fds[KNET_EPOLL_MAX_EVENTS];
+	int i, sockfd, nfds = 0, rearm_poll = 0;
+
+	if (pthread_rwlock_rdlock(&knet_h->global_rwlock) != 0) {
+		log_debug(knet_h, KNET_SUB_RX, "Unable to get global read lock");
+		return epoll_pending;
+	}
+
+	while (uring_get_cqe(knet_h, &user_data, &res, &flags)) {
+		if (user_data == KNET_URING_CANCEL_DATA) {
+			continue;
+		}
+
+		if (user_data == KNET_URING_EPOLL_DATA) {
+			if (!(flags & KNET_URING_CQE_MORE)) {
+				rearm_poll = 1;
+			}
+			epoll_pending = 1;
+			continue;
+		}
+
+		sockfd = KNET_URING_SOCK_FD(user_data);
+		tracker = &knet_h->knet_transport_fd_tracker[sockfd];
+
+		/*
+		 * the socket is gone or has been reassigned
+		 */
+		if ((_is_valid_fd(knet_h, sockfd) < 1) ||
+		    (!tracker->uring_armed) ||
+		    (tracker->uring_gen != KNET_URING_SOCK_GEN(user_data))) {
+			uring_put_buf(knet_h, flags);
+			continue;
+		}
+
+		if (res >= 0) {
+			_uring_recv_from_links(knet_h, sockfd, res, flags);
+		} else if ((res == -EINVAL) && (!(flags & KNET_URING_CQE_MORE))) {
+			uring_disable_recvmsg(knet_h);
+		} else if (res != -ENOBUFS) {
+			transport_rx_sock_error(knet_h, tracker->transport, sockfd, -1, -res);
+		}
+
+		uring_put_buf(knet_h, flags);
+
+		if (!(flags & KNET_URING_CQE_MORE)) {
+			_uring_disarm_sock(knet_h, sockfd);
+		}
+	}
+
+	if (rearm_poll) {
+		if (uring_poll_epoll(knet_h) < 0) {
+			log_err(knet_h, KNET_SUB_RX, "Unable to poll epoll fd via io_uring: %s",
+				strerror(errno));
+		}
+	}
+
+	/*
+	 * io_uring is only woken up by new epoll events,
+	 * check again till epoll has nothing left to report
+	 */
+	if (epoll_pending) {
+		epoll_pending = (_uring_handle_epoll(knet_h, fds, &nfds) > 0);
+	}
+
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	for (i = 0; i < nfds; i++) {
+		_handle_recv_from_links(knet_h, fds[i], msg);
+	}
+
+	return epoll_pending;
+}
+
+static void _handle_recv_from_links_uring(knet_handle_t knet_h, struct knet_mmsghdr *msg)
+{
+	int epoll_pending = 1;
+
+	if (uring_poll_epoll(knet_h) < 0) {
+		log_err(knet_h, KNET_SUB_RX, "Unable to poll epoll fd via io_uring: %s",
+			strerror(errno));
+	}
+
+	while (!shutdown_in_progress(knet_h)) {
+		if (!epoll_pending) {
+			if ((uring_wait(knet_h, knet_h->threads_timer_res) < 0) &&
+			    (errno != ETIME) && (errno != EINTR)) {
+				log_debug(knet_h, KNET_SUB_RX, "Unable to wait for io_uring completions: %s",
+					  strerror(errno));
+			}
+		}
+
+		epoll_pending = _handle_uring_cqes(knet_h, msg, epoll_pending);
+	}
+}
+
 void *_handle_recv_from_links_thread(void *data)
 {
 	int i, nev;
@@ -814,6 +1378,10 @@ void *_handle_recv_from_links_thread(void *data)
 	struct sockaddr_storage address[PCKT_RX_BUFS];
 	struct knet_mmsghdr msg[PCKT_RX_BUFS];
 	struct iovec iov_in[PCKT_RX_BUFS];
+	union {
+		char buf[PCKT_RX_CMSG_SIZE];
+		struct cmsghdr align;
+	} control[PCKT_RX_BUFS];
 
 	set_thread_status(knet_h, KNET_THREAD_RX, KNET_THREAD_STARTED);
 
@@ -829,6 +1397,12 @@ void *_handle_recv_from_links_thread(void *data)
 		msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
 		msg[i].msg_hdr.msg_iov = &iov_in[i];
 		msg[i].msg_hdr.msg_iovlen = 1;
+		msg[i].msg_hdr.msg_control = control[i].buf;
+		msg[i].msg_hdr.msg_controllen = 0;
+	}
+
+	if (knet_h->uring) {
+		_handle_recv_from_links_uring(knet_h, msg);
 	}
 
 	while (!shutdown_in_progress(knet_h)) {
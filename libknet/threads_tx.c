@@ -10,18 +10,26 @@
 #include "config.h"
 
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/uio.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 
 #include "compat.h"
 #include "compress.h"
 #include "crypto.h"
+#include "events.h"
+#include "histogram.h"
 #include "host.h"
 #include "link.h"
+#include "links.h"
 #include "logging.h"
+#include "probes.h"
+#include "relay.h"
+#include "stage_stats.h"
 #include "transports.h"
 #include "transport_common.h"
 #include "threads_common.h"
@@ -33,559 +41,2146 @@
  * SEND
  */
 
-static int _dispatch_to_links(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_mmsghdr *msg, int msgs_to_send)
+/*
+ * per link TX queue.
+ * When a link socket cannot take more data, the packets left to send
+ * are queued on the link and the TX thread is notified (EPOLLOUT) when
+ * the socket becomes writable again. This way a slow or congested
+ * destination does not delay traffic to all the others, unless the
+ * application opted in for KNET_LINK_TXQ_POLICY_BACKPRESSURE.
+ */
+
+/*
+ * pacing: token bucket refilled at link->rate bytes per second,
+ * up to link->burst bytes
+ */
+static void _pacing_refill(struct knet_link *cur_link)
 {
-	int link_idx, msg_idx, sent_msgs, prev_sent, progress;
-	int err = 0, savederrno = 0;
+	struct timespec now;
+	unsigned long long elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_diff(cur_link->tokens_last, now, &elapsed);
+	cur_link->tokens_last = now;
+
+	cur_link->tokens += ((double)cur_link->rate * elapsed) / 1000000000llu;
+	if (cur_link->tokens > cur_link->burst) {
+		cur_link->tokens = cur_link->burst;
+	}
+}
+
+/*
+ * usecs to wait for the token bucket to have room for more data
+ */
+static useconds_t _pacing_delay(struct knet_link *cur_link)
+{
+	if (cur_link->tokens > 0) {
+		return 0;
+	}
+
+	return (useconds_t)(((-cur_link->tokens + 1) * 1000000) / cur_link->rate) + 1;
+}
+
+static size_t _msg_len(struct knet_mmsghdr *msg)
+{
+	size_t len = 0;
 	unsigned int i;
-	struct knet_mmsghdr *cur;
-	struct knet_link *cur_link;
 
-	for (link_idx = 0; link_idx < dst_host->active_link_entries; link_idx++) {
-		sent_msgs = 0;
-		prev_sent = 0;
-		progress = 1;
+	/* Cast for Linux/BSD compatibility */
+	for (i = 0; i < (unsigned int)msg->msg_hdr.msg_iovlen; i++) {
+		len += msg->msg_hdr.msg_iov[i].iov_len;
+	}
+
+	return len;
+}
 
-		cur_link = &dst_host->link[dst_host->active_links[link_idx]];
+/*
+ * data is accounted for only once the transport accepted it,
+ * returns the number of bytes accounted for
+ */
+static size_t _tx_account(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_link *cur_link,
+			  struct knet_mmsghdr *msg, int sent_msgs, seq_num_t seq_num)
+{
+	int msg_idx;
+	size_t frag_len, tx_len = 0;
+
+	for (msg_idx = 0; msg_idx < sent_msgs; msg_idx++) {
+		frag_len = _msg_len(&msg[msg_idx]);
+		cur_link->status.stats.tx_data_bytes += frag_len;
+		cur_link->status.stats.tx_data_packets++;
+		KNET_PROBE(tx_frag, dst_host->host_id, cur_link->link_id, seq_num, frag_len);
+		tx_len += frag_len;
+	}
 
-		if (cur_link->transport_type == KNET_TRANSPORT_LOOPBACK) {
-			continue;
-		}
+	return tx_len;
+}
 
-		msg_idx = 0;
-		while (msg_idx < msgs_to_send) {
-			msg[msg_idx].msg_hdr.msg_name = &cur_link->dst_addr;
+/*
+ * arm the pacing timer to expire when the first
+ * paced link can send again, or disarm it
+ */
+static void _pacing_set_timer(knet_handle_t knet_h)
+{
+	struct itimerspec its;
+	struct knet_host *host;
+	struct knet_link *cur_link;
+	uint8_t link_id;
 
-			/* Cast for Linux/BSD compatibility */
-			for (i=0; i<(unsigned int)msg[msg_idx].msg_hdr.msg_iovlen; i++) {
-				cur_link->status.stats.tx_data_bytes += msg[msg_idx].msg_hdr.msg_iov[i].iov_len;
+	memset(&its, 0, sizeof(struct itimerspec));
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		for (link_id = 0; link_id < KNET_MAX_LINK; link_id++) {
+			cur_link = &host->link[link_id];
+			if (!cur_link->txq_paced) {
+				continue;
+			}
+			if (((!its.it_value.tv_sec) && (!its.it_value.tv_nsec)) ||
+			    (cur_link->txq_next.tv_sec < its.it_value.tv_sec) ||
+			    ((cur_link->txq_next.tv_sec == its.it_value.tv_sec) &&
+			     (cur_link->txq_next.tv_nsec < its.it_value.tv_nsec))) {
+				its.it_value = cur_link->txq_next;
 			}
-			cur_link->status.stats.tx_data_packets++;
-			msg_idx++;
 		}
+	}
 
-retry:
-		cur = &msg[prev_sent];
+	if (timerfd_settime(knet_h->pacing_timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		log_debug(knet_h, KNET_SUB_TX, "Unable to set pacing timer: %s", strerror(errno));
+	}
+}
 
-		sent_msgs = _sendmmsg(dst_host->link[dst_host->active_links[link_idx]].outsock,
-				      &cur[0], msgs_to_send - prev_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
-		savederrno = errno;
+static void _txq_arm(knet_handle_t knet_h, struct knet_link *cur_link)
+{
+	struct epoll_event ev;
 
-		err = transport_tx_sock_error(knet_h, dst_host->link[dst_host->active_links[link_idx]].transport_type, dst_host->link[dst_host->active_links[link_idx]].outsock, sent_msgs, savederrno);
-		switch(err) {
-			case -1: /* unrecoverable error */
-				cur_link->status.stats.tx_data_errors++;
-				goto out_unlock;
-				break;
-			case 0: /* ignore error and continue */
-				break;
-			case 1: /* retry to send those same data */
-				cur_link->status.stats.tx_data_retries++;
-				goto retry;
-				break;
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLOUT | EPOLLONESHOT;
+	ev.data.fd = cur_link->outsock;
+
+	/*
+	 * the socket might be shared between links and
+	 * already known to the epoll
+	 */
+	if (epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_MOD, cur_link->outsock, &ev)) {
+		if ((errno != ENOENT) ||
+		    (epoll_ctl(knet_h->send_to_links_epollfd, EPOLL_CTL_ADD, cur_link->outsock, &ev))) {
+			log_debug(knet_h, KNET_SUB_TX, "Unable to add socket %d to linkfd epoll pool: %s",
+				  cur_link->outsock, strerror(errno));
 		}
+	}
+}
 
-		prev_sent = prev_sent + sent_msgs;
+/*
+ * queued data is sent either when the link socket becomes writable
+ * or, for paced links, when there are enough tokens
+ */
+static void _txq_schedule(knet_handle_t knet_h, struct knet_link *cur_link)
+{
+	useconds_t delay;
+
+	if (cur_link->rate) {
+		_pacing_refill(cur_link);
+		delay = _pacing_delay(cur_link);
+		if (delay) {
+			clock_gettime(CLOCK_MONOTONIC, &cur_link->txq_next);
+			cur_link->txq_next.tv_nsec += (long)delay * 1000;
+			cur_link->txq_next.tv_sec += cur_link->txq_next.tv_nsec / 1000000000;
+			cur_link->txq_next.tv_nsec = cur_link->txq_next.tv_nsec % 1000000000;
+			cur_link->txq_paced = 1;
+			_pacing_set_timer(knet_h);
+			return;
+		}
+	}
 
-		if ((sent_msgs >= 0) && (prev_sent < msgs_to_send)) {
-			if ((sent_msgs) || (progress)) {
-				if (sent_msgs) {
-					progress = 1;
-				} else {
-					progress = 0;
-				}
-#ifdef DEBUG
-				log_debug(knet_h, KNET_SUB_TX, "Unable to send all (%d/%d) data packets to host %s (%u) link %s:%s (%u)",
-					  sent_msgs, msg_idx,
-					  dst_host->name, dst_host->host_id,
-					  dst_host->link[dst_host->active_links[link_idx]].status.dst_ipaddr,
-					  dst_host->link[dst_host->active_links[link_idx]].status.dst_port,
-					  dst_host->link[dst_host->active_links[link_idx]].link_id);
-#endif
-				goto retry;
-			}
-			if (!progress) {
-				savederrno = EAGAIN;
-				err = -1;
-				goto out_unlock;
-			}
+	_txq_arm(knet_h, cur_link);
+}
+
+/*
+ * the TX thread stops reading from the datafds as soon as a backpressure
+ * queue is full, so only the packet it is already processing can go past
+ * txq_len. Direct senders don't stop, they get EAGAIN before anything is
+ * sent instead (see _txq_dst_have_room).
+ */
+static void _txq_enqueue(knet_handle_t knet_h, struct knet_link *cur_link, struct knet_mmsghdr *msg, int msgs_to_queue)
+{
+	struct knet_txq_msg *txq_msg;
+	int was_empty = (cur_link->txq_head == NULL);
+	int msg_idx;
+	size_t len, offset;
+	unsigned int i;
+
+	for (msg_idx = 0; msg_idx < msgs_to_queue; msg_idx++) {
+		if ((cur_link->txq_count >= cur_link->txq_len) &&
+		    (cur_link->txq_policy == KNET_LINK_TXQ_POLICY_DROP)) {
+			cur_link->status.stats.tx_data_queue_drops++;
+			continue;
 		}
 
-		if ((dst_host->link_handler_policy == KNET_LINK_POLICY_RR) &&
-		    (dst_host->active_link_entries > 1)) {
-			uint8_t cur_link_id = dst_host->active_links[0];
+		len = _msg_len(&msg[msg_idx]);
 
-			memmove(&dst_host->active_links[0], &dst_host->active_links[1], KNET_MAX_LINK - 1);
-			dst_host->active_links[dst_host->active_link_entries - 1] = cur_link_id;
+		txq_msg = malloc(sizeof(struct knet_txq_msg) + len);
+		if (!txq_msg) {
+			log_debug(knet_h, KNET_SUB_TX, "Unable to allocate memory for TX queue");
+			cur_link->status.stats.tx_data_queue_drops++;
+			continue;
+		}
 
-			break;
+		offset = 0;
+		for (i = 0; i < (unsigned int)msg[msg_idx].msg_hdr.msg_iovlen; i++) {
+			memmove(txq_msg->buf + offset, msg[msg_idx].msg_hdr.msg_iov[i].iov_base, msg[msg_idx].msg_hdr.msg_iov[i].iov_len);
+			offset += msg[msg_idx].msg_hdr.msg_iov[i].iov_len;
 		}
+		txq_msg->channel = knet_h->tx_channel;
+		txq_msg->seq_num = knet_h->tx_seq_num;
+		clock_gettime(CLOCK_MONOTONIC, &txq_msg->queued);
+		txq_msg->len = len;
+		txq_msg->next = NULL;
+
+		if (cur_link->txq_tail) {
+			cur_link->txq_tail->next = txq_msg;
+		} else {
+			cur_link->txq_head = txq_msg;
+		}
+		cur_link->txq_tail = txq_msg;
+		cur_link->txq_count++;
+		cur_link->status.stats.tx_data_queued++;
 	}
 
-out_unlock:
-	errno = savederrno;
-	return err;
+	if ((was_empty) && (cur_link->txq_head)) {
+		_txq_schedule(knet_h, cur_link);
+	}
+
+	_link_txq_update_blocked(knet_h, cur_link);
 }
 
-static int _parse_recv_from_sock(knet_handle_t knet_h, size_t inlen, int8_t channel, int is_sync)
+static void _txq_drain(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_link *cur_link)
 {
-	size_t outlen, frag_len;
-	struct knet_host *dst_host;
-	knet_node_id_t dst_host_ids_temp[KNET_MAX_HOST];
-	size_t dst_host_ids_entries_temp = 0;
-	knet_node_id_t dst_host_ids[KNET_MAX_HOST];
-	size_t dst_host_ids_entries = 0;
-	int bcast = 1;
-	struct knet_hostinfo *knet_hostinfo;
-	struct iovec iov_out[PCKT_FRAG_MAX][2];
-	int iovcnt_out = 2;
-	uint8_t frag_idx;
-	unsigned int temp_data_mtu;
-	size_t host_idx;
-	int send_mcast = 0;
-	struct knet_header *inbuf;
-	int savederrno = 0;
-	int err = 0;
-	seq_num_t tx_seq_num;
 	struct knet_mmsghdr msg[PCKT_FRAG_MAX];
-	int msgs_to_send, msg_idx;
-	unsigned int i;
-	int j;
-	int send_local = 0;
-	int data_compressed = 0;
-	size_t uncrypted_frag_size;
+	struct iovec iov_out[PCKT_FRAG_MAX];
+	struct knet_txq_msg *txq_msg;
+	int msg_idx, msgs_to_send, sent_msgs, failed_msgs;
+	struct timespec now;
+	uint64_t queue_time;
+	seq_num_t seq_num = 0;
+	size_t tx_len = 0;
 
-	inbuf = knet_h->recv_from_sock_buf;
+	cur_link->txq_paced = 0;
 
-	if ((knet_h->enabled != 1) &&
-	    (inbuf->kh_type != KNET_HEADER_TYPE_HOST_INFO)) { /* data forward is disabled */
-		log_debug(knet_h, KNET_SUB_TX, "Received data packet but forwarding is disabled");
-		savederrno = ECANCELED;
-		err = -1;
-		goto out_unlock;
-	}
+	while (cur_link->txq_head) {
+		memset(&msg, 0, sizeof(msg));
 
-	/*
-	 * move this into a separate function to expand on
-	 * extra switching rules
-	 */
-	switch(inbuf->kh_type) {
-		case KNET_HEADER_TYPE_DATA:
-			if (knet_h->dst_host_filter_fn) {
-				bcast = knet_h->dst_host_filter_fn(
-						knet_h->dst_host_filter_fn_private_data,
-						(const unsigned char *)inbuf->khp_data_userdata,
-						inlen,
-						KNET_NOTIFY_TX,
-						knet_h->host_id,
-						knet_h->host_id,
-						&channel,
-						dst_host_ids_temp,
-						&dst_host_ids_entries_temp);
-				if (bcast < 0) {
-					log_debug(knet_h, KNET_SUB_TX, "Error from dst_host_filter_fn: %d", bcast);
-					savederrno = EFAULT;
-					err = -1;
-					goto out_unlock;
-				}
+		if (cur_link->rate) {
+			_pacing_refill(cur_link);
+		}
 
-				if ((!bcast) && (!dst_host_ids_entries_temp)) {
-					log_debug(knet_h, KNET_SUB_TX, "Message is unicast but no dst_host_ids_entries");
-					savederrno = EINVAL;
-					err = -1;
-					goto out_unlock;
+		/*
+		 * each batch carries data from one channel only,
+		 * transports can map channels to different streams
+		 */
+		knet_h->tx_channel = cur_link->txq_head->channel;
+
+		msgs_to_send = 0;
+		for (txq_msg = cur_link->txq_head;
+		     (txq_msg) && (msgs_to_send < PCKT_FRAG_MAX) &&
+		     (txq_msg->channel == knet_h->tx_channel);
+		     txq_msg = txq_msg->next) {
+			if (cur_link->rate) {
+				if (cur_link->tokens <= 0) {
+					break;
 				}
+				cur_link->tokens -= txq_msg->len;
+			}
+			iov_out[msgs_to_send].iov_base = txq_msg->buf;
+			iov_out[msgs_to_send].iov_len = txq_msg->len;
+			msg[msgs_to_send].msg_hdr.msg_name = &cur_link->dst_addr;
+			msg[msgs_to_send].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			msg[msgs_to_send].msg_hdr.msg_iov = &iov_out[msgs_to_send];
+			msg[msgs_to_send].msg_hdr.msg_iovlen = 1;
+			msgs_to_send++;
+		}
 
-				if ((!bcast) &&
-				    (dst_host_ids_entries_temp > KNET_MAX_HOST)) {
-					log_debug(knet_h, KNET_SUB_TX, "dst_host_filter_fn returned too many destinations");
-					savederrno = EINVAL;
-					err = -1;
-					goto out_unlock;
-				}
+		if (!msgs_to_send) {
+			break;
+		}
+
+		sent_msgs = transport_tx_sendmmsg(knet_h, cur_link, &msg[0], msgs_to_send, MSG_DONTWAIT | MSG_NOSIGNAL);
+		failed_msgs = 0;
+		if (sent_msgs < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS)) {
+				sent_msgs = 0;
+			} else {
+				/*
+				 * drop the packet at the head of the queue
+				 * rather than trying to send it forever
+				 */
+				log_debug(knet_h, KNET_SUB_TX, "Unable to send queued data to link %u: %s",
+					  cur_link->link_id, strerror(errno));
+				cur_link->status.stats.tx_data_errors++;
+				sent_msgs = 1;
+				failed_msgs = 1;
 			}
+		}
 
-			/* Send to localhost if appropriate and enabled */
-			if (knet_h->has_loop_link) {
-				send_local = 0;
-				if (bcast) {
-					send_local = 1;
-				} else {
-					for (i=0; i< dst_host_ids_entries_temp; i++) {
-						if (dst_host_ids_temp[i] == knet_h->host_id) {
-							send_local = 1;
-						}
-					}
+		/*
+		 * give back the tokens of what could not be sent
+		 */
+		if (cur_link->rate) {
+			txq_msg = cur_link->txq_head;
+			for (msg_idx = 0; msg_idx < msgs_to_send; msg_idx++) {
+				if (msg_idx >= sent_msgs) {
+					cur_link->tokens += txq_msg->len;
 				}
-				if (send_local) {
-					const unsigned char *buf = inbuf->khp_data_userdata;
-					ssize_t buflen = inlen;
-					struct knet_link *local_link;
-
-					local_link = knet_h->host_index[knet_h->host_id]->link;
+				txq_msg = txq_msg->next;
+			}
+		}
 
-				local_retry:
-					err = write(knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created], buf, buflen);
-					if (err < 0) {
-						log_err(knet_h, KNET_SUB_TRANSP_LOOPBACK, "send local failed. error=%s\n", strerror(errno));
-						local_link->status.stats.tx_data_errors++;
-					}
-					if (err > 0 && err < buflen) {
-						log_debug(knet_h, KNET_SUB_TRANSP_LOOPBACK, "send local incomplete=%d bytes of %zu\n", err, inlen);
-						local_link->status.stats.tx_data_retries++;
-						buf += err;
-						buflen -= err;
-						usleep(knet_h->threads_timer_res / 16);
-						goto local_retry;
-					}
-					if (err == buflen) {
-						local_link->status.stats.tx_data_packets++;
-						local_link->status.stats.tx_data_bytes += inlen;
-					}
+		if (sent_msgs > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		}
+		for (msg_idx = 0; msg_idx < sent_msgs; msg_idx++) {
+			txq_msg = cur_link->txq_head;
+			cur_link->txq_head = txq_msg->next;
+			if (!failed_msgs) {
+				/*
+				 * fragments of the same packet are queued back to back
+				 */
+				if ((tx_len) && (txq_msg->seq_num != seq_num)) {
+					KNET_PROBE(tx_packet, dst_host->host_id, cur_link->link_id, seq_num, tx_len);
+					tx_len = 0;
 				}
+				seq_num = txq_msg->seq_num;
+				tx_len += _tx_account(knet_h, dst_host, cur_link, &msg[msg_idx], 1, seq_num);
 			}
+			timespec_diff(txq_msg->queued, now, &queue_time);
+			_histogram_add(&knet_h->histograms[KNET_HISTOGRAM_TX_QUEUE], queue_time);
+			free(txq_msg);
+			cur_link->txq_count--;
+		}
+		if (!cur_link->txq_head) {
+			cur_link->txq_tail = NULL;
+		}
+
+		if (sent_msgs < msgs_to_send) {
 			break;
-		case KNET_HEADER_TYPE_HOST_INFO:
-			knet_hostinfo = (struct knet_hostinfo *)inbuf->khp_data_userdata;
-			if (knet_hostinfo->khi_bcast == KNET_HOSTINFO_UCAST) {
-				bcast = 0;
-				dst_host_ids_temp[0] = knet_hostinfo->khi_dst_node_id;
-				dst_host_ids_entries_temp = 1;
-				knet_hostinfo->khi_dst_node_id = htons(knet_hostinfo->khi_dst_node_id);
+		}
+	}
+
+	if (tx_len) {
+		KNET_PROBE(tx_packet, dst_host->host_id, cur_link->link_id, seq_num, tx_len);
+	}
+
+	if (cur_link->txq_head) {
+		_txq_schedule(knet_h, cur_link);
+	}
+
+	_link_txq_update_blocked(knet_h, cur_link);
+}
+
+/*
+ * sockfd is writable again, drain the queues of all
+ * the links using it
+ */
+static void _handle_txq_writable(knet_handle_t knet_h, int sockfd)
+{
+	struct knet_host *host;
+	uint8_t link_id;
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		for (link_id = 0; link_id < KNET_MAX_LINK; link_id++) {
+			if ((host->link[link_id].configured) &&
+			    (host->link[link_id].outsock == sockfd) &&
+			    (host->link[link_id].txq_head)) {
+				_txq_drain(knet_h, host, &host->link[link_id]);
 			}
-			break;
-		default:
-			log_warn(knet_h, KNET_SUB_TX, "Receiving unknown messages from socket");
-			savederrno = ENOMSG;
-			err = -1;
-			goto out_unlock;
-			break;
+		}
 	}
+}
 
-	if (is_sync) {
-		if ((bcast) ||
-		    ((!bcast) && (dst_host_ids_entries_temp > 1))) {
-			log_debug(knet_h, KNET_SUB_TX, "knet_send_sync is only supported with unicast packets for one destination");
-			savederrno = E2BIG;
-			err = -1;
-			goto out_unlock;
+/*
+ * data that could not be sent is queued and will take
+ * tokens again when sent from the queue
+ */
+static void _pacing_refund(struct knet_link *cur_link, struct knet_mmsghdr *msg, int msgs)
+{
+	int msg_idx;
+
+	if (!cur_link->rate) {
+		return;
+	}
+
+	for (msg_idx = 0; msg_idx < msgs; msg_idx++) {
+		cur_link->tokens += _msg_len(&msg[msg_idx]);
+	}
+}
+
+/*
+ * send the queued data of the paced links that
+ * have enough tokens again
+ */
+static void _handle_pacing_timer(knet_handle_t knet_h)
+{
+	uint64_t expirations;
+	struct timespec now;
+	struct knet_host *host;
+	struct knet_link *cur_link;
+	uint8_t link_id;
+
+	if (read(knet_h->pacing_timerfd, &expirations, sizeof(expirations)) < 0) {
+		if (errno != EAGAIN) {
+			log_debug(knet_h, KNET_SUB_TX, "Unable to read pacing timer: %s", strerror(errno));
 		}
 	}
 
-	/*
-	 * check destinations hosts before spending time
-	 * in fragmenting/encrypting packets to save
-	 * time processing data for unreachable hosts.
-	 * for unicast, also remap the destination data
-	 * to skip unreachable hosts.
-	 */
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	if (!bcast) {
-		dst_host_ids_entries = 0;
-		for (host_idx = 0; host_idx < dst_host_ids_entries_temp; host_idx++) {
-			dst_host = knet_h->host_index[dst_host_ids_temp[host_idx]];
-			if (!dst_host) {
-				continue;
-			}
-			if (!(dst_host->host_id == knet_h->host_id &&
-			     knet_h->has_loop_link) &&
-			    dst_host->status.reachable) {
-				dst_host_ids[dst_host_ids_entries] = dst_host_ids_temp[host_idx];
-				dst_host_ids_entries++;
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		for (link_id = 0; link_id < KNET_MAX_LINK; link_id++) {
+			cur_link = &host->link[link_id];
+			if ((cur_link->txq_paced) &&
+			    ((cur_link->txq_next.tv_sec < now.tv_sec) ||
+			     ((cur_link->txq_next.tv_sec == now.tv_sec) &&
+			      (cur_link->txq_next.tv_nsec <= now.tv_nsec)))) {
+				_txq_drain(knet_h, host, cur_link);
 			}
 		}
-		if (!dst_host_ids_entries) {
-			savederrno = EHOSTDOWN;
-			err = -1;
-			goto out_unlock;
+	}
+
+	_pacing_set_timer(knet_h);
+}
+
+static unsigned int _tx_flags(knet_handle_t knet_h, struct knet_link *cur_link)
+{
+	unsigned int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+
+#ifdef MSG_ZEROCOPY
+	if ((knet_h->tx_zerocopy_buf) && (cur_link->transport_zerocopy)) {
+		flags |= MSG_ZEROCOPY;
+	}
+#endif
+
+	return flags;
+}
+
+static int _dispatch_to_link(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_link *cur_link, struct knet_mmsghdr *msg, int msgs_to_send)
+{
+	int msg_idx, sent_msgs, prev_sent, progress;
+	int paced_msgs = 0, paced_idx = 0;
+	int err = 0, savederrno = 0;
+	struct knet_mmsghdr *cur;
+	size_t tx_len = 0;
+
+	sent_msgs = 0;
+	prev_sent = 0;
+	progress = 1;
+
+	if (cur_link->transport_type == KNET_TRANSPORT_LOOPBACK) {
+		tx_len = _tx_account(knet_h, dst_host, cur_link, msg, msgs_to_send, knet_h->tx_seq_num);
+		goto out_unlock;
+	}
+
+	for (msg_idx = 0; msg_idx < msgs_to_send; msg_idx++) {
+		msg[msg_idx].msg_hdr.msg_name = &cur_link->dst_addr;
+	}
+
+	/*
+	 * keep packets in order behind the ones already queued
+	 */
+	if ((cur_link->txq_len) && (cur_link->txq_head)) {
+		if (cur_link->txq_paced) {
+			cur_link->status.stats.tx_data_paced += msgs_to_send;
 		}
-	} else {
-		send_mcast = 0;
-		for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
-			if (!(dst_host->host_id == knet_h->host_id &&
-			      knet_h->has_loop_link) &&
-			    dst_host->status.reachable) {
-				send_mcast = 1;
+		_txq_enqueue(knet_h, cur_link, msg, msgs_to_send);
+		goto out_unlock;
+	}
+
+	/*
+	 * pacing: send what the token bucket allows and queue the rest
+	 * (paced links always have a TX queue, see knet_link_set_rate)
+	 */
+	if (cur_link->rate) {
+		_pacing_refill(cur_link);
+		for (paced_idx = 0; paced_idx < msgs_to_send; paced_idx++) {
+			if (cur_link->tokens <= 0) {
 				break;
 			}
+			cur_link->tokens -= _msg_len(&msg[paced_idx]);
 		}
-		if (!send_mcast) {
-			savederrno = EHOSTDOWN;
-			err = -1;
+		paced_msgs = msgs_to_send - paced_idx;
+		msgs_to_send = paced_idx;
+		cur_link->status.stats.tx_data_paced += paced_msgs;
+		if (!msgs_to_send) {
 			goto out_unlock;
 		}
 	}
 
-	if (!knet_h->data_mtu) {
-		/*
-		 * using MIN_MTU_V4 for data mtu is not completely accurate but safe enough
-		 */
-		log_debug(knet_h, KNET_SUB_TX,
-			  "Received data packet but data MTU is still unknown."
-			  " Packet might not be delivered."
-			  " Assuming minimum IPv4 MTU (%d)",
-			  KNET_PMTUD_MIN_MTU_V4);
-		temp_data_mtu = KNET_PMTUD_MIN_MTU_V4;
-	} else {
-		/*
-		 * take a copy of the mtu to avoid value changing under
-		 * our feet while we are sending a fragmented pckt
-		 */
-		temp_data_mtu = knet_h->data_mtu;
+retry:
+	cur = &msg[prev_sent];
+
+	sent_msgs = transport_tx_sendmmsg(knet_h, cur_link,
+					  &cur[0], msgs_to_send - prev_sent, _tx_flags(knet_h, cur_link));
+	savederrno = errno;
+
+	if ((sent_msgs < 0) && (cur_link->txq_len) &&
+	    ((savederrno == EAGAIN) || (savederrno == EWOULDBLOCK))) {
+		_pacing_refund(cur_link, cur, msgs_to_send - prev_sent);
+		_txq_enqueue(knet_h, cur_link, cur, msgs_to_send - prev_sent);
+		savederrno = 0;
+		goto out_unlock;
 	}
 
-	/*
-	 * compress data
-	 */
-	if ((knet_h->compress_model > 0) && (inlen > knet_h->compress_threshold)) {
-		size_t cmp_outlen = KNET_DATABUFSIZE_COMPRESS;
-		struct timespec start_time;
-		struct timespec end_time;
-		uint64_t compress_time;
+	err = transport_tx_sock_error(knet_h, cur_link->transport_type, cur_link->outsock, sent_msgs, savederrno);
+	switch(err) {
+		case -1: /* unrecoverable error */
+			cur_link->status.stats.tx_data_errors++;
+			goto out_unlock;
+			break;
+		case 0: /* ignore error and continue */
+			break;
+		case 1: /* retry to send those same data */
+			cur_link->status.stats.tx_data_retries++;
+			KNET_PROBE(tx_retry, dst_host->host_id, cur_link->link_id, knet_h->tx_seq_num, msgs_to_send - prev_sent);
+			goto retry;
+			break;
+	}
 
-		clock_gettime(CLOCK_MONOTONIC, &start_time);
-		err = compress(knet_h,
-			       (const unsigned char *)inbuf->khp_data_userdata, inlen,
-			       knet_h->send_to_links_buf_compress, (ssize_t *)&cmp_outlen);
-		if (err < 0) {
-			knet_h->stats.tx_failed_to_compress++;
-			log_warn(knet_h, KNET_SUB_COMPRESS, "Compression failed (%d): %s", err, strerror(errno));
-		} else {
-			/* Collect stats */
-			clock_gettime(CLOCK_MONOTONIC, &end_time);
-			timespec_diff(start_time, end_time, &compress_time);
+	if (sent_msgs > 0) {
+		tx_len += _tx_account(knet_h, dst_host, cur_link, cur, sent_msgs, knet_h->tx_seq_num);
+	}
 
-	                if (compress_time < knet_h->stats.tx_compress_time_min) {
-				knet_h->stats.tx_compress_time_min = compress_time;
+	prev_sent = prev_sent + sent_msgs;
+
+	if ((sent_msgs >= 0) && (prev_sent < msgs_to_send)) {
+		if ((sent_msgs) || (progress)) {
+			if (sent_msgs) {
+				progress = 1;
+			} else {
+				progress = 0;
 			}
-			if (compress_time > knet_h->stats.tx_compress_time_max) {
-				knet_h->stats.tx_compress_time_max = compress_time;
+#ifdef DEBUG
+			log_debug(knet_h, KNET_SUB_TX, "Unable to send all (%d/%d) data packets to host %s (%u) link %s:%s (%u)",
+				  sent_msgs, msg_idx,
+				  dst_host->name, dst_host->host_id,
+				  cur_link->status.dst_ipaddr,
+				  cur_link->status.dst_port,
+				  cur_link->link_id);
+#endif
+			KNET_PROBE(tx_retry, dst_host->host_id, cur_link->link_id, knet_h->tx_seq_num, msgs_to_send - prev_sent);
+			goto retry;
+		}
+		if (!progress) {
+			if (cur_link->txq_len) {
+				_pacing_refund(cur_link, &msg[prev_sent], msgs_to_send - prev_sent);
+				_txq_enqueue(knet_h, cur_link, &msg[prev_sent], msgs_to_send - prev_sent);
+				savederrno = 0;
+				goto out_unlock;
 			}
-			knet_h->stats.tx_compress_time_ave =
-				(unsigned long long)(knet_h->stats.tx_compress_time_ave * knet_h->stats.tx_compressed_packets +
-				 compress_time) / (knet_h->stats.tx_compressed_packets+1);
+			cur_link->status.stats.tx_data_errors++;
+			/*
+			 * part of the packet is already out, the caller
+			 * must not send it again
+			 */
+			if (prev_sent) {
+				savederrno = 0;
+				goto out_unlock;
+			}
+			savederrno = EAGAIN;
+			err = -1;
+			goto out_unlock;
+		}
+	}
 
-			knet_h->stats.tx_compressed_packets++;
-			knet_h->stats.tx_compressed_original_bytes += inlen;
-			knet_h->stats.tx_compressed_size_bytes += cmp_outlen;
+out_unlock:
+	if ((paced_msgs) && (!err)) {
+		_txq_enqueue(knet_h, cur_link, &msg[paced_idx], paced_msgs);
+	}
+	if (tx_len) {
+		KNET_PROBE(tx_packet, dst_host->host_id, cur_link->link_id, knet_h->tx_seq_num, tx_len);
+	}
+	errno = savederrno;
+	return err;
+}
 
-			if (cmp_outlen < inlen) {
-				memmove(inbuf->khp_data_userdata, knet_h->send_to_links_buf_compress, cmp_outlen);
-				inlen = cmp_outlen;
-				data_compressed = 1;
+/*
+ * FEC policy: data fragments of the same parity group are spread
+ * over different links and the group parity fragment goes to yet
+ * another link, so that losing one link only costs one fragment
+ * per parity group.
+ */
+static int _dispatch_to_links_fec(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_mmsghdr *msg, int msgs_to_send, int fec_msgs_to_send)
+{
+	int link_idx, msg_idx, group_idx, link_msgs_to_send;
+	int err = 0, savederrno = 0, sent_links = 0;
+	struct knet_mmsghdr link_msg[PCKT_FRAG_MAX];
+
+	/*
+	 * no parity has been generated for this packet (not fragmented
+	 * or too many fragments), duplicate it on 2 links instead
+	 */
+	if (!fec_msgs_to_send) {
+		for (link_idx = 0; (link_idx < dst_host->active_link_entries) && (link_idx < 2); link_idx++) {
+			if (_dispatch_to_link(knet_h, dst_host, &dst_host->link[dst_host->active_links[link_idx]], msg, msgs_to_send)) {
+				savederrno = errno;
+				err = -1;
 			} else {
-				knet_h->stats.tx_unable_to_compress++;
+				sent_links++;
 			}
 		}
+		goto out;
 	}
-	if (knet_h->compress_model > 0 && !data_compressed) {
-		knet_h->stats.tx_uncompressed_packets++;
+
+	for (link_idx = 0; link_idx < dst_host->active_link_entries; link_idx++) {
+		link_msgs_to_send = 0;
+
+		for (msg_idx = 0; msg_idx < msgs_to_send + fec_msgs_to_send; msg_idx++) {
+			if (msg_idx < msgs_to_send) {
+				/*
+				 * position of the data fragment in its parity group
+				 */
+				group_idx = msg_idx / fec_msgs_to_send;
+			} else {
+				/*
+				 * parity goes after the last data fragment of its group
+				 */
+				group_idx = (msgs_to_send - (msg_idx - msgs_to_send) + fec_msgs_to_send - 1) / fec_msgs_to_send;
+			}
+			if ((group_idx % dst_host->active_link_entries) == link_idx) {
+				memmove(&link_msg[link_msgs_to_send], &msg[msg_idx], sizeof(struct knet_mmsghdr));
+				link_msgs_to_send++;
+			}
+		}
+
+		if (!link_msgs_to_send) {
+			continue;
+		}
+
+		if (_dispatch_to_link(knet_h, dst_host, &dst_host->link[dst_host->active_links[link_idx]], link_msg, link_msgs_to_send)) {
+			savederrno = errno;
+			err = -1;
+		} else {
+			sent_links++;
+		}
 	}
 
+out:
 	/*
-	 * prepare the outgoing buffers
+	 * the packet went out on some links, sending it
+	 * again would only duplicate it
 	 */
+	if (sent_links) {
+		return 0;
+	}
+	errno = savederrno;
+	return err;
+}
 
-	frag_len = inlen;
-	frag_idx = 0;
+/*
+ * send the packet to the relay host with a relay header in front,
+ * parity fragments are not sent, there is only one path
+ */
+static int _dispatch_to_relay(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_host *via_host,
+			      struct knet_mmsghdr *msg, int msgs_to_send)
+{
+	struct knet_relay_header relay_header;
+	struct knet_mmsghdr relay_msg[PCKT_FRAG_MAX];
+	struct iovec relay_iov[PCKT_FRAG_MAX][3];
+	struct knet_zerocopy_buf *zc_buf = knet_h->tx_zerocopy_buf;
+	int msg_idx, err, savederrno;
+	unsigned int i;
 
-	inbuf->khp_data_bcast = bcast;
-	inbuf->khp_data_frag_num = ceil((float)inlen / temp_data_mtu);
-	inbuf->khp_data_channel = channel;
-	if (data_compressed) {
-		inbuf->khp_data_compress = knet_h->compress_model;
-	} else {
-		inbuf->khp_data_compress = 0;
-	}
+	relay_header.krh_magic = htonl(KNET_RELAY_MAGIC);
+	relay_header.krh_src_node = htons(knet_h->host_id);
+	relay_header.krh_dst_node = htons(dst_host->host_id);
 
-	if (pthread_mutex_lock(&knet_h->tx_seq_num_mutex)) {
-		log_debug(knet_h, KNET_SUB_TX, "Unable to get seq mutex lock");
-		goto out_unlock;
+	for (msg_idx = 0; msg_idx < msgs_to_send; msg_idx++) {
+		relay_iov[msg_idx][0].iov_base = &relay_header;
+		relay_iov[msg_idx][0].iov_len = KNET_RELAY_HEADER_SIZE;
+		/* Cast for Linux/BSD compatibility */
+		for (i = 0; i < (unsigned int)msg[msg_idx].msg_hdr.msg_iovlen; i++) {
+			relay_iov[msg_idx][i + 1] = msg[msg_idx].msg_hdr.msg_iov[i];
+		}
+		memmove(&relay_msg[msg_idx], &msg[msg_idx], sizeof(struct knet_mmsghdr));
+		relay_msg[msg_idx].msg_hdr.msg_iov = &relay_iov[msg_idx][0];
+		relay_msg[msg_idx].msg_hdr.msg_iovlen = msg[msg_idx].msg_hdr.msg_iovlen + 1;
 	}
-	knet_h->tx_seq_num++;
+
 	/*
-	 * force seq_num 0 to detect a node that has crashed and rejoining
-	 * the knet instance. seq_num 0 will clear the buffers in the RX
-	 * thread
+	 * the relay header is on the stack, the kernel must be done
+	 * with it by the time sendmsg returns
 	 */
-	if (knet_h->tx_seq_num == 0) {
-		knet_h->tx_seq_num++;
+	knet_h->tx_zerocopy_buf = NULL;
+	err = _dispatch_to_link(knet_h, via_host, &via_host->link[via_host->active_links[0]], relay_msg, msgs_to_send);
+	savederrno = errno;
+	knet_h->tx_zerocopy_buf = zc_buf;
+
+	if (!err) {
+		knet_h->stats.tx_relay_packets += msgs_to_send;
 	}
-	/*
-	 * cache the value in locked context
-	 */
-	tx_seq_num = knet_h->tx_seq_num;
-	inbuf->khp_data_seq_num = htons(knet_h->tx_seq_num);
-	pthread_mutex_unlock(&knet_h->tx_seq_num_mutex);
 
+	errno = savederrno;
+	return err;
+}
+
+static int _dispatch_to_links(knet_handle_t knet_h, struct knet_host *dst_host, struct knet_mmsghdr *msg, int msgs_to_send, int fec_msgs_to_send)
+{
+	int link_idx;
+	int err = 0, savederrno = 0, sent_links = 0;
+	struct knet_host *via_host;
+
+	via_host = _relay_get_via(knet_h, dst_host);
+	if (via_host) {
+		return _dispatch_to_relay(knet_h, dst_host, via_host, msg, msgs_to_send);
+	}
+
+	if (dst_host->link_handler_policy == KNET_LINK_POLICY_FEC) {
+		return _dispatch_to_links_fec(knet_h, dst_host, msg, msgs_to_send, fec_msgs_to_send);
+	}
+
+	for (link_idx = 0; link_idx < dst_host->active_link_entries; link_idx++) {
+		if (_dispatch_to_link(knet_h, dst_host, &dst_host->link[dst_host->active_links[link_idx]], msg, msgs_to_send)) {
+			savederrno = errno;
+			err = -1;
+			if (dst_host->link_handler_policy == KNET_LINK_POLICY_RR) {
+				goto out_unlock;
+			}
+			continue;
+		}
+		sent_links++;
+
+		if ((dst_host->link_handler_policy == KNET_LINK_POLICY_RR) &&
+		    (dst_host->active_link_entries > 1)) {
+			uint8_t cur_link_id = dst_host->active_links[0];
+
+			memmove(&dst_host->active_links[0], &dst_host->active_links[1], KNET_MAX_LINK - 1);
+			dst_host->active_links[dst_host->active_link_entries - 1] = cur_link_id;
+
+			break;
+		}
+	}
+
+out_unlock:
 	/*
-	 * forcefully broadcast a ping to all nodes every SEQ_MAX / 8
-	 * pckts.
-	 * this solves 2 problems:
-	 * 1) on TX socket overloads we generate extra pings to keep links alive
-	 * 2) in 3+ nodes setup, where all the traffic is flowing between node 1 and 2,
-	 *    node 3+ will be able to keep in sync on the TX seq_num even without
-	 *    receiving traffic or pings in betweens. This avoids issues with
-	 *    rollover of the circular buffer
+	 * the packet went out on some links, sending it
+	 * again would only duplicate it
 	 */
+	if (sent_links) {
+		return 0;
+	}
+	errno = savederrno;
+	return err;
+}
 
-	if (tx_seq_num % (SEQ_MAX / 8) == 0) {
-		_send_pings(knet_h, 0);
+/*
+ * send a broadcast packet once to the multicast group,
+ * parity fragments are not sent, there is only one path
+ */
+static int _dispatch_to_mcast(knet_handle_t knet_h, struct knet_mmsghdr *msg, int msgs_to_send)
+{
+	int msg_idx, sent_msgs, prev_sent;
+	int err = 0, savederrno = 0;
+
+	for (msg_idx = 0; msg_idx < msgs_to_send; msg_idx++) {
+		msg[msg_idx].msg_hdr.msg_name = &knet_h->mcast_addr;
 	}
 
-	if (inbuf->khp_data_frag_num > 1) {
-		while (frag_idx < inbuf->khp_data_frag_num) {
+	prev_sent = 0;
+
+	while (prev_sent < msgs_to_send) {
+		sent_msgs = _sendmmsg(knet_h->mcast_sockfd, &msg[prev_sent], msgs_to_send - prev_sent,
+				      MSG_DONTWAIT | MSG_NOSIGNAL);
+		savederrno = errno;
+
+		err = transport_tx_sock_error(knet_h, KNET_TRANSPORT_UDP, knet_h->mcast_sockfd, sent_msgs, savederrno);
+		if (err > 0) {
+			continue;
+		}
+		if ((err < 0) || (sent_msgs < 0)) {
 			/*
-			 * set the iov_base
+			 * nothing has been sent yet, let the caller use the links
 			 */
-			iov_out[frag_idx][0].iov_base = (void *)knet_h->send_to_links_buf[frag_idx];
-			iov_out[frag_idx][0].iov_len = KNET_HEADER_DATA_SIZE;
-			iov_out[frag_idx][1].iov_base = inbuf->khp_data_userdata + (temp_data_mtu * frag_idx);
+			if (!prev_sent) {
+				log_debug(knet_h, KNET_SUB_TX, "Unable to send data to the multicast group: %s",
+					  strerror(savederrno));
+				errno = savederrno;
+				return -1;
+			}
+			break;
+		}
+
+		prev_sent += sent_msgs;
+	}
+
+	knet_h->stats.tx_mcast_packets += prev_sent;
+
+	errno = 0;
+	return 0;
+}
+
+/*
+ * track the lowest number of active links across all
+ * destinations using FEC, it defines how much parity we need
+ */
+static void _fec_min_links(struct knet_host *dst_host, uint8_t *fec_min_links)
+{
+	if ((dst_host->link_handler_policy != KNET_LINK_POLICY_FEC) ||
+	    (!dst_host->active_link_entries)) {
+		return;
+	}
+
+	if ((!*fec_min_links) || (dst_host->active_link_entries < *fec_min_links)) {
+		*fec_min_links = dst_host->active_link_entries;
+	}
+}
+
+/*
+ * MSG_ZEROCOPY: find a ring buffer that the kernel is not using
+ * to hold the outgoing data of a packet
+ */
+static struct knet_zerocopy_buf *_zerocopy_get_buf(knet_handle_t knet_h, struct knet_header *inbuf, size_t inlen,
+						   unsigned int data_mtu, int fec_num)
+{
+	struct knet_zerocopy_buf *zc_buf = NULL;
+	size_t frag_size;
+	int i;
+
+	if ((!knet_h->zerocopy_threshold) || (!knet_h->zerocopy_buf[0].data)) {
+		return NULL;
+	}
+
+	if (inlen > data_mtu) {
+		frag_size = data_mtu;
+	} else {
+		frag_size = inlen;
+	}
+
+	if ((frag_size < knet_h->zerocopy_threshold) ||
+	    (inbuf->khp_data_frag_num + fec_num > KNET_ZEROCOPY_MAX_FRAGS)) {
+		return NULL;
+	}
+
+	/*
+	 * unencrypted data is sent straight from inbuf, that can be
+	 * handed over only if it is the socket buffer. FEC parity
+	 * fragments live in a shared buffer.
+	 */
+	if ((!knet_h->crypto_instance) &&
+	    ((inbuf != knet_h->recv_from_sock_buf) || (fec_num))) {
+		return NULL;
+	}
+
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TX, "Unable to get zerocopy mutex lock");
+		return NULL;
+	}
+	for (i = 0; i < KNET_ZEROCOPY_BUFS; i++) {
+		if (!knet_h->zerocopy_buf[i].pending) {
+			zc_buf = &knet_h->zerocopy_buf[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+
+	if (!zc_buf) {
+		knet_h->stats.tx_zerocopy_no_bufs++;
+	}
+
+	return zc_buf;
+}
+
+/*
+ * if the kernel still holds unencrypted data in inbuf,
+ * swap the socket buffer with the spare one of the ring
+ */
+static void _zerocopy_put_buf(knet_handle_t knet_h, struct knet_zerocopy_buf *zc_buf, struct knet_header *inbuf)
+{
+	struct knet_header *spare;
+
+	knet_h->tx_zerocopy_buf = NULL;
+
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TX, "Unable to get zerocopy mutex lock");
+		return;
+	}
+	if ((zc_buf->pending) && (!knet_h->crypto_instance)) {
+		spare = zc_buf->data;
+		memmove(spare, inbuf, KNET_HEADER_DATA_SIZE);
+		zc_buf->data = inbuf;
+		knet_h->recv_from_sock_buf = spare;
+	}
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+}
+
+/*
+ * like for the TX thread, a packet can go past txq_len
+ * when the queue is empty
+ */
+static int _txq_link_has_room(struct knet_link *cur_link, int msgs_to_queue)
+{
+	if ((cur_link->txq_policy != KNET_LINK_TXQ_POLICY_BACKPRESSURE) ||
+	    (!cur_link->txq_len) ||
+	    (!cur_link->txq_count) ||
+	    (cur_link->txq_count + msgs_to_queue <= cur_link->txq_len)) {
+		return 1;
+	}
+
+	cur_link->status.stats.tx_data_queue_drops += msgs_to_queue;
+	return 0;
+}
+
+/*
+ * same link selection as _dispatch_to_links, FEC hosts are
+ * checked as if all the fragments went to every link
+ */
+static int _txq_host_has_room(knet_handle_t knet_h, struct knet_host *dst_host, int msgs_to_send, int fec_msgs_to_send)
+{
+	struct knet_host *via_host;
+	int link_idx, link_entries;
+
+	via_host = _relay_get_via(knet_h, dst_host);
+	if (via_host) {
+		return _txq_link_has_room(&via_host->link[via_host->active_links[0]], msgs_to_send);
+	}
+
+	link_entries = dst_host->active_link_entries;
+	if (dst_host->link_handler_policy == KNET_LINK_POLICY_RR) {
+		if (link_entries > 1) {
+			link_entries = 1;
+		}
+	} else if (dst_host->link_handler_policy == KNET_LINK_POLICY_FEC) {
+		msgs_to_send = msgs_to_send + fec_msgs_to_send;
+	}
+
+	for (link_idx = 0; link_idx < link_entries; link_idx++) {
+		if (!_txq_link_has_room(&dst_host->link[dst_host->active_links[link_idx]], msgs_to_send)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * direct senders get EAGAIN rather than filling a backpressure queue
+ * past txq_len. All the destinations are checked before anything is
+ * sent: the packet would get a new seq_num when sent again and the
+ * hosts that already received it would deliver it twice.
+ */
+static int _txq_dst_have_room(knet_handle_t knet_h, int bcast, const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries,
+			      int msgs_to_send, int fec_msgs_to_send)
+{
+	struct knet_host *dst_host;
+	size_t host_idx;
+
+	if (knet_h->tx_group) {
+		for (host_idx = 0; host_idx < knet_h->tx_group->dst_hosts_entries; host_idx++) {
+			dst_host = knet_h->tx_group->dst_hosts[host_idx];
+			if ((dst_host->host_id == knet_h->host_id) && (knet_h->has_loop_link)) {
+				continue;
+			}
+			if (!_txq_host_has_room(knet_h, dst_host, msgs_to_send, fec_msgs_to_send)) {
+				return 0;
+			}
+		}
+	} else if (!bcast) {
+		for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
+			if (!_txq_host_has_room(knet_h, knet_h->host_index[dst_host_ids[host_idx]], msgs_to_send, fec_msgs_to_send)) {
+				return 0;
+			}
+		}
+	} else {
+		for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+			if ((dst_host->status.reachable) &&
+			    (!_txq_host_has_room(knet_h, dst_host, msgs_to_send, fec_msgs_to_send))) {
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int _send_to_hosts(knet_handle_t knet_h, struct knet_header *inbuf, size_t inlen, int8_t channel,
+			  int bcast, const knet_node_id_t *dst_host_ids_temp, size_t dst_host_ids_entries_temp)
+{
+	size_t outlen, frag_len;
+	struct knet_host *dst_host;
+	knet_node_id_t *dst_host_ids = knet_h->tx_dst_host_ids;
+	size_t dst_host_ids_entries = 0;
+	struct iovec iov_out[PCKT_FRAG_MAX][2];
+	int iovcnt_out = 2;
+	uint8_t frag_idx;
+	unsigned int temp_data_mtu;
+	size_t host_idx;
+	int send_mcast = 0;
+	int sent_hosts = 0;
+	int savederrno = 0;
+	int err = 0;
+	seq_num_t tx_seq_num;
+	struct knet_mmsghdr msg[PCKT_FRAG_MAX];
+	int msgs_to_send, msg_idx;
+	unsigned int i;
+	int j;
+	int data_compressed = 0;
+	size_t uncrypted_frag_size;
+	uint8_t fec_min_links = 0;
+	int fec_num = 0, fec_idx;
+	unsigned char *fec_buf;
+	uint16_t fec_last_frag_size;
+	struct knet_zerocopy_buf *zc_buf = NULL;
+	size_t zc_offset = 0;
+	struct timespec stage_time = { 0 };
+
+	/*
+	 * check destinations hosts before spending time
+	 * in fragmenting/encrypting packets to save
+	 * time processing data for unreachable hosts.
+	 * for unicast, also remap the destination data
+	 * to skip unreachable hosts.
+	 */
+
+	if (knet_h->tx_group) {
+		/*
+		 * the group already knows which hosts are reachable
+		 */
+		if (!knet_h->tx_group->dst_hosts_entries) {
+			savederrno = EHOSTDOWN;
+			err = -1;
+			goto out_unlock;
+		}
+		for (host_idx = 0; host_idx < knet_h->tx_group->dst_hosts_entries; host_idx++) {
+			_fec_min_links(knet_h->tx_group->dst_hosts[host_idx], &fec_min_links);
+		}
+	} else if (!bcast) {
+		dst_host_ids_entries = 0;
+		for (host_idx = 0; host_idx < dst_host_ids_entries_temp; host_idx++) {
+			dst_host = knet_h->host_index[dst_host_ids_temp[host_idx]];
+			if (!dst_host) {
+				continue;
+			}
+			if (!(dst_host->host_id == knet_h->host_id &&
+			     knet_h->has_loop_link) &&
+			    dst_host->status.reachable) {
+				dst_host_ids[dst_host_ids_entries] = dst_host_ids_temp[host_idx];
+				dst_host_ids_entries++;
+			}
+		}
+		if (!dst_host_ids_entries) {
+			savederrno = EHOSTDOWN;
+			err = -1;
+			goto out_unlock;
+		}
+		for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
+			_fec_min_links(knet_h->host_index[dst_host_ids[host_idx]], &fec_min_links);
+		}
+	} else {
+		send_mcast = 0;
+		for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+			if (!(dst_host->host_id == knet_h->host_id &&
+			      knet_h->has_loop_link) &&
+			    dst_host->status.reachable) {
+				send_mcast = 1;
+				_fec_min_links(dst_host, &fec_min_links);
+			}
+		}
+		if (!send_mcast) {
+			savederrno = EHOSTDOWN;
+			err = -1;
+			goto out_unlock;
+		}
+	}
+
+	if (!knet_h->data_mtu) {
+		/*
+		 * using MIN_MTU_V4 for data mtu is not completely accurate but safe enough
+		 */
+		log_debug(knet_h, KNET_SUB_TX,
+			  "Received data packet but data MTU is still unknown."
+			  " Packet might not be delivered."
+			  " Assuming minimum IPv4 MTU (%d)",
+			  KNET_PMTUD_MIN_MTU_V4);
+		temp_data_mtu = KNET_PMTUD_MIN_MTU_V4;
+	} else {
+		/*
+		 * take a copy of the mtu to avoid value changing under
+		 * our feet while we are sending a fragmented pckt
+		 */
+		temp_data_mtu = knet_h->data_mtu;
+	}
+
+	/*
+	 * FEC parity fragments carry a small trailer, reserve space
+	 * for it in all fragments so they all have the same size
+	 */
+	if (fec_min_links) {
+		temp_data_mtu = temp_data_mtu - KNET_FEC_TRAILER_SIZE;
+	}
+
+	/*
+	 * any destination can be relayed, reserve space for the relay header
+	 */
+	temp_data_mtu = temp_data_mtu - _relay_overhead(knet_h);
+
+	_stage_stats_start(knet_h, &stage_time);
+
+	/*
+	 * compress data
+	 */
+	if ((knet_h->compress_model > 0) && (inlen > knet_h->compress_threshold)) {
+		size_t cmp_outlen = KNET_DATABUFSIZE_COMPRESS;
+		struct timespec start_time;
+		struct timespec end_time;
+		uint64_t compress_time;
+
+		clock_gettime(CLOCK_MONOTONIC, &start_time);
+		err = compress(knet_h,
+			       (const unsigned char *)inbuf->khp_data_userdata, inlen,
+			       knet_h->send_to_links_buf_compress, (ssize_t *)&cmp_outlen);
+		if (err < 0) {
+			knet_h->stats.tx_failed_to_compress++;
+			log_warn(knet_h, KNET_SUB_COMPRESS, "Compression failed (%d): %s", err, strerror(errno));
+		} else {
+			/* Collect stats */
+			clock_gettime(CLOCK_MONOTONIC, &end_time);
+			timespec_diff(start_time, end_time, &compress_time);
+			_histogram_add(&knet_h->histograms[KNET_HISTOGRAM_TX_COMPRESS], compress_time);
+
+	                if (compress_time < knet_h->stats.tx_compress_time_min) {
+				knet_h->stats.tx_compress_time_min = compress_time;
+			}
+			if (compress_time > knet_h->stats.tx_compress_time_max) {
+				knet_h->stats.tx_compress_time_max = compress_time;
+			}
+			knet_h->stats.tx_compress_time_ave =
+				(unsigned long long)(knet_h->stats.tx_compress_time_ave * knet_h->stats.tx_compressed_packets +
+				 compress_time) / (knet_h->stats.tx_compressed_packets+1);
+
+			knet_h->stats.tx_compressed_packets++;
+			knet_h->stats.tx_compressed_original_bytes += inlen;
+			knet_h->stats.tx_compressed_size_bytes += cmp_outlen;
+
+			if (cmp_outlen < inlen) {
+				memmove(inbuf->khp_data_userdata, knet_h->send_to_links_buf_compress, cmp_outlen);
+				inlen = cmp_outlen;
+				data_compressed = 1;
+			} else {
+				knet_h->stats.tx_unable_to_compress++;
+			}
+		}
+		_stage_stats_mark(knet_h, KNET_STAGE_TX_COMPRESS, &stage_time);
+	}
+	if (knet_h->compress_model > 0 && !data_compressed) {
+		knet_h->stats.tx_uncompressed_packets++;
+	}
+
+	/*
+	 * prepare the outgoing buffers
+	 */
+
+	frag_len = inlen;
+	frag_idx = 0;
+
+	inbuf->khp_data_bcast = bcast;
+	inbuf->khp_data_frag_num = ceil((float)inlen / temp_data_mtu);
+	inbuf->khp_data_channel = channel;
+	if (data_compressed) {
+		inbuf->khp_data_compress = knet_h->compress_model;
+	} else {
+		inbuf->khp_data_compress = 0;
+	}
+
+	/*
+	 * one parity fragment every (links - 1) data fragments
+	 * allows to lose all the fragments sent on any given link
+	 */
+	if ((fec_min_links) && (inbuf->khp_data_frag_num > 1)) {
+		if (fec_min_links > 1) {
+			fec_num = (inbuf->khp_data_frag_num + fec_min_links - 2) / (fec_min_links - 1);
+		} else {
+			fec_num = 1;
+		}
+		/*
+		 * parity as big as the data is just a copy of the data,
+		 * fall back to duplicate the fragments on 2 links
+		 */
+		if (fec_num >= inbuf->khp_data_frag_num) {
+			fec_num = 0;
+		}
+		if ((inbuf->khp_data_frag_num + fec_num >= PCKT_FRAG_MAX) ||
+		    (fec_num * temp_data_mtu > KNET_MAX_PACKET_SIZE)) {
+			log_debug(knet_h, KNET_SUB_TX, "Packet has too many fragments to generate FEC parity");
+			fec_num = 0;
+		}
+	}
+	inbuf->khp_data_fec = fec_num;
+
+	if ((knet_h->tx_direct) &&
+	    (!_txq_dst_have_room(knet_h, bcast, dst_host_ids, dst_host_ids_entries,
+				 inbuf->khp_data_frag_num, fec_num))) {
+		savederrno = EAGAIN;
+		err = -1;
+		goto out_unlock;
+	}
+
+	zc_buf = _zerocopy_get_buf(knet_h, inbuf, inlen, temp_data_mtu, fec_num);
+
+	if (pthread_mutex_lock(&knet_h->tx_seq_num_mutex)) {
+		log_debug(knet_h, KNET_SUB_TX, "Unable to get seq mutex lock");
+		goto out_unlock;
+	}
+	knet_h->tx_seq_num++;
+	/*
+	 * force seq_num 0 to detect a node that has crashed and rejoining
+	 * the knet instance. seq_num 0 will clear the buffers in the RX
+	 * thread
+	 */
+	if (knet_h->tx_seq_num == 0) {
+		knet_h->tx_seq_num++;
+	}
+	/*
+	 * cache the value in locked context
+	 */
+	tx_seq_num = knet_h->tx_seq_num;
+	inbuf->khp_data_seq_num = htons(knet_h->tx_seq_num);
+	pthread_mutex_unlock(&knet_h->tx_seq_num_mutex);
+
+	/*
+	 * forcefully broadcast a ping to all nodes every SEQ_MAX / 8
+	 * pckts.
+	 * this solves 2 problems:
+	 * 1) on TX socket overloads we generate extra pings to keep links alive
+	 * 2) in 3+ nodes setup, where all the traffic is flowing between node 1 and 2,
+	 *    node 3+ will be able to keep in sync on the TX seq_num even without
+	 *    receiving traffic or pings in betweens. This avoids issues with
+	 *    rollover of the circular buffer
+	 */
+
+	if (tx_seq_num % (SEQ_MAX / 8) == 0) {
+		_send_pings(knet_h, 0);
+	}
+
+	if (inbuf->khp_data_frag_num > 1) {
+		while (frag_idx < inbuf->khp_data_frag_num) {
+			/*
+			 * set the iov_base
+			 */
+			iov_out[frag_idx][0].iov_base = (void *)knet_h->send_to_links_buf[frag_idx];
+			iov_out[frag_idx][0].iov_len = KNET_HEADER_DATA_SIZE;
+			iov_out[frag_idx][1].iov_base = inbuf->khp_data_userdata + (temp_data_mtu * frag_idx);
+
+			/*
+			 * set the len
+			 */
+			if (frag_len > temp_data_mtu) {
+				iov_out[frag_idx][1].iov_len = temp_data_mtu;
+			} else {
+				iov_out[frag_idx][1].iov_len = frag_len;
+			}
+
+			/*
+			 * copy the frag info on all buffers
+			 */
+			knet_h->send_to_links_buf[frag_idx]->kh_type = inbuf->kh_type;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_seq_num = inbuf->khp_data_seq_num;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_frag_num = inbuf->khp_data_frag_num;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_bcast = inbuf->khp_data_bcast;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_channel = inbuf->khp_data_channel;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_compress = inbuf->khp_data_compress;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_fec = inbuf->khp_data_fec;
+
+			frag_len = frag_len - temp_data_mtu;
+			frag_idx++;
+		}
+
+		/*
+		 * generate FEC parity fragments
+		 */
+		fec_last_frag_size = htons(iov_out[inbuf->khp_data_frag_num - 1][1].iov_len);
+		for (fec_idx = 0; fec_idx < fec_num; fec_idx++) {
+			fec_buf = knet_h->send_to_links_buf_fec + (fec_idx * (temp_data_mtu + KNET_FEC_TRAILER_SIZE));
+
+			memset(fec_buf, 0, temp_data_mtu);
+			for (j = fec_idx; j < inbuf->khp_data_frag_num; j = j + fec_num) {
+				const unsigned char *frag_data = iov_out[j][1].iov_base;
+
+				for (i = 0; i < iov_out[j][1].iov_len; i++) {
+					fec_buf[i] ^= frag_data[i];
+				}
+			}
+			memmove(fec_buf + temp_data_mtu, &fec_last_frag_size, KNET_FEC_TRAILER_SIZE);
+
+			iov_out[frag_idx][0].iov_base = (void *)knet_h->send_to_links_buf[frag_idx];
+			iov_out[frag_idx][0].iov_len = KNET_HEADER_DATA_SIZE;
+			iov_out[frag_idx][1].iov_base = fec_buf;
+			iov_out[frag_idx][1].iov_len = temp_data_mtu + KNET_FEC_TRAILER_SIZE;
+
+			knet_h->send_to_links_buf[frag_idx]->kh_type = inbuf->kh_type;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_seq_num = inbuf->khp_data_seq_num;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_frag_num = inbuf->khp_data_frag_num;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_bcast = inbuf->khp_data_bcast;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_channel = inbuf->khp_data_channel;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_compress = inbuf->khp_data_compress;
+			knet_h->send_to_links_buf[frag_idx]->khp_data_fec = inbuf->khp_data_fec;
+
+			frag_idx++;
+		}
+		iovcnt_out = 2;
+
+		/*
+		 * the kernel might still read the headers after sendmsg,
+		 * move them to the zerocopy buffer
+		 */
+		if ((zc_buf) && (!knet_h->crypto_instance)) {
+			for (frag_idx = 0; frag_idx < inbuf->khp_data_frag_num; frag_idx++) {
+				memmove(zc_buf->out + zc_offset, knet_h->send_to_links_buf[frag_idx], KNET_HEADER_DATA_SIZE);
+				iov_out[frag_idx][0].iov_base = zc_buf->out + zc_offset;
+				zc_offset = zc_offset + KNET_HEADER_DATA_SIZE;
+			}
+		}
+	} else {
+		iov_out[frag_idx][0].iov_base = (void *)inbuf;
+		iov_out[frag_idx][0].iov_len = frag_len + KNET_HEADER_DATA_SIZE;
+		iovcnt_out = 1;
+	}
+
+	_stage_stats_mark(knet_h, KNET_STAGE_TX_FRAGMENT, &stage_time);
+
+	if (knet_h->crypto_instance) {
+		struct timespec start_time;
+		struct timespec end_time;
+		uint64_t crypt_time;
+		unsigned char *crypt_buf;
+
+		frag_idx = 0;
+		while (frag_idx < inbuf->khp_data_frag_num + fec_num) {
+			clock_gettime(CLOCK_MONOTONIC, &start_time);
+			if (zc_buf) {
+				crypt_buf = zc_buf->out + zc_offset;
+			} else {
+				crypt_buf = knet_h->send_to_links_buf_crypt[frag_idx];
+			}
+			if (crypto_encrypt_and_signv(
+					knet_h,
+					iov_out[frag_idx], iovcnt_out,
+					crypt_buf,
+					(ssize_t *)&outlen) < 0) {
+				log_debug(knet_h, KNET_SUB_TX, "Unable to encrypt packet");
+				KNET_PROBE(tx_crypt_fail, 0, KNET_MAX_LINK, tx_seq_num, inlen);
+				savederrno = ECHILD;
+				err = -1;
+				goto out_unlock;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end_time);
+			timespec_diff(start_time, end_time, &crypt_time);
+			_histogram_add(&knet_h->histograms[KNET_HISTOGRAM_TX_CRYPT], crypt_time);
+
+	                if (crypt_time < knet_h->stats.tx_crypt_time_min) {
+				knet_h->stats.tx_crypt_time_min = crypt_time;
+			}
+			if (crypt_time > knet_h->stats.tx_crypt_time_max) {
+				knet_h->stats.tx_crypt_time_max = crypt_time;
+			}
+			knet_h->stats.tx_crypt_time_ave =
+				(knet_h->stats.tx_crypt_time_ave * knet_h->stats.tx_crypt_packets +
+				 crypt_time) / (knet_h->stats.tx_crypt_packets+1);
+
+			uncrypted_frag_size = 0;
+			for (j=0; j < iovcnt_out; j++) {
+				uncrypted_frag_size += iov_out[frag_idx][j].iov_len;
+			}
+			knet_h->stats.tx_crypt_byte_overhead += (outlen - uncrypted_frag_size);
+			knet_h->stats.tx_crypt_packets++;
+
+			iov_out[frag_idx][0].iov_base = crypt_buf;
+			iov_out[frag_idx][0].iov_len = outlen;
+			if (zc_buf) {
+				zc_offset = zc_offset + outlen;
+			}
+			frag_idx++;
+		}
+		iovcnt_out = 1;
+		_stage_stats_mark(knet_h, KNET_STAGE_TX_CRYPT, &stage_time);
+	}
+
+	memset(&msg, 0, sizeof(msg));
+
+	msgs_to_send = inbuf->khp_data_frag_num;
+
+	msg_idx = 0;
+
+	while (msg_idx < msgs_to_send + fec_num) {
+		msg[msg_idx].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+		msg[msg_idx].msg_hdr.msg_iov = &iov_out[msg_idx][0];
+		msg[msg_idx].msg_hdr.msg_iovlen = iovcnt_out;
+		msg_idx++;
+	}
+
+	/*
+	 * an error sending to one host must not prevent
+	 * delivery to the others, report the last error
+	 */
+	err = 0;
+	savederrno = 0;
+
+	knet_h->tx_zerocopy_buf = zc_buf;
+	knet_h->tx_channel = channel;
+
+	if (knet_h->tx_group) {
+		for (host_idx = 0; host_idx < knet_h->tx_group->dst_hosts_entries; host_idx++) {
+			dst_host = knet_h->tx_group->dst_hosts[host_idx];
+			if ((dst_host->host_id == knet_h->host_id) && (knet_h->has_loop_link)) {
+				continue;
+			}
+
+			if (_dispatch_to_links(knet_h, dst_host, &msg[0], msgs_to_send, fec_num)) {
+				savederrno = errno;
+				err = -1;
+			} else {
+				sent_hosts++;
+			}
+		}
+	} else if (!bcast) {
+		for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
+			dst_host = knet_h->host_index[dst_host_ids[host_idx]];
+
+			if (_dispatch_to_links(knet_h, dst_host, &msg[0], msgs_to_send, fec_num)) {
+				savederrno = errno;
+				err = -1;
+			} else {
+				sent_hosts++;
+			}
+		}
+	} else {
+		if ((knet_h->mcast_addr.ss_family) &&
+		    (inbuf->kh_type != KNET_HEADER_TYPE_HOST_INFO)) {
+			send_mcast = !_dispatch_to_mcast(knet_h, &msg[0], msgs_to_send);
+		} else {
+			send_mcast = 0;
+		}
+		sent_hosts = send_mcast;
+		for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
+			if ((send_mcast) && (dst_host->host_id != knet_h->host_id) &&
+			    (dst_host->active_link_entries)) {
+				continue;
+			}
+			if (dst_host->status.reachable) {
+				if (_dispatch_to_links(knet_h, dst_host, &msg[0], msgs_to_send, fec_num)) {
+					savederrno = errno;
+					err = -1;
+				} else {
+					sent_hosts++;
+				}
+			}
+		}
+	}
+
+	/*
+	 * some hosts already got the packet, it cannot be sent again
+	 */
+	if ((err) && (savederrno == EAGAIN) && (sent_hosts)) {
+		err = 0;
+		savederrno = 0;
+	}
+
+	_stage_stats_mark(knet_h, KNET_STAGE_TX_SEND, &stage_time);
+
+out_unlock:
+	if (zc_buf) {
+		_zerocopy_put_buf(knet_h, zc_buf, inbuf);
+	}
+	errno = savederrno;
+	return err;
+}
+
+/*
+ * arm the coalesce timer to expire at the earliest
+ * deadline of the pending packets, or disarm it
+ * if there is nothing left to send
+ */
+static void _coalesce_set_timer(knet_handle_t knet_h)
+{
+	struct itimerspec its;
+	int8_t channel;
+
+	memset(&its, 0, sizeof(struct itimerspec));
+
+	for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
+		struct knet_coalesce *coalesce = &knet_h->coalesce[channel];
+
+		if (!coalesce->buf_len) {
+			continue;
+		}
+		if (((!its.it_value.tv_sec) && (!its.it_value.tv_nsec)) ||
+		    (coalesce->deadline.tv_sec < its.it_value.tv_sec) ||
+		    ((coalesce->deadline.tv_sec == its.it_value.tv_sec) &&
+		     (coalesce->deadline.tv_nsec < its.it_value.tv_nsec))) {
+			its.it_value = coalesce->deadline;
+		}
+	}
+
+	if (timerfd_settime(knet_h->coalesce_timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		log_debug(knet_h, KNET_SUB_TX, "Unable to set coalesce timer: %s", strerror(errno));
+	}
+}
+
+static void _coalesce_flush(knet_handle_t knet_h, int8_t channel)
+{
+	struct knet_coalesce *coalesce = &knet_h->coalesce[channel];
+	uint8_t tx_direct;
+
+	if (!coalesce->buf_len) {
+		return;
+	}
+
+	if (knet_h->enabled != 1) {
+		log_debug(knet_h, KNET_SUB_TX, "Dropping coalesced messages, forwarding is disabled");
+	} else {
+		/*
+		 * the coalesced messages have already been accepted,
+		 * queue them like the TX thread does even when the
+		 * flush is triggered by a direct sender
+		 */
+		tx_direct = knet_h->tx_direct;
+		knet_h->tx_direct = 0;
+		if (_send_to_hosts(knet_h, coalesce->buf, coalesce->buf_len, channel, coalesce->bcast,
+				   coalesce->dst_host_ids, coalesce->dst_host_ids_entries) < 0) {
+			log_debug(knet_h, KNET_SUB_TX, "Unable to send coalesced messages: %s", strerror(errno));
+		} else {
+			knet_h->stats.tx_coalesced_packets++;
+		}
+		knet_h->tx_direct = tx_direct;
+	}
+
+	coalesce->buf_len = 0;
+}
+
+/*
+ * returns 0 if the message has been queued in the channel coalesce
+ * buffer, 1 if it has to be sent right away. In the latter case
+ * all messages previously queued on the channel are sent first
+ * to preserve ordering.
+ */
+static int _coalesce_msg(knet_handle_t knet_h, size_t inlen, int8_t channel, int is_sync,
+			 int bcast, const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries)
+{
+	struct knet_coalesce *coalesce = &knet_h->coalesce[channel];
+	unsigned int temp_data_mtu;
+	uint16_t frame_len;
+	int first_msg = 0;
+
+	if (!coalesce->buf) {
+		return 1;
+	}
+
+	if (!knet_h->data_mtu) {
+		temp_data_mtu = KNET_PMTUD_MIN_MTU_V4;
+	} else {
+		temp_data_mtu = knet_h->data_mtu;
+	}
+
+	if ((is_sync) ||
+	    (!coalesce->max_delay) ||
+	    (inlen + KNET_COALESCE_FRAME_SIZE > temp_data_mtu) ||
+	    ((!bcast) && (dst_host_ids_entries > KNET_COALESCE_MAX_DST))) {
+		_coalesce_flush(knet_h, channel);
+		return 1;
+	}
+
+	if ((coalesce->buf_len) &&
+	    ((coalesce->bcast != bcast) ||
+	     ((!bcast) &&
+	      ((coalesce->dst_host_ids_entries != dst_host_ids_entries) ||
+	       (memcmp(coalesce->dst_host_ids, dst_host_ids, dst_host_ids_entries * sizeof(knet_node_id_t))))) ||
+	     (coalesce->buf_len + KNET_COALESCE_FRAME_SIZE + inlen > temp_data_mtu))) {
+		_coalesce_flush(knet_h, channel);
+	}
+
+	if (!coalesce->buf_len) {
+		coalesce->bcast = bcast;
+		if (!bcast) {
+			memmove(coalesce->dst_host_ids, dst_host_ids, dst_host_ids_entries * sizeof(knet_node_id_t));
+			coalesce->dst_host_ids_entries = dst_host_ids_entries;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &coalesce->deadline);
+		coalesce->deadline.tv_nsec += coalesce->max_delay * 1000llu;
+		coalesce->deadline.tv_sec += coalesce->deadline.tv_nsec / 1000000000;
+		coalesce->deadline.tv_nsec = coalesce->deadline.tv_nsec % 1000000000;
+		first_msg = 1;
+	}
+
+	frame_len = htons(inlen);
+	memmove(coalesce->buf->khp_data_userdata + coalesce->buf_len, &frame_len, KNET_COALESCE_FRAME_SIZE);
+	coalesce->buf_len += KNET_COALESCE_FRAME_SIZE;
+	memmove(coalesce->buf->khp_data_userdata + coalesce->buf_len, knet_h->recv_from_sock_buf->khp_data_userdata, inlen);
+	coalesce->buf_len += inlen;
+
+	knet_h->stats.tx_coalesced_msgs++;
+
+	if (first_msg) {
+		_coalesce_set_timer(knet_h);
+	}
+
+	return 0;
+}
+
+/*
+ * send all coalesced packets that reached their deadline
+ */
+static void _handle_coalesce_timer(knet_handle_t knet_h)
+{
+	uint64_t expirations;
+	struct timespec now;
+	int8_t channel;
+
+	if (read(knet_h->coalesce_timerfd, &expirations, sizeof(expirations)) < 0) {
+		if (errno != EAGAIN) {
+			log_debug(knet_h, KNET_SUB_TX, "Unable to read coalesce timer: %s", strerror(errno));
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
+		struct knet_coalesce *coalesce = &knet_h->coalesce[channel];
+
+		if ((coalesce->buf_len) &&
+		    ((coalesce->deadline.tv_sec < now.tv_sec) ||
+		     ((coalesce->deadline.tv_sec == now.tv_sec) &&
+		      (coalesce->deadline.tv_nsec <= now.tv_nsec)))) {
+			_coalesce_flush(knet_h, channel);
+		}
+	}
+
+	_coalesce_set_timer(knet_h);
+}
+
+/*
+ * deliver data to our own host via the loopback link
+ */
+static void _send_local(knet_handle_t knet_h, struct knet_header *inbuf, size_t inlen, int8_t channel)
+{
+	const unsigned char *buf = inbuf->khp_data_userdata;
+	ssize_t buflen = inlen;
+	struct knet_link *local_link;
+	int err;
+
+	local_link = knet_h->host_index[knet_h->host_id]->link;
+
+	if (knet_h->sockfd[channel].rx_notify_fn) {
+		knet_h->sockfd[channel].rx_notify_fn(knet_h->sockfd[channel].rx_notify_fn_private_data,
+						     buf, buflen, knet_h->host_id, channel);
+		local_link->status.stats.tx_data_packets++;
+		local_link->status.stats.tx_data_bytes += inlen;
+		return;
+	}
+
+local_retry:
+	err = write(knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created], buf, buflen);
+	if (err < 0) {
+		log_err(knet_h, KNET_SUB_TRANSP_LOOPBACK, "send local failed. error=%s\n", strerror(errno));
+		local_link->status.stats.tx_data_errors++;
+	}
+	if (err > 0 && err < buflen) {
+		log_debug(knet_h, KNET_SUB_TRANSP_LOOPBACK, "send local incomplete=%d bytes of %zu\n", err, inlen);
+		local_link->status.stats.tx_data_retries++;
+		buf += err;
+		buflen -= err;
+		usleep(knet_h->threads_timer_res / 16);
+		goto local_retry;
+	}
+	if (err == buflen) {
+		local_link->status.stats.tx_data_packets++;
+		local_link->status.stats.tx_data_bytes += inlen;
+	}
+}
+
+/*
+ * dst_host_ids is the destination list passed by knet_send_to*,
+ * NULL to ask dst_host_filter_fn (if any)
+ */
+static int _parse_recv_from_sock(knet_handle_t knet_h, size_t inlen, int8_t channel, int is_sync,
+				 const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries)
+{
+	knet_node_id_t *dst_host_ids_temp = knet_h->tx_dst_host_ids_temp;
+	size_t dst_host_ids_entries_temp = 0;
+	int bcast = 1;
+	struct knet_hostinfo *knet_hostinfo;
+	struct knet_header *inbuf;
+	int savederrno = 0;
+	int err = 0;
+	unsigned int i;
+	int send_local = 0;
+	struct timespec stage_time = { 0 };
+
+	_stage_stats_start(knet_h, &stage_time);
+
+	inbuf = knet_h->recv_from_sock_buf;
+
+	if ((knet_h->enabled != 1) &&
+	    (inbuf->kh_type != KNET_HEADER_TYPE_HOST_INFO)) { /* data forward is disabled */
+		log_debug(knet_h, KNET_SUB_TX, "Received data packet but forwarding is disabled");
+		savederrno = ECANCELED;
+		err = -1;
+		goto out_unlock;
+	}
+
+	/*
+	 * move this into a separate function to expand on
+	 * extra switching rules
+	 */
+	switch(inbuf->kh_type) {
+		case KNET_HEADER_TYPE_DATA:
+			if (dst_host_ids) {
+				bcast = 0;
+				memmove(dst_host_ids_temp, dst_host_ids, dst_host_ids_entries * sizeof(knet_node_id_t));
+				dst_host_ids_entries_temp = dst_host_ids_entries;
+			} else if (knet_h->dst_host_filter_fn) {
+				bcast = knet_h->dst_host_filter_fn(
+						knet_h->dst_host_filter_fn_private_data,
+						(const unsigned char *)inbuf->khp_data_userdata,
+						inlen,
+						KNET_NOTIFY_TX,
+						knet_h->host_id,
+						knet_h->host_id,
+						&channel,
+						dst_host_ids_temp,
+						&dst_host_ids_entries_temp);
+				if (bcast < 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Error from dst_host_filter_fn: %d", bcast);
+					savederrno = EFAULT;
+					err = -1;
+					goto out_unlock;
+				}
+
+				if ((!bcast) && (!dst_host_ids_entries_temp)) {
+					log_debug(knet_h, KNET_SUB_TX, "Message is unicast but no dst_host_ids_entries");
+					savederrno = EINVAL;
+					err = -1;
+					goto out_unlock;
+				}
+
+				if ((!bcast) &&
+				    (dst_host_ids_entries_temp > KNET_MAX_HOST)) {
+					log_debug(knet_h, KNET_SUB_TX, "dst_host_filter_fn returned too many destinations");
+					savederrno = EINVAL;
+					err = -1;
+					goto out_unlock;
+				}
+			}
+
+			/* Send to localhost if appropriate and enabled */
+			if (knet_h->has_loop_link) {
+				send_local = 0;
+				if (bcast) {
+					send_local = 1;
+				} else {
+					for (i=0; i< dst_host_ids_entries_temp; i++) {
+						if (dst_host_ids_temp[i] == knet_h->host_id) {
+							send_local = 1;
+						}
+					}
+				}
+				if (send_local) {
+					_send_local(knet_h, inbuf, inlen, channel);
+				}
+			}
+			break;
+		case KNET_HEADER_TYPE_HOST_INFO:
+			knet_hostinfo = (struct knet_hostinfo *)inbuf->khp_data_userdata;
+			if (knet_hostinfo->khi_bcast == KNET_HOSTINFO_UCAST) {
+				bcast = 0;
+				dst_host_ids_temp[0] = knet_hostinfo->khi_dst_node_id;
+				dst_host_ids_entries_temp = 1;
+				knet_hostinfo->khi_dst_node_id = htons(knet_hostinfo->khi_dst_node_id);
+			}
+			break;
+		default:
+			log_warn(knet_h, KNET_SUB_TX, "Receiving unknown messages from socket");
+			savederrno = ENOMSG;
+			err = -1;
+			goto out_unlock;
+			break;
+	}
+
+	if ((is_sync) && (!dst_host_ids)) {
+		if ((bcast) ||
+		    ((!bcast) && (dst_host_ids_entries_temp > 1))) {
+			log_debug(knet_h, KNET_SUB_TX, "knet_send_sync is only supported with unicast packets for one destination");
+			savederrno = E2BIG;
+			err = -1;
+			goto out_unlock;
+		}
+	}
+
+	_stage_stats_mark(knet_h, KNET_STAGE_TX_FILTER, &stage_time);
+
+	/*
+	 * small messages can be held back and packed together
+	 * with other messages bound to the same destinations
+	 */
+	if ((inbuf->kh_type == KNET_HEADER_TYPE_DATA) &&
+	    (!_coalesce_msg(knet_h, inlen, channel, is_sync, bcast,
+			    dst_host_ids_temp, dst_host_ids_entries_temp))) {
+		goto out_unlock;
+	}
+
+	err = _send_to_hosts(knet_h, inbuf, inlen, channel, bcast,
+			     dst_host_ids_temp, dst_host_ids_entries_temp);
+	savederrno = errno;
+
+out_unlock:
+	errno = savederrno;
+	return err;
+}
+
+static int _send_direct(knet_handle_t knet_h, const char *buff, const size_t buff_len, const int8_t channel,
+			int is_sync, const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries)
+{
+	int savederrno = 0, err = 0;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff_len <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff_len > KNET_MAX_PACKET_SIZE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel >= KNET_DATAFD_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	if (!knet_h->sockfd[channel].in_use) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out;
+	}
+
+	savederrno = pthread_mutex_lock(&knet_h->tx_mutex);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get TX mutex lock: %s",
+			strerror(savederrno));
+		err = -1;
+		goto out;
+	}
+
+	knet_h->recv_from_sock_buf->kh_type = KNET_HEADER_TYPE_DATA;
+	memmove(knet_h->recv_from_sock_buf->khp_data_userdata, buff, buff_len);
+	knet_h->tx_direct = 1;
+	err = _parse_recv_from_sock(knet_h, buff_len, channel, is_sync,
+				    dst_host_ids, dst_host_ids_entries);
+	savederrno = errno;
+	knet_h->tx_direct = 0;
+
+	pthread_mutex_unlock(&knet_h->tx_mutex);
+
+out:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
+
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_send_sync(knet_handle_t knet_h, const char *buff, const size_t buff_len, const int8_t channel)
+{
+	return _send_direct(knet_h, buff, buff_len, channel, 1, NULL, 0);
+}
+
+int knet_send_to(knet_handle_t knet_h, const char *buff, const size_t buff_len, const int8_t channel,
+		 const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries)
+{
+	if ((!dst_host_ids) || (!dst_host_ids_entries) || (dst_host_ids_entries > KNET_MAX_HOST)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return _send_direct(knet_h, buff, buff_len, channel, 0, dst_host_ids, dst_host_ids_entries);
+}
+
+int knet_send_sync_to(knet_handle_t knet_h, const char *buff, const size_t buff_len, const int8_t channel,
+		      const knet_node_id_t *dst_host_ids, size_t dst_host_ids_entries)
+{
+	if ((!dst_host_ids) || (!dst_host_ids_entries) || (dst_host_ids_entries > KNET_MAX_HOST)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return _send_direct(knet_h, buff, buff_len, channel, 1, dst_host_ids, dst_host_ids_entries);
+}
+
+int knet_send_to_group(knet_handle_t knet_h, uint16_t group_id, const char *buff, const size_t buff_len, const int8_t channel)
+{
+	int savederrno = 0, err = 0;
+	struct knet_group *group;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (group_id >= KNET_MAX_GROUPS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff_len <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (buff_len > KNET_MAX_PACKET_SIZE) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (channel >= KNET_DATAFD_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	savederrno = pthread_rwlock_rdlock(&knet_h->global_rwlock);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get read lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
+
+	group = knet_h->groups[group_id];
+
+	if ((!group) || (!knet_h->sockfd[channel].in_use)) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out;
+	}
+
+	if (knet_h->enabled != 1) {
+		log_debug(knet_h, KNET_SUB_TX, "Received data packet but forwarding is disabled");
+		savederrno = ECANCELED;
+		err = -1;
+		goto out;
+	}
 
-			/*
-			 * set the len
-			 */
-			if (frag_len > temp_data_mtu) {
-				iov_out[frag_idx][1].iov_len = temp_data_mtu;
-			} else {
-				iov_out[frag_idx][1].iov_len = frag_len;
-			}
+	savederrno = pthread_mutex_lock(&knet_h->tx_mutex);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get TX mutex lock: %s",
+			strerror(savederrno));
+		err = -1;
+		goto out;
+	}
 
-			/*
-			 * copy the frag info on all buffers
-			 */
-			knet_h->send_to_links_buf[frag_idx]->kh_type = inbuf->kh_type;
-			knet_h->send_to_links_buf[frag_idx]->khp_data_seq_num = inbuf->khp_data_seq_num;
-			knet_h->send_to_links_buf[frag_idx]->khp_data_frag_num = inbuf->khp_data_frag_num;
-			knet_h->send_to_links_buf[frag_idx]->khp_data_bcast = inbuf->khp_data_bcast;
-			knet_h->send_to_links_buf[frag_idx]->khp_data_channel = inbuf->khp_data_channel;
-			knet_h->send_to_links_buf[frag_idx]->khp_data_compress = inbuf->khp_data_compress;
+	knet_h->recv_from_sock_buf->kh_type = KNET_HEADER_TYPE_DATA;
+	memmove(knet_h->recv_from_sock_buf->khp_data_userdata, buff, buff_len);
 
-			frag_len = frag_len - temp_data_mtu;
-			frag_idx++;
+	if ((group->has_local) && (knet_h->has_loop_link)) {
+		_send_local(knet_h, knet_h->recv_from_sock_buf, buff_len, channel);
+		/*
+		 * nobody else to send to
+		 */
+		if ((!group->dst_hosts_entries) ||
+		    ((group->dst_hosts_entries == 1) && (group->dst_hosts[0]->host_id == knet_h->host_id))) {
+			goto out_unlock;
 		}
-		iovcnt_out = 2;
-	} else {
-		iov_out[frag_idx][0].iov_base = (void *)inbuf;
-		iov_out[frag_idx][0].iov_len = frag_len + KNET_HEADER_DATA_SIZE;
-		iovcnt_out = 1;
 	}
 
-	if (knet_h->crypto_instance) {
-		struct timespec start_time;
-		struct timespec end_time;
-		uint64_t crypt_time;
+	knet_h->tx_group = group;
+	knet_h->tx_direct = 1;
+	err = _send_to_hosts(knet_h, knet_h->recv_from_sock_buf, buff_len, channel, 0, NULL, 0);
+	savederrno = errno;
+	knet_h->tx_direct = 0;
+	knet_h->tx_group = NULL;
 
-		frag_idx = 0;
-		while (frag_idx < inbuf->khp_data_frag_num) {
-			clock_gettime(CLOCK_MONOTONIC, &start_time);
-			if (crypto_encrypt_and_signv(
-					knet_h,
-					iov_out[frag_idx], iovcnt_out,
-					knet_h->send_to_links_buf_crypt[frag_idx],
-					(ssize_t *)&outlen) < 0) {
-				log_debug(knet_h, KNET_SUB_TX, "Unable to encrypt packet");
-				savederrno = ECHILD;
-				err = -1;
-				goto out_unlock;
-			}
-			clock_gettime(CLOCK_MONOTONIC, &end_time);
-			timespec_diff(start_time, end_time, &crypt_time);
+out_unlock:
+	pthread_mutex_unlock(&knet_h->tx_mutex);
 
-	                if (crypt_time < knet_h->stats.tx_crypt_time_min) {
-				knet_h->stats.tx_crypt_time_min = crypt_time;
-			}
-			if (crypt_time > knet_h->stats.tx_crypt_time_max) {
-				knet_h->stats.tx_crypt_time_max = crypt_time;
-			}
-			knet_h->stats.tx_crypt_time_ave =
-				(knet_h->stats.tx_crypt_time_ave * knet_h->stats.tx_crypt_packets +
-				 crypt_time) / (knet_h->stats.tx_crypt_packets+1);
+out:
+	pthread_rwlock_unlock(&knet_h->global_rwlock);
 
-			uncrypted_frag_size = 0;
-			for (j=0; j < iovcnt_out; j++) {
-				uncrypted_frag_size += iov_out[frag_idx][j].iov_len;
-			}
-			knet_h->stats.tx_crypt_byte_overhead += (outlen - uncrypted_frag_size);
-			knet_h->stats.tx_crypt_packets++;
+	errno = err ? savederrno : 0;
+	return err;
+}
 
-			iov_out[frag_idx][0].iov_base = knet_h->send_to_links_buf_crypt[frag_idx];
-			iov_out[frag_idx][0].iov_len = outlen;
-			frag_idx++;
-		}
-		iovcnt_out = 1;
+int knet_send_buf_reserve(knet_handle_t knet_h, char **buff, size_t *buff_len)
+{
+	int savederrno = 0, err = 0;
+	struct knet_send_buf *send_buf = NULL;
+	int i;
+
+	if (!knet_h) {
+		errno = EINVAL;
+		return -1;
 	}
 
-	memset(&msg, 0, sizeof(msg));
+	if (!buff) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	msgs_to_send = inbuf->khp_data_frag_num;
+	if (!buff_len) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	msg_idx = 0;
+	savederrno = pthread_mutex_lock(&knet_h->send_buf_mutex);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get send buffers mutex lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
+		return -1;
+	}
 
-	while (msg_idx < msgs_to_send) {
-		msg[msg_idx].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
-		msg[msg_idx].msg_hdr.msg_iov = &iov_out[msg_idx][0];
-		msg[msg_idx].msg_hdr.msg_iovlen = iovcnt_out;
-		msg_idx++;
+	for (i = 0; i < KNET_SEND_BUFS; i++) {
+		if (!knet_h->send_buf[i].lent) {
+			send_buf = &knet_h->send_buf[i];
+			break;
+		}
 	}
 
-	if (!bcast) {
-		for (host_idx = 0; host_idx < dst_host_ids_entries; host_idx++) {
-			dst_host = knet_h->host_index[dst_host_ids[host_idx]];
+	if (!send_buf) {
+		savederrno = EBUSY;
+		err = -1;
+		goto out_unlock;
+	}
 
-			err = _dispatch_to_links(knet_h, dst_host, &msg[0], msgs_to_send);
+	/*
+	 * buffers are allocated on demand and never released
+	 * till knet_handle_free, they travel between the pool
+	 * and recv_from_sock_buf
+	 */
+	if (!send_buf->data) {
+		send_buf->data = malloc(KNET_DATABUFSIZE);
+		if (!send_buf->data) {
 			savederrno = errno;
-			if (err) {
-				goto out_unlock;
-			}
-		}
-	} else {
-		for (dst_host = knet_h->host_head; dst_host != NULL; dst_host = dst_host->next) {
-			if (dst_host->status.reachable) {
-				err = _dispatch_to_links(knet_h, dst_host, &msg[0], msgs_to_send);
-				savederrno = errno;
-				if (err) {
-					goto out_unlock;
-				}
-			}
+			err = -1;
+			log_err(knet_h, KNET_SUB_TX, "Unable to allocate memory for send buffer: %s",
+				strerror(savederrno));
+			goto out_unlock;
 		}
+		memset(send_buf->data, 0, KNET_DATABUFSIZE);
 	}
 
+	send_buf->lent = 1;
+	*buff = (char *)send_buf->data->khp_data_userdata;
+	*buff_len = KNET_MAX_PACKET_SIZE;
+
 out_unlock:
-	errno = savederrno;
+	pthread_mutex_unlock(&knet_h->send_buf_mutex);
+	errno = err ? savederrno : 0;
 	return err;
 }
 
-int knet_send_sync(knet_handle_t knet_h, const char *buff, const size_t buff_len, const int8_t channel)
+/*
+ * must be called with send_buf_mutex held
+ */
+static struct knet_send_buf *_send_buf_find(knet_handle_t knet_h, const char *buff)
+{
+	int i;
+
+	for (i = 0; i < KNET_SEND_BUFS; i++) {
+		if ((knet_h->send_buf[i].lent) &&
+		    ((const char *)knet_h->send_buf[i].data->khp_data_userdata == buff)) {
+			return &knet_h->send_buf[i];
+		}
+	}
+
+	return NULL;
+}
+
+int knet_send_buf_release(knet_handle_t knet_h, char *buff)
 {
 	int savederrno = 0, err = 0;
+	struct knet_send_buf *send_buf;
 
 	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (buff == NULL) {
+	if (!buff) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (buff_len <= 0) {
-		errno = EINVAL;
+	savederrno = pthread_mutex_lock(&knet_h->send_buf_mutex);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get send buffers mutex lock: %s",
+			strerror(savederrno));
+		errno = savederrno;
 		return -1;
 	}
 
-	if (buff_len > KNET_MAX_PACKET_SIZE) {
+	send_buf = _send_buf_find(knet_h, buff);
+	if (!send_buf) {
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
+
+	send_buf->lent = 0;
+
+out_unlock:
+	pthread_mutex_unlock(&knet_h->send_buf_mutex);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+int knet_send_buf_commit(knet_handle_t knet_h, char *buff, const size_t buff_len, const int8_t channel)
+{
+	int savederrno = 0, err = 0;
+	struct knet_send_buf *send_buf;
+	struct knet_header *inbuf;
+
+	if (!knet_h) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (channel < 0) {
+	if (buff == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
 
-	if (channel >= KNET_DATAFD_MAX) {
+	/*
+	 * the buffer is given back to libknet whatever happens
+	 */
+	if ((buff_len <= 0) ||
+	    (buff_len > KNET_MAX_PACKET_SIZE) ||
+	    (channel < 0) ||
+	    (channel >= KNET_DATAFD_MAX)) {
+		knet_send_buf_release(knet_h, buff);
 		errno = EINVAL;
 		return -1;
 	}
@@ -594,11 +2189,13 @@ int knet_send_sync(knet_handle_t knet_h, const char *buff, const size_t buff_len
 	if (savederrno) {
 		log_err(knet_h, KNET_SUB_TX, "Unable to get read lock: %s",
 			strerror(savederrno));
+		knet_send_buf_release(knet_h, buff);
 		errno = savederrno;
 		return -1;
 	}
 
 	if (!knet_h->sockfd[channel].in_use) {
+		knet_send_buf_release(knet_h, buff);
 		savederrno = EINVAL;
 		err = -1;
 		goto out;
@@ -608,15 +2205,49 @@ int knet_send_sync(knet_handle_t knet_h, const char *buff, const size_t buff_len
 	if (savederrno) {
 		log_err(knet_h, KNET_SUB_TX, "Unable to get TX mutex lock: %s",
 			strerror(savederrno));
+		knet_send_buf_release(knet_h, buff);
 		err = -1;
 		goto out;
 	}
 
+	savederrno = pthread_mutex_lock(&knet_h->send_buf_mutex);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TX, "Unable to get send buffers mutex lock: %s",
+			strerror(savederrno));
+		knet_send_buf_release(knet_h, buff);
+		err = -1;
+		goto out_unlock;
+	}
+
+	send_buf = _send_buf_find(knet_h, buff);
+	if (!send_buf) {
+		pthread_mutex_unlock(&knet_h->send_buf_mutex);
+		savederrno = EINVAL;
+		err = -1;
+		goto out_unlock;
+	}
+
+	/*
+	 * the application wrote the data where the TX thread would
+	 * have read it from the socket: swap the buffers instead of
+	 * copying the data. Only the header is carried over.
+	 * The old socket buffer goes back to the pool.
+	 */
+	inbuf = send_buf->data;
+	memmove(inbuf, knet_h->recv_from_sock_buf, KNET_HEADER_DATA_SIZE);
+	send_buf->data = knet_h->recv_from_sock_buf;
+	send_buf->lent = 0;
+	knet_h->recv_from_sock_buf = inbuf;
+
+	pthread_mutex_unlock(&knet_h->send_buf_mutex);
+
 	knet_h->recv_from_sock_buf->kh_type = KNET_HEADER_TYPE_DATA;
-	memmove(knet_h->recv_from_sock_buf->khp_data_userdata, buff, buff_len);
-	err = _parse_recv_from_sock(knet_h, buff_len, channel, 1);
+	knet_h->tx_direct = 1;
+	err = _parse_recv_from_sock(knet_h, buff_len, channel, 0, NULL, 0);
 	savederrno = errno;
+	knet_h->tx_direct = 0;
 
+out_unlock:
 	pthread_mutex_unlock(&knet_h->tx_mutex);
 
 out:
@@ -626,11 +2257,20 @@ out:
 	return err;
 }
 
-static void _handle_send_to_links(knet_handle_t knet_h, struct msghdr *msg, int sockfd, int8_t channel, int type)
+/*
+ * returns the amount of data read from sockfd, 0 if there
+ * was nothing to read or the sockfd had an error
+ */
+static ssize_t _handle_send_to_links(knet_handle_t knet_h, struct msghdr *msg, int sockfd, int8_t channel, int type)
 {
 	ssize_t inlen = 0;
 	int savederrno = 0, docallback = 0;
 
+	/*
+	 * recv_from_sock_buf can be swapped by MSG_ZEROCOPY
+	 */
+	msg->msg_iov->iov_base = (void *)knet_h->recv_from_sock_buf->khp_data_userdata;
+
 	if ((channel >= 0) &&
 	    (channel < KNET_DATAFD_MAX) &&
 	    (!knet_h->sockfd[channel].is_socket)) {
@@ -639,6 +2279,22 @@ static void _handle_send_to_links(knet_handle_t knet_h, struct msghdr *msg, int
 		inlen = recvmsg(sockfd, msg, MSG_DONTWAIT | MSG_NOSIGNAL);
 	}
 
+	if ((inlen < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+		/*
+		 * the TX thread keeps reading from a channel till
+		 * it runs out of quantum or data
+		 */
+		return 0;
+	}
+
+	if ((inlen <= 0) && (channel < 0)) {
+		/*
+		 * internal host info socket, there is no datafd to notify
+		 */
+		log_debug(knet_h, KNET_SUB_TX, "Unable to read host info: %s", strerror(errno));
+		return 0;
+	}
+
 	if (inlen == 0) {
 		savederrno = 0;
 		docallback = 1;
@@ -658,7 +2314,13 @@ static void _handle_send_to_links(knet_handle_t knet_h, struct msghdr *msg, int
 		}
 	} else {
 		knet_h->recv_from_sock_buf->kh_type = type;
-		_parse_recv_from_sock(knet_h, inlen, channel, 0);
+		_parse_recv_from_sock(knet_h, inlen, channel, 0, NULL, 0);
+	}
+
+	if ((docallback) && (knet_h->event_queue)) {
+		_event_sock(knet_h, knet_h->sockfd[channel].sockfd[0],
+			    channel, KNET_NOTIFY_TX, inlen, savederrno);
+		return 0;
 	}
 
 	if (docallback) {
@@ -668,15 +2330,94 @@ static void _handle_send_to_links(knet_handle_t knet_h, struct msghdr *msg, int
 				       KNET_NOTIFY_TX,
 				       inlen,
 				       savederrno);
+		return 0;
+	}
+
+	return inlen;
+}
+
+/*
+ * serve the channels with data ready to be sent.
+ * Channels with higher priority are served first and lower priority
+ * channels are only served once all higher priority channels have
+ * been drained. Channels with the same priority are served with
+ * deficit round robin, reading up to KNET_TX_CHANNEL_QUANTUM bytes
+ * for each turn.
+ */
+static void _handle_send_to_channels(knet_handle_t knet_h, struct msghdr *msg, const uint8_t *channel_ready)
+{
+	int8_t channel;
+	int i, prio, next_prio;
+	int backlog = 0;
+	ssize_t inlen;
+
+	prio = -1;
+	for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
+		if ((channel_ready[channel]) &&
+		    (knet_h->sockfd[channel].priority > prio)) {
+			prio = knet_h->sockfd[channel].priority;
+		}
+	}
+
+	while ((prio >= 0) && (!backlog)) {
+		next_prio = -1;
+		for (i = 0; i < KNET_DATAFD_MAX; i++) {
+			channel = (knet_h->tx_next_channel + i) % KNET_DATAFD_MAX;
+
+			if (!channel_ready[channel]) {
+				continue;
+			}
+			if (knet_h->sockfd[channel].priority < prio) {
+				if (knet_h->sockfd[channel].priority > next_prio) {
+					next_prio = knet_h->sockfd[channel].priority;
+				}
+				continue;
+			}
+			if (knet_h->sockfd[channel].priority > prio) {
+				continue;
+			}
+
+			knet_h->sockfd[channel].deficit += KNET_TX_CHANNEL_QUANTUM;
+			inlen = 0;
+
+			while ((knet_h->sockfd[channel].deficit > 0) && (!knet_h->txq_blocked)) {
+				if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+					inlen = 0;
+					break;
+				}
+				inlen = _handle_send_to_links(knet_h, msg,
+							      knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created],
+							      channel, KNET_HEADER_TYPE_DATA);
+				pthread_mutex_unlock(&knet_h->tx_mutex);
+				if (inlen <= 0) {
+					break;
+				}
+				knet_h->sockfd[channel].deficit -= inlen;
+			}
+
+			if (inlen <= 0) {
+				/*
+				 * channel is empty, it doesn't carry over any credit
+				 */
+				knet_h->sockfd[channel].deficit = 0;
+			} else {
+				backlog = 1;
+			}
+
+			knet_h->tx_next_channel = (channel + 1) % KNET_DATAFD_MAX;
+		}
+		prio = next_prio;
 	}
 }
 
 void *_handle_send_to_links_thread(void *data)
 {
 	knet_handle_t knet_h = (knet_handle_t) data;
-	struct epoll_event events[KNET_EPOLL_MAX_EVENTS];
-	int i, nev, type;
+	struct epoll_event events[KNET_TX_EPOLL_MAX_EVENTS];
+	int i, nev;
 	int8_t channel;
+	uint8_t channel_ready[KNET_DATAFD_MAX];
 	struct iovec iov_in;
 	struct msghdr msg;
 	struct sockaddr_storage address;
@@ -704,7 +2445,7 @@ void *_handle_send_to_links_thread(void *data)
 	}
 
 	while (!shutdown_in_progress(knet_h)) {
-		nev = epoll_wait(knet_h->send_to_links_epollfd, events, KNET_EPOLL_MAX_EVENTS + 1, knet_h->threads_timer_res / 1000);
+		nev = epoll_wait(knet_h->send_to_links_epollfd, events, sizeof(events) / sizeof(events[0]), knet_h->threads_timer_res / 1000);
 
 		/*
 		 * we use timeout to detect if thread is shutting down
@@ -718,30 +2459,75 @@ void *_handle_send_to_links_thread(void *data)
 			continue;
 		}
 
+		memset(channel_ready, 0, sizeof(channel_ready));
+
 		for (i = 0; i < nev; i++) {
+			if (events[i].data.fd == knet_h->coalesce_timerfd) {
+				if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+					continue;
+				}
+				_handle_coalesce_timer(knet_h);
+				pthread_mutex_unlock(&knet_h->tx_mutex);
+				continue;
+			}
+			if (events[i].data.fd == knet_h->pacing_timerfd) {
+				if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+					continue;
+				}
+				_handle_pacing_timer(knet_h);
+				pthread_mutex_unlock(&knet_h->tx_mutex);
+				continue;
+			}
+			/*
+			 * host info are sent right away, data from the channels
+			 * is sent below, based on the channels priority
+			 */
 			if (events[i].data.fd == knet_h->hostsockfd[0]) {
-				type = KNET_HEADER_TYPE_HOST_INFO;
-				channel = -1;
-			} else {
-				type = KNET_HEADER_TYPE_DATA;
-				for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
-					if ((knet_h->sockfd[channel].in_use) &&
-					    (knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created] == events[i].data.fd)) {
-						break;
-					}
+				if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+					continue;
 				}
-				if (channel >= KNET_DATAFD_MAX) {
-					log_debug(knet_h, KNET_SUB_TX, "No available channels");
-					continue; /* channel not found */
+				_handle_send_to_links(knet_h, &msg, events[i].data.fd, -1, KNET_HEADER_TYPE_HOST_INFO);
+				pthread_mutex_unlock(&knet_h->tx_mutex);
+				continue;
+			}
+			for (channel = 0; channel < KNET_DATAFD_MAX; channel++) {
+				if ((knet_h->sockfd[channel].in_use) &&
+				    (knet_h->sockfd[channel].sockfd[knet_h->sockfd[channel].is_created] == events[i].data.fd)) {
+					break;
 				}
 			}
-			if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
-				log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+			if (channel < KNET_DATAFD_MAX) {
+				channel_ready[channel] = 1;
+				continue;
+			}
+			/*
+			 * anything else is a link socket with queued data
+			 * that became writable
+			 */
+			if (events[i].events & EPOLLOUT) {
+				if (pthread_mutex_lock(&knet_h->tx_mutex) != 0) {
+					log_debug(knet_h, KNET_SUB_TX, "Unable to get mutex lock");
+					continue;
+				}
+				_handle_txq_writable(knet_h, events[i].data.fd);
+				pthread_mutex_unlock(&knet_h->tx_mutex);
 				continue;
 			}
-			_handle_send_to_links(knet_h, &msg, events[i].data.fd, channel, type);
-			pthread_mutex_unlock(&knet_h->tx_mutex);
+			log_debug(knet_h, KNET_SUB_TX, "No available channels");
+		}
+
+		/*
+		 * backpressure: one or more link queues are full,
+		 * leave data in the datafds till they are drained.
+		 * The datafds are not polled meanwhile, see _link_txq_update_blocked
+		 */
+		if (!knet_h->txq_blocked) {
+			_handle_send_to_channels(knet_h, &msg, channel_ready);
 		}
+
 		pthread_rwlock_unlock(&knet_h->global_rwlock);
 	}
 
@@ -24,6 +24,7 @@
 #include "logging.h"
 #include "common.h"
 #include "transport_common.h"
+#include "uring.h"
 
 /*
  * reuse Jan Friesse's compat layer as wrapper to drop usage of sendmmsg
@@ -431,6 +432,20 @@ int _set_fd_tracker(knet_handle_t knet_h, int sockfd, uint8_t transport, uint8_t
 		return -1;
 	}
 
+	/*
+	 * io_uring holds a reference to the socket till the
+	 * request is cancelled. Completions of the old request
+	 * are discarded by the RX thread checking uring_gen.
+	 */
+	if (knet_h->knet_transport_fd_tracker[sockfd].uring_armed) {
+		if (uring_cancel(knet_h, KNET_URING_SOCK_DATA(knet_h->knet_transport_fd_tracker[sockfd].uring_gen, sockfd)) < 0) {
+			log_debug(knet_h, KNET_SUB_TRANSPORT, "Unable to cancel io_uring recvmsg for socket %d: %s",
+				  sockfd, strerror(errno));
+		}
+		knet_h->knet_transport_fd_tracker[sockfd].uring_armed = 0;
+	}
+	knet_h->knet_transport_fd_tracker[sockfd].uring_gen++;
+
 	knet_h->knet_transport_fd_tracker[sockfd].transport = transport;
 	knet_h->knet_transport_fd_tracker[sockfd].data_type = data_type;
 	knet_h->knet_transport_fd_tracker[sockfd].data = data;
@@ -78,6 +78,7 @@ typedef struct sctp_connect_link_info {
 	int on_connected_epoll;
 	int on_rx_epoll;
 	int close_sock;
+	uint16_t out_streams;	/* outbound streams negotiated with the peer */
 } sctp_connect_link_info_t;
 
 /*
@@ -152,6 +153,7 @@ static int _configure_sctp_socket(knet_handle_t knet_h, int sock, struct sockadd
 	int err = 0, savederrno = 0;
 	int value;
 	int level;
+	struct sctp_initmsg initmsg;
 
 #ifdef SOL_SCTP
 	level = SOL_SCTP;
@@ -174,6 +176,17 @@ static int _configure_sctp_socket(knet_handle_t knet_h, int sock, struct sockadd
 		goto exit_error;
 	}
 
+	memset(&initmsg, 0, sizeof(struct sctp_initmsg));
+	initmsg.sinit_num_ostreams = KNET_SCTP_STREAMS;
+	initmsg.sinit_max_instreams = KNET_SCTP_STREAMS;
+	if (setsockopt(sock, level, SCTP_INITMSG, &initmsg, sizeof(initmsg)) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSPORT, "Unable to set sctp streams: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
 	if (_enable_sctp_notifications(knet_h, sock, type) < 0) {
 		savederrno = errno;
 		err = -1;
@@ -416,6 +429,67 @@ int sctp_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err,
  *       delegate any FD error management to sctp_transport_rx_sock_error
  *       and keep this code to parsing incoming data only
  */
+/*
+ * data from each channel is sent on its own stream and unordered,
+ * knet sequence numbers and defrag already take care of ordering
+ * and duplicates, so a lost packet does not hold back the others.
+ * Channels with a lifetime are sent with PR-SCTP timed reliability.
+ */
+int sctp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	sctp_connect_link_info_t *info = kn_link->transport_link;
+	char cbuf[CMSG_SPACE(sizeof(struct sctp_sndrcvinfo))];
+	struct cmsghdr *cmsg;
+	struct sctp_sndrcvinfo *sinfo;
+	int8_t channel = knet_h->tx_channel;
+	unsigned int i;
+	int err, savederrno;
+
+	/*
+	 * host info and single stream associations keep
+	 * the default ordered delivery on stream 0
+	 */
+	if ((channel < 0) || (channel >= KNET_DATAFD_MAX) ||
+	    (!info) || (info->out_streams <= 1)) {
+		return _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+	}
+
+	memset(cbuf, 0, sizeof(cbuf));
+	cmsg = (struct cmsghdr *)cbuf;
+	cmsg->cmsg_level = IPPROTO_SCTP;
+	cmsg->cmsg_type = SCTP_SNDRCV;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_sndrcvinfo));
+
+	sinfo = (struct sctp_sndrcvinfo *)CMSG_DATA(cmsg);
+	sinfo->sinfo_stream = (channel % (info->out_streams - 1)) + 1;
+	sinfo->sinfo_flags = SCTP_UNORDERED;
+	if (knet_h->sockfd[channel].lifetime) {
+#ifdef SCTP_PR_SCTP_TTL
+		sinfo->sinfo_flags |= SCTP_PR_SCTP_TTL;
+#endif
+		sinfo->sinfo_timetolive = knet_h->sockfd[channel].lifetime;
+	}
+
+	for (i = 0; i < vlen; i++) {
+		msgvec[i].msg_hdr.msg_control = cbuf;
+		msgvec[i].msg_hdr.msg_controllen = sizeof(cbuf);
+	}
+
+	err = _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+	savederrno = errno;
+
+	/*
+	 * msgvec is reused by the caller for other links
+	 */
+	for (i = 0; i < vlen; i++) {
+		msgvec[i].msg_hdr.msg_control = NULL;
+		msgvec[i].msg_hdr.msg_controllen = 0;
+	}
+
+	errno = savederrno;
+	return err;
+}
+
 int sctp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg)
 {
 	size_t i;
@@ -528,6 +602,8 @@ static void _handle_connected_sctp(knet_handle_t knet_h, int connect_sock)
 	int err;
 	struct epoll_event ev;
 	unsigned int status, len = sizeof(status);
+	struct sctp_status sstatus;
+	socklen_t sstatus_len = sizeof(sstatus);
 	sctp_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_SCTP];
 	sctp_connect_link_info_t *info = knet_h->knet_transport_fd_tracker[connect_sock].data;
 	struct knet_link *kn_link = info->link;
@@ -576,6 +652,19 @@ static void _handle_connected_sctp(knet_handle_t knet_h, int connect_sock)
 	}
 	info->on_connected_epoll = 0;
 
+	/*
+	 * the peer might accept less streams than we asked for,
+	 * fall back to stream 0 only if we cannot tell
+	 */
+	memset(&sstatus, 0, sizeof(struct sctp_status));
+	if (getsockopt(connect_sock, IPPROTO_SCTP, SCTP_STATUS, &sstatus, &sstatus_len) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SCTP, "Unable to get SCTP status of socket %d: %s",
+			  connect_sock, strerror(errno));
+		info->out_streams = 1;
+	} else {
+		info->out_streams = sstatus.sstat_outstrms;
+	}
+
 	kn_link->transport_connected = 1;
 	kn_link->outsock = info->connect_sock;
 
@@ -588,9 +677,10 @@ static void _handle_connected_sctp(knet_handle_t knet_h, int connect_sock)
 	}
 	info->on_rx_epoll = 1;
 
-	log_debug(knet_h, KNET_SUB_TRANSP_SCTP, "SCTP handler fd %d now connected to %s port %s",
+	log_debug(knet_h, KNET_SUB_TRANSP_SCTP, "SCTP handler fd %d now connected to %s port %s (%u streams)",
 		  connect_sock,
-		  kn_link->status.dst_ipaddr, kn_link->status.dst_port);
+		  kn_link->status.dst_ipaddr, kn_link->status.dst_port,
+		  info->out_streams);
 }
 
 static void _handle_connected_sctp_errors(knet_handle_t knet_h)
@@ -845,6 +935,7 @@ static void _handle_listen_sctp_errors(knet_handle_t knet_h)
 				log_debug(knet_h, KNET_SUB_TRANSP_SCTP, "Found dynamic connection on host %d link %d (%d)",
 					  host->host_id, link_idx, sockfd);
 				host->link[link_idx].status.dynconnected = 0;
+				host->link[link_idx].status_generation = _host_topology_changed(knet_h);
 				host->link[link_idx].transport_connected = 0;
 				host->link[link_idx].outsock = 0;
 				memset(&host->link[link_idx].dst_addr, 0, sizeof(struct sockaddr_storage));
@@ -23,12 +23,19 @@
 
 #ifdef HAVE_NETINET_SCTP_H
 
+/*
+ * data channels are sent on streams 1..KNET_DATAFD_MAX,
+ * stream 0 carries heartbeats, PMTUd and host info
+ */
+#define KNET_SCTP_STREAMS (KNET_DATAFD_MAX + 1)
+
 int sctp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link);
 int sctp_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link);
 int sctp_transport_free(knet_handle_t knet_h);
 int sctp_transport_init(knet_handle_t knet_h);
 int sctp_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
 int sctp_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int sctp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
 int sctp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg);
 int sctp_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link);
 
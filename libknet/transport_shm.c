@@ -0,0 +1,1290 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "compat.h"
+#include "host.h"
+#include "links.h"
+#include "logging.h"
+#include "common.h"
+#include "transport_common.h"
+#include "transport_shm.h"
+#include "threads_common.h"
+
+#ifdef KNET_HAVE_SHM
+#include <sys/eventfd.h>
+
+/*
+ * Shared memory transport.
+ *
+ * Links between knet nodes running on the same machine exchange
+ * packets via a pair of single producer/single consumer rings, one
+ * per direction, allocated by the sender with memfd_create(2).
+ * The sender rings an eventfd doorbell when it adds packets to an
+ * empty ring and the RX thread polls the doorbell as any other
+ * link socket.
+ *
+ * Nodes find each other via an abstract unix socket named after the
+ * link source address and port, co-located nodes must share the
+ * network namespace. The node with the lower address connects to
+ * the other one and both send their TX ring and doorbell over the
+ * connection (SCM_RIGHTS). The connection is kept open as long as
+ * the rings are in use, when the peer goes away the rings are
+ * released and the node with the lower address reconnects on the
+ * next heartbeat.
+ *
+ * Link up/down is still driven by ping/pong, sent via the rings
+ * as any other packet.
+ */
+
+#define KNET_SHM_MAGIC 0x6b6e7368	/* knsh */
+#define KNET_SHM_VERSION 1
+#define KNET_SHM_RING_MAX_SIZE (64 * 1024 * 1024)
+#define KNET_SHM_REC_WRAP UINT32_MAX	/* rest of the ring is unused, restart from 0 */
+
+typedef struct shm_ring_hdr {
+	uint32_t magic;
+	uint32_t size;
+	uint64_t head __attribute__((aligned(64)));	/* written by the producer */
+	uint64_t tail __attribute__((aligned(64)));	/* written by the consumer */
+} __attribute__((aligned(64))) shm_ring_hdr_t;
+
+typedef struct shm_rec {
+	uint32_t len;
+	uint32_t pad;
+} shm_rec_t;
+
+#define KNET_SHM_REC_SIZE(len) ((sizeof(shm_rec_t) + (len) + 7) & ~((uint64_t)7))
+
+typedef struct shm_ring {
+	shm_ring_hdr_t *hdr;
+	unsigned char *data;
+	size_t map_size;
+	uint64_t mask;
+} shm_ring_t;
+
+typedef struct shm_hello {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t ring_size;
+	uint32_t pad;
+	struct sockaddr_storage src;	/* sender link source address */
+	struct sockaddr_storage dst;	/* sender link destination address */
+} shm_hello_t;
+
+typedef struct shm_listener_info {
+	struct knet_list_head list;
+	struct sockaddr_storage local_address;
+	int refcount;
+	int listen_fd;
+} shm_listener_info_t;
+
+typedef struct shm_handle_info {
+	struct knet_list_head links_list;
+	struct knet_list_head listeners_list;
+} shm_handle_info_t;
+
+typedef struct shm_link_info {
+	struct knet_list_head list;
+	struct knet_link *kn_link;
+	shm_listener_info_t *listener;
+	int initiator;			/* we connect to the peer */
+	pthread_mutex_t mutex;		/* TX ring and peer connection */
+	int ctrl_fd;			/* connection to the peer, -1 if not attached */
+	int tx_efd;			/* doorbell of the peer, also link outsock */
+	shm_ring_t tx;
+	int rx_efd;			/* our doorbell, rung by the peer */
+	shm_ring_t rx;
+	struct timespec connect_last;
+} shm_link_info_t;
+
+/*
+ * compares address and port only, sockaddr_storage padding
+ * is not part of the identity of a link
+ */
+static int _shm_addr_cmp(const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+	const struct sockaddr_in *a4 = (const struct sockaddr_in *)a;
+	const struct sockaddr_in *b4 = (const struct sockaddr_in *)b;
+	const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a;
+	const struct sockaddr_in6 *b6 = (const struct sockaddr_in6 *)b;
+	int res;
+
+	if (a->ss_family != b->ss_family) {
+		return (a->ss_family < b->ss_family) ? -1 : 1;
+	}
+
+	if (a->ss_family == AF_INET6) {
+		res = memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(struct in6_addr));
+		if (!res) {
+			res = memcmp(&a6->sin6_port, &b6->sin6_port, sizeof(in_port_t));
+		}
+	} else {
+		res = memcmp(&a4->sin_addr, &b4->sin_addr, sizeof(struct in_addr));
+		if (!res) {
+			res = memcmp(&a4->sin_port, &b4->sin_port, sizeof(in_port_t));
+		}
+	}
+
+	return res;
+}
+
+/*
+ * abstract unix socket used to reach the node owning address
+ */
+static int _shm_sockname(const struct sockaddr_storage *address, struct sockaddr_un *sun, socklen_t *sunlen)
+{
+	char host[KNET_MAX_HOST_LEN];
+	char port[KNET_MAX_PORT_LEN];
+	int len;
+
+	if (knet_addrtostr(address, sizeof(struct sockaddr_storage),
+			   host, KNET_MAX_HOST_LEN, port, KNET_MAX_PORT_LEN)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(sun, 0, sizeof(struct sockaddr_un));
+	sun->sun_family = AF_UNIX;
+	len = snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1, "knet-shm-%s:%s", host, port);
+	if ((len < 0) || ((size_t)len >= sizeof(sun->sun_path) - 1)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	*sunlen = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+
+	return 0;
+}
+
+static int _shm_epoll_add(knet_handle_t knet_h, int fd, uint8_t data_type, void *data)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_ADD, fd, &ev)) {
+		return -1;
+	}
+
+	if (_set_fd_tracker(knet_h, fd, KNET_TRANSPORT_SHM, data_type, data) < 0) {
+		epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, fd, &ev);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void _shm_epoll_del(knet_handle_t knet_h, int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, fd, &ev) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to remove fd %d from epoll pool: %s",
+			  fd, strerror(errno));
+	}
+
+	_set_fd_tracker(knet_h, fd, KNET_MAX_TRANSPORTS, 0, NULL);
+}
+
+/*
+ * rings
+ */
+
+static int _shm_ring_map(shm_ring_t *ring, int ring_fd, uint32_t size)
+{
+	struct stat st;
+	size_t map_size = sizeof(shm_ring_hdr_t) + size;
+	void *map;
+
+	if ((size < 4096) || (size > KNET_SHM_RING_MAX_SIZE) || (size & (size - 1))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (fstat(ring_fd, &st) < 0) {
+		return -1;
+	}
+
+	if ((size_t)st.st_size < map_size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+	if (map == MAP_FAILED) {
+		return -1;
+	}
+
+	ring->hdr = map;
+	ring->data = (unsigned char *)map + sizeof(shm_ring_hdr_t);
+	ring->map_size = map_size;
+	ring->mask = size - 1;
+
+	return 0;
+}
+
+static void _shm_ring_unmap(shm_ring_t *ring)
+{
+	if (ring->hdr) {
+		munmap(ring->hdr, ring->map_size);
+	}
+	memset(ring, 0, sizeof(shm_ring_t));
+}
+
+/*
+ * returns the memfd backing the ring, to be sent to the peer
+ */
+static int _shm_ring_create(shm_ring_t *ring)
+{
+	int ring_fd, savederrno;
+
+	ring_fd = memfd_create("knet-shm", MFD_CLOEXEC);
+	if (ring_fd < 0) {
+		return -1;
+	}
+
+	if ((ftruncate(ring_fd, sizeof(shm_ring_hdr_t) + KNET_SHM_RING_SIZE) < 0) ||
+	    (_shm_ring_map(ring, ring_fd, KNET_SHM_RING_SIZE) < 0)) {
+		savederrno = errno;
+		close(ring_fd);
+		errno = savederrno;
+		return -1;
+	}
+
+	ring->hdr->magic = KNET_SHM_MAGIC;
+	ring->hdr->size = KNET_SHM_RING_SIZE;
+
+	return ring_fd;
+}
+
+static size_t _shm_iov_len(const struct iovec *iov, size_t iovlen)
+{
+	size_t i, len = 0;
+
+	for (i = 0; i < iovlen; i++) {
+		len += iov[i].iov_len;
+	}
+
+	return len;
+}
+
+/*
+ * add a packet at *head, the caller publishes head once done.
+ * returns the packet length or -1 and errno ENOBUFS when the ring is full
+ */
+static ssize_t _shm_ring_push(shm_ring_t *ring, uint64_t *head, const struct iovec *iov, size_t iovlen)
+{
+	uint64_t size = ring->mask + 1;
+	uint64_t tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE);
+	uint64_t idx = *head & ring->mask;
+	uint64_t used = *head - tail;
+	uint64_t pad = 0;
+	size_t len, rec_size, i;
+	shm_rec_t *rec;
+	unsigned char *dst;
+
+	len = _shm_iov_len(iov, iovlen);
+	rec_size = KNET_SHM_REC_SIZE(len);
+
+	if (rec_size > size / 2) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	if (size - idx < rec_size) {
+		pad = size - idx;
+	}
+
+	if ((used > size) || (size - used < pad + rec_size)) {
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	if (pad) {
+		rec = (shm_rec_t *)(ring->data + idx);
+		rec->len = KNET_SHM_REC_WRAP;
+		*head += pad;
+		idx = 0;
+	}
+
+	rec = (shm_rec_t *)(ring->data + idx);
+	rec->len = len;
+	dst = (unsigned char *)(rec + 1);
+	for (i = 0; i < iovlen; i++) {
+		memmove(dst, iov[i].iov_base, iov[i].iov_len);
+		dst += iov[i].iov_len;
+	}
+	*head += rec_size;
+
+	return len;
+}
+
+/*
+ * make the packets visible to the peer and ring the doorbell
+ * if the peer might be waiting for them (the ring was empty).
+ * The barrier pairs with the one in _shm_rx_ring.
+ */
+static void _shm_ring_publish(knet_handle_t knet_h, shm_link_info_t *info, uint64_t start, uint64_t head)
+{
+	uint64_t one = 1;
+
+	__atomic_store_n(&info->tx.hdr->head, head, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&info->tx.hdr->tail, __ATOMIC_RELAXED) != start) {
+		return;
+	}
+
+	if (write(info->tx_efd, &one, sizeof(one)) != sizeof(one)) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to ring shared memory doorbell: %s",
+			  strerror(errno));
+	}
+}
+
+/*
+ * peer connection
+ */
+
+static int _shm_send_hello(shm_link_info_t *info, int sock, int ring_fd)
+{
+	shm_hello_t hello;
+	struct msghdr msg;
+	struct iovec iov;
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+		struct cmsghdr align;
+	} cmsgbuf;
+	struct cmsghdr *cmsg;
+	int fds[2];
+	ssize_t len;
+
+	memset(&hello, 0, sizeof(shm_hello_t));
+	hello.magic = KNET_SHM_MAGIC;
+	hello.version = KNET_SHM_VERSION;
+	hello.ring_size = info->tx.mask + 1;
+	memmove(&hello.src, &info->kn_link->src_addr, sizeof(struct sockaddr_storage));
+	memmove(&hello.dst, &info->kn_link->dst_addr, sizeof(struct sockaddr_storage));
+
+	iov.iov_base = &hello;
+	iov.iov_len = sizeof(shm_hello_t);
+
+	memset(&cmsgbuf, 0, sizeof(cmsgbuf));
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	fds[0] = ring_fd;
+	fds[1] = info->tx_efd;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memmove(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	len = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (len != sizeof(shm_hello_t)) {
+		if (len >= 0) {
+			errno = EPROTO;
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * returns 1 when a valid hello has been received, 0 when the peer
+ * closed the connection, -1 and errno set on error (EAGAIN if there
+ * is nothing to read)
+ */
+static int _shm_recv_hello(int sock, shm_hello_t *hello, int *ring_fd, int *efd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+		struct cmsghdr align;
+	} cmsgbuf;
+	struct cmsghdr *cmsg;
+	int fds[2] = { -1, -1 };
+	int nfds = 0;
+	ssize_t len;
+
+	iov.iov_base = hello;
+	iov.iov_len = sizeof(shm_hello_t);
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	len = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (len <= 0) {
+		return len;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+			nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			if (nfds > 2) {
+				nfds = 2;
+			}
+			memmove(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+		}
+	}
+
+	if ((len != sizeof(shm_hello_t)) || (nfds != 2) || (msg.msg_flags & MSG_CTRUNC) ||
+	    (hello->magic != KNET_SHM_MAGIC) || (hello->version != KNET_SHM_VERSION)) {
+		if (fds[0] >= 0) {
+			close(fds[0]);
+		}
+		if (fds[1] >= 0) {
+			close(fds[1]);
+		}
+		errno = EPROTO;
+		return -1;
+	}
+
+	*ring_fd = fds[0];
+	*efd = fds[1];
+
+	return 1;
+}
+
+/*
+ * release everything shared with the peer.
+ * caller must hold info->mutex
+ */
+static void _shm_detach(knet_handle_t knet_h, shm_link_info_t *info)
+{
+	if (info->rx_efd >= 0) {
+		_shm_epoll_del(knet_h, info->rx_efd);
+		close(info->rx_efd);
+		info->rx_efd = -1;
+	}
+	_shm_ring_unmap(&info->rx);
+
+	if (info->ctrl_fd >= 0) {
+		_shm_epoll_del(knet_h, info->ctrl_fd);
+		close(info->ctrl_fd);
+		info->ctrl_fd = -1;
+	}
+	_shm_ring_unmap(&info->tx);
+}
+
+/*
+ * map the ring and doorbell sent by the peer, both fds are consumed.
+ * caller must hold info->mutex
+ */
+static int _shm_attach_rx(knet_handle_t knet_h, shm_link_info_t *info, shm_hello_t *hello, int ring_fd, int efd)
+{
+	int err = 0, savederrno = 0;
+
+	if (_shm_ring_map(&info->rx, ring_fd, hello->ring_size) < 0) {
+		savederrno = errno;
+		err = -1;
+		close(efd);
+		goto exit_error;
+	}
+
+	if ((info->rx.hdr->magic != KNET_SHM_MAGIC) || (info->rx.hdr->size != hello->ring_size)) {
+		savederrno = EPROTO;
+		err = -1;
+		_shm_ring_unmap(&info->rx);
+		close(efd);
+		goto exit_error;
+	}
+
+	if (_shm_epoll_add(knet_h, efd, KNET_SHM_DATA_RING, info) < 0) {
+		savederrno = errno;
+		err = -1;
+		_shm_ring_unmap(&info->rx);
+		close(efd);
+		goto exit_error;
+	}
+
+	info->rx_efd = efd;
+
+exit_error:
+	close(ring_fd);
+	errno = savederrno;
+	return err;
+}
+
+/*
+ * create a new TX ring and send it to the peer over sock.
+ * caller must hold info->mutex
+ */
+static int _shm_attach_tx(knet_handle_t knet_h, shm_link_info_t *info, int sock)
+{
+	int ring_fd, savederrno;
+
+	ring_fd = _shm_ring_create(&info->tx);
+	if (ring_fd < 0) {
+		return -1;
+	}
+
+	if (_shm_send_hello(info, sock, ring_fd) < 0) {
+		savederrno = errno;
+		close(ring_fd);
+		_shm_ring_unmap(&info->tx);
+		errno = savederrno;
+		return -1;
+	}
+
+	close(ring_fd);
+
+	if (_shm_epoll_add(knet_h, sock, KNET_SHM_DATA_CTRL, info) < 0) {
+		savederrno = errno;
+		_shm_ring_unmap(&info->tx);
+		errno = savederrno;
+		return -1;
+	}
+
+	info->ctrl_fd = sock;
+
+	return 0;
+}
+
+/*
+ * caller must hold info->mutex
+ */
+static int _shm_connect(knet_handle_t knet_h, shm_link_info_t *info)
+{
+	struct sockaddr_un sun;
+	socklen_t sunlen;
+	int sock, savederrno;
+
+	clock_gettime(CLOCK_MONOTONIC, &info->connect_last);
+
+	if (_shm_sockname(&info->kn_link->dst_addr, &sun, &sunlen) < 0) {
+		return -1;
+	}
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (sock < 0) {
+		return -1;
+	}
+
+	if (connect(sock, (struct sockaddr *)&sun, sunlen) < 0) {
+		savederrno = errno;
+		close(sock);
+		errno = savederrno;
+		return -1;
+	}
+
+	if (_shm_attach_tx(knet_h, info, sock) < 0) {
+		savederrno = errno;
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to send shared memory ring to %s:%s: %s",
+			  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port,
+			  strerror(savederrno));
+		close(sock);
+		errno = savederrno;
+		return -1;
+	}
+
+	log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Connected to shared memory peer %s:%s",
+		  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port);
+
+	return 0;
+}
+
+static shm_link_info_t *_shm_find_link(shm_handle_info_t *handle_info, shm_hello_t *hello)
+{
+	shm_link_info_t *info;
+
+	knet_list_for_each_entry(info, &handle_info->links_list, list) {
+		if ((!_shm_addr_cmp(&info->kn_link->src_addr, &hello->dst)) &&
+		    (!_shm_addr_cmp(&info->kn_link->dst_addr, &hello->src)) &&
+		    (_shm_addr_cmp(&info->kn_link->src_addr, &info->kn_link->dst_addr))) {
+			return info;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * new connection on the listener, the peer sends its hello
+ * right after connecting
+ */
+static void _shm_accept(knet_handle_t knet_h, int sock)
+{
+	shm_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_SHM];
+	shm_link_info_t *info;
+	shm_hello_t hello;
+	struct ucred cred;
+	socklen_t credlen = sizeof(struct ucred);
+	struct pollfd pfd;
+	int ring_fd, efd;
+
+	if ((getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0) ||
+	    ((cred.uid != geteuid()) && (cred.uid != 0))) {
+		log_warn(knet_h, KNET_SUB_TRANSP_SHM, "Rejecting shared memory connection from pid %d uid %u",
+			 (int)cred.pid, (unsigned int)cred.uid);
+		close(sock);
+		return;
+	}
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if ((poll(&pfd, 1, KNET_SHM_HELLO_TIMEOUT) <= 0) ||
+	    (_shm_recv_hello(sock, &hello, &ring_fd, &efd) != 1)) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "No valid hello from shared memory peer (pid %d)",
+			  (int)cred.pid);
+		close(sock);
+		return;
+	}
+
+	info = _shm_find_link(handle_info, &hello);
+	if (!info) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "No shared memory link configured for peer (pid %d)",
+			  (int)cred.pid);
+		close(ring_fd);
+		close(efd);
+		close(sock);
+		return;
+	}
+
+	pthread_mutex_lock(&info->mutex);
+
+	/*
+	 * the peer has restarted, drop the old rings
+	 */
+	_shm_detach(knet_h, info);
+
+	if (_shm_attach_rx(knet_h, info, &hello, ring_fd, efd) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to map shared memory ring from %s:%s: %s",
+			  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port,
+			  strerror(errno));
+		close(sock);
+		goto out_unlock;
+	}
+
+	if (_shm_attach_tx(knet_h, info, sock) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to send shared memory ring to %s:%s: %s",
+			  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port,
+			  strerror(errno));
+		_shm_detach(knet_h, info);
+		close(sock);
+		goto out_unlock;
+	}
+
+	log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Accepted shared memory peer %s:%s",
+		  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port);
+
+out_unlock:
+	pthread_mutex_unlock(&info->mutex);
+}
+
+static void _shm_listener_event(knet_handle_t knet_h, int listen_fd)
+{
+	int sock;
+
+	while ((sock = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		_shm_accept(knet_h, sock);
+	}
+}
+
+/*
+ * the peer replied to our hello with its ring, or went away
+ */
+static void _shm_ctrl_event(knet_handle_t knet_h, shm_link_info_t *info, int sock)
+{
+	shm_hello_t hello;
+	int ring_fd, efd;
+	int res;
+
+	pthread_mutex_lock(&info->mutex);
+
+	if (info->ctrl_fd != sock) {
+		goto out_unlock;
+	}
+
+	res = _shm_recv_hello(sock, &hello, &ring_fd, &efd);
+	if ((res < 0) && (errno == EAGAIN)) {
+		goto out_unlock;
+	}
+
+	if (res == 1) {
+		if ((!info->rx.hdr) &&
+		    (!_shm_addr_cmp(&info->kn_link->src_addr, &hello.dst)) &&
+		    (!_shm_addr_cmp(&info->kn_link->dst_addr, &hello.src))) {
+			if (_shm_attach_rx(knet_h, info, &hello, ring_fd, efd) < 0) {
+				log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to map shared memory ring from %s:%s: %s",
+					  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port,
+					  strerror(errno));
+				_shm_detach(knet_h, info);
+			}
+			goto out_unlock;
+		}
+		close(ring_fd);
+		close(efd);
+	}
+
+	log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Shared memory peer %s:%s detached",
+		  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port);
+	_shm_detach(knet_h, info);
+
+out_unlock:
+	pthread_mutex_unlock(&info->mutex);
+}
+
+/*
+ * listeners, one per local address
+ */
+
+static shm_listener_info_t *_shm_listener_get(knet_handle_t knet_h, shm_handle_info_t *handle_info, const struct sockaddr_storage *address)
+{
+	shm_listener_info_t *listener;
+	struct sockaddr_un sun;
+	socklen_t sunlen;
+	int savederrno = 0;
+
+	knet_list_for_each_entry(listener, &handle_info->listeners_list, list) {
+		if (!_shm_addr_cmp(&listener->local_address, address)) {
+			listener->refcount++;
+			return listener;
+		}
+	}
+
+	if (_shm_sockname(address, &sun, &sunlen) < 0) {
+		return NULL;
+	}
+
+	listener = malloc(sizeof(shm_listener_info_t));
+	if (!listener) {
+		return NULL;
+	}
+
+	memset(listener, 0, sizeof(shm_listener_info_t));
+
+	listener->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener->listen_fd < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to create listener socket: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (bind(listener->listen_fd, (struct sockaddr *)&sun, sunlen) < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to bind listener socket %s: %s",
+			sun.sun_path + 1, strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (listen(listener->listen_fd, SOMAXCONN) < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to listen on socket %s: %s",
+			sun.sun_path + 1, strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (_shm_epoll_add(knet_h, listener->listen_fd, KNET_SHM_DATA_LISTENER, listener) < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to add listener to epoll pool: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	memmove(&listener->local_address, address, sizeof(struct sockaddr_storage));
+	listener->refcount = 1;
+	knet_list_add(&listener->list, &handle_info->listeners_list);
+
+	return listener;
+
+exit_error:
+	if (listener->listen_fd >= 0) {
+		close(listener->listen_fd);
+	}
+	free(listener);
+	errno = savederrno;
+	return NULL;
+}
+
+static void _shm_listener_put(knet_handle_t knet_h, shm_listener_info_t *listener)
+{
+	listener->refcount--;
+	if (listener->refcount) {
+		return;
+	}
+
+	_shm_epoll_del(knet_h, listener->listen_fd);
+	close(listener->listen_fd);
+	knet_list_del(&listener->list);
+	free(listener);
+}
+
+/*
+ * transport API
+ */
+
+int shm_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link)
+{
+	int err = 0, savederrno = 0;
+	int ring_fd, cmp;
+	shm_link_info_t *info;
+	shm_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_SHM];
+
+	if (kn_link->dynamic != KNET_LINK_STATIC) {
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Shared memory links require a static destination address");
+		errno = EINVAL;
+		return -1;
+	}
+
+	info = malloc(sizeof(shm_link_info_t));
+	if (!info) {
+		return -1;
+	}
+
+	memset(info, 0, sizeof(shm_link_info_t));
+	info->kn_link = kn_link;
+	info->ctrl_fd = -1;
+	info->rx_efd = -1;
+
+	savederrno = pthread_mutex_init(&info->mutex, NULL);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to initialize link mutex: %s",
+			strerror(savederrno));
+		free(info);
+		errno = savederrno;
+		return -1;
+	}
+
+	info->tx_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (info->tx_efd < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to create doorbell: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	info->listener = _shm_listener_get(knet_h, handle_info, &kn_link->src_addr);
+	if (!info->listener) {
+		savederrno = errno;
+		err = -1;
+		goto exit_error;
+	}
+
+	cmp = _shm_addr_cmp(&kn_link->src_addr, &kn_link->dst_addr);
+	if (!cmp) {
+		/*
+		 * link to ourselves, TX and RX share the same ring
+		 */
+		ring_fd = _shm_ring_create(&info->tx);
+		if (ring_fd < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to create shared memory ring: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		err = _shm_ring_map(&info->rx, ring_fd, KNET_SHM_RING_SIZE);
+		savederrno = errno;
+		close(ring_fd);
+		if (err < 0) {
+			log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to map shared memory ring: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		info->rx_efd = fcntl(info->tx_efd, F_DUPFD_CLOEXEC, 0);
+		if ((info->rx_efd < 0) ||
+		    (_shm_epoll_add(knet_h, info->rx_efd, KNET_SHM_DATA_RING, info) < 0)) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_SHM, "Unable to add doorbell to epoll pool: %s",
+				strerror(savederrno));
+			if (info->rx_efd >= 0) {
+				close(info->rx_efd);
+				info->rx_efd = -1;
+			}
+			goto exit_error;
+		}
+	} else if (cmp < 0) {
+		/*
+		 * the peer might not be there yet, the heartbeats will retry
+		 */
+		info->initiator = 1;
+		pthread_mutex_lock(&info->mutex);
+		_shm_connect(knet_h, info);
+		pthread_mutex_unlock(&info->mutex);
+	}
+
+	knet_list_add(&info->list, &handle_info->links_list);
+
+	kn_link->outsock = info->tx_efd;
+	kn_link->transport_link = info;
+	kn_link->transport_connected = 1;
+	kn_link->transport_gso = 0;
+	kn_link->transport_zerocopy = 0;
+
+exit_error:
+	if (err) {
+		_shm_ring_unmap(&info->rx);
+		_shm_ring_unmap(&info->tx);
+		if (info->listener) {
+			_shm_listener_put(knet_h, info->listener);
+		}
+		if (info->tx_efd >= 0) {
+			close(info->tx_efd);
+		}
+		pthread_mutex_destroy(&info->mutex);
+		free(info);
+	}
+	errno = savederrno;
+	return err;
+}
+
+int shm_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link)
+{
+	shm_link_info_t *info = kn_link->transport_link;
+
+	pthread_mutex_lock(&info->mutex);
+	_shm_detach(knet_h, info);
+	pthread_mutex_unlock(&info->mutex);
+
+	_shm_listener_put(knet_h, info->listener);
+	close(info->tx_efd);
+	pthread_mutex_destroy(&info->mutex);
+	knet_list_del(&info->list);
+	free(info);
+	kn_link->transport_link = NULL;
+
+	return 0;
+}
+
+int shm_transport_free(knet_handle_t knet_h)
+{
+	shm_handle_info_t *handle_info;
+
+	if (!knet_h->transports[KNET_TRANSPORT_SHM]) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	handle_info = knet_h->transports[KNET_TRANSPORT_SHM];
+
+	/*
+	 * keep it here while we debug list usage and such
+	 */
+	if ((!knet_list_empty(&handle_info->links_list)) ||
+	    (!knet_list_empty(&handle_info->listeners_list))) {
+		log_err(knet_h, KNET_SUB_TRANSP_SHM, "Internal error. handle list is not empty");
+		return -1;
+	}
+
+	free(handle_info);
+
+	knet_h->transports[KNET_TRANSPORT_SHM] = NULL;
+
+	return 0;
+}
+
+int shm_transport_init(knet_handle_t knet_h)
+{
+	shm_handle_info_t *handle_info;
+
+	if (knet_h->transports[KNET_TRANSPORT_SHM]) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	handle_info = malloc(sizeof(shm_handle_info_t));
+	if (!handle_info) {
+		return -1;
+	}
+
+	memset(handle_info, 0, sizeof(shm_handle_info_t));
+
+	knet_h->transports[KNET_TRANSPORT_SHM] = handle_info;
+
+	knet_list_init(&handle_info->links_list);
+	knet_list_init(&handle_info->listeners_list);
+
+	return 0;
+}
+
+int shm_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno)
+{
+	return 0;
+}
+
+int shm_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno)
+{
+	if (recv_err < 0) {
+		if (recv_errno == EMSGSIZE) {
+			return 0;
+		}
+		if (recv_errno == ENOBUFS) {
+#ifdef DEBUG
+			log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Ring of doorbell %d is full. Slowing TX down", sockfd);
+#endif
+			usleep(KNET_SHM_FULL_WAIT);
+			return 1;
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * data from the TX thread. A full ring is reported as ENOBUFS
+ * so that the TX thread waits for the peer to catch up.
+ */
+int shm_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	shm_link_info_t *info = kn_link->transport_link;
+	uint64_t start, head;
+	unsigned int i;
+	ssize_t len;
+	int sent = 0, savederrno = 0;
+
+	pthread_mutex_lock(&info->mutex);
+
+	if (!info->tx.hdr) {
+		/*
+		 * no peer, packets are lost as they would be on the wire
+		 */
+		for (i = 0; i < vlen; i++) {
+			msgvec[i].msg_len = _shm_iov_len(msgvec[i].msg_hdr.msg_iov, msgvec[i].msg_hdr.msg_iovlen);
+		}
+		pthread_mutex_unlock(&info->mutex);
+		return vlen;
+	}
+
+	start = head = __atomic_load_n(&info->tx.hdr->head, __ATOMIC_RELAXED);
+
+	for (i = 0; i < vlen; i++) {
+		len = _shm_ring_push(&info->tx, &head, msgvec[i].msg_hdr.msg_iov, msgvec[i].msg_hdr.msg_iovlen);
+		if (len < 0) {
+			savederrno = errno;
+			break;
+		}
+		msgvec[i].msg_len = len;
+		sent++;
+	}
+
+	if (sent) {
+		_shm_ring_publish(knet_h, info, start, head);
+	}
+
+	pthread_mutex_unlock(&info->mutex);
+
+	if (!sent) {
+		errno = savederrno;
+		return -1;
+	}
+
+	return sent;
+}
+
+/*
+ * heartbeats and PMTUd. These are sent also from the RX thread
+ * (pong/PMTUd replies) that must never wait for the peer or two
+ * nodes could deadlock on each other rings, when the ring is full
+ * they are dropped as they would be on the wire.
+ *
+ * The heartbeats also drive the reconnection to the peer.
+ */
+ssize_t shm_transport_tx_sendto(knet_handle_t knet_h, struct knet_link *kn_link, const void *buf, size_t len, int flags)
+{
+	shm_link_info_t *info = kn_link->transport_link;
+	struct timespec clock_now;
+	unsigned long long diff = 0;
+	struct iovec iov;
+	uint64_t start, head;
+	ssize_t ret = len;
+
+	pthread_mutex_lock(&info->mutex);
+
+	if ((!info->tx.hdr) && (info->initiator)) {
+		clock_gettime(CLOCK_MONOTONIC, &clock_now);
+		timespec_diff(info->connect_last, clock_now, &diff);
+		if (diff >= (unsigned long long)knet_h->reconnect_int * 1000000llu) {
+			_shm_connect(knet_h, info);
+		}
+	}
+
+	if (!info->tx.hdr) {
+		goto out_unlock;
+	}
+
+	iov.iov_base = (void *)buf;
+	iov.iov_len = len;
+
+	start = head = __atomic_load_n(&info->tx.hdr->head, __ATOMIC_RELAXED);
+
+	if (_shm_ring_push(&info->tx, &head, &iov, 1) < 0) {
+		if (errno == EMSGSIZE) {
+			ret = -1;
+		}
+		goto out_unlock;
+	}
+
+	_shm_ring_publish(knet_h, info, start, head);
+
+out_unlock:
+	pthread_mutex_unlock(&info->mutex);
+	if (ret < 0) {
+		errno = EMSGSIZE;
+	}
+	return ret;
+}
+
+/*
+ * drain the RX ring in recvmmsg format. When the ring is empty the
+ * doorbell is cleared and, if the peer added packets meanwhile
+ * (see _shm_ring_publish), rung again so that epoll wakes us up.
+ */
+static int _shm_rx_ring(knet_handle_t knet_h, shm_link_info_t *info, struct knet_mmsghdr *msgvec, unsigned int vlen)
+{
+	shm_ring_t *ring = &info->rx;
+	uint64_t size, tail, head, idx, rec_size, count;
+	struct knet_mmsghdr *msg;
+	shm_rec_t *rec;
+	uint32_t len, copy;
+	unsigned int received = 0;
+
+	if (!ring->hdr) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	size = ring->mask + 1;
+	tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_RELAXED);
+	head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+
+	while ((received < vlen) && (tail != head)) {
+		idx = tail & ring->mask;
+		rec = (shm_rec_t *)(ring->data + idx);
+		len = rec->len;
+
+		if (len == KNET_SHM_REC_WRAP) {
+			tail += size - idx;
+			continue;
+		}
+
+		rec_size = KNET_SHM_REC_SIZE(len);
+		if ((len > size / 2) || (idx + rec_size > size) || (head - tail < rec_size)) {
+			log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Corrupted shared memory ring from %s:%s, dropping data",
+				  info->kn_link->status.dst_ipaddr, info->kn_link->status.dst_port);
+			tail = head;
+			break;
+		}
+
+		msg = &msgvec[received];
+		copy = len;
+		msg->msg_hdr.msg_flags = 0;
+		if (copy > msg->msg_hdr.msg_iov[0].iov_len) {
+			copy = msg->msg_hdr.msg_iov[0].iov_len;
+			msg->msg_hdr.msg_flags = MSG_TRUNC;
+		}
+		memmove(msg->msg_hdr.msg_iov[0].iov_base, rec + 1, copy);
+		msg->msg_len = copy;
+		if (msg->msg_hdr.msg_name) {
+			memmove(msg->msg_hdr.msg_name, &info->kn_link->dst_addr, sizeof(struct sockaddr_storage));
+			msg->msg_hdr.msg_namelen = sockaddr_len(&info->kn_link->dst_addr);
+		}
+
+		tail += rec_size;
+		received++;
+	}
+
+	__atomic_store_n(&ring->hdr->tail, tail, __ATOMIC_RELEASE);
+
+	if (received < vlen) {
+		if (read(info->rx_efd, &count, sizeof(count)) < 0) {
+			/*
+			 * EAGAIN, doorbell was not rung
+			 */
+		}
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE) != tail) {
+			count = 1;
+			if (write(info->rx_efd, &count, sizeof(count)) != sizeof(count)) {
+				log_debug(knet_h, KNET_SUB_TRANSP_SHM, "Unable to ring shared memory doorbell: %s",
+					  strerror(errno));
+			}
+		}
+	}
+
+	if (!received) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return received;
+}
+
+int shm_transport_rx_recvmmsg(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	struct knet_fd_trackers *tracker = &knet_h->knet_transport_fd_tracker[sockfd];
+
+	switch (tracker->data_type) {
+		case KNET_SHM_DATA_RING:
+			return _shm_rx_ring(knet_h, tracker->data, msgvec, vlen);
+			break;
+		case KNET_SHM_DATA_LISTENER:
+			_shm_listener_event(knet_h, sockfd);
+			break;
+		case KNET_SHM_DATA_CTRL:
+			_shm_ctrl_event(knet_h, tracker->data, sockfd);
+			break;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int shm_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg)
+{
+	if (knet_h->knet_transport_fd_tracker[sockfd].data_type == KNET_SHM_DATA_RING) {
+		return 2;
+	}
+
+	return 0;
+}
+
+int shm_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link)
+{
+	return 0;
+}
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include "internals.h"
+
+#ifndef __KNET_TRANSPORT_SHM_H__
+#define __KNET_TRANSPORT_SHM_H__
+
+/*
+ * packets are copied as-is into the rings
+ */
+#define KNET_PMTUD_SHM_OVERHEAD 0
+
+#if defined (HAVE_SYS_EVENTFD_H) && defined (HAVE_MEMFD_CREATE)
+#define KNET_HAVE_SHM 1
+#endif
+
+#ifdef KNET_HAVE_SHM
+
+#define KNET_SHM_RING_SIZE (2 * 1024 * 1024)	/* per direction, must be a power of 2 */
+#define KNET_SHM_HELLO_TIMEOUT 100		/* msecs to wait for the hello of a new peer */
+#define KNET_SHM_FULL_WAIT 50			/* usecs to wait for the peer when the ring is full */
+
+/*
+ * fd tracker data_type
+ */
+#define KNET_SHM_DATA_LISTENER 0		/* rendez-vous socket */
+#define KNET_SHM_DATA_CTRL 1			/* control connection to the peer */
+#define KNET_SHM_DATA_RING 2			/* RX ring doorbell */
+
+int shm_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link);
+int shm_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link);
+int shm_transport_free(knet_handle_t knet_h);
+int shm_transport_init(knet_handle_t knet_h);
+int shm_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int shm_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int shm_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+ssize_t shm_transport_tx_sendto(knet_handle_t knet_h, struct knet_link *kn_link, const void *buf, size_t len, int flags);
+int shm_transport_rx_recvmmsg(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+int shm_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg);
+int shm_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link);
+
+#endif
+
+#endif
@@ -16,7 +16,10 @@
 #include <stdlib.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 #include <netinet/ip_icmp.h>
+#include <net/if.h>
+#include <ifaddrs.h>
 #if defined (IP_RECVERR) || defined (IPV6_RECVERR)
 #include <linux/errqueue.h>
 #endif
@@ -40,8 +43,139 @@ typedef struct udp_link_info {
 	struct sockaddr_storage local_address;
 	int socket_fd;
 	int on_epoll;
+	int gso;
+	int zerocopy;
+	uint32_t zc_next_id;		/* mirror of the kernel MSG_ZEROCOPY counter */
+	unsigned int zc_inflight;
+	struct knet_zerocopy_buf *zc_buf[KNET_UDP_ZEROCOPY_IDS];
 } udp_link_info_t;
 
+/*
+ * MSG_ZEROCOPY completion tracking.
+ *
+ * the kernel numbers each successful zerocopy sendmsg on a socket
+ * with a counter and reports ranges of completed ids on the error
+ * queue. Each id is mapped back to the ring buffer holding the data,
+ * that cannot be reused till all its sends are completed.
+ */
+#if defined (SO_ZEROCOPY) && defined (MSG_ZEROCOPY) && defined (SO_EE_ORIGIN_ZEROCOPY)
+/*
+ * the completion can be reported before sendmsg returns,
+ * register the id upfront and return the flags to use
+ */
+static unsigned int _udp_zerocopy_track(knet_handle_t knet_h, udp_link_info_t *info, unsigned int flags)
+{
+	if (!(flags & MSG_ZEROCOPY)) {
+		return flags;
+	}
+
+	if ((!info->zerocopy) || (!knet_h->tx_zerocopy_buf)) {
+		return flags & ~MSG_ZEROCOPY;
+	}
+
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Unable to get zerocopy mutex lock");
+		return flags & ~MSG_ZEROCOPY;
+	}
+	/*
+	 * too many sends to track, copy this one
+	 */
+	if (info->zc_inflight >= KNET_UDP_ZEROCOPY_IDS) {
+		pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+		return flags & ~MSG_ZEROCOPY;
+	}
+	info->zc_buf[info->zc_next_id % KNET_UDP_ZEROCOPY_IDS] = knet_h->tx_zerocopy_buf;
+	info->zc_next_id++;
+	info->zc_inflight++;
+	knet_h->tx_zerocopy_buf->pending++;
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+
+	return flags;
+}
+
+/*
+ * a failed sendmsg does not consume an id
+ */
+static void _udp_zerocopy_untrack(knet_handle_t knet_h, udp_link_info_t *info)
+{
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Unable to get zerocopy mutex lock");
+		return;
+	}
+	info->zc_next_id--;
+	info->zc_buf[info->zc_next_id % KNET_UDP_ZEROCOPY_IDS]->pending--;
+	info->zc_buf[info->zc_next_id % KNET_UDP_ZEROCOPY_IDS] = NULL;
+	info->zc_inflight--;
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+}
+
+static void _udp_zerocopy_complete(knet_handle_t knet_h, udp_link_info_t *info, uint32_t first, uint32_t last, int copied)
+{
+	struct knet_zerocopy_buf *zc_buf;
+	uint32_t id;
+
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Unable to get zerocopy mutex lock");
+		return;
+	}
+	for (id = first; ; id++) {
+		zc_buf = info->zc_buf[id % KNET_UDP_ZEROCOPY_IDS];
+		if (zc_buf) {
+			zc_buf->pending--;
+			info->zc_buf[id % KNET_UDP_ZEROCOPY_IDS] = NULL;
+			info->zc_inflight--;
+		}
+		if (copied) {
+			knet_h->stats.tx_zerocopy_copied++;
+		}
+		if (id == last) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+}
+
+/*
+ * the socket is gone, completions will never be reported
+ */
+static void _udp_zerocopy_release(knet_handle_t knet_h, udp_link_info_t *info)
+{
+	int i;
+
+	if (!info->zc_inflight) {
+		return;
+	}
+
+	if (pthread_mutex_lock(&knet_h->zerocopy_mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Unable to get zerocopy mutex lock");
+		return;
+	}
+	for (i = 0; i < KNET_UDP_ZEROCOPY_IDS; i++) {
+		if (info->zc_buf[i]) {
+			info->zc_buf[i]->pending--;
+			info->zc_buf[i] = NULL;
+		}
+	}
+	info->zc_inflight = 0;
+	pthread_mutex_unlock(&knet_h->zerocopy_mutex);
+}
+#else
+static unsigned int _udp_zerocopy_track(knet_handle_t knet_h, udp_link_info_t *info, unsigned int flags)
+{
+	return flags;
+}
+
+static void _udp_zerocopy_untrack(knet_handle_t knet_h, udp_link_info_t *info)
+{
+	return;
+}
+
+static void _udp_zerocopy_release(knet_handle_t knet_h, udp_link_info_t *info)
+{
+	return;
+}
+#endif
+
 int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link)
 {
 	int err = 0, savederrno = 0;
@@ -49,7 +183,7 @@ int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_lin
 	struct epoll_event ev;
 	udp_link_info_t *info;
 	udp_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_UDP];
-#if defined (IP_RECVERR) || defined (IPV6_RECVERR)
+#if defined (IP_RECVERR) || defined (IPV6_RECVERR) || defined (UDP_SEGMENT) || defined (SO_ZEROCOPY)
 	int value;
 #endif
 
@@ -62,6 +196,8 @@ int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_lin
 			kn_link->outsock = info->socket_fd;
 			kn_link->transport_link = info;
 			kn_link->transport_connected = 1;
+			kn_link->transport_gso = info->gso;
+			kn_link->transport_zerocopy = info->zerocopy;
 			return 0;
 		}
 	}
@@ -72,6 +208,8 @@ int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_lin
 		goto exit_error;
 	}
 
+	memset(info, 0, sizeof(udp_link_info_t));
+
 	sock = socket(kn_link->src_addr.ss_family, SOCK_DGRAM, 0);
 	if (sock < 0) {
 		savederrno = errno;
@@ -117,6 +255,49 @@ int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_lin
 #else
 	log_debug(knet_h, KNET_SUB_TRANSP_UDP, "IPV6_RECVERR not available in this build/platform");
 #endif
+#ifdef UDP_SEGMENT
+	/*
+	 * probe for GSO support (kernel >= 4.18), a segment size of 0
+	 * leaves GSO disabled by default, it is requested per sendmsg
+	 */
+	value = 0;
+	if (setsockopt(sock, SOL_UDP, UDP_SEGMENT, &value, sizeof(value)) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_SEGMENT not supported on socket %i: %s",
+			  sock, strerror(errno));
+	} else {
+		info->gso = 1;
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_SEGMENT available on socket: %i", sock);
+	}
+#else
+	log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_SEGMENT not available in this build/platform");
+#endif
+#ifdef UDP_GRO
+	value = 1;
+	if (setsockopt(sock, SOL_UDP, UDP_GRO, &value, sizeof(value)) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_GRO not supported on socket %i: %s",
+			  sock, strerror(errno));
+	} else {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_GRO enabled on socket: %i", sock);
+	}
+#else
+	log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP_GRO not available in this build/platform");
+#endif
+#if defined (SO_ZEROCOPY) && defined (MSG_ZEROCOPY) && defined (SO_EE_ORIGIN_ZEROCOPY)
+	/*
+	 * SO_ZEROCOPY alone does not change how data is sent,
+	 * zerocopy is requested per sendmsg with MSG_ZEROCOPY
+	 */
+	value = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(value)) < 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "SO_ZEROCOPY not supported on socket %i: %s",
+			  sock, strerror(errno));
+	} else {
+		info->zerocopy = 1;
+		log_debug(knet_h, KNET_SUB_TRANSP_UDP, "SO_ZEROCOPY enabled on socket: %i", sock);
+	}
+#else
+	log_debug(knet_h, KNET_SUB_TRANSP_UDP, "SO_ZEROCOPY not available in this build/platform");
+#endif
 
 	if (bind(sock, (struct sockaddr *)&kn_link->src_addr, sockaddr_len(&kn_link->src_addr))) {
 		savederrno = errno;
@@ -155,6 +336,8 @@ int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_lin
 	kn_link->outsock = sock;
 	kn_link->transport_link = info;
 	kn_link->transport_connected = 1;
+	kn_link->transport_gso = info->gso;
+	kn_link->transport_zerocopy = info->zerocopy;
 
 exit_error:
 	if (err) {
@@ -225,6 +408,7 @@ int udp_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_l
 	}
 
 	close(info->socket_fd);
+	_udp_zerocopy_release(knet_h, info);
 	knet_list_del(&info->list);
 	free(kn_link->transport_link);
 
@@ -297,6 +481,9 @@ static int read_errs_from_sock(knet_handle_t knet_h, int sockfd)
 	struct sockaddr_storage *origin;
 	char addr_str[KNET_MAX_HOST_LEN];
 	char port_str[KNET_MAX_PORT_LEN];
+#if defined (SO_ZEROCOPY) && defined (MSG_ZEROCOPY) && defined (SO_EE_ORIGIN_ZEROCOPY)
+	udp_link_info_t *info = knet_h->knet_transport_fd_tracker[sockfd].data;
+#endif
 
 	iov.iov_base = &icmph;
 	iov.iov_len = sizeof(icmph);
@@ -309,6 +496,11 @@ static int read_errs_from_sock(knet_handle_t knet_h, int sockfd)
 	msg.msg_controllen = sizeof(buffer);
 
 	for (;;) {
+		/*
+		 * recvmsg updates both lengths
+		 */
+		msg.msg_namelen = sizeof(remote);
+		msg.msg_controllen = sizeof(buffer);
 		err = recvmsg(sockfd, &msg, MSG_ERRQUEUE);
 		savederrno = errno;
 		if (err < 0) {
@@ -371,6 +563,14 @@ static int read_errs_from_sock(knet_handle_t knet_h, int sockfd)
 								log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Received ICMP error from %s: %s", addr_str, strerror(sock_err->ee_errno));
 							}
 							break;
+#if defined (SO_ZEROCOPY) && defined (MSG_ZEROCOPY) && defined (SO_EE_ORIGIN_ZEROCOPY)
+						case SO_EE_ORIGIN_ZEROCOPY: /* MSG_ZEROCOPY completions */
+							if (info) {
+								_udp_zerocopy_complete(knet_h, info, sock_err->ee_info, sock_err->ee_data,
+										       sock_err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+							}
+							break;
+#endif
 					}
 				} else {
 					log_debug(knet_h, KNET_SUB_TRANSP_UDP, "No data in MSG_ERRQUEUE");
@@ -418,6 +618,197 @@ int udp_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err,
 	return 0;
 }
 
+static int _udp_sendmsg(knet_handle_t knet_h, udp_link_info_t *info, struct msghdr *msg, unsigned int flags)
+{
+	int err;
+#ifdef MSG_ZEROCOPY
+	int savederrno;
+#endif
+
+	flags = _udp_zerocopy_track(knet_h, info, flags);
+
+	err = sendmsg(info->socket_fd, msg, flags);
+#ifdef MSG_ZEROCOPY
+	if (flags & MSG_ZEROCOPY) {
+		if (err >= 0) {
+			knet_h->stats.tx_zerocopy_packets++;
+			return err;
+		}
+		savederrno = errno;
+		_udp_zerocopy_untrack(knet_h, info);
+		/*
+		 * the kernel refuses zerocopy datagrams spanning more pages
+		 * than a skb can hold, send a copy instead
+		 */
+		if (savederrno == EMSGSIZE) {
+			err = sendmsg(info->socket_fd, msg, flags & ~MSG_ZEROCOPY);
+			savederrno = errno;
+		}
+		errno = savederrno;
+	}
+#endif
+
+	return err;
+}
+
+/*
+ * same as _sendmmsg, with MSG_ZEROCOPY tracking
+ */
+static int _udp_sendmmsg(knet_handle_t knet_h, udp_link_info_t *info, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	int savederrno = 0, err = 0;
+	unsigned int i;
+
+	for (i = 0; i < vlen; i++) {
+		err = _udp_sendmsg(knet_h, info, &msgvec[i].msg_hdr, flags);
+		savederrno = errno;
+		if (err < 0) {
+			break;
+		}
+	}
+
+	errno = savederrno;
+	return ((i > 0) ? (int)i : err);
+}
+
+#ifdef UDP_SEGMENT
+static size_t _udp_msg_len(struct msghdr *msg)
+{
+	size_t len = 0;
+	unsigned int i;
+
+	/* Cast for Linux/BSD compatibility */
+	for (i = 0; i < (unsigned int)msg->msg_iovlen; i++) {
+		len += msg->msg_iov[i].iov_len;
+	}
+
+	return len;
+}
+#endif
+
+/*
+ * on links with GSO, merge a train of packets of the same size (the last
+ * one can be shorter) into GSO super-datagrams and let the kernel/NIC
+ * split them.
+ *
+ * same return semantics as _sendmmsg: number of packets sent,
+ * or -1 and errno set if none could be sent.
+ */
+int udp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	udp_link_info_t *info = kn_link->transport_link;
+#ifdef UDP_SEGMENT
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov[KNET_UDP_GSO_MAX_SEGS * 2];
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control;
+	unsigned int i, j, sent = 0, segs, iovcnt;
+	size_t seg_len, len, total;
+	uint16_t gso_size;
+	int err, savederrno = 0;
+
+	if ((!kn_link->transport_gso) || (vlen < 2)) {
+		return _udp_sendmmsg(knet_h, info, msgvec, vlen, flags);
+	}
+
+	while (sent < vlen) {
+		seg_len = _udp_msg_len(&msgvec[sent].msg_hdr);
+		segs = 0;
+		iovcnt = 0;
+		total = 0;
+
+		for (i = sent; i < vlen; i++) {
+			len = _udp_msg_len(&msgvec[i].msg_hdr);
+			if ((segs == KNET_UDP_GSO_MAX_SEGS) ||
+			    (len > seg_len) ||
+			    (total + len > KNET_UDP_GSO_MAX_LEN) ||
+			    (iovcnt + (unsigned int)msgvec[i].msg_hdr.msg_iovlen > KNET_UDP_GSO_MAX_SEGS * 2)) {
+				break;
+			}
+			for (j = 0; j < (unsigned int)msgvec[i].msg_hdr.msg_iovlen; j++) {
+				iov[iovcnt++] = msgvec[i].msg_hdr.msg_iov[j];
+			}
+			total += len;
+			segs++;
+			/*
+			 * only the last segment can be shorter
+			 */
+			if (len < seg_len) {
+				break;
+			}
+		}
+
+		if (segs < 2) {
+			err = _udp_sendmsg(knet_h, info, &msgvec[sent].msg_hdr, flags);
+			if (err < 0) {
+				savederrno = errno;
+				break;
+			}
+			sent++;
+			continue;
+		}
+
+		memset(&msg, 0, sizeof(struct msghdr));
+		msg.msg_name = msgvec[sent].msg_hdr.msg_name;
+		msg.msg_namelen = msgvec[sent].msg_hdr.msg_namelen;
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iovcnt;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		gso_size = seg_len;
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		memmove(CMSG_DATA(cmsg), &gso_size, sizeof(uint16_t));
+
+		err = _udp_sendmsg(knet_h, info, &msg, flags);
+		if (err < 0) {
+			savederrno = errno;
+			if ((savederrno == EAGAIN) || (savederrno == EWOULDBLOCK) || (savederrno == ENOBUFS)) {
+				break;
+			}
+			/*
+			 * the device cannot segment for us, stop trying on this socket
+			 */
+			if ((savederrno == EIO) || (savederrno == EOPNOTSUPP)) {
+				log_debug(knet_h, KNET_SUB_TRANSP_UDP, "UDP GSO disabled on socket %d: %s",
+					  kn_link->outsock, strerror(savederrno));
+				info->gso = 0;
+				kn_link->transport_gso = 0;
+			}
+			/*
+			 * fall back to plain datagrams for this train
+			 */
+			err = _udp_sendmmsg(knet_h, info, &msgvec[sent], segs, flags);
+			savederrno = errno;
+			if (err < 0) {
+				break;
+			}
+			sent = sent + err;
+			if ((unsigned int)err < segs) {
+				break;
+			}
+			savederrno = 0;
+			continue;
+		}
+
+		kn_link->status.stats.tx_data_gso_packets++;
+		kn_link->status.stats.tx_data_gso_segments += segs;
+		sent = sent + segs;
+	}
+
+	errno = savederrno;
+	return ((sent > 0) ? (int)sent : -1);
+#else
+	return _udp_sendmmsg(knet_h, info, msgvec, vlen, flags);
+#endif
+}
+
 int udp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg)
 {
 	if (msg->msg_len == 0)
@@ -426,8 +817,239 @@ int udp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsgh
 	return 2;
 }
 
+/*
+ * with UDP_GRO the kernel can hand us many datagrams of the same
+ * flow in one buffer, all of gso_size bytes but the last one
+ */
+size_t udp_transport_rx_gro_size(knet_handle_t knet_h, struct knet_mmsghdr *msg)
+{
+#ifdef UDP_GRO
+	struct cmsghdr *cmsg;
+	int gso_size;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg->msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg->msg_hdr, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+			memmove(&gso_size, CMSG_DATA(cmsg), sizeof(int));
+			if (gso_size > 0) {
+				return gso_size;
+			}
+		}
+	}
+#endif
+	return 0;
+}
+
 int udp_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link)
 {
 	kn_link->status.dynconnected = 1;
 	return 0;
 }
+
+/*
+ * multicast group used to send broadcast data once to all nodes.
+ *
+ * a single socket, bound to the group, is used to send and receive.
+ * Multicast loop is left enabled so that nodes running on the same
+ * machine receive each other traffic, our own packets are either
+ * dropped (no local host) or deduplicated by the RX thread.
+ */
+
+static unsigned int _udp_mcast_ifindex(const struct sockaddr_storage *address)
+{
+	struct ifaddrs *ifap, *ifa;
+	unsigned int ifindex = 0;
+
+	if (getifaddrs(&ifap) < 0) {
+		return 0;
+	}
+
+	for (ifa = ifap; ifa != NULL; ifa = ifa->ifa_next) {
+		if ((!ifa->ifa_addr) || (ifa->ifa_addr->sa_family != AF_INET6)) {
+			continue;
+		}
+		if (!memcmp(&((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr,
+			    &((const struct sockaddr_in6 *)address)->sin6_addr, sizeof(struct in6_addr))) {
+			ifindex = if_nametoindex(ifa->ifa_name);
+			break;
+		}
+	}
+
+	freeifaddrs(ifap);
+
+	return ifindex;
+}
+
+/*
+ * called with global wrlock, knet_h->mcast_* define the group
+ */
+int udp_transport_mcast_set_config(knet_handle_t knet_h)
+{
+	int err = 0, savederrno = 0;
+	int sock = -1;
+	int on_epoll = 0;
+	int value;
+	struct epoll_event ev;
+	struct ip_mreq mreq;
+	struct ipv6_mreq mreq6;
+	unsigned int ifindex;
+
+	sock = socket(knet_h->mcast_addr.ss_family, SOCK_DGRAM, 0);
+	if (sock < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to create multicast socket: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (_configure_transport_socket(knet_h, sock, &knet_h->mcast_addr, 0, "UDP multicast") < 0) {
+		savederrno = errno;
+		err = -1;
+		goto exit_error;
+	}
+
+	value = knet_h->mcast_ttl;
+	if (knet_h->mcast_addr.ss_family == AF_INET) {
+		memset(&mreq, 0, sizeof(struct ip_mreq));
+		mreq.imr_multiaddr = ((struct sockaddr_in *)&knet_h->mcast_addr)->sin_addr;
+		mreq.imr_interface = ((struct sockaddr_in *)&knet_h->mcast_src_addr)->sin_addr;
+
+		if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface, sizeof(struct in_addr)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set multicast interface: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &value, sizeof(value)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set multicast TTL: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to join multicast group: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+	} else {
+		ifindex = _udp_mcast_ifindex(&knet_h->mcast_src_addr);
+
+		memset(&mreq6, 0, sizeof(struct ipv6_mreq));
+		mreq6.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&knet_h->mcast_addr)->sin6_addr;
+		mreq6.ipv6mr_interface = ifindex;
+
+		if (setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof(ifindex)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set multicast interface: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		if (setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &value, sizeof(value)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set multicast hops: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+		if (setsockopt(sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq6, sizeof(mreq6)) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to join multicast group: %s",
+				strerror(savederrno));
+			goto exit_error;
+		}
+	}
+
+	/*
+	 * binding to the group filters out unicast traffic
+	 * sent to the same port
+	 */
+	if (bind(sock, (struct sockaddr *)&knet_h->mcast_addr, sockaddr_len(&knet_h->mcast_addr))) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to bind multicast socket: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_ADD, sock, &ev)) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to add multicast socket to epoll pool: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+	on_epoll = 1;
+
+	if (_set_fd_tracker(knet_h, sock, KNET_TRANSPORT_UDP, 0, NULL) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set fd tracker: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	knet_h->mcast_sockfd = sock;
+
+	log_debug(knet_h, KNET_SUB_TRANSP_UDP, "Multicast socket %d joined the broadcast group", sock);
+
+exit_error:
+	if (err) {
+		if (on_epoll) {
+			epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, sock, &ev);
+		}
+		if (sock >= 0) {
+			close(sock);
+		}
+	}
+	errno = savederrno;
+	return err;
+}
+
+/*
+ * called with global wrlock
+ */
+int udp_transport_mcast_clear_config(knet_handle_t knet_h)
+{
+	int err = 0, savederrno = 0;
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = knet_h->mcast_sockfd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, knet_h->mcast_sockfd, &ev) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to remove multicast socket from epoll poll: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (_set_fd_tracker(knet_h, knet_h->mcast_sockfd, KNET_MAX_TRANSPORTS, 0, NULL) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_UDP, "Unable to set fd tracker: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	/*
+	 * closing the socket leaves the group
+	 */
+	close(knet_h->mcast_sockfd);
+	knet_h->mcast_sockfd = -1;
+
+exit_error:
+	errno = savederrno;
+	return err;
+}
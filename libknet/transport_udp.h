@@ -15,13 +15,29 @@
 
 #define KNET_PMTUD_UDP_OVERHEAD 8
 
+/*
+ * UDP GSO limits: number of segments accepted by older kernels
+ * and max payload of a single IPv4 datagram
+ */
+#define KNET_UDP_GSO_MAX_SEGS 64
+#define KNET_UDP_GSO_MAX_LEN 65507
+
+/*
+ * max number of MSG_ZEROCOPY sends in flight per socket
+ */
+#define KNET_UDP_ZEROCOPY_IDS 1024
+
 int udp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link);
 int udp_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link);
 int udp_transport_free(knet_handle_t knet_h);
 int udp_transport_init(knet_handle_t knet_h);
 int udp_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
 int udp_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int udp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
 int udp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg);
+size_t udp_transport_rx_gro_size(knet_handle_t knet_h, struct knet_mmsghdr *msg);
 int udp_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link);
+int udp_transport_mcast_set_config(knet_handle_t knet_h);
+int udp_transport_mcast_clear_config(knet_handle_t knet_h);
 
 #endif
@@ -0,0 +1,1392 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+
+#include "compat.h"
+#include "host.h"
+#include "links.h"
+#include "logging.h"
+#include "common.h"
+#include "transport_common.h"
+#include "transport_xdp.h"
+#include "threads_common.h"
+
+#ifdef KNET_HAVE_XDP
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/*
+ * AF_XDP transport.
+ *
+ * Each link owns a regular UDP socket, bound to the link source
+ * address. It is used for heartbeats, PMTUd and as fallback path.
+ *
+ * On top of it, every interface used by XDP links gets an AF_XDP
+ * socket bound to queue KNET_XDP_QUEUE and a small XDP program
+ * that redirects UDP packets for our local ports to it. knet data
+ * is then received from the AF_XDP RX ring and sent by building
+ * the Ethernet/IP/UDP headers ourselves into the TX ring, without
+ * going through the kernel network stack.
+ *
+ * Packets that do not hit the AF_XDP socket (other RX queues,
+ * fragments, IP options...) are passed to the kernel and received
+ * via the UDP socket. The destination MAC address is learned from
+ * the packets received from the peer, till then data are sent via
+ * the UDP socket.
+ */
+
+typedef struct xdp_ring {
+	void *map;
+	size_t map_size;
+	uint32_t *producer;
+	uint32_t *consumer;
+	void *desc;
+	uint32_t mask;
+} xdp_ring_t;
+
+typedef struct xdp_neigh {
+	uint8_t valid;
+	sa_family_t family;
+	uint8_t addr[16];
+	uint8_t mac[ETH_ALEN];
+} xdp_neigh_t;
+
+typedef struct xdp_if_info {
+	struct knet_list_head list;
+	int refcount;
+	int ifindex;
+	char ifname[IF_NAMESIZE];
+	uint8_t mac[ETH_ALEN];
+	int xsk_fd;
+	int on_epoll;
+	int prog_fd;
+	int link_fd;
+	int xskmap_fd;
+	int ports_fd;
+	unsigned char *umem;
+	size_t umem_size;
+	xdp_ring_t rx;
+	xdp_ring_t tx;
+	xdp_ring_t fill;
+	xdp_ring_t comp;
+	pthread_mutex_t mutex;		/* TX ring and neighbour table */
+	uint64_t tx_frames[KNET_XDP_TX_FRAMES];
+	unsigned int tx_free;
+	xdp_neigh_t neigh[KNET_XDP_NEIGH_SIZE];
+} xdp_if_info_t;
+
+typedef struct xdp_handle_info {
+	struct knet_list_head links_list;
+	struct knet_list_head if_list;
+} xdp_handle_info_t;
+
+typedef struct xdp_link_info {
+	struct knet_list_head list;
+	struct sockaddr_storage local_address;
+	int socket_fd;
+	int on_epoll;
+	xdp_if_info_t *xif;
+} xdp_link_info_t;
+
+/*
+ * bpf helpers, libbpf is not required for the few bits we need
+ */
+
+static int _xdp_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(union bpf_attr));
+}
+
+static int _xdp_map_create(uint32_t map_type, uint32_t key_size, uint32_t value_size, uint32_t max_entries)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(union bpf_attr));
+	attr.map_type = map_type;
+	attr.key_size = key_size;
+	attr.value_size = value_size;
+	attr.max_entries = max_entries;
+
+	return _xdp_bpf(BPF_MAP_CREATE, &attr);
+}
+
+static int _xdp_map_update(int map_fd, const void *key, const void *value)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(union bpf_attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64_t)(uintptr_t)key;
+	attr.value = (uint64_t)(uintptr_t)value;
+	attr.flags = BPF_ANY;
+
+	return _xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+static int _xdp_map_delete(int map_fd, const void *key)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(union bpf_attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64_t)(uintptr_t)key;
+
+	return _xdp_bpf(BPF_MAP_DELETE_ELEM, &attr);
+}
+
+#define XDP_INSN(_code, _dst, _src, _off, _imm) \
+	((struct bpf_insn) { .code = (_code), .dst_reg = (_dst), .src_reg = (_src), .off = (_off), .imm = (_imm) })
+
+#define XDP_PROG_LEN 38
+
+/*
+ * redirect IPv4/IPv6 UDP packets, with a destination port found in
+ * ports map, to the AF_XDP socket of the RX queue. Everything else
+ * (and everything if no AF_XDP socket is bound to the queue) goes
+ * to the kernel.
+ *
+ * packet fields are loaded and compared in network byte order
+ */
+static int _xdp_prog_load(int ports_fd, int xskmap_fd)
+{
+	struct bpf_insn prog[XDP_PROG_LEN];
+	union bpf_attr attr;
+	int i = 0;
+
+	/* r6 = ctx, r2 = data, r3 = data_end */
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, data), 0);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(struct xdp_md, data_end), 0);
+	/* 3: Ethernet + IPv4 + UDP headers */
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, 42);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 30, 0);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 12, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_5, 0, 10, htons(ETHERTYPE_IPV6));
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 27, htons(ETHERTYPE_IP));
+	/* 9: IPv4 without options, UDP, not fragmented */
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 14, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 25, 0x45);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 23, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 23, IPPROTO_UDP);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 20, 0);
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, htons(IP_MF | IP_OFFMASK));
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 20, 0);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 36, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JA, 0, 0, 5, 0);
+	/* 18: IPv6 without extension headers, UDP */
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, 20);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 16, 0);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, 20, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 14, IPPROTO_UDP);
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_5, BPF_REG_2, 56, 0);
+	/* 23: lookup the destination port */
+	prog[i++] = XDP_INSN(BPF_STX | BPF_MEM | BPF_H, BPF_REG_10, BPF_REG_5, -2, 0);
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0);
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -2);
+	prog[i++] = XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, ports_fd);
+	prog[i++] = XDP_INSN(0, 0, 0, 0, 0);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 6, 0);
+	/* 30: redirect to the AF_XDP socket of this queue, pass if there is none */
+	prog[i++] = XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0);
+	prog[i++] = XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, xskmap_fd);
+	prog[i++] = XDP_INSN(0, 0, 0, 0, 0);
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+	/* 36: pass */
+	prog[i++] = XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+	prog[i++] = XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+	memset(&attr, 0, sizeof(union bpf_attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.expected_attach_type = BPF_XDP;
+	attr.insns = (uint64_t)(uintptr_t)prog;
+	attr.insn_cnt = i;
+	attr.license = (uint64_t)(uintptr_t)"GPL";
+
+	return _xdp_bpf(BPF_PROG_LOAD, &attr);
+}
+
+/*
+ * the program is detached from the interface when link_fd is closed
+ */
+static int _xdp_prog_attach(int prog_fd, int ifindex, uint32_t xdp_flags)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(union bpf_attr));
+	attr.link_create.prog_fd = prog_fd;
+	attr.link_create.target_ifindex = ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	attr.link_create.flags = xdp_flags;
+
+	return _xdp_bpf(BPF_LINK_CREATE, &attr);
+}
+
+/*
+ * AF_XDP rings
+ */
+
+static int _xdp_ring_map(int xsk_fd, xdp_ring_t *ring, const struct xdp_ring_offset *off, off_t pgoff, uint32_t entries, size_t entry_size)
+{
+	ring->map_size = off->desc + (entries * entry_size);
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xsk_fd, pgoff);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -1;
+	}
+
+	ring->producer = (uint32_t *)((unsigned char *)ring->map + off->producer);
+	ring->consumer = (uint32_t *)((unsigned char *)ring->map + off->consumer);
+	ring->desc = (unsigned char *)ring->map + off->desc;
+	ring->mask = entries - 1;
+
+	return 0;
+}
+
+static void _xdp_ring_unmap(xdp_ring_t *ring)
+{
+	if (ring->map) {
+		munmap(ring->map, ring->map_size);
+		ring->map = NULL;
+	}
+}
+
+static int _xdp_xsk_setup(xdp_if_info_t *xif)
+{
+	struct xdp_umem_reg mr;
+	struct xdp_mmap_offsets off;
+	socklen_t optlen;
+	uint64_t *fill;
+	int entries;
+	uint32_t i;
+
+	xif->xsk_fd = socket(AF_XDP, SOCK_RAW, 0);
+	if (xif->xsk_fd < 0) {
+		return -1;
+	}
+
+	xif->umem_size = (size_t)KNET_XDP_FRAMES * KNET_XDP_FRAME_SIZE;
+	xif->umem = mmap(NULL, xif->umem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (xif->umem == MAP_FAILED) {
+		xif->umem = NULL;
+		return -1;
+	}
+
+	memset(&mr, 0, sizeof(struct xdp_umem_reg));
+	mr.addr = (uint64_t)(uintptr_t)xif->umem;
+	mr.len = xif->umem_size;
+	mr.chunk_size = KNET_XDP_FRAME_SIZE;
+	mr.headroom = 0;
+
+	if (setsockopt(xif->xsk_fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr)) < 0) {
+		return -1;
+	}
+
+	entries = KNET_XDP_RX_FRAMES;
+	if ((setsockopt(xif->xsk_fd, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries)) < 0) ||
+	    (setsockopt(xif->xsk_fd, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries)) < 0)) {
+		return -1;
+	}
+
+	entries = KNET_XDP_TX_FRAMES;
+	if ((setsockopt(xif->xsk_fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries, sizeof(entries)) < 0) ||
+	    (setsockopt(xif->xsk_fd, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries)) < 0)) {
+		return -1;
+	}
+
+	optlen = sizeof(off);
+	if (getsockopt(xif->xsk_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+		return -1;
+	}
+
+	if ((_xdp_ring_map(xif->xsk_fd, &xif->rx, &off.rx, XDP_PGOFF_RX_RING, KNET_XDP_RX_FRAMES, sizeof(struct xdp_desc)) < 0) ||
+	    (_xdp_ring_map(xif->xsk_fd, &xif->tx, &off.tx, XDP_PGOFF_TX_RING, KNET_XDP_TX_FRAMES, sizeof(struct xdp_desc)) < 0) ||
+	    (_xdp_ring_map(xif->xsk_fd, &xif->fill, &off.fr, XDP_UMEM_PGOFF_FILL_RING, KNET_XDP_RX_FRAMES, sizeof(uint64_t)) < 0) ||
+	    (_xdp_ring_map(xif->xsk_fd, &xif->comp, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, KNET_XDP_TX_FRAMES, sizeof(uint64_t)) < 0)) {
+		return -1;
+	}
+
+	/*
+	 * the first half of the UMEM is handed to the kernel for RX
+	 */
+	fill = xif->fill.desc;
+	for (i = 0; i < KNET_XDP_RX_FRAMES; i++) {
+		fill[i] = (uint64_t)i * KNET_XDP_FRAME_SIZE;
+	}
+	__atomic_store_n(xif->fill.producer, KNET_XDP_RX_FRAMES, __ATOMIC_RELEASE);
+
+	for (i = 0; i < KNET_XDP_TX_FRAMES; i++) {
+		xif->tx_frames[i] = (uint64_t)(KNET_XDP_RX_FRAMES + i) * KNET_XDP_FRAME_SIZE;
+	}
+	xif->tx_free = KNET_XDP_TX_FRAMES;
+
+	return 0;
+}
+
+static int _xdp_xsk_bind(xdp_if_info_t *xif, uint16_t bind_flags)
+{
+	struct sockaddr_xdp sxdp;
+
+	memset(&sxdp, 0, sizeof(struct sockaddr_xdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = xif->ifindex;
+	sxdp.sxdp_queue_id = KNET_XDP_QUEUE;
+	sxdp.sxdp_flags = bind_flags;
+
+	return bind(xif->xsk_fd, (struct sockaddr *)&sxdp, sizeof(struct sockaddr_xdp));
+}
+
+/*
+ * neighbour table, destination MAC addresses learned from RX
+ */
+
+static int _xdp_addr_key(const struct sockaddr_storage *ss, uint8_t *addr)
+{
+	memset(addr, 0, 16);
+
+	if (ss->ss_family == AF_INET) {
+		memmove(addr, &((const struct sockaddr_in *)ss)->sin_addr, sizeof(struct in_addr));
+	} else {
+		memmove(addr, &((const struct sockaddr_in6 *)ss)->sin6_addr, sizeof(struct in6_addr));
+	}
+
+	return ss->ss_family;
+}
+
+static xdp_neigh_t *_xdp_neigh_slot(xdp_if_info_t *xif, const uint8_t *addr)
+{
+	uint32_t hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		hash = (hash ^ addr[i]) * 16777619U;
+	}
+
+	return &xif->neigh[hash & (KNET_XDP_NEIGH_SIZE - 1)];
+}
+
+static void _xdp_neigh_update(xdp_if_info_t *xif, sa_family_t family, const uint8_t *addr, const uint8_t *mac)
+{
+	xdp_neigh_t *neigh = _xdp_neigh_slot(xif, addr);
+
+	if ((neigh->valid) && (neigh->family == family) &&
+	    (!memcmp(neigh->addr, addr, 16)) && (!memcmp(neigh->mac, mac, ETH_ALEN))) {
+		return;
+	}
+
+	neigh->family = family;
+	memmove(neigh->addr, addr, 16);
+	memmove(neigh->mac, mac, ETH_ALEN);
+	neigh->valid = 1;
+}
+
+static int _xdp_neigh_lookup(xdp_if_info_t *xif, const struct sockaddr_storage *ss, uint8_t *mac)
+{
+	uint8_t addr[16];
+	sa_family_t family = _xdp_addr_key(ss, addr);
+	xdp_neigh_t *neigh = _xdp_neigh_slot(xif, addr);
+
+	if ((!neigh->valid) || (neigh->family != family) || (memcmp(neigh->addr, addr, 16))) {
+		return -1;
+	}
+
+	memmove(mac, neigh->mac, ETH_ALEN);
+	return 0;
+}
+
+/*
+ * interface setup
+ */
+
+static int _xdp_find_if(const struct sockaddr_storage *address, char *ifname)
+{
+	struct ifaddrs *ifap, *ifa;
+	size_t ifname_len;
+	int found = 0;
+
+	if (getifaddrs(&ifap) < 0) {
+		return -1;
+	}
+
+	for (ifa = ifap; ifa != NULL; ifa = ifa->ifa_next) {
+		if ((!ifa->ifa_addr) || (ifa->ifa_addr->sa_family != address->ss_family)) {
+			continue;
+		}
+		if (address->ss_family == AF_INET) {
+			if (memcmp(&((struct sockaddr_in *)ifa->ifa_addr)->sin_addr,
+				   &((const struct sockaddr_in *)address)->sin_addr, sizeof(struct in_addr))) {
+				continue;
+			}
+		} else {
+			if (memcmp(&((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr,
+				   &((const struct sockaddr_in6 *)address)->sin6_addr, sizeof(struct in6_addr))) {
+				continue;
+			}
+		}
+		ifname_len = strlen(ifa->ifa_name);
+		if (ifname_len >= IF_NAMESIZE) {
+			continue;
+		}
+		memmove(ifname, ifa->ifa_name, ifname_len);
+		ifname[ifname_len] = 0;
+		found = 1;
+		break;
+	}
+
+	freeifaddrs(ifap);
+
+	if (!found) {
+		errno = EADDRNOTAVAIL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void _xdp_if_destroy(knet_handle_t knet_h, xdp_if_info_t *xif)
+{
+	struct epoll_event ev;
+
+	if (xif->link_fd >= 0) {
+		close(xif->link_fd);
+	}
+
+	if (xif->on_epoll) {
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = EPOLLIN;
+		ev.data.fd = xif->xsk_fd;
+		if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, xif->xsk_fd, &ev) < 0) {
+			log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to remove AF_XDP socket from epoll pool: %s",
+				strerror(errno));
+		}
+		_set_fd_tracker(knet_h, xif->xsk_fd, KNET_MAX_TRANSPORTS, 0, NULL);
+	}
+
+	_xdp_ring_unmap(&xif->rx);
+	_xdp_ring_unmap(&xif->tx);
+	_xdp_ring_unmap(&xif->fill);
+	_xdp_ring_unmap(&xif->comp);
+
+	if (xif->xsk_fd >= 0) {
+		close(xif->xsk_fd);
+	}
+	if (xif->umem) {
+		munmap(xif->umem, xif->umem_size);
+	}
+	if (xif->prog_fd >= 0) {
+		close(xif->prog_fd);
+	}
+	if (xif->xskmap_fd >= 0) {
+		close(xif->xskmap_fd);
+	}
+	if (xif->ports_fd >= 0) {
+		close(xif->ports_fd);
+	}
+
+	pthread_mutex_destroy(&xif->mutex);
+	free(xif);
+}
+
+static xdp_if_info_t *_xdp_if_create(knet_handle_t knet_h, xdp_link_info_t *info, const char *ifname)
+{
+	int savederrno = 0;
+	xdp_if_info_t *xif;
+	struct ifreq ifr;
+	struct epoll_event ev;
+	uint32_t queue = KNET_XDP_QUEUE;
+	const char *mode;
+	size_t ifname_len;
+
+	ifname_len = strlen(ifname);
+	if (ifname_len >= IF_NAMESIZE) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	xif = malloc(sizeof(xdp_if_info_t));
+	if (!xif) {
+		return NULL;
+	}
+
+	memset(xif, 0, sizeof(xdp_if_info_t));
+	xif->xsk_fd = -1;
+	xif->prog_fd = -1;
+	xif->link_fd = -1;
+	xif->xskmap_fd = -1;
+	xif->ports_fd = -1;
+	memmove(xif->ifname, ifname, ifname_len);
+	xif->ifname[ifname_len] = 0;
+
+	if (pthread_mutex_init(&xif->mutex, NULL) != 0) {
+		free(xif);
+		return NULL;
+	}
+
+	xif->ifindex = if_nametoindex(ifname);
+	if (!xif->ifindex) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	/*
+	 * only Ethernet devices, and frames must fit in a UMEM frame
+	 */
+	memset(&ifr, 0, sizeof(struct ifreq));
+	memmove(ifr.ifr_name, ifname, ifname_len);
+	ifr.ifr_name[ifname_len] = 0;
+	if (ioctl(info->socket_fd, SIOCGIFHWADDR, &ifr) < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+	if (ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER) {
+		savederrno = EOPNOTSUPP;
+		goto out_error;
+	}
+	memmove(xif->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+	if (ioctl(info->socket_fd, SIOCGIFMTU, &ifr) < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+	if (ifr.ifr_mtu + ETH_HLEN > KNET_XDP_FRAME_SIZE - XDP_PACKET_HEADROOM) {
+		log_debug(knet_h, KNET_SUB_TRANSP_XDP, "MTU %d of %s is too large for AF_XDP frames",
+			  ifr.ifr_mtu, ifname);
+		savederrno = EMSGSIZE;
+		goto out_error;
+	}
+
+	xif->xskmap_fd = _xdp_map_create(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t), sizeof(uint32_t), KNET_XDP_QUEUE + 1);
+	if (xif->xskmap_fd < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	xif->ports_fd = _xdp_map_create(BPF_MAP_TYPE_HASH, sizeof(uint16_t), sizeof(uint32_t), KNET_XDP_MAX_PORTS);
+	if (xif->ports_fd < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	xif->prog_fd = _xdp_prog_load(xif->ports_fd, xif->xskmap_fd);
+	if (xif->prog_fd < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	if (_xdp_xsk_setup(xif) < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	/*
+	 * prefer the driver (native) mode and zero-copy, fall back
+	 * to the generic mode that works on any device
+	 */
+	mode = "native zero-copy";
+	xif->link_fd = _xdp_prog_attach(xif->prog_fd, xif->ifindex, XDP_FLAGS_DRV_MODE);
+	if (xif->link_fd >= 0) {
+		if (_xdp_xsk_bind(xif, XDP_ZEROCOPY) < 0) {
+			mode = "native copy";
+			if (_xdp_xsk_bind(xif, XDP_COPY) < 0) {
+				close(xif->link_fd);
+				xif->link_fd = -1;
+			}
+		}
+	}
+	if (xif->link_fd < 0) {
+		mode = "generic copy";
+		xif->link_fd = _xdp_prog_attach(xif->prog_fd, xif->ifindex, XDP_FLAGS_SKB_MODE);
+		if (xif->link_fd < 0) {
+			savederrno = errno;
+			goto out_error;
+		}
+		if (_xdp_xsk_bind(xif, XDP_COPY) < 0) {
+			savederrno = errno;
+			goto out_error;
+		}
+	}
+
+	if (_xdp_map_update(xif->xskmap_fd, &queue, &xif->xsk_fd) < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = xif->xsk_fd;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_ADD, xif->xsk_fd, &ev)) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	xif->on_epoll = 1;
+
+	if (_set_fd_tracker(knet_h, xif->xsk_fd, KNET_TRANSPORT_XDP, KNET_XDP_DATA_XSK, xif) < 0) {
+		savederrno = errno;
+		goto out_error;
+	}
+
+	log_info(knet_h, KNET_SUB_TRANSP_XDP, "AF_XDP enabled on %s queue %u (%s mode)",
+		 ifname, KNET_XDP_QUEUE, mode);
+
+	return xif;
+
+out_error:
+	_xdp_if_destroy(knet_h, xif);
+	errno = savederrno;
+	return NULL;
+}
+
+/*
+ * AF_XDP is an optimization, links keep working via
+ * the UDP socket if it cannot be used
+ */
+static xdp_if_info_t *_xdp_if_get(knet_handle_t knet_h, xdp_handle_info_t *handle_info, xdp_link_info_t *info)
+{
+	xdp_if_info_t *xif;
+	char ifname[IF_NAMESIZE];
+	int ifindex;
+
+	if (_xdp_find_if(&info->local_address, ifname) < 0) {
+		log_info(knet_h, KNET_SUB_TRANSP_XDP, "Unable to find interface for XDP link: %s. Using UDP socket",
+			 strerror(errno));
+		return NULL;
+	}
+
+	ifindex = if_nametoindex(ifname);
+
+	knet_list_for_each_entry(xif, &handle_info->if_list, list) {
+		if (xif->ifindex == ifindex) {
+			xif->refcount++;
+			return xif;
+		}
+	}
+
+	xif = _xdp_if_create(knet_h, info, ifname);
+	if (!xif) {
+		log_info(knet_h, KNET_SUB_TRANSP_XDP, "Unable to enable AF_XDP on %s: %s. Using UDP socket",
+			 ifname, strerror(errno));
+		return NULL;
+	}
+
+	xif->refcount = 1;
+	knet_list_add(&xif->list, &handle_info->if_list);
+
+	return xif;
+}
+
+static void _xdp_if_put(knet_handle_t knet_h, xdp_if_info_t *xif)
+{
+	xif->refcount--;
+	if (xif->refcount) {
+		return;
+	}
+
+	knet_list_del(&xif->list);
+	_xdp_if_destroy(knet_h, xif);
+}
+
+static uint16_t _xdp_port(const struct sockaddr_storage *ss)
+{
+	if (ss->ss_family == AF_INET) {
+		return ((const struct sockaddr_in *)ss)->sin_port;
+	}
+	return ((const struct sockaddr_in6 *)ss)->sin6_port;
+}
+
+/*
+ * ports are shared by all the links on the same interface/port,
+ * only the last one removes it from the map
+ */
+static int _xdp_port_users(xdp_handle_info_t *handle_info, xdp_link_info_t *info)
+{
+	xdp_link_info_t *cur;
+	int users = 0;
+
+	knet_list_for_each_entry(cur, &handle_info->links_list, list) {
+		if ((cur->xif == info->xif) &&
+		    (_xdp_port(&cur->local_address) == _xdp_port(&info->local_address))) {
+			users++;
+		}
+	}
+
+	return users;
+}
+
+int xdp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link)
+{
+	int err = 0, savederrno = 0;
+	int sock = -1;
+	struct epoll_event ev;
+	xdp_link_info_t *info;
+	xdp_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_XDP];
+	uint16_t port;
+	uint32_t value = 1;
+
+	/*
+	 * Only allocate a new link if the local address is different
+	 */
+	knet_list_for_each_entry(info, &handle_info->links_list, list) {
+		if (memcmp(&info->local_address, &kn_link->src_addr, sizeof(struct sockaddr_storage)) == 0) {
+			log_debug(knet_h, KNET_SUB_TRANSP_XDP, "Re-using existing XDP socket for new link");
+			kn_link->outsock = info->socket_fd;
+			kn_link->transport_link = info;
+			kn_link->transport_connected = 1;
+			kn_link->transport_gso = 0;
+			kn_link->transport_zerocopy = 0;
+			return 0;
+		}
+	}
+
+	info = malloc(sizeof(xdp_link_info_t));
+	if (!info) {
+		err = -1;
+		goto exit_error;
+	}
+
+	memset(info, 0, sizeof(xdp_link_info_t));
+
+	sock = socket(kn_link->src_addr.ss_family, SOCK_DGRAM, 0);
+	if (sock < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to create listener socket: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (_configure_transport_socket(knet_h, sock, &kn_link->src_addr, kn_link->flags, "XDP") < 0) {
+		savederrno = errno;
+		err = -1;
+		goto exit_error;
+	}
+
+	if (bind(sock, (struct sockaddr *)&kn_link->src_addr, sockaddr_len(&kn_link->src_addr))) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to bind listener socket: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+
+	if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_ADD, sock, &ev)) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to add listener to epoll pool: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	info->on_epoll = 1;
+
+	if (_set_fd_tracker(knet_h, sock, KNET_TRANSPORT_XDP, KNET_XDP_DATA_SOCK, info) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to set fd tracker: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	memmove(&info->local_address, &kn_link->src_addr, sizeof(struct sockaddr_storage));
+	info->socket_fd = sock;
+
+	info->xif = _xdp_if_get(knet_h, handle_info, info);
+	if (info->xif) {
+		port = _xdp_port(&info->local_address);
+		if (_xdp_map_update(info->xif->ports_fd, &port, &value) < 0) {
+			log_info(knet_h, KNET_SUB_TRANSP_XDP, "Unable to redirect port %u to AF_XDP: %s. Using UDP socket",
+				 ntohs(port), strerror(errno));
+			_xdp_if_put(knet_h, info->xif);
+			info->xif = NULL;
+		}
+	}
+
+	knet_list_add(&info->list, &handle_info->links_list);
+
+	kn_link->outsock = sock;
+	kn_link->transport_link = info;
+	kn_link->transport_connected = 1;
+	kn_link->transport_gso = 0;
+	kn_link->transport_zerocopy = 0;
+
+exit_error:
+	if (err) {
+		if (info) {
+			if (info->on_epoll) {
+				epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, sock, &ev);
+			}
+			free(info);
+		}
+		if (sock >= 0) {
+			close(sock);
+		}
+	}
+	errno = savederrno;
+	return err;
+}
+
+int xdp_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link)
+{
+	int err = 0, savederrno = 0;
+	int found = 0;
+	struct knet_host *host;
+	int link_idx;
+	xdp_link_info_t *info = kn_link->transport_link;
+	xdp_handle_info_t *handle_info = knet_h->transports[KNET_TRANSPORT_XDP];
+	struct epoll_event ev;
+	uint16_t port;
+
+	for (host = knet_h->host_head; host != NULL; host = host->next) {
+		for (link_idx = 0; link_idx < KNET_MAX_LINK; link_idx++) {
+			if (&host->link[link_idx] == kn_link)
+				continue;
+
+			if ((host->link[link_idx].transport_link == info) &&
+			    (host->link[link_idx].status.enabled == 1)) {
+				found = 1;
+				break;
+			}
+		}
+	}
+
+	if (found) {
+		log_debug(knet_h, KNET_SUB_TRANSP_XDP, "XDP socket %d still in use", info->socket_fd);
+		savederrno = EBUSY;
+		err = -1;
+		goto exit_error;
+	}
+
+	if (info->on_epoll) {
+		memset(&ev, 0, sizeof(struct epoll_event));
+		ev.events = EPOLLIN;
+		ev.data.fd = info->socket_fd;
+
+		if (epoll_ctl(knet_h->recv_from_links_epollfd, EPOLL_CTL_DEL, info->socket_fd, &ev) < 0) {
+			savederrno = errno;
+			err = -1;
+			log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to remove XDP socket from epoll poll: %s",
+				strerror(errno));
+			goto exit_error;
+		}
+		info->on_epoll = 0;
+	}
+
+	if (_set_fd_tracker(knet_h, info->socket_fd, KNET_MAX_TRANSPORTS, 0, NULL) < 0) {
+		savederrno = errno;
+		err = -1;
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Unable to set fd tracker: %s",
+			strerror(savederrno));
+		goto exit_error;
+	}
+
+	if (info->xif) {
+		if (_xdp_port_users(handle_info, info) == 1) {
+			port = _xdp_port(&info->local_address);
+			_xdp_map_delete(info->xif->ports_fd, &port);
+		}
+		_xdp_if_put(knet_h, info->xif);
+	}
+
+	close(info->socket_fd);
+	knet_list_del(&info->list);
+	free(kn_link->transport_link);
+
+exit_error:
+	errno = savederrno;
+	return err;
+}
+
+int xdp_transport_free(knet_handle_t knet_h)
+{
+	xdp_handle_info_t *handle_info;
+
+	if (!knet_h->transports[KNET_TRANSPORT_XDP]) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	handle_info = knet_h->transports[KNET_TRANSPORT_XDP];
+
+	/*
+	 * keep it here while we debug list usage and such
+	 */
+	if ((!knet_list_empty(&handle_info->links_list)) ||
+	    (!knet_list_empty(&handle_info->if_list))) {
+		log_err(knet_h, KNET_SUB_TRANSP_XDP, "Internal error. handle list is not empty");
+		return -1;
+	}
+
+	free(handle_info);
+
+	knet_h->transports[KNET_TRANSPORT_XDP] = NULL;
+
+	return 0;
+}
+
+int xdp_transport_init(knet_handle_t knet_h)
+{
+	xdp_handle_info_t *handle_info;
+
+	if (knet_h->transports[KNET_TRANSPORT_XDP]) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	handle_info = malloc(sizeof(xdp_handle_info_t));
+	if (!handle_info) {
+		return -1;
+	}
+
+	memset(handle_info, 0, sizeof(xdp_handle_info_t));
+
+	knet_h->transports[KNET_TRANSPORT_XDP] = handle_info;
+
+	knet_list_init(&handle_info->links_list);
+	knet_list_init(&handle_info->if_list);
+
+	return 0;
+}
+
+int xdp_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno)
+{
+	return 0;
+}
+
+int xdp_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno)
+{
+	if (recv_err < 0) {
+		if (recv_errno == EMSGSIZE) {
+			return 0;
+		}
+		if (recv_errno == EINVAL || recv_errno == EPERM) {
+			return -1;
+		}
+		if ((recv_errno == ENOBUFS) || (recv_errno == EAGAIN)) {
+#ifdef DEBUG
+			log_debug(knet_h, KNET_SUB_TRANSP_XDP, "Sock: %d is overloaded. Slowing TX down", sockfd);
+#endif
+			usleep(knet_h->threads_timer_res / 16);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * checksum of 16 bit big endian words
+ */
+static uint32_t _xdp_csum_add(uint32_t sum, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len > 1) {
+		sum += (p[0] << 8) | p[1];
+		p += 2;
+		len -= 2;
+	}
+	if (len) {
+		sum += p[0] << 8;
+	}
+
+	return sum;
+}
+
+static uint16_t _xdp_csum_fold(uint32_t sum)
+{
+	while (sum >> 16) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+
+	return htons(~sum & 0xffff);
+}
+
+/*
+ * returns the frame length, 0 if the packet does not fit in a frame
+ */
+static uint32_t _xdp_build_frame(xdp_if_info_t *xif, unsigned char *frame, const uint8_t *dst_mac,
+				 const struct sockaddr_storage *src, const struct sockaddr_storage *dst,
+				 const struct msghdr *msg)
+{
+	struct ether_header eth;
+	struct iphdr ip;
+	struct ip6_hdr ip6;
+	struct udphdr udp;
+	size_t ip_len, payload_len = 0, offset;
+	uint32_t sum;
+	uint16_t proto_len;
+	unsigned int i;
+
+	/* Cast for Linux/BSD compatibility */
+	for (i = 0; i < (unsigned int)msg->msg_iovlen; i++) {
+		payload_len += msg->msg_iov[i].iov_len;
+	}
+
+	ip_len = (src->ss_family == AF_INET) ? sizeof(struct iphdr) : sizeof(struct ip6_hdr);
+	if (ETH_HLEN + ip_len + sizeof(struct udphdr) + payload_len > KNET_XDP_FRAME_SIZE) {
+		return 0;
+	}
+
+	offset = ETH_HLEN + ip_len + sizeof(struct udphdr);
+	for (i = 0; i < (unsigned int)msg->msg_iovlen; i++) {
+		memmove(frame + offset, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+		offset += msg->msg_iov[i].iov_len;
+	}
+
+	memmove(eth.ether_dhost, dst_mac, ETH_ALEN);
+	memmove(eth.ether_shost, xif->mac, ETH_ALEN);
+
+	memset(&udp, 0, sizeof(struct udphdr));
+	udp.source = _xdp_port(src);
+	udp.dest = _xdp_port(dst);
+	udp.len = htons(sizeof(struct udphdr) + payload_len);
+
+	if (src->ss_family == AF_INET) {
+		eth.ether_type = htons(ETHERTYPE_IP);
+
+		memset(&ip, 0, sizeof(struct iphdr));
+		ip.version = 4;
+		ip.ihl = sizeof(struct iphdr) / 4;
+		ip.tot_len = htons(sizeof(struct iphdr) + sizeof(struct udphdr) + payload_len);
+		ip.frag_off = htons(IP_DF);
+		ip.ttl = IPDEFTTL;
+		ip.protocol = IPPROTO_UDP;
+		ip.saddr = ((const struct sockaddr_in *)src)->sin_addr.s_addr;
+		ip.daddr = ((const struct sockaddr_in *)dst)->sin_addr.s_addr;
+		ip.check = _xdp_csum_fold(_xdp_csum_add(0, &ip, sizeof(struct iphdr)));
+
+		/*
+		 * UDP checksum is optional on IPv4
+		 */
+		memmove(frame + ETH_HLEN, &ip, sizeof(struct iphdr));
+	} else {
+		eth.ether_type = htons(ETHERTYPE_IPV6);
+
+		memset(&ip6, 0, sizeof(struct ip6_hdr));
+		ip6.ip6_flow = htonl(6 << 28);
+		ip6.ip6_plen = udp.len;
+		ip6.ip6_nxt = IPPROTO_UDP;
+		ip6.ip6_hlim = IPDEFTTL;
+		memmove(&ip6.ip6_src, &((const struct sockaddr_in6 *)src)->sin6_addr, sizeof(struct in6_addr));
+		memmove(&ip6.ip6_dst, &((const struct sockaddr_in6 *)dst)->sin6_addr, sizeof(struct in6_addr));
+
+		/*
+		 * pseudo header + UDP header + payload
+		 */
+		proto_len = ntohs(udp.len);
+		sum = _xdp_csum_add(0, &ip6.ip6_src, sizeof(struct in6_addr) * 2);
+		sum += proto_len + IPPROTO_UDP;
+		sum = _xdp_csum_add(sum, &udp, sizeof(struct udphdr));
+		sum = _xdp_csum_add(sum, frame + ETH_HLEN + ip_len + sizeof(struct udphdr), payload_len);
+		udp.check = _xdp_csum_fold(sum);
+		if (!udp.check) {
+			udp.check = 0xffff;
+		}
+
+		memmove(frame + ETH_HLEN, &ip6, sizeof(struct ip6_hdr));
+	}
+
+	memmove(frame, &eth, ETH_HLEN);
+	memmove(frame + ETH_HLEN + ip_len, &udp, sizeof(struct udphdr));
+
+	return offset;
+}
+
+static void _xdp_tx_reclaim(xdp_if_info_t *xif)
+{
+	uint32_t cons = *xif->comp.consumer;
+	uint32_t prod = __atomic_load_n(xif->comp.producer, __ATOMIC_ACQUIRE);
+	uint64_t *addrs = xif->comp.desc;
+
+	while (cons != prod) {
+		xif->tx_frames[xif->tx_free++] = addrs[cons & xif->comp.mask];
+		cons++;
+	}
+
+	__atomic_store_n(xif->comp.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/*
+ * in copy mode the kernel transmits a limited budget
+ * of frames per call and asks to be called again
+ */
+static void _xdp_tx_kick(xdp_if_info_t *xif)
+{
+	int i;
+
+	for (i = 0; i < KNET_XDP_TX_FRAMES / 32; i++) {
+		if (sendto(xif->xsk_fd, NULL, 0, MSG_DONTWAIT, NULL, 0) >= 0) {
+			return;
+		}
+		if (errno != EAGAIN) {
+			return;
+		}
+	}
+}
+
+/*
+ * same return semantics as _sendmmsg. Packets that cannot
+ * go through AF_XDP are sent via the UDP socket.
+ */
+int xdp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	xdp_link_info_t *info = kn_link->transport_link;
+	xdp_if_info_t *xif = info->xif;
+	struct xdp_desc *descs;
+	uint8_t dst_mac[ETH_ALEN];
+	uint32_t prod, len;
+	unsigned int sent = 0;
+	int err;
+
+	if (!xif) {
+		return _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+	}
+
+	if (pthread_mutex_lock(&xif->mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_XDP, "Unable to get XDP mutex lock");
+		return _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+	}
+
+	if (_xdp_neigh_lookup(xif, &kn_link->dst_addr, dst_mac) < 0) {
+		pthread_mutex_unlock(&xif->mutex);
+		return _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+	}
+
+	_xdp_tx_reclaim(xif);
+
+	descs = xif->tx.desc;
+	prod = *xif->tx.producer;
+
+	while ((sent < vlen) && (xif->tx_free)) {
+		len = _xdp_build_frame(xif, xif->umem + xif->tx_frames[xif->tx_free - 1], dst_mac,
+				       &kn_link->src_addr, &kn_link->dst_addr, &msgvec[sent].msg_hdr);
+		if (!len) {
+			break;
+		}
+		xif->tx_free--;
+		descs[prod & xif->tx.mask].addr = xif->tx_frames[xif->tx_free];
+		descs[prod & xif->tx.mask].len = len;
+		descs[prod & xif->tx.mask].options = 0;
+		prod++;
+		sent++;
+	}
+
+	if (sent) {
+		__atomic_store_n(xif->tx.producer, prod, __ATOMIC_RELEASE);
+		_xdp_tx_kick(xif);
+	}
+
+	pthread_mutex_unlock(&xif->mutex);
+
+	if (sent < vlen) {
+		err = _sendmmsg(kn_link->outsock, &msgvec[sent], vlen - sent, flags);
+		if (err < 0) {
+			return sent ? (int)sent : err;
+		}
+		sent = sent + err;
+	}
+
+	return sent;
+}
+
+/*
+ * copy the UDP payload of an Ethernet frame to msg, as recvmmsg would do
+ */
+static int _xdp_parse_frame(xdp_if_info_t *xif, const unsigned char *frame, uint32_t frame_len, struct knet_mmsghdr *msg)
+{
+	struct ether_header eth;
+	struct iphdr ip;
+	struct ip6_hdr ip6;
+	struct udphdr udp;
+	struct sockaddr_in *sin = msg->msg_hdr.msg_name;
+	struct sockaddr_in6 *sin6 = msg->msg_hdr.msg_name;
+	uint8_t addr[16];
+	size_t offset, payload_len;
+
+	if (frame_len < ETH_HLEN) {
+		return -1;
+	}
+	memmove(&eth, frame, ETH_HLEN);
+	offset = ETH_HLEN;
+
+	memset(addr, 0, sizeof(addr));
+
+	switch (ntohs(eth.ether_type)) {
+		case ETHERTYPE_IP:
+			if (frame_len < offset + sizeof(struct iphdr)) {
+				return -1;
+			}
+			memmove(&ip, frame + offset, sizeof(struct iphdr));
+			if ((ip.ihl < 5) || (ip.protocol != IPPROTO_UDP)) {
+				return -1;
+			}
+			offset += ip.ihl * 4;
+			memset(sin, 0, sizeof(struct sockaddr_in));
+			sin->sin_family = AF_INET;
+			sin->sin_addr.s_addr = ip.saddr;
+			msg->msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			memmove(addr, &ip.saddr, sizeof(struct in_addr));
+			break;
+		case ETHERTYPE_IPV6:
+			if (frame_len < offset + sizeof(struct ip6_hdr)) {
+				return -1;
+			}
+			memmove(&ip6, frame + offset, sizeof(struct ip6_hdr));
+			if (ip6.ip6_nxt != IPPROTO_UDP) {
+				return -1;
+			}
+			offset += sizeof(struct ip6_hdr);
+			memset(sin6, 0, sizeof(struct sockaddr_in6));
+			sin6->sin6_family = AF_INET6;
+			memmove(&sin6->sin6_addr, &ip6.ip6_src, sizeof(struct in6_addr));
+			msg->msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+			memmove(addr, &ip6.ip6_src, sizeof(struct in6_addr));
+			break;
+		default:
+			return -1;
+	}
+
+	if (frame_len < offset + sizeof(struct udphdr)) {
+		return -1;
+	}
+	memmove(&udp, frame + offset, sizeof(struct udphdr));
+	offset += sizeof(struct udphdr);
+
+	payload_len = ntohs(udp.len);
+	if ((payload_len < sizeof(struct udphdr)) ||
+	    (offset + payload_len - sizeof(struct udphdr) > frame_len)) {
+		return -1;
+	}
+	payload_len -= sizeof(struct udphdr);
+
+	if (payload_len > msg->msg_hdr.msg_iov[0].iov_len) {
+		return -1;
+	}
+
+	if (sin->sin_family == AF_INET) {
+		sin->sin_port = udp.source;
+	} else {
+		sin6->sin6_port = udp.source;
+	}
+
+	memmove(msg->msg_hdr.msg_iov[0].iov_base, frame + offset, payload_len);
+	msg->msg_hdr.msg_flags = 0;
+	msg->msg_len = payload_len;
+
+	_xdp_neigh_update(xif, sin->sin_family, addr, eth.ether_shost);
+
+	return 0;
+}
+
+/*
+ * same semantics as _recvmmsg. msgvec must have one iovec per message
+ */
+int xdp_transport_rx_recvmmsg(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	xdp_if_info_t *xif;
+	struct xdp_desc *descs;
+	uint64_t *fill;
+	uint32_t cons, prod, fill_prod;
+	unsigned int received = 0;
+
+	if (knet_h->knet_transport_fd_tracker[sockfd].data_type != KNET_XDP_DATA_XSK) {
+		return _recvmmsg(sockfd, msgvec, vlen, flags);
+	}
+
+	xif = knet_h->knet_transport_fd_tracker[sockfd].data;
+	descs = xif->rx.desc;
+	fill = xif->fill.desc;
+
+	cons = *xif->rx.consumer;
+	prod = __atomic_load_n(xif->rx.producer, __ATOMIC_ACQUIRE);
+	fill_prod = *xif->fill.producer;
+
+	if (pthread_mutex_lock(&xif->mutex) != 0) {
+		log_debug(knet_h, KNET_SUB_TRANSP_XDP, "Unable to get XDP mutex lock");
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/*
+	 * the fill ring is as large as the RX frames
+	 * pool, it can always take the frames back
+	 */
+	while ((cons != prod) && (received < vlen)) {
+		if (!_xdp_parse_frame(xif, xif->umem + descs[cons & xif->rx.mask].addr,
+				      descs[cons & xif->rx.mask].len, &msgvec[received])) {
+			received++;
+		}
+		fill[fill_prod & xif->fill.mask] = descs[cons & xif->rx.mask].addr & ~((uint64_t)KNET_XDP_FRAME_SIZE - 1);
+		fill_prod++;
+		cons++;
+	}
+
+	pthread_mutex_unlock(&xif->mutex);
+
+	__atomic_store_n(xif->rx.consumer, cons, __ATOMIC_RELEASE);
+	__atomic_store_n(xif->fill.producer, fill_prod, __ATOMIC_RELEASE);
+
+	if (!received) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return received;
+}
+
+int xdp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg)
+{
+	if (msg->msg_len == 0)
+		return 0;
+
+	return 2;
+}
+
+int xdp_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link)
+{
+	kn_link->status.dynconnected = 1;
+	return 0;
+}
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include "internals.h"
+
+#ifndef __KNET_TRANSPORT_XDP_H__
+#define __KNET_TRANSPORT_XDP_H__
+
+/*
+ * on the wire XDP links are plain UDP
+ */
+#define KNET_PMTUD_XDP_OVERHEAD 8
+
+#if defined (HAVE_LINUX_IF_XDP_H) && defined (HAVE_LINUX_BPF_H) && defined (HAVE_DECL_BPF_XDP) && HAVE_DECL_BPF_XDP
+#define KNET_HAVE_XDP 1
+#endif
+
+#ifdef KNET_HAVE_XDP
+
+/*
+ * UMEM layout: one AF_XDP socket per interface, bound to queue 0,
+ * half of the frames are used for RX (fill ring) and half for TX
+ */
+#define KNET_XDP_QUEUE 0
+#define KNET_XDP_FRAME_SIZE 4096
+#define KNET_XDP_RX_FRAMES 512		/* must be a power of 2 */
+#define KNET_XDP_TX_FRAMES 512		/* must be a power of 2 */
+#define KNET_XDP_FRAMES (KNET_XDP_RX_FRAMES + KNET_XDP_TX_FRAMES)
+
+#define KNET_XDP_MAX_PORTS 64		/* local UDP ports redirected to AF_XDP per interface */
+#define KNET_XDP_NEIGH_SIZE 256		/* must be a power of 2 */
+
+/*
+ * fd tracker data_type
+ */
+#define KNET_XDP_DATA_SOCK 0		/* kernel UDP socket */
+#define KNET_XDP_DATA_XSK 1		/* AF_XDP socket */
+
+int xdp_transport_link_set_config(knet_handle_t knet_h, struct knet_link *kn_link);
+int xdp_transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link);
+int xdp_transport_free(knet_handle_t knet_h);
+int xdp_transport_init(knet_handle_t knet_h);
+int xdp_transport_rx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int xdp_transport_tx_sock_error(knet_handle_t knet_h, int sockfd, int recv_err, int recv_errno);
+int xdp_transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+int xdp_transport_rx_recvmmsg(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+int xdp_transport_rx_is_data(knet_handle_t knet_h, int sockfd, struct knet_mmsghdr *msg);
+int xdp_transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link);
+
+#endif
+
+#endif
@@ -22,9 +22,12 @@
 #include "logging.h"
 #include "common.h"
 #include "transports.h"
+#include "transport_common.h"
 #include "transport_loopback.h"
 #include "transport_udp.h"
 #include "transport_sctp.h"
+#include "transport_xdp.h"
+#include "transport_shm.h"
 #include "threads_common.h"
 
 #define empty_module 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL },
@@ -37,6 +40,18 @@ static knet_transport_ops_t transport_modules_cmd[KNET_MAX_TRANSPORTS] = {
 				       1, KNET_PMTUD_SCTP_OVERHEAD, sctp_transport_init, sctp_transport_free, sctp_transport_link_set_config, sctp_transport_link_clear_config, sctp_transport_link_dyn_connect, sctp_transport_rx_sock_error, sctp_transport_tx_sock_error, sctp_transport_rx_is_data },
 #else
 empty_module
+#endif
+	{ "XDP", KNET_TRANSPORT_XDP,
+#ifdef KNET_HAVE_XDP
+				       1, KNET_PMTUD_XDP_OVERHEAD, xdp_transport_init, xdp_transport_free, xdp_transport_link_set_config, xdp_transport_link_clear_config, xdp_transport_link_dyn_connect, xdp_transport_rx_sock_error, xdp_transport_tx_sock_error, xdp_transport_rx_is_data },
+#else
+empty_module
+#endif
+	{ "SHM", KNET_TRANSPORT_SHM,
+#ifdef KNET_HAVE_SHM
+				       1, KNET_PMTUD_SHM_OVERHEAD, shm_transport_init, shm_transport_free, shm_transport_link_set_config, shm_transport_link_clear_config, shm_transport_link_dyn_connect, shm_transport_rx_sock_error, shm_transport_tx_sock_error, shm_transport_rx_is_data },
+#else
+empty_module
 #endif
 	{ NULL, KNET_MAX_TRANSPORTS, empty_module
 };
@@ -100,7 +115,14 @@ int transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link)
 
 int transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link)
 {
-	return transport_modules_cmd[kn_link->transport_type].transport_link_dyn_connect(knet_h, sockfd, kn_link);
+	uint8_t dynconnected = kn_link->status.dynconnected;
+	int err;
+
+	err = transport_modules_cmd[kn_link->transport_type].transport_link_dyn_connect(knet_h, sockfd, kn_link);
+	if (kn_link->status.dynconnected != dynconnected) {
+		kn_link->status_generation = _host_topology_changed(knet_h);
+	}
+	return err;
 }
 
 int transport_rx_sock_error(knet_handle_t knet_h, uint8_t transport, int sockfd, int recv_err, int recv_errno)
@@ -113,11 +135,102 @@ int transport_tx_sock_error(knet_handle_t knet_h, uint8_t transport, int sockfd,
 	return transport_modules_cmd[transport].transport_tx_sock_error(knet_h, sockfd, recv_err, recv_errno);
 }
 
+/*
+ * send a train of packets to the same link destination,
+ * letting the transport merge them (GSO) or avoid
+ * copies (MSG_ZEROCOPY) when it can
+ */
+int transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+	if (kn_link->transport_type == KNET_TRANSPORT_UDP) {
+		return udp_transport_tx_sendmmsg(knet_h, kn_link, msgvec, vlen, flags);
+	}
+#ifdef HAVE_NETINET_SCTP_H
+	if (kn_link->transport_type == KNET_TRANSPORT_SCTP) {
+		return sctp_transport_tx_sendmmsg(knet_h, kn_link, msgvec, vlen, flags);
+	}
+#endif
+#ifdef KNET_HAVE_XDP
+	if (kn_link->transport_type == KNET_TRANSPORT_XDP) {
+		return xdp_transport_tx_sendmmsg(knet_h, kn_link, msgvec, vlen, flags);
+	}
+#endif
+#ifdef KNET_HAVE_SHM
+	if (kn_link->transport_type == KNET_TRANSPORT_SHM) {
+		return shm_transport_tx_sendmmsg(knet_h, kn_link, msgvec, vlen, flags);
+	}
+#endif
+
+	return _sendmmsg(kn_link->outsock, msgvec, vlen, flags);
+}
+
+/*
+ * send a single control packet (heartbeat, PMTUd) to the link destination
+ */
+ssize_t transport_tx_sendto(knet_handle_t knet_h, struct knet_link *kn_link, const void *buf, size_t len, int flags)
+{
+#ifdef KNET_HAVE_SHM
+	if (kn_link->transport_type == KNET_TRANSPORT_SHM) {
+		return shm_transport_tx_sendto(knet_h, kn_link, buf, len, flags);
+	}
+#endif
+
+	return sendto(kn_link->outsock, buf, len, flags,
+		      (struct sockaddr *) &kn_link->dst_addr,
+		      sizeof(struct sockaddr_storage));
+}
+
+/*
+ * transports that do not receive from a socket (AF_XDP and shared
+ * memory rings) hand their packets to the RX thread in recvmmsg format
+ */
+int transport_rx_recvmmsg(knet_handle_t knet_h, uint8_t transport, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags)
+{
+#ifdef KNET_HAVE_XDP
+	if (transport == KNET_TRANSPORT_XDP) {
+		return xdp_transport_rx_recvmmsg(knet_h, sockfd, msgvec, vlen, flags);
+	}
+#endif
+#ifdef KNET_HAVE_SHM
+	if (transport == KNET_TRANSPORT_SHM) {
+		return shm_transport_rx_recvmmsg(knet_h, sockfd, msgvec, vlen, flags);
+	}
+#endif
+
+	return _recvmmsg(sockfd, msgvec, vlen, flags);
+}
+
 int transport_rx_is_data(knet_handle_t knet_h, uint8_t transport, int sockfd, struct knet_mmsghdr *msg)
 {
 	return transport_modules_cmd[transport].transport_rx_is_data(knet_h, sockfd, msg);
 }
 
+/*
+ * returns the segment size of a buffer coalesced by the kernel,
+ * 0 if the buffer holds a single packet
+ */
+size_t transport_rx_gro_size(knet_handle_t knet_h, uint8_t transport, struct knet_mmsghdr *msg)
+{
+	if (transport == KNET_TRANSPORT_UDP) {
+		return udp_transport_rx_gro_size(knet_h, msg);
+	}
+
+	return 0;
+}
+
+/*
+ * the broadcast multicast group is only available via UDP
+ */
+int transport_mcast_set_config(knet_handle_t knet_h)
+{
+	return udp_transport_mcast_set_config(knet_h);
+}
+
+int transport_mcast_clear_config(knet_handle_t knet_h)
+{
+	return udp_transport_mcast_clear_config(knet_h);
+}
+
 /*
  * public api
  */
@@ -17,6 +17,12 @@ int transport_link_clear_config(knet_handle_t knet_h, struct knet_link *kn_link)
 int transport_link_dyn_connect(knet_handle_t knet_h, int sockfd, struct knet_link *kn_link);
 int transport_rx_sock_error(knet_handle_t knet_h, uint8_t transport, int sockfd, int recv_err, int recv_errno);
 int transport_tx_sock_error(knet_handle_t knet_h, uint8_t transport, int sockfd, int recv_err, int recv_errno);
+int transport_tx_sendmmsg(knet_handle_t knet_h, struct knet_link *kn_link, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+ssize_t transport_tx_sendto(knet_handle_t knet_h, struct knet_link *kn_link, const void *buf, size_t len, int flags);
+int transport_rx_recvmmsg(knet_handle_t knet_h, uint8_t transport, int sockfd, struct knet_mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
 int transport_rx_is_data(knet_handle_t knet_h, uint8_t transport, int sockfd, struct knet_mmsghdr *msg);
+size_t transport_rx_gro_size(knet_handle_t knet_h, uint8_t transport, struct knet_mmsghdr *msg);
+int transport_mcast_set_config(knet_handle_t knet_h);
+int transport_mcast_clear_config(knet_handle_t knet_h);
 
 #endif
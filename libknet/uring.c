@@ -0,0 +1,539 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <endian.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "compat.h"
+#include "logging.h"
+#include "uring.h"
+
+#ifdef KNET_HAVE_IO_URING
+
+static int _io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete,
+			   unsigned int flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int _io_uring_register(int ring_fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static void _uring_unmap(struct knet_uring *uring)
+{
+	if ((uring->cq_ptr) && (uring->cq_ptr != uring->sq_ptr)) {
+		munmap(uring->cq_ptr, uring->cq_size);
+	}
+	if (uring->sq_ptr) {
+		munmap(uring->sq_ptr, uring->sq_size);
+	}
+	if (uring->sqes) {
+		munmap(uring->sqes, uring->sqes_size);
+	}
+	if (uring->buf_ring) {
+		munmap(uring->buf_ring, uring->buf_ring_size);
+	}
+	free(uring->bufs);
+}
+
+static int _uring_map(struct knet_uring *uring, struct io_uring_params *p)
+{
+	uring->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	uring->cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (uring->cq_size > uring->sq_size) {
+			uring->sq_size = uring->cq_size;
+		}
+		uring->cq_size = uring->sq_size;
+	}
+
+	uring->sq_ptr = mmap(NULL, uring->sq_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+	if (uring->sq_ptr == MAP_FAILED) {
+		uring->sq_ptr = NULL;
+		return -1;
+	}
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		uring->cq_ptr = uring->sq_ptr;
+	} else {
+		uring->cq_ptr = mmap(NULL, uring->cq_size, PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_CQ_RING);
+		if (uring->cq_ptr == MAP_FAILED) {
+			uring->cq_ptr = NULL;
+			return -1;
+		}
+	}
+
+	uring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED) {
+		uring->sqes = NULL;
+		return -1;
+	}
+
+	uring->sq_head = (unsigned int *)((char *)uring->sq_ptr + p->sq_off.head);
+	uring->sq_tail = (unsigned int *)((char *)uring->sq_ptr + p->sq_off.tail);
+	uring->sq_mask = (unsigned int *)((char *)uring->sq_ptr + p->sq_off.ring_mask);
+	uring->sq_array = (unsigned int *)((char *)uring->sq_ptr + p->sq_off.array);
+	uring->sq_entries = p->sq_entries;
+
+	uring->cq_head = (unsigned int *)((char *)uring->cq_ptr + p->cq_off.head);
+	uring->cq_tail = (unsigned int *)((char *)uring->cq_ptr + p->cq_off.tail);
+	uring->cq_mask = (unsigned int *)((char *)uring->cq_ptr + p->cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ptr + p->cq_off.cqes);
+
+	return 0;
+}
+
+/*
+ * hand all the RX buffers to the kernel
+ */
+static int _uring_setup_bufs(struct knet_uring *uring)
+{
+	struct io_uring_buf_reg reg;
+	struct io_uring_buf *buf;
+	uint16_t i;
+
+	uring->buf_size = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage) +
+			  PCKT_RX_CMSG_SIZE + (KNET_DATABUFSIZE);
+
+	uring->bufs = malloc(uring->buf_size * KNET_URING_BUFS);
+	if (!uring->bufs) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	uring->buf_ring_size = KNET_URING_BUFS * sizeof(struct io_uring_buf);
+	uring->buf_ring = mmap(NULL, uring->buf_ring_size, PROT_READ | PROT_WRITE,
+			       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (uring->buf_ring == MAP_FAILED) {
+		uring->buf_ring = NULL;
+		return -1;
+	}
+
+	memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)uring->buf_ring;
+	reg.ring_entries = KNET_URING_BUFS;
+	reg.bgid = KNET_URING_BGID;
+
+	if (_io_uring_register(uring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < KNET_URING_BUFS; i++) {
+		buf = &uring->buf_ring->bufs[i];
+		buf->addr = (uint64_t)(uintptr_t)(uring->bufs + (i * uring->buf_size));
+		buf->len = uring->buf_size;
+		buf->bid = i;
+	}
+	__atomic_store_n(&uring->buf_ring->tail, KNET_URING_BUFS, __ATOMIC_RELEASE);
+
+	/*
+	 * the kernel lays out each buffer as
+	 * io_uring_recvmsg_out + name + control + payload
+	 */
+	memset(&uring->recv_msg, 0, sizeof(struct msghdr));
+	uring->recv_msg.msg_namelen = sizeof(struct sockaddr_storage);
+	uring->recv_msg.msg_controllen = PCKT_RX_CMSG_SIZE;
+
+	return 0;
+}
+
+int uring_init(knet_handle_t knet_h)
+{
+	struct knet_uring *uring;
+	struct io_uring_params p;
+	int savederrno = 0;
+
+	uring = malloc(sizeof(struct knet_uring));
+	if (!uring) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to allocate memory for io_uring");
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(uring, 0, sizeof(struct knet_uring));
+	uring->ring_fd = -1;
+
+	savederrno = pthread_mutex_init(&uring->sq_mutex, NULL);
+	if (savederrno) {
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to initialize io_uring mutex: %s",
+			strerror(savederrno));
+		free(uring);
+		errno = savederrno;
+		return -1;
+	}
+
+	memset(&p, 0, sizeof(struct io_uring_params));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = KNET_URING_CQ_ENTRIES;
+
+	uring->ring_fd = _io_uring_setup(KNET_URING_SQ_ENTRIES, &p);
+	if (uring->ring_fd < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to create io_uring: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	if ((!(p.features & IORING_FEAT_EXT_ARG)) ||
+	    (!(p.features & IORING_FEAT_NODROP))) {
+		savederrno = EOPNOTSUPP;
+		log_err(knet_h, KNET_SUB_HANDLE, "io_uring is missing required features: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	if (_uring_map(uring, &p) < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to map io_uring: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	if (_uring_setup_bufs(uring) < 0) {
+		savederrno = errno;
+		log_err(knet_h, KNET_SUB_HANDLE, "Unable to setup io_uring buffers: %s",
+			strerror(savederrno));
+		goto exit_fail;
+	}
+
+	knet_h->uring = uring;
+
+	log_debug(knet_h, KNET_SUB_HANDLE, "io_uring RX engine enabled (%u buffers)", KNET_URING_BUFS);
+
+	return 0;
+
+exit_fail:
+	_uring_unmap(uring);
+	if (uring->ring_fd >= 0) {
+		close(uring->ring_fd);
+	}
+	pthread_mutex_destroy(&uring->sq_mutex);
+	free(uring);
+	errno = savederrno;
+	return -1;
+}
+
+void uring_free(knet_handle_t knet_h)
+{
+	struct knet_uring *uring = knet_h->uring;
+
+	if (!uring) {
+		return;
+	}
+
+	/*
+	 * closing the ring cancels all pending requests
+	 * and releases the sockets they reference
+	 */
+	close(uring->ring_fd);
+	_uring_unmap(uring);
+	pthread_mutex_destroy(&uring->sq_mutex);
+	free(uring);
+	knet_h->uring = NULL;
+}
+
+/*
+ * requests are rare (one per socket), submit them right away
+ */
+static int _uring_submit(knet_handle_t knet_h, uint8_t opcode, int fd, uint64_t addr,
+			 uint32_t len, uint32_t op_flags, uint16_t ioprio, uint8_t sqe_flags,
+			 uint64_t user_data)
+{
+	struct knet_uring *uring = knet_h->uring;
+	struct io_uring_sqe *sqe;
+	unsigned int head, tail, idx;
+	int err = 0, savederrno = 0;
+
+	savederrno = pthread_mutex_lock(&uring->sq_mutex);
+	if (savederrno) {
+		log_debug(knet_h, KNET_SUB_HANDLE, "Unable to get io_uring mutex lock");
+		errno = savederrno;
+		return -1;
+	}
+
+	head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+	tail = *uring->sq_tail;
+	if (tail - head >= uring->sq_entries) {
+		savederrno = EBUSY;
+		err = -1;
+		goto out_unlock;
+	}
+
+	idx = tail & *uring->sq_mask;
+	sqe = &uring->sqes[idx];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = addr;
+	sqe->len = len;
+	if (opcode == IORING_OP_POLL_ADD) {
+#if __BYTE_ORDER == __BIG_ENDIAN
+		op_flags = (op_flags << 16) | (op_flags >> 16);
+#endif
+		sqe->poll32_events = op_flags;
+	} else {
+		sqe->msg_flags = op_flags;
+	}
+	sqe->ioprio = ioprio;
+	sqe->flags = sqe_flags;
+	if (sqe_flags & IOSQE_BUFFER_SELECT) {
+		sqe->buf_group = KNET_URING_BGID;
+	}
+	sqe->user_data = user_data;
+
+	uring->sq_array[idx] = idx;
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (_io_uring_enter(uring->ring_fd, 1, 0, 0, NULL, 0) < 0) {
+		savederrno = errno;
+		err = -1;
+	}
+
+out_unlock:
+	pthread_mutex_unlock(&uring->sq_mutex);
+	errno = err ? savederrno : 0;
+	return err;
+}
+
+/*
+ * get notified when the RX epoll fd has events
+ */
+int uring_poll_epoll(knet_handle_t knet_h)
+{
+	return _uring_submit(knet_h, IORING_OP_POLL_ADD, knet_h->recv_from_links_epollfd,
+			     0, IORING_POLL_ADD_MULTI, POLLIN, 0, 0, KNET_URING_EPOLL_DATA);
+}
+
+int uring_recvmsg(knet_handle_t knet_h, int sockfd, uint64_t user_data)
+{
+	if (knet_h->uring->multishot_failed) {
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	return _uring_submit(knet_h, IORING_OP_RECVMSG, sockfd,
+			     (uint64_t)(uintptr_t)&knet_h->uring->recv_msg, 1, 0,
+			     IORING_RECV_MULTISHOT, IOSQE_BUFFER_SELECT, user_data);
+}
+
+/*
+ * multishot recvmsg requires Linux >= 6.0, older kernels
+ * fail the request with EINVAL. Sockets stay on epoll.
+ */
+void uring_disable_recvmsg(knet_handle_t knet_h)
+{
+	if (!knet_h->uring->multishot_failed) {
+		log_warn(knet_h, KNET_SUB_RX, "io_uring multishot recvmsg is not supported by the kernel, using epoll");
+		knet_h->uring->multishot_failed = 1;
+	}
+}
+
+int uring_cancel(knet_handle_t knet_h, uint64_t user_data)
+{
+	return _uring_submit(knet_h, IORING_OP_ASYNC_CANCEL, -1,
+			     user_data, 0, 0, 0, 0, KNET_URING_CANCEL_DATA);
+}
+
+/*
+ * wait for completions, up to timeout usecs
+ */
+int uring_wait(knet_handle_t knet_h, useconds_t timeout)
+{
+	struct knet_uring *uring = knet_h->uring;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+
+	if (__atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE) != *uring->cq_head) {
+		return 0;
+	}
+
+	ts.tv_sec = timeout / 1000000;
+	ts.tv_nsec = (timeout % 1000000) * 1000;
+
+	memset(&arg, 0, sizeof(struct io_uring_getevents_arg));
+	arg.sigmask_sz = _NSIG / 8;
+	arg.ts = (uint64_t)(uintptr_t)&ts;
+
+	if (_io_uring_enter(uring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			    &arg, sizeof(struct io_uring_getevents_arg)) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * pop a completion, returns 0 if there is none
+ */
+int uring_get_cqe(knet_handle_t knet_h, uint64_t *user_data, int32_t *res, uint32_t *flags)
+{
+	struct knet_uring *uring = knet_h->uring;
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+
+	head = *uring->cq_head;
+	if (head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+
+	cqe = &uring->cqes[head & *uring->cq_mask];
+	*user_data = cqe->user_data;
+	*res = cqe->res;
+	*flags = cqe->flags;
+
+	__atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/*
+ * fill msg to point to the data of a recvmsg completion.
+ * iov and name are in the buffer, msg_hdr.msg_iov must
+ * point to an iovec provided by the caller.
+ */
+int uring_get_msg(knet_handle_t knet_h, int32_t res, uint32_t flags, struct knet_mmsghdr *msg)
+{
+	struct knet_uring *uring = knet_h->uring;
+	struct io_uring_recvmsg_out *out;
+	unsigned char *buf;
+	size_t hdrlen;
+	uint16_t bid;
+
+	if (!(flags & IORING_CQE_F_BUFFER)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	bid = flags >> IORING_CQE_BUFFER_SHIFT;
+	buf = uring->bufs + (bid * uring->buf_size);
+	out = (struct io_uring_recvmsg_out *)buf;
+
+	hdrlen = sizeof(struct io_uring_recvmsg_out) + uring->recv_msg.msg_namelen + uring->recv_msg.msg_controllen;
+	if ((res < 0) || ((size_t)res < hdrlen)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	msg->msg_hdr.msg_name = buf + sizeof(struct io_uring_recvmsg_out);
+	msg->msg_hdr.msg_namelen = out->namelen;
+	msg->msg_hdr.msg_control = buf + sizeof(struct io_uring_recvmsg_out) + uring->recv_msg.msg_namelen;
+	msg->msg_hdr.msg_controllen = out->controllen;
+	msg->msg_hdr.msg_flags = out->flags;
+	msg->msg_hdr.msg_iov->iov_base = buf + hdrlen;
+	msg->msg_hdr.msg_iov->iov_len = res - hdrlen;
+	msg->msg_hdr.msg_iovlen = 1;
+	msg->msg_len = res - hdrlen;
+
+	return 0;
+}
+
+/*
+ * give a buffer back to the kernel
+ */
+void uring_put_buf(knet_handle_t knet_h, uint32_t flags)
+{
+	struct knet_uring *uring = knet_h->uring;
+	struct io_uring_buf *buf;
+	uint16_t bid, tail;
+
+	if (!(flags & IORING_CQE_F_BUFFER)) {
+		return;
+	}
+
+	bid = flags >> IORING_CQE_BUFFER_SHIFT;
+	tail = uring->buf_ring->tail;
+
+	buf = &uring->buf_ring->bufs[tail & (KNET_URING_BUFS - 1)];
+	buf->addr = (uint64_t)(uintptr_t)(uring->bufs + (bid * uring->buf_size));
+	buf->len = uring->buf_size;
+	buf->bid = bid;
+
+	__atomic_store_n(&uring->buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+#else
+
+int uring_init(knet_handle_t knet_h)
+{
+	log_err(knet_h, KNET_SUB_HANDLE, "io_uring support is not available in this build");
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+void uring_free(knet_handle_t knet_h)
+{
+	return;
+}
+
+int uring_poll_epoll(knet_handle_t knet_h)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+int uring_recvmsg(knet_handle_t knet_h, int sockfd, uint64_t user_data)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+void uring_disable_recvmsg(knet_handle_t knet_h)
+{
+	return;
+}
+
+int uring_cancel(knet_handle_t knet_h, uint64_t user_data)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+int uring_wait(knet_handle_t knet_h, useconds_t timeout)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+int uring_get_cqe(knet_handle_t knet_h, uint64_t *user_data, int32_t *res, uint32_t *flags)
+{
+	return 0;
+}
+
+int uring_get_msg(knet_handle_t knet_h, int32_t res, uint32_t flags, struct knet_mmsghdr *msg)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+void uring_put_buf(knet_handle_t knet_h, uint32_t flags)
+{
+	return;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Red Hat, Inc.  All rights reserved.
+ *
+ * Authors: Fabio M. Di Nitto <fabbione@kronosnet.org>
+ *
+ * This software licensed under GPL-2.0+, LGPL-2.0+
+ */
+
+#ifndef __KNET_URING_H__
+#define __KNET_URING_H__
+
+#include "internals.h"
+
+/*
+ * io_uring RX engine for link sockets.
+ *
+ * link sockets are received with multishot recvmsg into a ring of
+ * buffers provided to the kernel, the RX thread only needs to reap
+ * completions. Sockets not handled by io_uring (SCTP) and socket
+ * errors are still dispatched via the RX epoll fd, that io_uring
+ * polls for us.
+ *
+ * liburing is not required, the few bits we need are implemented
+ * on top of the raw syscalls.
+ */
+
+#if defined (HAVE_LINUX_IO_URING_H) && defined (HAVE_SYS_EPOLL_H)
+#include <linux/io_uring.h>
+#if defined (IORING_RECV_MULTISHOT) && defined (IORING_CQE_F_BUFFER) && defined (IORING_FEAT_EXT_ARG)
+#define KNET_HAVE_IO_URING 1
+#endif
+#endif
+
+#define KNET_URING_SQ_ENTRIES 64
+#define KNET_URING_CQ_ENTRIES 4096
+#define KNET_URING_BUFS 256		/* must be a power of 2 */
+#define KNET_URING_BGID 0
+
+/*
+ * user_data of the internal requests, link sockets
+ * use (fd tracker generation << 32 | sockfd)
+ */
+#define KNET_URING_EPOLL_DATA UINT64_MAX
+#define KNET_URING_CANCEL_DATA (UINT64_MAX - 1)
+
+#define KNET_URING_SOCK_DATA(gen, sockfd) (((uint64_t)(gen) << 32) | (uint32_t)(sockfd))
+#define KNET_URING_SOCK_FD(data) ((int)((data) & UINT32_MAX))
+#define KNET_URING_SOCK_GEN(data) ((uint32_t)((data) >> 32))
+
+#ifdef KNET_HAVE_IO_URING
+#define KNET_URING_CQE_MORE IORING_CQE_F_MORE
+#else
+#define KNET_URING_CQE_MORE 0
+#endif
+
+#ifdef KNET_HAVE_IO_URING
+struct knet_uring {
+	int ring_fd;
+	pthread_mutex_t sq_mutex;	/* SQ is written by the RX thread and by link config (cancel) */
+	int multishot_failed;		/* kernel does not support multishot recvmsg */
+
+	void *sq_ptr;
+	size_t sq_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int sq_entries;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	void *cq_ptr;
+	size_t cq_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	struct io_uring_buf_ring *buf_ring;
+	size_t buf_ring_size;
+	unsigned char *bufs;
+	size_t buf_size;
+
+	struct msghdr recv_msg;		/* multishot recvmsg layout of the buffers */
+};
+#endif
+
+int uring_init(knet_handle_t knet_h);
+void uring_free(knet_handle_t knet_h);
+
+int uring_poll_epoll(knet_handle_t knet_h);
+int uring_recvmsg(knet_handle_t knet_h, int sockfd, uint64_t user_data);
+void uring_disable_recvmsg(knet_handle_t knet_h);
+int uring_cancel(knet_handle_t knet_h, uint64_t user_data);
+int uring_wait(knet_handle_t knet_h, useconds_t timeout);
+
+int uring_get_cqe(knet_handle_t knet_h, uint64_t *user_data, int32_t *res, uint32_t *flags);
+int uring_get_msg(knet_handle_t knet_h, int32_t res, uint32_t flags, struct knet_mmsghdr *msg);
+void uring_put_buf(knet_handle_t knet_h, uint32_t flags);
+
+#endif